@@ -135,6 +135,7 @@ print_bearer_info (MMBearer *bearer)
     MMBearerIpConfig *ipv4_config;
     MMBearerIpConfig *ipv6_config;
     MMBearerProperties *properties;
+    GVariant *stats;
 
     ipv4_config = mm_bearer_get_ipv4_config (bearer);
     ipv6_config = mm_bearer_get_ipv6_config (bearer);
@@ -253,6 +254,37 @@ print_bearer_info (MMBearer *bearer)
             g_print ("                     |      MTU: '%u'\n", mtu);
     }
 
+    /* Stats */
+    stats = mm_bearer_dup_stats (bearer);
+    if (stats) {
+        guint64 rx_bytes;
+        guint64 tx_bytes;
+        guint32 duration = 0;
+        guint32 attempts = 0;
+        guint32 failed_attempts = 0;
+        guint32 latency = 0;
+
+        g_variant_lookup (stats, "duration", "u", &duration);
+        g_variant_lookup (stats, "attempts", "u", &attempts);
+        g_variant_lookup (stats, "failed-attempts", "u", &failed_attempts);
+        g_variant_lookup (stats, "last-connect-latency", "u", &latency);
+
+        g_print ("  -------------------------\n"
+                 "  Stats              |         duration: '%u'\n"
+                 "                     |         attempts: '%u'\n"
+                 "                     |  failed attempts: '%u'\n"
+                 "                     |  connect latency: '%u ms'\n",
+                 duration, attempts, failed_attempts, latency);
+
+        if (g_variant_lookup (stats, "rx-bytes", "t", &rx_bytes) &&
+            g_variant_lookup (stats, "tx-bytes", "t", &tx_bytes))
+            g_print ("                     |         bytes rx: '%" G_GUINT64_FORMAT "'\n"
+                     "                     |         bytes tx: '%" G_GUINT64_FORMAT "'\n",
+                     rx_bytes, tx_bytes);
+
+        g_variant_unref (stats);
+    }
+
     g_clear_object (&properties);
     g_clear_object (&ipv4_config);
     g_clear_object (&ipv6_config);
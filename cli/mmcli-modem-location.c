@@ -64,6 +64,8 @@ static gboolean enable_gps_unmanaged_flag;
 static gboolean disable_gps_unmanaged_flag;
 static gboolean get_all_flag;
 static gchar *set_supl_server_str;
+static gchar *set_gps_refresh_rate_str;
+static gchar *set_gps_distance_threshold_str;
 
 static GOptionEntry entries[] = {
     { "location-status", 0, 0, G_OPTION_ARG_NONE, &status_flag,
@@ -142,6 +144,14 @@ static GOptionEntry entries[] = {
       "Set SUPL server address",
       "[IP:PORT] or [URL]"
     },
+    { "location-set-gps-refresh-rate", 0, 0, G_OPTION_ARG_STRING, &set_gps_refresh_rate_str,
+      "Set minimum time between GPS location updates (0 to disable rate limiting)",
+      "[SECONDS]"
+    },
+    { "location-set-gps-distance-threshold", 0, 0, G_OPTION_ARG_STRING, &set_gps_distance_threshold_str,
+      "Set distance which triggers a GPS location update right away (0 to disable)",
+      "[METERS]"
+    },
     { NULL }
 };
 
@@ -203,7 +213,9 @@ mmcli_modem_location_options_enabled (void)
                     get_gps_nmea_flag +
                     get_gps_raw_flag +
                     get_cdma_bs_flag) +
-                 !!set_supl_server_str);
+                 !!set_supl_server_str +
+                 !!set_gps_refresh_rate_str +
+                 !!set_gps_distance_threshold_str);
 
     if (n_actions > 1) {
         g_printerr ("error: too many Location actions requested\n");
@@ -283,6 +295,15 @@ print_location_status (void)
                  "  A-GPS    |  SUPL server: '%s'\n",
                  mm_modem_location_get_supl_server (ctx->modem_location));
 
+    /* If GPS supported, show update rules */
+    if (mm_modem_location_get_capabilities (ctx->modem_location) & (MM_MODEM_LOCATION_SOURCE_GPS_RAW |
+                                                                    MM_MODEM_LOCATION_SOURCE_GPS_NMEA))
+        g_print ("  ----------------------------\n"
+                 "  GPS      | refresh rate: '%u seconds'\n"
+                 "           |     distance: '%u meters'\n",
+                 mm_modem_location_get_gps_refresh_rate (ctx->modem_location),
+                 mm_modem_location_get_gps_distance_threshold (ctx->modem_location));
+
     g_free (capabilities_str);
     g_free (enabled_str);
 }
@@ -339,6 +360,71 @@ set_supl_server_ready (MMModemLocation *modem_location,
     mmcli_async_operation_done ();
 }
 
+static void
+set_gps_refresh_rate_process_reply (gboolean result,
+                                    const GError *error)
+{
+    if (!result) {
+        g_printerr ("error: couldn't set GPS refresh rate: '%s'\n",
+                    error ? error->message : "unknown error");
+        exit (EXIT_FAILURE);
+    }
+
+    g_print ("successfully set GPS refresh rate\n");
+}
+
+static void
+set_gps_refresh_rate_ready (MMModemLocation *modem_location,
+                            GAsyncResult    *result)
+{
+    gboolean operation_result;
+    GError *error = NULL;
+
+    operation_result = mm_modem_location_set_gps_refresh_rate_finish (modem_location, result, &error);
+    set_gps_refresh_rate_process_reply (operation_result, error);
+
+    mmcli_async_operation_done ();
+}
+
+static void
+set_gps_distance_threshold_process_reply (gboolean result,
+                                          const GError *error)
+{
+    if (!result) {
+        g_printerr ("error: couldn't set GPS distance threshold: '%s'\n",
+                    error ? error->message : "unknown error");
+        exit (EXIT_FAILURE);
+    }
+
+    g_print ("successfully set GPS distance threshold\n");
+}
+
+static void
+set_gps_distance_threshold_ready (MMModemLocation *modem_location,
+                                  GAsyncResult    *result)
+{
+    gboolean operation_result;
+    GError *error = NULL;
+
+    operation_result = mm_modem_location_set_gps_distance_threshold_finish (modem_location, result, &error);
+    set_gps_distance_threshold_process_reply (operation_result, error);
+
+    mmcli_async_operation_done ();
+}
+
+static guint
+parse_uint_option (const gchar *str,
+                   const gchar *name)
+{
+    guint value;
+
+    if (!mm_get_uint_from_str (str, &value)) {
+        g_printerr ("error: invalid %s value '%s'\n", name, str);
+        exit (EXIT_FAILURE);
+    }
+    return value;
+}
+
 static MMModemLocationSource
 build_sources_from_flags (void)
 {
@@ -587,6 +673,28 @@ get_modem_ready (GObject      *source,
         return;
     }
 
+    /* Request to set GPS refresh rate? */
+    if (set_gps_refresh_rate_str) {
+        g_debug ("Asynchronously setting GPS refresh rate...");
+        mm_modem_location_set_gps_refresh_rate (ctx->modem_location,
+                                                parse_uint_option (set_gps_refresh_rate_str, "refresh rate"),
+                                                ctx->cancellable,
+                                                (GAsyncReadyCallback)set_gps_refresh_rate_ready,
+                                                NULL);
+        return;
+    }
+
+    /* Request to set GPS distance threshold? */
+    if (set_gps_distance_threshold_str) {
+        g_debug ("Asynchronously setting GPS distance threshold...");
+        mm_modem_location_set_gps_distance_threshold (ctx->modem_location,
+                                                      parse_uint_option (set_gps_distance_threshold_str, "distance threshold"),
+                                                      ctx->cancellable,
+                                                      (GAsyncReadyCallback)set_gps_distance_threshold_ready,
+                                                      NULL);
+        return;
+    }
+
     g_warn_if_reached ();
 }
 
@@ -692,5 +800,31 @@ mmcli_modem_location_run_synchronous (GDBusConnection *connection)
         return;
     }
 
+    /* Request to set GPS refresh rate? */
+    if (set_gps_refresh_rate_str) {
+        gboolean result;
+
+        g_debug ("Synchronously setting GPS refresh rate...");
+        result = mm_modem_location_set_gps_refresh_rate_sync (ctx->modem_location,
+                                                              parse_uint_option (set_gps_refresh_rate_str, "refresh rate"),
+                                                              NULL,
+                                                              &error);
+        set_gps_refresh_rate_process_reply (result, error);
+        return;
+    }
+
+    /* Request to set GPS distance threshold? */
+    if (set_gps_distance_threshold_str) {
+        gboolean result;
+
+        g_debug ("Synchronously setting GPS distance threshold...");
+        result = mm_modem_location_set_gps_distance_threshold_sync (ctx->modem_location,
+                                                                    parse_uint_option (set_gps_distance_threshold_str, "distance threshold"),
+                                                                    NULL,
+                                                                    &error);
+        set_gps_distance_threshold_process_reply (result, error);
+        return;
+    }
+
     g_warn_if_reached ();
 }
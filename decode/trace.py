@@ -0,0 +1,110 @@
+#!/usr/bin/python
+# -*- Mode: python; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details:
+#
+# ---- Dumps binary trace files written by ModemManager --trace-file
+
+import binascii
+import struct
+import sys
+import time
+
+TRACE_MAGIC = b"MMTRACE1"
+
+# Header: magic, header_size, data_size, head, tail, wrap, n_ports
+HEADER_FORMAT = "<8s6I"
+# Port slot: id, type, device
+PORT_FORMAT = "<II32s"
+MAX_PORTS = 256
+# Record: len, port_id, timestamp, data_len, direction, reserved
+RECORD_FORMAT = "<IIqIB3x"
+
+# MMPortType
+port_types = {
+    0: "unknown",
+    1: "ignored",
+    2: "net",
+    3: "at",
+    4: "qcdm",
+    5: "gps",
+    6: "qmi",
+    7: "mbim",
+}
+
+TEXT_PORT_TYPES = [ 3, 5 ]
+
+def escape_text(data):
+    out = ""
+    for b in bytearray(data):
+        if b == 0x0d:
+            out += "<CR>"
+        elif b == 0x0a:
+            out += "<LF>"
+        elif b >= 0x20 and b < 0x7f:
+            out += chr(b)
+        else:
+            out += "\\%u" % b
+    return "'" + out + "'"
+
+def read_ports(buf):
+    ports = {}
+    offset = struct.calcsize(HEADER_FORMAT)
+    size = struct.calcsize(PORT_FORMAT)
+    for i in range(0, MAX_PORTS):
+        (pid, ptype, device) = struct.unpack_from(PORT_FORMAT, buf, offset + i * size)
+        if pid != 0:
+            ports[pid] = (ptype, device.split(b"\0")[0].decode("ascii", "replace"))
+    return ports
+
+def records(buf, header_size, start, end):
+    rsize = struct.calcsize(RECORD_FORMAT)
+    offset = start
+    while offset < end:
+        (rlen, pid, ts, dlen, direction) = struct.unpack_from(RECORD_FORMAT, buf, header_size + offset)
+        if rlen == 0:
+            raise Exception("corrupted record at offset %u" % offset)
+        data_start = header_size + offset + rsize
+        yield (pid, ts, direction, buf[data_start:data_start + dlen])
+        offset += rlen
+
+def dump(path):
+    f = open(path, "rb")
+    buf = f.read()
+    f.close()
+
+    (magic, header_size, data_size, head, tail, wrap, n_ports) = struct.unpack_from(HEADER_FORMAT, buf, 0)
+    if magic != TRACE_MAGIC:
+        raise Exception("%s is not a ModemManager trace file" % path)
+
+    ports = read_ports(buf)
+
+    if wrap:
+        ranges = [ (tail, wrap), (0, head) ]
+    else:
+        ranges = [ (tail, head) ]
+
+    for (start, end) in ranges:
+        for (pid, ts, direction, data) in records(buf, header_size, start, end):
+            (ptype, device) = ports.get(pid, (0, "port-%u" % pid))
+            stamp = time.strftime("%H:%M:%S", time.localtime(ts / 1000000)) + ".%06u" % (ts % 1000000)
+            if ptype in TEXT_PORT_TYPES:
+                rendered = escape_text(data)
+            else:
+                rendered = binascii.hexlify(data).decode("ascii")
+            print("%s (%s/%s): %s %s" % (stamp, device, port_types.get(ptype, "unknown"),
+                                         "-->" if direction == 0 else "<--", rendered))
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        print("Usage: %s <trace-file>" % sys.argv[0])
+        sys.exit(1)
+    dump(sys.argv[1])
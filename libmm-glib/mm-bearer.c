@@ -199,6 +199,26 @@ mm_bearer_get_ip_timeout (MMBearer *self)
 
 /*****************************************************************************/
 
+/**
+ * mm_bearer_dup_stats:
+ * @self: A #MMBearer.
+ *
+ * Gets the statistics of the current or last connection of the bearer, as
+ * described in the documentation of the Stats property.
+ *
+ * Returns: (transfer full): A dictionary #GVariant of type "a{sv}", or %NULL
+ * if none available. The returned value should be freed with g_variant_unref().
+ */
+GVariant *
+mm_bearer_dup_stats (MMBearer *self)
+{
+    g_return_val_if_fail (MM_IS_BEARER (self), NULL);
+
+    return mm_gdbus_bearer_dup_stats (MM_GDBUS_BEARER (self));
+}
+
+/*****************************************************************************/
+
 static void
 ipv4_config_updated (MMBearer *self,
                      GParamSpec *pspec)
@@ -78,6 +78,8 @@ gboolean     mm_bearer_get_suspended  (MMBearer *self);
 
 guint        mm_bearer_get_ip_timeout (MMBearer *self);
 
+GVariant    *mm_bearer_dup_stats      (MMBearer *self);
+
 void     mm_bearer_connect        (MMBearer *self,
                                    GCancellable *cancellable,
                                    GAsyncReadyCallback callback,
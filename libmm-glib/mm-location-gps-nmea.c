@@ -36,91 +36,105 @@
 
 G_DEFINE_TYPE (MMLocationGpsNmea, mm_location_gps_nmea, G_TYPE_OBJECT);
 
+/* One slot per trace type, updated in place so that storing a new trace of a
+ * type already seen doesn't allocate anything */
+typedef struct {
+    gchar *type;
+    GString *trace;
+} TraceSlot;
+
 struct _MMLocationGpsNmeaPrivate {
-    GHashTable *traces;
-    GRegex *sequence_regex;
+    /* Kept in the order in which trace types were first seen */
+    GArray *slots;
 };
 
 /*****************************************************************************/
 
-static gboolean
-check_append_or_replace (MMLocationGpsNmea *self,
-                         const gchar *trace)
+static TraceSlot *
+find_slot (MMLocationGpsNmea *self,
+           const gchar *type,
+           gsize type_len)
 {
-    /* By default, replace */
-    gboolean append_or_replace = FALSE;
-    GMatchInfo *match_info = NULL;
-
-    if (G_UNLIKELY (!self->priv->sequence_regex))
-        self->priv->sequence_regex = g_regex_new ("\\$GPGSV,(\\d),(\\d).*",
-                                                  G_REGEX_RAW | G_REGEX_OPTIMIZE,
-                                                  0,
-                                                  NULL);
-
-    if (g_regex_match (self->priv->sequence_regex, trace, 0, &match_info)) {
-        guint index;
-
-        /* If we don't have the first element of a sequence, append */
-        if (mm_get_uint_from_match_info (match_info, 2, &index) && index != 1)
-            append_or_replace = TRUE;
-    }
-    g_match_info_free (match_info);
+    guint i;
+
+    for (i = 0; i < self->priv->slots->len; i++) {
+        TraceSlot *slot;
 
-    return append_or_replace;
+        slot = &g_array_index (self->priv->slots, TraceSlot, i);
+        if (strncmp (slot->type, type, type_len) == 0 && slot->type[type_len] == '\0')
+            return slot;
+    }
+    return NULL;
 }
 
+/* Satellites-in-view traces ($GPGSV, $GLGSV...) come in sequences of several
+ * messages, given as "$xxGSV,<total>,<index>,...". Every message but the
+ * first one of the sequence needs to be appended instead of replacing the
+ * previous trace. */
 static gboolean
-location_gps_nmea_take_trace (MMLocationGpsNmea *self,
-                              gchar *trace)
+check_append_or_replace (const gchar *trace,
+                         gsize type_len)
+{
+    const gchar *p;
+
+    if (type_len < 4 || strncmp (&trace[type_len - 3], "GSV", 3) != 0)
+        return FALSE;
+
+    /* Skip the total number of messages */
+    p = &trace[type_len + 1];
+    if (!g_ascii_isdigit (*p))
+        return FALSE;
+    while (g_ascii_isdigit (*p))
+        p++;
+    if (*p++ != ',' || !g_ascii_isdigit (*p))
+        return FALSE;
+
+    /* If we don't have the first element of a sequence, append */
+    return (strtoul (p, NULL, 10) != 1);
+}
+
+gboolean
+mm_location_gps_nmea_add_trace (MMLocationGpsNmea *self,
+                                const gchar *trace)
 {
-    gchar *i;
-    gchar *trace_type;
+    const gchar *i;
+    gsize type_len;
+    TraceSlot *slot;
 
     i = strchr (trace, ',');
     if (!i || i == trace)
         return FALSE;
+    type_len = i - trace;
 
-    trace_type = g_malloc (i - trace + 1);
-    memcpy (trace_type, trace, i - trace);
-    trace_type[i - trace] = '\0';
+    slot = find_slot (self, trace, type_len);
+    if (!slot) {
+        TraceSlot new_slot;
+
+        new_slot.type = g_strndup (trace, type_len);
+        new_slot.trace = g_string_new (trace);
+        g_array_append_val (self->priv->slots, new_slot);
+        return TRUE;
+    }
 
     /* Some traces are part of a SEQUENCE; so we need to decide whether we
      * completely replace the previous trace, or we append the new one to
      * the already existing list */
-    if (check_append_or_replace (self, trace)) {
-        /* Append */
-        const gchar *previous;
-
-        previous = g_hash_table_lookup (self->priv->traces, trace_type);
-        if (previous) {
-            gchar *sequence;
-
-            /* Skip the trace if we already have it there */
-            if (strstr (previous, trace))
-                return TRUE;
-
-            sequence = g_strdup_printf ("%s%s%s",
-                                        previous,
-                                        g_str_has_suffix (previous, "\r\n") ? "" : "\r\n",
-                                        trace);
-            g_free (trace);
-            trace = sequence;
-        }
+    if (check_append_or_replace (trace, type_len)) {
+        /* Skip the trace if we already have it there */
+        if (strstr (slot->trace->str, trace))
+            return TRUE;
+
+        if (slot->trace->len > 0 &&
+            !g_str_has_suffix (slot->trace->str, "\r\n"))
+            g_string_append (slot->trace, "\r\n");
+        g_string_append (slot->trace, trace);
+        return TRUE;
     }
 
-    g_hash_table_replace (self->priv->traces,
-                          trace_type,
-                          trace);
+    g_string_assign (slot->trace, trace);
     return TRUE;
 }
 
-gboolean
-mm_location_gps_nmea_add_trace (MMLocationGpsNmea *self,
-                                const gchar *trace)
-{
-    return location_gps_nmea_take_trace (self, g_strdup (trace));
-}
-
 /*****************************************************************************/
 
 /**
@@ -136,22 +150,14 @@ const gchar *
 mm_location_gps_nmea_get_trace (MMLocationGpsNmea *self,
                                 const gchar *trace_type)
 {
-    return (const gchar *)g_hash_table_lookup (self->priv->traces, trace_type);
+    TraceSlot *slot;
+
+    slot = find_slot (self, trace_type, strlen (trace_type));
+    return slot ? slot->trace->str : NULL;
 }
 
 /*****************************************************************************/
 
-static void
-build_full_foreach (const gchar *trace_type,
-                    const gchar *trace,
-                    GString **built)
-{
-    if ((*built)->len == 0 || g_str_has_suffix ((*built)->str, "\r\n"))
-        g_string_append (*built, trace);
-    else
-        g_string_append_printf (*built, "\r\n%s", trace);
-}
-
 /**
  * mm_location_gps_nmea_build_full:
  * @self: a #MMLocationGpsNmea.
@@ -164,11 +170,17 @@ gchar *
 mm_location_gps_nmea_build_full (MMLocationGpsNmea *self)
 {
     GString *built;
+    guint i;
 
     built = g_string_new ("");
-    g_hash_table_foreach (self->priv->traces,
-                          (GHFunc)build_full_foreach,
-                          &built);
+    for (i = 0; i < self->priv->slots->len; i++) {
+        TraceSlot *slot;
+
+        slot = &g_array_index (self->priv->slots, TraceSlot, i);
+        if (built->len > 0 && !g_str_has_suffix (built->str, "\r\n"))
+            g_string_append (built, "\r\n");
+        g_string_append_len (built, slot->trace->str, slot->trace->len);
+    }
     return g_string_free (built, FALSE);
 }
 
@@ -221,14 +233,9 @@ mm_location_gps_nmea_new_from_string_variant (GVariant *string,
     /* Create new location object */
     self = mm_location_gps_nmea_new ();
 
-    for (i = 0; split[i]; i++) {
-        if (!location_gps_nmea_take_trace (self, split[i]))
-            g_free (split[i]);
-    }
-
-    /* Note that the strings in the array of strings were already taken
-     * or freed */
-    g_free (split);
+    for (i = 0; split[i]; i++)
+        mm_location_gps_nmea_add_trace (self, split[i]);
+    g_strfreev (split);
 
     return self;
 }
@@ -249,20 +256,23 @@ mm_location_gps_nmea_init (MMLocationGpsNmea *self)
                                               MM_TYPE_LOCATION_GPS_NMEA,
                                               MMLocationGpsNmeaPrivate);
 
-    self->priv->traces = g_hash_table_new_full (g_str_hash,
-                                                g_str_equal,
-                                                g_free,
-                                                g_free);
+    self->priv->slots = g_array_new (FALSE, FALSE, sizeof (TraceSlot));
 }
 
 static void
 finalize (GObject *object)
 {
     MMLocationGpsNmea *self = MM_LOCATION_GPS_NMEA (object);
+    guint i;
 
-    g_hash_table_destroy (self->priv->traces);
-    if (self->priv->sequence_regex)
-        g_regex_unref (self->priv->sequence_regex);
+    for (i = 0; i < self->priv->slots->len; i++) {
+        TraceSlot *slot;
+
+        slot = &g_array_index (self->priv->slots, TraceSlot, i);
+        g_free (slot->type);
+        g_string_free (slot->trace, TRUE);
+    }
+    g_array_unref (self->priv->slots);
 
     G_OBJECT_CLASS (mm_location_gps_nmea_parent_class)->finalize (object);
 }
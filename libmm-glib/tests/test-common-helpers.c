@@ -486,6 +486,94 @@ field_parser_double (void)
     g_free (str);
 }
 
+/********************* GPS NMEA LOCATION TESTS *********************/
+
+#define GGA_1 "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47"
+#define GGA_2 "$GPGGA,123520,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*4D"
+#define GSV_1 "$GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*75"
+#define GSV_2 "$GPGSV,2,2,08,32,17,308,41,33,07,344,39,34,22,228,45,35,40,083,46*73"
+
+static void
+gps_nmea_test_replace (void)
+{
+    MMLocationGpsNmea *nmea;
+
+    nmea = mm_location_gps_nmea_new ();
+
+    g_assert (mm_location_gps_nmea_add_trace (nmea, GGA_1));
+    g_assert_cmpstr (mm_location_gps_nmea_get_trace (nmea, "$GPGGA"), ==, GGA_1);
+
+    /* Same type, replaced in place */
+    g_assert (mm_location_gps_nmea_add_trace (nmea, GGA_2));
+    g_assert_cmpstr (mm_location_gps_nmea_get_trace (nmea, "$GPGGA"), ==, GGA_2);
+
+    /* Types are matched as a whole */
+    g_assert (mm_location_gps_nmea_get_trace (nmea, "$GPGG") == NULL);
+    g_assert (mm_location_gps_nmea_get_trace (nmea, "$GPGGAX") == NULL);
+
+    /* No type */
+    g_assert (!mm_location_gps_nmea_add_trace (nmea, "$GPGGA"));
+    g_assert (!mm_location_gps_nmea_add_trace (nmea, ",123519"));
+
+    g_object_unref (nmea);
+}
+
+static void
+gps_nmea_test_gsv_sequence (void)
+{
+    MMLocationGpsNmea *nmea;
+    gchar *full;
+
+    nmea = mm_location_gps_nmea_new ();
+
+    g_assert (mm_location_gps_nmea_add_trace (nmea, GGA_1));
+
+    /* Every message of a sequence but the first one is appended */
+    g_assert (mm_location_gps_nmea_add_trace (nmea, GSV_1));
+    g_assert (mm_location_gps_nmea_add_trace (nmea, GSV_2));
+    g_assert_cmpstr (mm_location_gps_nmea_get_trace (nmea, "$GPGSV"), ==, GSV_1 "\r\n" GSV_2);
+
+    /* Already there, not appended again */
+    g_assert (mm_location_gps_nmea_add_trace (nmea, GSV_2));
+    g_assert_cmpstr (mm_location_gps_nmea_get_trace (nmea, "$GPGSV"), ==, GSV_1 "\r\n" GSV_2);
+
+    /* Traces are built in the order their types were first seen */
+    full = mm_location_gps_nmea_build_full (nmea);
+    g_assert_cmpstr (full, ==, GGA_1 "\r\n" GSV_1 "\r\n" GSV_2);
+    g_free (full);
+
+    /* A new sequence replaces the previous one */
+    g_assert (mm_location_gps_nmea_add_trace (nmea, GSV_1));
+    g_assert_cmpstr (mm_location_gps_nmea_get_trace (nmea, "$GPGSV"), ==, GSV_1);
+
+    g_object_unref (nmea);
+}
+
+static void
+gps_nmea_test_string_variant (void)
+{
+    MMLocationGpsNmea *nmea;
+    MMLocationGpsNmea *copy;
+    GVariant *variant;
+    GError *error = NULL;
+
+    nmea = mm_location_gps_nmea_new ();
+    mm_location_gps_nmea_add_trace (nmea, GGA_1);
+    mm_location_gps_nmea_add_trace (nmea, GSV_1);
+    mm_location_gps_nmea_add_trace (nmea, GSV_2);
+
+    /* The split sequence is put back together */
+    variant = g_variant_ref_sink (mm_location_gps_nmea_get_string_variant (nmea));
+    copy = mm_location_gps_nmea_new_from_string_variant (variant, &error);
+    g_assert_no_error (error);
+    g_assert_cmpstr (mm_location_gps_nmea_get_trace (copy, "$GPGGA"), ==, GGA_1);
+    g_assert_cmpstr (mm_location_gps_nmea_get_trace (copy, "$GPGSV"), ==, GSV_1 "\r\n" GSV_2);
+
+    g_variant_unref (variant);
+    g_object_unref (copy);
+    g_object_unref (nmea);
+}
+
 /**************************************************************/
 
 int main (int argc, char **argv)
@@ -525,5 +613,9 @@ int main (int argc, char **argv)
     g_test_add_func ("/MM/Common/FieldParsers/Uint", field_parser_uint);
     g_test_add_func ("/MM/Common/FieldParsers/Double", field_parser_double);
 
+    g_test_add_func ("/MM/Common/GpsNmea/replace", gps_nmea_test_replace);
+    g_test_add_func ("/MM/Common/GpsNmea/gsv-sequence", gps_nmea_test_gsv_sequence);
+    g_test_add_func ("/MM/Common/GpsNmea/string-variant", gps_nmea_test_string_variant);
+
     return g_test_run ();
 }
@@ -29,6 +29,10 @@
 /*****************************************************************************/
 /* ^NDISSTAT /  ^NDISSTATQRY response parser */
 
+static MMRegex ndisstatqry_regex = MM_REGEX_INIT ("\\^NDISSTAT(?:QRY)?:\\s*(\\d),([^,]*),([^,]*),([^,\\r\\n]*)(?:\\r\\n)?"
+                                                  "(?:\\^NDISSTAT:|\\^NDISSTATQRY:)?\\s*,?(\\d)?,?([^,]*)?,?([^,]*)?,?([^,\\r\\n]*)?(?:\\r\\n)?",
+                                                  G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW, 0);
+
 gboolean
 mm_huawei_parse_ndisstatqry_response (const gchar *response,
                                       gboolean *ipv4_available,
@@ -62,11 +66,7 @@ mm_huawei_parse_ndisstatqry_response (const gchar *response,
      *     ^NDISSTATQRY:0,,,"IPV4",0,,,"IPV6"
      *     OK
      */
-    r = g_regex_new ("\\^NDISSTAT(?:QRY)?:\\s*(\\d),([^,]*),([^,]*),([^,\\r\\n]*)(?:\\r\\n)?"
-                     "(?:\\^NDISSTAT:|\\^NDISSTATQRY:)?\\s*,?(\\d)?,?([^,]*)?,?([^,]*)?,?([^,\\r\\n]*)?(?:\\r\\n)?",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                     0, NULL);
-    g_assert (r != NULL);
+    r = mm_regex_get (&ndisstatqry_regex);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
     if (!inner_error && g_match_info_matches (match_info)) {
@@ -120,6 +120,8 @@ mm_huawei_parse_ndisstatqry_response (const gchar *response,
 /*****************************************************************************/
 /* ^SYSINFO response parser */
 
+static MMRegex sysinfo_regex = MM_REGEX_INIT ("\\^SYSINFO:\\s*(\\d+),(\\d+),(\\d+),(\\d+),(\\d+),?(\\d+)?,?(\\d+)?$", 0, 0);
+
 gboolean
 mm_huawei_parse_sysinfo_response (const char *reply,
                                   guint *out_srv_status,
@@ -150,8 +152,7 @@ mm_huawei_parse_sysinfo_response (const char *reply,
      */
 
     /* Can't just use \d here since sometimes you get "^SYSINFO:2,1,0,3,1,,3" */
-    r = g_regex_new ("\\^SYSINFO:\\s*(\\d+),(\\d+),(\\d+),(\\d+),(\\d+),?(\\d+)?,?(\\d+)?$", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_regex_get (&sysinfo_regex);
 
     matched = g_regex_match_full (r, reply, -1, 0, 0, &match_info, &match_error);
     if (!matched) {
@@ -187,6 +188,8 @@ mm_huawei_parse_sysinfo_response (const char *reply,
 /*****************************************************************************/
 /* ^SYSINFOEX response parser */
 
+static MMRegex sysinfoex_regex = MM_REGEX_INIT ("\\^SYSINFOEX:\\s*(\\d+),(\\d+),(\\d+),(\\d+),?(\\d*),(\\d+),\"?([^\"]*)\"?,(\\d+),\"?([^\"]*)\"?$", 0, 0);
+
 gboolean
 mm_huawei_parse_sysinfoex_response (const char *reply,
                                     guint *out_srv_status,
@@ -218,8 +221,7 @@ mm_huawei_parse_sysinfoex_response (const char *reply,
 
     /* ^SYSINFOEX:2,3,0,1,,3,"WCDMA",41,"HSPA+" */
 
-    r = g_regex_new ("\\^SYSINFOEX:\\s*(\\d+),(\\d+),(\\d+),(\\d+),?(\\d*),(\\d+),\"?([^\"]*)\"?,(\\d+),\"?([^\"]*)\"?$", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_regex_get (&sysinfoex_regex);
 
     matched = g_regex_match_full (r, reply, -1, 0, 0, &match_info, &match_error);
     if (!matched) {
@@ -1037,6 +1039,8 @@ mm_huawei_parse_syscfgex_response (const gchar *response,
 /*****************************************************************************/
 /* ^NWTIME response parser */
 
+static MMRegex nwtime_regex = MM_REGEX_INIT ("\\^NWTIME:\\s*(\\d+)/(\\d+)/(\\d+),(\\d+):(\\d+):(\\d*)([\\-\\+\\d]+),(\\d+)$", 0, 0);
+
 gboolean mm_huawei_parse_nwtime_response (const gchar *response,
                                           gchar **iso8601p,
                                           MMNetworkTimezone **tzp,
@@ -1051,8 +1055,7 @@ gboolean mm_huawei_parse_nwtime_response (const gchar *response,
 
     g_assert (iso8601p || tzp); /* at least one */
 
-    r = g_regex_new ("\\^NWTIME:\\s*(\\d+)/(\\d+)/(\\d+),(\\d+):(\\d+):(\\d*)([\\-\\+\\d]+),(\\d+)$", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_regex_get (&nwtime_regex);
 
     if (!g_regex_match_full (r, response, -1, 0, 0, &match_info, &match_error)) {
         if (match_error) {
@@ -1115,6 +1118,8 @@ gboolean mm_huawei_parse_nwtime_response (const gchar *response,
 /*****************************************************************************/
 /* ^TIME response parser */
 
+static MMRegex time_regex = MM_REGEX_INIT ("\\^TIME:\\s*(\\d+)/(\\d+)/(\\d+)\\s*(\\d+):(\\d+):(\\d*)$", 0, 0);
+
 gboolean mm_huawei_parse_time_response (const gchar *response,
                                         gchar **iso8601p,
                                         MMNetworkTimezone **tzp,
@@ -1138,8 +1143,7 @@ gboolean mm_huawei_parse_time_response (const gchar *response,
     }
 
     /* Already in ISO-8601 format, but verify just to be sure */
-    r = g_regex_new ("\\^TIME:\\s*(\\d+)/(\\d+)/(\\d+)\\s*(\\d+):(\\d+):(\\d*)$", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_regex_get (&time_regex);
 
     if (!g_regex_match_full (r, response, -1, 0, 0, &match_info, &match_error)) {
         if (match_error) {
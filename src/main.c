@@ -28,7 +28,11 @@
 
 #include "mm-base-manager.h"
 #include "mm-log.h"
+#include "mm-trace.h"
+#include "mm-reply-cache.h"
+#include "mm-probe-cache.h"
 #include "mm-context.h"
+#include "mm-serial-parsers.h"
 
 /* Maximum time to wait for all modems to get disabled and removed */
 #define MAX_SHUTDOWN_TIME_SECS 20
@@ -120,6 +124,7 @@ main (int argc, char *argv[])
 
     if (!mm_log_setup (mm_context_get_log_level (),
                        mm_context_get_log_file (),
+                       mm_context_get_log_flush (),
                        mm_context_get_timestamps (),
                        mm_context_get_relative_timestamps (),
                        mm_context_get_debug (),
@@ -129,6 +134,29 @@ main (int argc, char *argv[])
         exit (1);
     }
 
+    mm_serial_parser_v1_set_default_use_regex (mm_context_get_test_regex_parser ());
+
+    if (mm_context_get_trace_file () &&
+        !mm_trace_setup (mm_context_get_trace_file (), &err)) {
+        g_warning ("Failed to set up tracing: %s", err->message);
+        g_error_free (err);
+        exit (1);
+    }
+
+    if (mm_context_get_reply_cache_dir () &&
+        !mm_reply_cache_setup (mm_context_get_reply_cache_dir (), &err)) {
+        g_warning ("Failed to set up reply cache: %s", err->message);
+        g_error_free (err);
+        exit (1);
+    }
+
+    if (mm_context_get_probe_cache_file () &&
+        !mm_probe_cache_setup (mm_context_get_probe_cache_file (), &err)) {
+        g_warning ("Failed to set up probe cache: %s", err->message);
+        g_error_free (err);
+        exit (1);
+    }
+
     g_unix_signal_add (SIGTERM, quit_cb, NULL);
     g_unix_signal_add (SIGINT, quit_cb, NULL);
 
@@ -186,6 +214,8 @@ main (int argc, char *argv[])
 
     mm_info ("ModemManager is shut down");
 
+    mm_probe_cache_shutdown ();
+    mm_trace_shutdown ();
     mm_log_shutdown ();
 
     return 0;
@@ -26,8 +26,17 @@
 
 G_DEFINE_TYPE (MMAuthProviderPolkit, mm_auth_provider_polkit, MM_TYPE_AUTH_PROVIDER)
 
+/* How long a successful authorization is reused for the same sender and
+ * action without asking PolicyKit again */
+#define AUTHORIZATION_CACHE_TTL_SEC 30
+
 struct _MMAuthProviderPolkitPrivate {
     PolkitAuthority *authority;
+
+    /* Successful authorizations, by sender unique name */
+    GHashTable *cache;
+    guint64 cache_hits;
+    guint64 cache_misses;
 };
 
 /*****************************************************************************/
@@ -38,6 +47,108 @@ mm_auth_provider_polkit_new (void)
     return g_object_new (MM_TYPE_AUTH_PROVIDER_POLKIT, NULL);
 }
 
+/*****************************************************************************/
+/* Authorization cache */
+
+typedef struct {
+    GDBusConnection *connection;
+    guint name_owner_changed_id;
+    /* Action -> expiration time (monotonic) */
+    GHashTable *actions;
+} CachedSender;
+
+static void
+cached_sender_free (CachedSender *sender)
+{
+    g_dbus_connection_signal_unsubscribe (sender->connection, sender->name_owner_changed_id);
+    g_object_unref (sender->connection);
+    g_hash_table_unref (sender->actions);
+    g_slice_free (CachedSender, sender);
+}
+
+static void
+name_owner_changed (GDBusConnection *connection,
+                    const gchar *sender_name,
+                    const gchar *object_path,
+                    const gchar *interface_name,
+                    const gchar *signal_name,
+                    GVariant *parameters,
+                    MMAuthProviderPolkit *self)
+{
+    const gchar *name;
+    const gchar *old_owner;
+    const gchar *new_owner;
+
+    g_variant_get (parameters, "(&s&s&s)", &name, &old_owner, &new_owner);
+
+    /* Unique names are never reused, so once gone, they're gone for good */
+    if (new_owner[0] == '\0' && g_hash_table_remove (self->priv->cache, name))
+        mm_dbg ("Authorization cache: flushed entries of '%s'", name);
+}
+
+static gboolean
+cache_lookup (MMAuthProviderPolkit *self,
+              const gchar *sender_name,
+              const gchar *authorization)
+{
+    CachedSender *sender;
+    gpointer expiration;
+
+    if (!self->priv->cache)
+        return FALSE;
+
+    sender = g_hash_table_lookup (self->priv->cache, sender_name);
+    if (!sender ||
+        !g_hash_table_lookup_extended (sender->actions, authorization, NULL, &expiration))
+        return FALSE;
+
+    if (*((gint64 *)expiration) < g_get_monotonic_time ()) {
+        g_hash_table_remove (sender->actions, authorization);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+cache_add (MMAuthProviderPolkit *self,
+           GDBusMethodInvocation *invocation,
+           const gchar *authorization)
+{
+    CachedSender *sender;
+    const gchar *sender_name;
+    gint64 *expiration;
+
+    sender_name = g_dbus_method_invocation_get_sender (invocation);
+    if (!sender_name || !self->priv->cache)
+        return;
+
+    sender = g_hash_table_lookup (self->priv->cache, sender_name);
+    if (!sender) {
+        sender = g_slice_new (CachedSender);
+        sender->connection = g_object_ref (g_dbus_method_invocation_get_connection (invocation));
+        sender->actions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+        /* The cache doesn't hold a reference to self; entries and their
+         * subscriptions are all gone when self gets disposed */
+        sender->name_owner_changed_id =
+            g_dbus_connection_signal_subscribe (sender->connection,
+                                                "org.freedesktop.DBus",
+                                                "org.freedesktop.DBus",
+                                                "NameOwnerChanged",
+                                                "/org/freedesktop/DBus",
+                                                sender_name,
+                                                G_DBUS_SIGNAL_FLAGS_NONE,
+                                                (GDBusSignalCallback)name_owner_changed,
+                                                self,
+                                                NULL);
+        g_hash_table_insert (self->priv->cache, g_strdup (sender_name), sender);
+    }
+
+    expiration = g_new (gint64, 1);
+    *expiration = g_get_monotonic_time () + AUTHORIZATION_CACHE_TTL_SEC * G_USEC_PER_SEC;
+    g_hash_table_replace (sender->actions, g_strdup (authorization), expiration);
+}
+
 /*****************************************************************************/
 
 typedef struct {
@@ -97,10 +208,11 @@ check_authorization_ready (PolkitAuthority *authority,
                                          error->message);
         g_error_free (error);
     } else {
-        if (polkit_authorization_result_get_is_authorized (pk_result))
+        if (polkit_authorization_result_get_is_authorized (pk_result)) {
             /* Good! */
+            cache_add (MM_AUTH_PROVIDER_POLKIT (ctx->self), ctx->invocation, ctx->authorization);
             g_simple_async_result_set_op_res_gboolean (ctx->result, TRUE);
-        else if (polkit_authorization_result_get_is_challenge (pk_result))
+        } else if (polkit_authorization_result_get_is_challenge (pk_result))
             g_simple_async_result_set_error (ctx->result,
                                              MM_CORE_ERROR,
                                              MM_CORE_ERROR_UNAUTHORIZED,
@@ -128,6 +240,7 @@ authorize (MMAuthProvider *self,
 {
     MMAuthProviderPolkit *polkit = MM_AUTH_PROVIDER_POLKIT (self);
     AuthorizeContext *ctx;
+    const gchar *sender_name;
 
     /* When creating the object, we actually allowed errors when looking for the
      * authority. If that is the case, we'll just forbid any incoming
@@ -143,6 +256,28 @@ authorize (MMAuthProvider *self,
         return;
     }
 
+    /* Reuse a recent successful authorization of the same sender */
+    sender_name = g_dbus_method_invocation_get_sender (invocation);
+    if (sender_name && cache_lookup (polkit, sender_name, authorization)) {
+        GSimpleAsyncResult *result;
+
+        polkit->priv->cache_hits++;
+        mm_dbg ("Authorization cache hit for '%s' from '%s' "
+                "(%" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses)",
+                authorization, sender_name,
+                polkit->priv->cache_hits, polkit->priv->cache_misses);
+
+        result = g_simple_async_result_new (G_OBJECT (self),
+                                            callback,
+                                            user_data,
+                                            authorize);
+        g_simple_async_result_set_op_res_gboolean (result, TRUE);
+        g_simple_async_result_complete_in_idle (result);
+        g_object_unref (result);
+        return;
+    }
+    polkit->priv->cache_misses++;
+
     ctx = g_new (AuthorizeContext, 1);
     ctx->self = g_object_ref (self);
     ctx->invocation = g_object_ref (invocation);
@@ -175,6 +310,11 @@ mm_auth_provider_polkit_init (MMAuthProviderPolkit *self)
                                               MM_TYPE_AUTH_PROVIDER_POLKIT,
                                               MMAuthProviderPolkitPrivate);
 
+    self->priv->cache = g_hash_table_new_full (g_str_hash,
+                                               g_str_equal,
+                                               g_free,
+                                               (GDestroyNotify)cached_sender_free);
+
     self->priv->authority = polkit_authority_get_sync (NULL, &error);
     if (!self->priv->authority) {
         /* NOTE: we failed to create the polkit authority, but we still create
@@ -188,7 +328,13 @@ mm_auth_provider_polkit_init (MMAuthProviderPolkit *self)
 static void
 dispose (GObject *object)
 {
-    g_clear_object (&(MM_AUTH_PROVIDER_POLKIT (object)->priv->authority));
+    MMAuthProviderPolkit *self = MM_AUTH_PROVIDER_POLKIT (object);
+
+    if (self->priv->cache) {
+        g_hash_table_unref (self->priv->cache);
+        self->priv->cache = NULL;
+    }
+    g_clear_object (&self->priv->authority);
 
     G_OBJECT_CLASS (mm_auth_provider_polkit_parent_class)->dispose (object);
 }
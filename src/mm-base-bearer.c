@@ -36,12 +36,21 @@
 #include "mm-base-modem.h"
 #include "mm-log.h"
 #include "mm-modem-helpers.h"
+#include "mm-context.h"
+#include "mm-coalesced-timeout.h"
 
 /* We require up to 20s to get a proper IP when using PPP */
 #define BEARER_IP_TIMEOUT_DEFAULT 20
 
 #define BEARER_DEFERRED_UNREGISTRATION_TIMEOUT 15
 
+#define BEARER_STATS_REFRESH_SLACK(rate) ((rate) / 4)
+
+/* Upper limits (in seconds) of the connection latency histogram buckets; an
+ * additional last bucket gets all the attempts above the last limit */
+static const guint connect_latency_limits[] = { 1, 2, 5, 10, 20, 30, 60 };
+#define CONNECT_LATENCY_BUCKETS (G_N_ELEMENTS (connect_latency_limits) + 1)
+
 G_DEFINE_TYPE (MMBaseBearer, mm_base_bearer, MM_GDBUS_TYPE_BEARER_SKELETON);
 
 typedef enum {
@@ -97,6 +106,29 @@ struct _MMBaseBearerPrivate {
     /* Handler IDs for the registration state change signals */
     guint id_cdma1x_registration_change;
     guint id_evdo_registration_change;
+
+    /*-- Statistics --*/
+    /* Traffic counters of the current or last connection */
+    gboolean traffic_available;
+    guint64 rx_bytes;
+    guint64 tx_bytes;
+    guint64 rx_packets;
+    guint64 tx_packets;
+    /* Monotonic times when the last attempt started and when connected */
+    gint64 connect_start;
+    gint64 connected_since;
+    /* Duration of the last connection, once disconnected */
+    guint duration;
+    guint attempts;
+    guint failed_attempts;
+    guint last_connect_latency;
+    guint connect_latency_histogram[CONNECT_LATENCY_BUCKETS];
+    /* Periodic traffic statistics reload */
+    guint stats_refresh_id;
+    gboolean stats_reload_ongoing;
+    /* Bumped on every connection and disconnection, so that reloads started
+     * for a previous connection are ignored */
+    guint stats_connection_id;
 };
 
 /*****************************************************************************/
@@ -122,6 +154,199 @@ mm_base_bearer_export (MMBaseBearer *self)
     g_free (path);
 }
 
+/*****************************************************************************/
+/* Statistics */
+
+static void
+bearer_stats_update (MMBaseBearer *self)
+{
+    GVariantBuilder builder;
+    GVariantBuilder histogram;
+    guint duration;
+    guint i;
+
+    if (self->priv->connected_since)
+        duration = (guint) ((g_get_monotonic_time () - self->priv->connected_since) / G_USEC_PER_SEC);
+    else
+        duration = self->priv->duration;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+    if (self->priv->traffic_available) {
+        g_variant_builder_add (&builder, "{sv}", "rx-bytes",   g_variant_new_uint64 (self->priv->rx_bytes));
+        g_variant_builder_add (&builder, "{sv}", "tx-bytes",   g_variant_new_uint64 (self->priv->tx_bytes));
+        g_variant_builder_add (&builder, "{sv}", "rx-packets", g_variant_new_uint64 (self->priv->rx_packets));
+        g_variant_builder_add (&builder, "{sv}", "tx-packets", g_variant_new_uint64 (self->priv->tx_packets));
+    }
+    g_variant_builder_add (&builder, "{sv}", "duration",             g_variant_new_uint32 (duration));
+    g_variant_builder_add (&builder, "{sv}", "attempts",             g_variant_new_uint32 (self->priv->attempts));
+    g_variant_builder_add (&builder, "{sv}", "failed-attempts",      g_variant_new_uint32 (self->priv->failed_attempts));
+    g_variant_builder_add (&builder, "{sv}", "last-connect-latency", g_variant_new_uint32 (self->priv->last_connect_latency));
+
+    g_variant_builder_init (&histogram, G_VARIANT_TYPE ("au"));
+    for (i = 0; i < CONNECT_LATENCY_BUCKETS; i++)
+        g_variant_builder_add (&histogram, "u", self->priv->connect_latency_histogram[i]);
+    g_variant_builder_add (&builder, "{sv}", "connect-latency-histogram", g_variant_builder_end (&histogram));
+
+    mm_gdbus_bearer_set_stats (MM_GDBUS_BEARER (self), g_variant_builder_end (&builder));
+}
+
+typedef struct {
+    MMBaseBearer *self;
+    guint connection_id;
+} ReloadStatsContext;
+
+static void
+reload_stats_ready (MMBaseBearer *self,
+                    GAsyncResult *res,
+                    ReloadStatsContext *ctx)
+{
+    GError *error = NULL;
+    guint64 rx_bytes = 0;
+    guint64 tx_bytes = 0;
+    guint64 rx_packets = 0;
+    guint64 tx_packets = 0;
+
+    self->priv->stats_reload_ongoing = FALSE;
+
+    if (!MM_BASE_BEARER_GET_CLASS (self)->reload_stats_finish (self,
+                                                              res,
+                                                              &rx_bytes,
+                                                              &tx_bytes,
+                                                              &rx_packets,
+                                                              &tx_packets,
+                                                              &error)) {
+        mm_dbg ("Couldn't reload stats of bearer '%s': '%s'",
+                self->priv->path, error->message);
+        g_error_free (error);
+    } else if (ctx->connection_id != self->priv->stats_connection_id)
+        mm_dbg ("Ignoring stats of bearer '%s' reloaded for a previous connection",
+                self->priv->path);
+    else if (self->priv->status == MM_BEARER_STATUS_CONNECTED) {
+        self->priv->traffic_available = TRUE;
+        self->priv->rx_bytes = rx_bytes;
+        self->priv->tx_bytes = tx_bytes;
+        self->priv->rx_packets = rx_packets;
+        self->priv->tx_packets = tx_packets;
+    }
+
+    bearer_stats_update (self);
+    g_object_unref (ctx->self);
+    g_slice_free (ReloadStatsContext, ctx);
+}
+
+static gboolean
+stats_refresh_cb (MMBaseBearer *self)
+{
+    ReloadStatsContext *ctx;
+
+    /* If the bearer doesn't report traffic, just refresh the duration */
+    if (!MM_BASE_BEARER_GET_CLASS (self)->reload_stats ||
+        !MM_BASE_BEARER_GET_CLASS (self)->reload_stats_finish) {
+        bearer_stats_update (self);
+        return TRUE;
+    }
+
+    /* Don't stack requests if the modem is too slow to reply */
+    if (self->priv->stats_reload_ongoing)
+        return TRUE;
+
+    ctx = g_slice_new (ReloadStatsContext);
+    ctx->self = g_object_ref (self);
+    ctx->connection_id = self->priv->stats_connection_id;
+
+    self->priv->stats_reload_ongoing = TRUE;
+    MM_BASE_BEARER_GET_CLASS (self)->reload_stats (
+        self,
+        (GAsyncReadyCallback)reload_stats_ready,
+        ctx);
+    return TRUE;
+}
+
+static void
+bearer_stats_refresh_stop (MMBaseBearer *self)
+{
+    if (self->priv->stats_refresh_id) {
+        mm_coalesced_timeout_remove (self->priv->stats_refresh_id);
+        self->priv->stats_refresh_id = 0;
+    }
+}
+
+static void
+bearer_stats_connect_started (MMBaseBearer *self)
+{
+    self->priv->attempts++;
+    self->priv->connect_start = g_get_monotonic_time ();
+    bearer_stats_update (self);
+}
+
+static void
+bearer_stats_connect_finished (MMBaseBearer *self,
+                               gboolean success)
+{
+    gint64 now;
+    guint latency;
+    guint i;
+
+    now = g_get_monotonic_time ();
+    latency = (guint) ((now - self->priv->connect_start) / 1000);
+    self->priv->last_connect_latency = latency;
+
+    if (!success) {
+        self->priv->failed_attempts++;
+        mm_dbg ("Bearer '%s' connection attempt failed after %ums",
+                self->priv->path, latency);
+        bearer_stats_update (self);
+        return;
+    }
+
+    mm_dbg ("Bearer '%s' connected in %ums", self->priv->path, latency);
+
+    for (i = 0; i < G_N_ELEMENTS (connect_latency_limits); i++) {
+        if (latency < connect_latency_limits[i] * 1000)
+            break;
+    }
+    self->priv->connect_latency_histogram[i]++;
+
+    /* Counters are given for the new connection only */
+    self->priv->stats_connection_id++;
+    self->priv->traffic_available = FALSE;
+    self->priv->rx_bytes = 0;
+    self->priv->tx_bytes = 0;
+    self->priv->rx_packets = 0;
+    self->priv->tx_packets = 0;
+    self->priv->connected_since = now;
+    self->priv->duration = 0;
+
+    bearer_stats_refresh_stop (self);
+    if (mm_context_get_bearer_stats_refresh_rate ()) {
+        guint rate;
+
+        rate = mm_context_get_bearer_stats_refresh_rate ();
+        self->priv->stats_refresh_id =
+            mm_coalesced_timeout_add_seconds (rate,
+                                              BEARER_STATS_REFRESH_SLACK (rate),
+                                              (GSourceFunc)stats_refresh_cb,
+                                              self);
+    }
+
+    bearer_stats_update (self);
+}
+
+static void
+bearer_stats_disconnected (MMBaseBearer *self)
+{
+    bearer_stats_refresh_stop (self);
+    self->priv->stats_connection_id++;
+
+    if (!self->priv->connected_since)
+        return;
+
+    self->priv->duration = (guint) ((g_get_monotonic_time () - self->priv->connected_since) / G_USEC_PER_SEC);
+    self->priv->connected_since = 0;
+    mm_dbg ("Bearer '%s' was connected for %us", self->priv->path, self->priv->duration);
+    bearer_stats_update (self);
+}
+
 /*****************************************************************************/
 
 static void
@@ -151,8 +376,10 @@ bearer_update_status (MMBaseBearer *self,
 
     /* Ensure that we don't expose any connection related data in the
      * interface when going into disconnected state. */
-    if (self->priv->status == MM_BEARER_STATUS_DISCONNECTED)
+    if (self->priv->status == MM_BEARER_STATUS_DISCONNECTED) {
         bearer_reset_interface_status (self);
+        bearer_stats_disconnected (self);
+    }
 }
 
 static void
@@ -471,11 +698,13 @@ connect_ready (MMBaseBearer *self,
         } else
             bearer_update_status (self, MM_BEARER_STATUS_DISCONNECTED);
 
+        bearer_stats_connect_finished (self, FALSE);
         g_simple_async_result_take_error (simple, error);
     }
     /* Handle cancellations detected after successful connection */
     else if (g_cancellable_is_cancelled (self->priv->connect_cancellable)) {
         mm_dbg ("Connected bearer '%s', but need to disconnect", self->priv->path);
+        bearer_stats_connect_finished (self, FALSE);
         mm_bearer_connect_result_unref (result);
         g_simple_async_result_set_error (
             simple,
@@ -486,6 +715,7 @@ connect_ready (MMBaseBearer *self,
     }
     else {
         mm_dbg ("Connected bearer '%s'", self->priv->path);
+        bearer_stats_connect_finished (self, TRUE);
 
         /* Update bearer and interface status */
         bearer_update_status_connected (
@@ -589,6 +819,7 @@ mm_base_bearer_connect (MMBaseBearer *self,
     /* Connecting! */
     mm_dbg ("Connecting bearer '%s'", self->priv->path);
     self->priv->connect_cancellable = g_cancellable_new ();
+    bearer_stats_connect_started (self);
     bearer_update_status (self, MM_BEARER_STATUS_CONNECTING);
     MM_BASE_BEARER_GET_CLASS (self)->connect (
         self,
@@ -1133,6 +1364,7 @@ mm_base_bearer_init (MMBaseBearer *self)
                                     mm_bearer_ip_config_get_dictionary (NULL));
     mm_gdbus_bearer_set_ip6_config (MM_GDBUS_BEARER (self),
                                     mm_bearer_ip_config_get_dictionary (NULL));
+    bearer_stats_update (self);
 }
 
 static void
@@ -1157,6 +1389,7 @@ dispose (GObject *object)
 
     reset_signal_handlers (self);
     reset_deferred_unregistration (self);
+    bearer_stats_refresh_stop (self);
 
     g_clear_object (&self->priv->modem);
     g_clear_object (&self->priv->config);
@@ -104,6 +104,18 @@ struct _MMBaseBearerClass {
     /* Report connection status of this bearer */
     void (* report_connection_status) (MMBaseBearer *bearer,
                                        MMBearerConnectionStatus status);
+
+    /* Reload traffic statistics of the connected bearer (optional) */
+    void (* reload_stats) (MMBaseBearer *bearer,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data);
+    gboolean (* reload_stats_finish) (MMBaseBearer *bearer,
+                                      GAsyncResult *res,
+                                      guint64 *rx_bytes,
+                                      guint64 *tx_bytes,
+                                      guint64 *rx_packets,
+                                      guint64 *tx_packets,
+                                      GError **error);
 };
 
 GType mm_base_bearer_get_type (void);
@@ -67,6 +67,8 @@ struct _MMBaseManagerPrivate {
     MMPluginManager *plugin_manager;
     /* The container of devices being prepared */
     GHashTable *devices;
+    /* Index of grabbed ports, sysfs path to device */
+    GHashTable *ports;
     /* The Object Manager server */
     GDBusObjectManagerServer *object_manager;
 
@@ -76,20 +78,29 @@ struct _MMBaseManagerPrivate {
 
 /*****************************************************************************/
 
+static MMDevice *
+find_device_by_sysfs_path (MMBaseManager *self,
+                           const gchar *sysfs_path)
+{
+    return g_hash_table_lookup (self->priv->devices,
+                                sysfs_path);
+}
+
 static MMDevice *
 find_device_by_modem (MMBaseManager *manager,
                       MMBaseModem *modem)
 {
-    GHashTableIter iter;
-    gpointer key, value;
+    MMDevice *device;
+    const gchar *path;
 
-    g_hash_table_iter_init (&iter, manager->priv->devices);
-    while (g_hash_table_iter_next (&iter, &key, &value)) {
-        MMDevice *candidate = MM_DEVICE (value);
+    /* Modems are created with the path of their device as 'device' */
+    path = mm_base_modem_get_device (modem);
+    if (!path)
+        return NULL;
 
-        if (modem == mm_device_peek_modem (candidate))
-            return candidate;
-    }
+    device = find_device_by_sysfs_path (manager, path);
+    if (device && mm_device_peek_modem (device) == modem)
+        return device;
     return NULL;
 }
 
@@ -97,25 +108,36 @@ static MMDevice *
 find_device_by_port (MMBaseManager *manager,
                      GUdevDevice *port)
 {
-    GHashTableIter iter;
-    gpointer key, value;
+    MMDevice *device;
+    const gchar *path;
 
-    g_hash_table_iter_init (&iter, manager->priv->devices);
-    while (g_hash_table_iter_next (&iter, &key, &value)) {
-        MMDevice *candidate = MM_DEVICE (value);
+    path = g_udev_device_get_sysfs_path (port);
+    if (!path)
+        return NULL;
 
-        if (mm_device_owns_port (candidate, port))
-            return candidate;
-    }
+    /* Ports ignored by the device are still indexed, but no longer owned */
+    device = g_hash_table_lookup (manager->priv->ports, path);
+    if (device && mm_device_owns_port (device, port))
+        return device;
     return NULL;
 }
 
-static MMDevice *
-find_device_by_sysfs_path (MMBaseManager *self,
-                           const gchar *sysfs_path)
+static gboolean
+port_index_matches_device (gpointer key,
+                           MMDevice *value,
+                           MMDevice *device)
 {
-    return g_hash_table_lookup (self->priv->devices,
-                                sysfs_path);
+    return (value == device);
+}
+
+static void
+remove_device (MMBaseManager *self,
+               MMDevice *device)
+{
+    g_hash_table_foreach_remove (self->priv->ports,
+                                 (GHRFunc)port_index_matches_device,
+                                 device);
+    g_hash_table_remove (self->priv->devices, mm_device_get_path (device));
 }
 
 static MMDevice *
@@ -345,6 +367,9 @@ device_added (MMBaseManager *manager,
 
     /* Grab the port in the existing device. */
     mm_device_grab_port (device, port);
+    g_hash_table_replace (manager->priv->ports,
+                          g_strdup (g_udev_device_get_sysfs_path (port)),
+                          device);
 
 out:
     if (physdev)
@@ -374,12 +399,13 @@ device_removed (MMBaseManager *self,
                      name,
                      g_udev_device_get_sysfs_path (mm_device_peek_udev_device (device)));
             mm_device_release_port (device, udev_device);
+            g_hash_table_remove (self->priv->ports, g_udev_device_get_sysfs_path (udev_device));
 
             /* If port probe list gets empty, remove the device object iself */
             if (!mm_device_peek_port_probe_list (device)) {
                 mm_dbg ("Removing empty device '%s'", mm_device_get_path (device));
                 mm_device_remove_modem (device);
-                g_hash_table_remove (self->priv->devices, mm_device_get_path (device));
+                remove_device (self, device);
             }
         }
 
@@ -398,7 +424,7 @@ device_removed (MMBaseManager *self,
     if (device) {
         mm_dbg ("Removing device '%s'", mm_device_get_path (device));
         mm_device_remove_modem (device);
-        g_hash_table_remove (self->priv->devices, mm_device_get_path (device));
+        remove_device (self, device);
         return;
     }
 
@@ -533,7 +559,7 @@ remove_disable_ready (MMBaseModem *modem,
     device = find_device_by_modem (self, modem);
     if (device) {
         mm_device_remove_modem (device);
-        g_hash_table_remove (self->priv->devices, device);
+        remove_device (self, device);
     }
 }
 
@@ -757,7 +783,7 @@ out:
 
     if (error) {
         mm_device_remove_modem (device);
-        g_hash_table_remove (self->priv->devices, mm_device_get_path (device));
+        remove_device (self, device);
         g_dbus_method_invocation_return_gerror (invocation, error);
         g_error_free (error);
     } else
@@ -878,6 +904,7 @@ mm_base_manager_init (MMBaseManager *manager)
 
     /* Setup internal lists of device objects */
     priv->devices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+    priv->ports = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
     /* Setup UDev client */
     priv->udev = g_udev_client_new (subsys);
@@ -954,6 +981,7 @@ finalize (GObject *object)
 
     g_free (priv->plugin_dir);
 
+    g_hash_table_destroy (priv->ports);
     g_hash_table_destroy (priv->devices);
 
     if (priv->udev)
@@ -13,6 +13,8 @@
  * Copyright (C) 2011 Aleksander Morgado <aleksander@gnu.org>
  */
 
+#include <string.h>
+
 #include <glib.h>
 #include <glib-object.h>
 
@@ -20,6 +22,21 @@
 
 #include "mm-base-modem-at.h"
 #include "mm-errors-types.h"
+#include "mm-modem-helpers.h"
+#include "mm-log.h"
+
+/* Keep chained command lines within what any modem accepts */
+#define AT_CHAIN_MAX_LENGTH 128
+
+/* Chaining is disabled only after several different command lines were
+ * rejected even if all their commands work one by one, so that a transient
+ * failure (e.g. a timeout) doesn't disable it for good */
+#define AT_CHAINING_MAX_REJECTIONS 3
+
+#define AT_CHAINING_REJECTIONS_TAG "at-chaining-rejections-tag"
+#define AT_CHAINS_REJECTED_TAG     "at-chains-rejected-tag"
+static GQuark at_chaining_rejections_quark;
+static GQuark at_chains_rejected_quark;
 
 static gboolean
 abort_async_if_port_unusable (MMBaseModem *self,
@@ -102,6 +119,12 @@ typedef struct {
     gpointer response_processor_context;
     GDestroyNotify response_processor_context_free;
     GVariant *result;
+    /* Current chained command line, and how many commands it has */
+    gchar *chain;
+    guint n_chained;
+    /* Commands of a rejected chained command line still to run one by one */
+    guint n_unchained;
+    gboolean unchained_error;
 } AtSequenceContext;
 
 static void
@@ -127,6 +150,7 @@ at_sequence_context_free (AtSequenceContext *ctx)
         g_variant_unref (ctx->result);
     if (ctx->simple)
         g_object_unref (ctx->simple);
+    g_free (ctx->chain);
     g_free (ctx);
 }
 
@@ -153,40 +177,57 @@ mm_base_modem_at_sequence_full_finish (MMBaseModem *self,
 }
 
 static void
-at_sequence_parse_response (MMPortSerialAt *port,
-                            GAsyncResult *res,
-                            AtSequenceContext *ctx)
+at_sequence_complete (AtSequenceContext *ctx,
+                      GVariant *result)
 {
-    GVariant *result = NULL;
-    GError *result_error = NULL;
-    gboolean continue_sequence;
     GSimpleAsyncResult *simple;
-    const gchar *response;
-    GError *error = NULL;
 
-    response = mm_port_serial_at_command_finish (port, res, &error);
+    /* If we got a response, set it as result */
+    if (result)
+        /* transfer-full */
+        ctx->result = result;
 
-    /* Cancelled? */
-    if (g_cancellable_is_cancelled (ctx->cancellable)) {
-        g_simple_async_result_set_error (ctx->simple,
-                                         MM_CORE_ERROR,
-                                         MM_CORE_ERROR_CANCELLED,
-                                         "AT sequence was cancelled");
-        if (error)
-            g_error_free (error);
-        g_simple_async_result_complete (ctx->simple);
-        at_sequence_context_free (ctx);
-        return;
-    }
+    /* Set the whole context as result, in order to pass the response
+     * processor context during finish(). We do remove the simple async result
+     * from the context as well, so that we control its last unref. */
+    simple = ctx->simple;
+    ctx->simple = NULL;
+    g_simple_async_result_set_op_res_gpointer (
+        simple,
+        ctx,
+        (GDestroyNotify)at_sequence_context_free);
+
+    /* And complete. The whole context is owned by the result, and it will
+     * be freed when completed. */
+    g_simple_async_result_complete (simple);
+    g_object_unref (simple);
+}
 
+static void
+at_sequence_abort (AtSequenceContext *ctx,
+                   GError *error)
+{
+    g_simple_async_result_take_error (ctx->simple, error);
+    g_simple_async_result_complete (ctx->simple);
+    at_sequence_context_free (ctx);
+}
+
+/* Returns FALSE if the sequence got completed */
+static gboolean
+at_sequence_process_response (AtSequenceContext *ctx,
+                              const gchar *response,
+                              const GError *error)
+{
+    const MMBaseModemAtCommand *next = ctx->current + 1;
+    GVariant *result = NULL;
+    GError *result_error = NULL;
+
+    /* No need to process response, go on to next command */
     if (!ctx->current->response_processor)
-        /* No need to process response, go on to next command */
-        continue_sequence = TRUE;
-    else {
-        const MMBaseModemAtCommand *next = ctx->current + 1;
+        return TRUE;
 
-        /* Response processor will tell us if we need to keep on the sequence */
-        continue_sequence = !ctx->current->response_processor (
+    /* Response processor will tell us if we need to keep on the sequence */
+    if (!ctx->current->response_processor (
             ctx->self,
             ctx->response_processor_context,
             ctx->current->command,
@@ -194,61 +235,264 @@ at_sequence_parse_response (MMPortSerialAt *port,
             next->command ? FALSE : TRUE,  /* Last command in sequence? */
             error,
             &result,
-            &result_error);
+            &result_error)) {
+        g_assert (result == NULL);
         /* Were we told to abort the sequence? */
         if (result_error) {
-            g_assert (result == NULL);
-            g_simple_async_result_take_error (ctx->simple, result_error);
-            g_simple_async_result_complete (ctx->simple);
-            at_sequence_context_free (ctx);
-            if (error)
-                g_error_free (error);
-            return;
+            at_sequence_abort (ctx, result_error);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    if (result_error) {
+        g_assert (result == NULL);
+        at_sequence_abort (ctx, result_error);
+        return FALSE;
+    }
+
+    at_sequence_complete (ctx, result);
+    return FALSE;
+}
+
+static gboolean
+at_sequence_check_cancelled (AtSequenceContext *ctx)
+{
+    if (!g_cancellable_is_cancelled (ctx->cancellable))
+        return FALSE;
+
+    g_simple_async_result_set_error (ctx->simple,
+                                     MM_CORE_ERROR,
+                                     MM_CORE_ERROR_CANCELLED,
+                                     "AT sequence was cancelled");
+    g_simple_async_result_complete (ctx->simple);
+    at_sequence_context_free (ctx);
+    return TRUE;
+}
+
+static void at_sequence_run (AtSequenceContext *ctx,
+                             gboolean allow_cached);
+
+static void
+at_sequence_parse_response (MMPortSerialAt *port,
+                            GAsyncResult *res,
+                            AtSequenceContext *ctx)
+{
+    const gchar *response;
+    GError *error = NULL;
+    gboolean continue_sequence;
+
+    response = mm_port_serial_at_command_finish (port, res, &error);
+
+    /* Cancelled? */
+    if (at_sequence_check_cancelled (ctx)) {
+        if (error)
+            g_error_free (error);
+        return;
+    }
+
+    /* Running the commands of a rejected command line one by one; if all of
+     * them work, the modem may just not support chaining */
+    if (ctx->n_unchained) {
+        if (error)
+            ctx->unchained_error = TRUE;
+        if (--ctx->n_unchained == 0 && !ctx->unchained_error) {
+            guint n_rejections;
+
+            n_rejections = GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (ctx->self),
+                                                                 at_chaining_rejections_quark));
+            n_rejections++;
+            g_object_set_qdata (G_OBJECT (ctx->self),
+                                at_chaining_rejections_quark,
+                                GUINT_TO_POINTER (n_rejections));
+            if (n_rejections == AT_CHAINING_MAX_REJECTIONS)
+                mm_dbg ("AT command chaining not supported, disabling it");
         }
     }
 
+    continue_sequence = at_sequence_process_response (ctx, response, error);
     if (error)
         g_error_free (error);
+    if (!continue_sequence)
+        return;
 
-    if (continue_sequence) {
-        g_assert (result == NULL);
-        ctx->current++;
-        if (ctx->current->command) {
-            /* Schedule the next command in the probing group */
-            mm_port_serial_at_command (
-                ctx->port,
-                ctx->current->command,
-                ctx->current->timeout,
-                FALSE,
-                ctx->current->allow_cached,
-                ctx->cancellable,
-                (GAsyncReadyCallback)at_sequence_parse_response,
-                ctx);
+    ctx->current++;
+    if (ctx->current->command) {
+        /* Schedule the next command in the probing group */
+        at_sequence_run (ctx, ctx->current->allow_cached);
+        return;
+    }
+
+    /* On last command, end. */
+    at_sequence_complete (ctx, NULL);
+}
+
+static void
+at_sequence_parse_chained_response (MMPortSerialAt *port,
+                                    GAsyncResult *res,
+                                    AtSequenceContext *ctx)
+{
+    const gchar *commands[AT_CHAIN_MAX_LENGTH / 2];
+    const gchar *response;
+    GError *error = NULL;
+    gchar **split;
+    guint n_chained;
+    guint i;
+
+    response = mm_port_serial_at_command_finish (port, res, &error);
+
+    /* Cancelled? */
+    if (at_sequence_check_cancelled (ctx)) {
+        if (error)
+            g_error_free (error);
+        return;
+    }
+
+    n_chained = ctx->n_chained;
+    ctx->n_chained = 0;
+
+    /* Either one of the commands failed or the modem doesn't like chaining;
+     * run them again one by one to know. This same line won't be chained
+     * again in this modem. */
+    if (error) {
+        GHashTable *rejected;
+
+        mm_dbg ("Chained AT command line failed: '%s'", error->message);
+        g_error_free (error);
+
+        rejected = g_object_get_qdata (G_OBJECT (ctx->self), at_chains_rejected_quark);
+        if (!rejected) {
+            rejected = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+            g_object_set_qdata_full (G_OBJECT (ctx->self),
+                                     at_chains_rejected_quark,
+                                     rejected,
+                                     (GDestroyNotify)g_hash_table_unref);
+        }
+        g_hash_table_add (rejected, ctx->chain);
+        ctx->chain = NULL;
+
+        ctx->n_unchained = n_chained;
+        ctx->unchained_error = FALSE;
+        at_sequence_run (ctx, ctx->current->allow_cached);
+        return;
+    }
+
+    for (i = 0; i < n_chained; i++)
+        commands[i] = ctx->current[i].command;
+    split = mm_split_chained_response (response, commands, n_chained);
+
+    for (i = 0; i < n_chained; i++) {
+        if (!at_sequence_process_response (ctx, split[i], NULL)) {
+            g_strfreev (split);
             return;
         }
+        ctx->current++;
+    }
+    g_strfreev (split);
 
-        /* On last command, end. */
+    if (ctx->current->command) {
+        at_sequence_run (ctx, ctx->current->allow_cached);
+        return;
     }
 
-    /* If we got a response, set it as result */
-    if (result)
-        /* transfer-full */
-        ctx->result = result;
+    /* On last command, end. */
+    at_sequence_complete (ctx, NULL);
+}
 
-    /* Set the whole context as result, in order to pass the response
-     * processor context during finish(). We do remove the simple async result
-     * from the context as well, so that we control its last unref. */
-    simple = ctx->simple;
-    ctx->simple = NULL;
-    g_simple_async_result_set_op_res_gpointer (
-        simple,
-        ctx,
-        (GDestroyNotify)at_sequence_context_free);
+static gboolean
+command_is_chainable (const MMBaseModemAtCommand *command)
+{
+    const gchar *str = command->command;
+    gsize len;
 
-    /* And complete. The whole context is owned by the result, and it will
-     * be freed when completed. */
-    g_simple_async_result_complete (simple);
-    g_object_unref (simple);
+    if (!command->allow_chaining)
+        return FALSE;
+
+    if (!g_ascii_strncasecmp (str, "AT", 2))
+        str += 2;
+    len = strlen (str);
+
+    /* Only extended read commands, e.g. "+CREG?" */
+    return (len > 2 && str[0] == '+' && str[len - 1] == '?' && !strchr (str, ';'));
+}
+
+static gboolean
+at_sequence_build_chain (AtSequenceContext *ctx,
+                         guint *timeout)
+{
+    const MMBaseModemAtCommand *command;
+    GHashTable *rejected;
+    GString *line;
+
+    if (G_UNLIKELY (!at_chaining_rejections_quark)) {
+        at_chaining_rejections_quark = g_quark_from_static_string (AT_CHAINING_REJECTIONS_TAG);
+        at_chains_rejected_quark = g_quark_from_static_string (AT_CHAINS_REJECTED_TAG);
+    }
+
+    g_free (ctx->chain);
+    ctx->chain = NULL;
+
+    if (ctx->n_unchained ||
+        (GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (ctx->self), at_chaining_rejections_quark)) >=
+         AT_CHAINING_MAX_REJECTIONS))
+        return FALSE;
+
+    line = g_string_new ("");
+    *timeout = 0;
+    for (command = ctx->current; command->command && command_is_chainable (command); command++) {
+        const gchar *str = command->command;
+
+        if (!g_ascii_strncasecmp (str, "AT", 2))
+            str += 2;
+        if (line->len && line->len + 1 + strlen (str) > AT_CHAIN_MAX_LENGTH)
+            break;
+        if (line->len)
+            g_string_append_c (line, ';');
+        g_string_append (line, str);
+        *timeout += command->timeout;
+        ctx->n_chained++;
+    }
+
+    rejected = g_object_get_qdata (G_OBJECT (ctx->self), at_chains_rejected_quark);
+    if (ctx->n_chained < 2 ||
+        (rejected && g_hash_table_contains (rejected, line->str))) {
+        ctx->n_chained = 0;
+        g_string_free (line, TRUE);
+        return FALSE;
+    }
+
+    ctx->chain = g_string_free (line, FALSE);
+    return TRUE;
+}
+
+static void
+at_sequence_run (AtSequenceContext *ctx,
+                 gboolean allow_cached)
+{
+    guint timeout;
+
+    if (at_sequence_build_chain (ctx, &timeout)) {
+        mm_port_serial_at_command (
+            ctx->port,
+            ctx->chain,
+            timeout,
+            FALSE,
+            FALSE,
+            ctx->cancellable,
+            (GAsyncReadyCallback)at_sequence_parse_chained_response,
+            ctx);
+        return;
+    }
+
+    mm_port_serial_at_command (
+        ctx->port,
+        ctx->current->command,
+        ctx->current->timeout,
+        FALSE,
+        allow_cached,
+        ctx->cancellable,
+        (GAsyncReadyCallback)at_sequence_parse_response,
+        ctx);
 }
 
 void
@@ -296,15 +540,7 @@ mm_base_modem_at_sequence_full (MMBaseModem *self,
     }
 
     /* Go on with the first one in the sequence */
-    mm_port_serial_at_command (
-        ctx->port,
-        ctx->current->command,
-        ctx->current->timeout,
-        FALSE,
-        FALSE,
-        ctx->cancellable,
-        (GAsyncReadyCallback)at_sequence_parse_response,
-        ctx);
+    at_sequence_run (ctx, FALSE);
 }
 
 GVariant *
@@ -504,23 +740,15 @@ at_command_ready (MMPortSerialAt *port,
     at_command_context_free (ctx);
 }
 
-void
-mm_base_modem_at_command_full (MMBaseModem *self,
-                               MMPortSerialAt *port,
-                               const gchar *command,
-                               guint timeout,
-                               gboolean allow_cached,
-                               gboolean is_raw,
-                               GCancellable *cancellable,
-                               GAsyncReadyCallback callback,
-                               gpointer user_data)
+static AtCommandContext *
+at_command_context_new (MMBaseModem *self,
+                        MMPortSerialAt *port,
+                        GCancellable *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data)
 {
     AtCommandContext *ctx;
 
-    /* Ensure that we have an open port */
-    if (!abort_async_if_port_unusable (self, port, callback, user_data))
-        return;
-
     ctx = g_new0 (AtCommandContext, 1);
     ctx->self = g_object_ref (self);
     ctx->port = g_object_ref (port);
@@ -545,6 +773,28 @@ mm_base_modem_at_command_full (MMBaseModem *self,
                                                    NULL);
     }
 
+    return ctx;
+}
+
+void
+mm_base_modem_at_command_full (MMBaseModem *self,
+                               MMPortSerialAt *port,
+                               const gchar *command,
+                               guint timeout,
+                               gboolean allow_cached,
+                               gboolean is_raw,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
+{
+    AtCommandContext *ctx;
+
+    /* Ensure that we have an open port */
+    if (!abort_async_if_port_unusable (self, port, callback, user_data))
+        return;
+
+    ctx = at_command_context_new (self, port, cancellable, callback, user_data);
+
     /* Go on with the command */
     mm_port_serial_at_command (
         port,
@@ -620,3 +870,46 @@ mm_base_modem_at_command_raw (MMBaseModem *self,
 {
     _at_command (self, command, timeout, allow_cached, TRUE, callback, user_data);
 }
+
+void
+mm_base_modem_at_command_streaming (MMBaseModem *self,
+                                    const gchar *command,
+                                    guint timeout,
+                                    GRegex *entry_regex,
+                                    MMPortSerialAtStreamEntryFn entry_callback,
+                                    gpointer entry_user_data,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data)
+{
+    AtCommandContext *ctx;
+    MMPortSerialAt *port;
+    GError *error = NULL;
+
+    /* No port given, so we'll try to guess which is best */
+    port = mm_base_modem_peek_best_at_port (self, &error);
+    if (!port) {
+        g_assert (error != NULL);
+        g_simple_async_report_take_gerror_in_idle (G_OBJECT (self),
+                                                   callback,
+                                                   user_data,
+                                                   error);
+        return;
+    }
+
+    /* Ensure that we have an open port */
+    if (!abort_async_if_port_unusable (self, port, callback, user_data))
+        return;
+
+    ctx = at_command_context_new (self, port, NULL, callback, user_data);
+
+    mm_port_serial_at_command_streaming (
+        port,
+        command,
+        timeout,
+        entry_regex,
+        entry_callback,
+        entry_user_data,
+        ctx->cancellable,
+        (GAsyncReadyCallback)at_command_ready,
+        ctx);
+}
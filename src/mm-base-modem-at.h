@@ -61,6 +61,9 @@ typedef struct {
     gboolean allow_cached;
     /* The response processor */
     MMBaseModemAtResponseProcessor response_processor;
+    /* Flag to allow sending the command in the same command line as the
+     * next ones in the sequence, see mm_base_modem_at_sequence_full() */
+    gboolean allow_chaining;
 } MMBaseModemAtCommand;
 
 /* Generic AT sequence handling, using the best AT port available and without
@@ -77,7 +80,17 @@ GVariant *mm_base_modem_at_sequence_finish (MMBaseModem *self,
                                             GError **error);
 
 /* Fully detailed AT sequence handling, when specific AT port and/or explicit
- * cancellations need to be used. */
+ * cancellations need to be used.
+ *
+ * Consecutive extended read commands (e.g. "+CREG?") flagged with
+ * allow_chaining are sent in a single command line ("AT+CREG?;+CGREG?"), and
+ * each response processor gets the lines prefixed with its command name, or
+ * an empty response if there are none. If the modem rejects the chained line,
+ * the commands are sent one by one, and the same line is never chained again
+ * in that modem. Each rejected line whose commands all succeed one by one
+ * counts as a rejection of chaining itself; after three of them, chaining is
+ * disabled for the modem altogether. This state is kept in the modem object,
+ * so it is lost when the modem is removed, e.g. on replug. */
 void     mm_base_modem_at_sequence_full         (MMBaseModem *self,
                                                  MMPortSerialAt *port,
                                                  const MMBaseModemAtCommand *sequence,
@@ -149,6 +162,19 @@ const gchar *mm_base_modem_at_command_finish (MMBaseModem *self,
                                               GAsyncResult *res,
                                               GError **error);
 
+/* Like mm_base_modem_at_command() except that complete entries matching
+ * @entry_regex are reported as they arrive, see
+ * mm_port_serial_at_command_streaming(). Never cached. The response given by
+ * mm_base_modem_at_command_finish() is what was left after the entries. */
+void mm_base_modem_at_command_streaming      (MMBaseModem *self,
+                                              const gchar *command,
+                                              guint timeout,
+                                              GRegex *entry_regex,
+                                              MMPortSerialAtStreamEntryFn entry_callback,
+                                              gpointer entry_user_data,
+                                              GAsyncReadyCallback callback,
+                                              gpointer user_data);
+
 /* Fully detailed AT command handling, when specific AT port and/or explicit
  * cancellations need to be used. */
 void mm_base_modem_at_command_full                (MMBaseModem *self,
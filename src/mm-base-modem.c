@@ -82,6 +82,9 @@ struct _MMBaseModemPrivate {
     MMPortSerialAt *secondary;
     MMPortSerialQcdm *qcdm;
     GList *data;
+    /* Driver and utilization of each data port */
+    GHashTable *data_port_infos;
+    guint n_data_port_connections;
 
     /* GPS-enabled modems will have an AT port for control, and a raw serial
      * port to receive all GPS traces */
@@ -363,6 +366,7 @@ mm_base_modem_release_port (MMBaseModem *self,
 
     l = g_list_find (self->priv->data, port);
     if (l) {
+        g_hash_table_remove (self->priv->data_port_infos, port);
         g_object_unref (l->data);
         self->priv->data = g_list_delete_link (self->priv->data, l);
     }
@@ -758,6 +762,107 @@ mm_base_modem_peek_port_mbim_for_data (MMBaseModem *self,
 
 #endif /* WITH_MBIM */
 
+/*****************************************************************************/
+/* Data ports */
+
+typedef struct {
+    MMPort *port;
+    gchar *driver;
+    guint rank;
+    gulong connected_id;
+    MMDataPortUsage usage;
+} DataPortInfo;
+
+static void
+data_port_info_free (DataPortInfo *info)
+{
+    if (info->connected_id)
+        g_signal_handler_disconnect (info->port, info->connected_id);
+    g_free (info->driver);
+    g_slice_free (DataPortInfo, info);
+}
+
+static void
+log_data_port_utilization (MMBaseModem *self)
+{
+    gint64 now;
+    GList *l;
+
+    now = g_get_monotonic_time ();
+    mm_dbg ("(%s) data port utilization:", self->priv->device);
+    for (l = self->priv->data; l; l = g_list_next (l)) {
+        DataPortInfo *info;
+
+        info = g_hash_table_lookup (self->priv->data_port_infos, l->data);
+        if (!info)
+            continue;
+
+        mm_dbg ("(%s)   %s/%s [%s]: %s, %u connections, %us connected",
+                self->priv->device,
+                mm_port_subsys_get_string (mm_port_get_subsys (info->port)),
+                mm_port_get_device (info->port),
+                info->driver ? info->driver : "unknown",
+                info->usage.connected_since ? "in use" : "free",
+                info->usage.n_connections,
+                (guint) (mm_data_port_usage_get_connected_time (&info->usage, now) / G_USEC_PER_SEC));
+    }
+}
+
+static void
+data_port_connected_changed (MMPort *port,
+                             GParamSpec *pspec,
+                             MMBaseModem *self)
+{
+    DataPortInfo *info;
+
+    info = g_hash_table_lookup (self->priv->data_port_infos, port);
+    g_assert (info != NULL);
+
+    if (mm_data_port_usage_set_connected (&info->usage,
+                                          mm_port_get_connected (port),
+                                          g_get_monotonic_time (),
+                                          &self->priv->n_data_port_connections))
+        log_data_port_utilization (self);
+}
+
+static void
+data_port_info_add (MMBaseModem *self,
+                    MMPort *port)
+{
+    DataPortInfo *info;
+
+    info = g_slice_new0 (DataPortInfo);
+    info->port = port;
+    if (mm_port_get_port_type (port) == MM_PORT_TYPE_NET)
+        info->driver = mm_net_port_get_driver (NULL, mm_port_get_device (port));
+    info->rank = mm_net_driver_get_rank (info->driver);
+
+    info->connected_id = g_signal_connect (port,
+                                           "notify::" MM_PORT_CONNECTED,
+                                           G_CALLBACK (data_port_connected_changed),
+                                           self);
+    g_hash_table_insert (self->priv->data_port_infos, port, info);
+}
+
+static gint
+data_port_cmp (MMPort *a,
+               MMPort *b,
+               MMBaseModem *self)
+{
+    DataPortInfo *info_a;
+    DataPortInfo *info_b;
+
+    /* AT ports keep their order, with the PPP-flagged one first */
+    info_a = g_hash_table_lookup (self->priv->data_port_infos, a);
+    info_b = g_hash_table_lookup (self->priv->data_port_infos, b);
+    return mm_data_port_cmp (mm_port_get_port_type (a) == MM_PORT_TYPE_NET,
+                             info_a->rank,
+                             mm_port_get_device (a),
+                             mm_port_get_port_type (b) == MM_PORT_TYPE_NET,
+                             info_b->rank,
+                             mm_port_get_device (b));
+}
+
 MMPort *
 mm_base_modem_get_best_data_port (MMBaseModem *self,
                                   MMPortType type)
@@ -772,20 +877,52 @@ MMPort *
 mm_base_modem_peek_best_data_port (MMBaseModem *self,
                                    MMPortType type)
 {
+    MMDataPortSelection selection;
+    GPtrArray *candidates = NULL;
+    GPtrArray *usages = NULL;
+    MMPort *best = NULL;
     GList *l;
 
     g_return_val_if_fail (MM_IS_BASE_MODEM (self), NULL);
 
-    /* Return first not-connected data port */
+    selection = mm_context_get_data_port_selection ();
+
     for (l = self->priv->data; l; l = g_list_next (l)) {
-        if (!mm_port_get_connected ((MMPort *)l->data) &&
-            (mm_port_get_port_type ((MMPort *)l->data) == type ||
-             type == MM_PORT_TYPE_UNKNOWN)) {
+        DataPortInfo *info;
+
+        if (mm_port_get_connected ((MMPort *)l->data) ||
+            (mm_port_get_port_type ((MMPort *)l->data) != type &&
+             type != MM_PORT_TYPE_UNKNOWN))
+            continue;
+
+        /* Return first not-connected data port */
+        if (selection == MM_DATA_PORT_SELECTION_FIRST)
             return (MMPort *)l->data;
+
+        info = g_hash_table_lookup (self->priv->data_port_infos, l->data);
+        if (!info)
+            continue;
+        if (!candidates) {
+            candidates = g_ptr_array_new ();
+            usages = g_ptr_array_new ();
         }
+        g_ptr_array_add (candidates, info->port);
+        g_ptr_array_add (usages, &info->usage);
     }
 
-    return NULL;
+    /* Otherwise, the not-connected port used longest ago, so that
+     * multiple bearers get spread across all of them */
+    if (candidates) {
+        gint i;
+
+        i = mm_data_port_usage_select ((const MMDataPortUsage **) usages->pdata, usages->len);
+        if (i >= 0)
+            best = g_ptr_array_index (candidates, i);
+        g_ptr_array_unref (candidates);
+        g_ptr_array_unref (usages);
+    }
+
+    return best;
 }
 
 GList *
@@ -1194,9 +1331,6 @@ mm_base_modem_organize_ports (MMBaseModem *self,
 
     log_port (self, MM_PORT (primary),      "at (primary)");
     log_port (self, MM_PORT (secondary),    "at (secondary)");
-    log_port (self, MM_PORT (data_primary), "data (primary)");
-    for (l = data; l; l = g_list_next (l))
-        log_port (self, MM_PORT (l->data),  "data (secondary)");
     log_port (self, MM_PORT (qcdm),         "qcdm");
     log_port (self, MM_PORT (gps_control),  "gps (control)");
     log_port (self, MM_PORT (gps),          "gps (nmea)");
@@ -1223,6 +1357,18 @@ mm_base_modem_organize_ports (MMBaseModem *self,
     g_list_foreach (data, (GFunc)g_object_ref, NULL);
     self->priv->data = g_list_concat (self->priv->data, data);
 
+    /* When spreading connections across all data ports, sort them by
+     * preference; otherwise the primary one given by the plugin is kept
+     * as the one used first */
+    for (l = self->priv->data; l; l = g_list_next (l))
+        data_port_info_add (self, MM_PORT (l->data));
+    if (mm_context_get_data_port_selection () == MM_DATA_PORT_SELECTION_ROUND_ROBIN)
+        self->priv->data = g_list_sort_with_data (self->priv->data,
+                                                  (GCompareDataFunc)data_port_cmp,
+                                                  self);
+    for (l = self->priv->data; l; l = g_list_next (l))
+        log_port (self, MM_PORT (l->data), (l == self->priv->data ? "data (primary)" : "data (secondary)"));
+
 #if defined WITH_QMI
     /* Build the final list of QMI ports, primary port first */
     if (qmi_primary) {
@@ -1395,6 +1541,11 @@ mm_base_modem_init (MMBaseModem *self)
                                                g_str_equal,
                                                g_free,
                                                g_object_unref);
+
+    self->priv->data_port_infos = g_hash_table_new_full (g_direct_hash,
+                                                         g_direct_equal,
+                                                         NULL,
+                                                         (GDestroyNotify)data_port_info_free);
 }
 
 static void
@@ -1495,6 +1646,7 @@ finalize (GObject *object)
     g_free (self->priv->device);
     g_strfreev (self->priv->drivers);
     g_free (self->priv->plugin);
+    g_hash_table_unref (self->priv->data_port_infos);
 
     G_OBJECT_CLASS (mm_base_modem_parent_class)->finalize (object);
 }
@@ -1519,6 +1671,7 @@ dispose (GObject *object)
 
     g_clear_object (&self->priv->primary);
     g_clear_object (&self->priv->secondary);
+    g_hash_table_remove_all (self->priv->data_port_infos);
     g_list_free_full (self->priv->data, g_object_unref);
     self->priv->data = NULL;
     g_clear_object (&self->priv->qcdm);
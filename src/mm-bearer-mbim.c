@@ -42,11 +42,22 @@ enum {
 
 static GParamSpec *properties[PROP_LAST];
 
+typedef struct {
+    guint64 rx_bytes;
+    guint64 tx_bytes;
+    guint64 rx_packets;
+    guint64 tx_packets;
+} PacketStatistics;
+
 struct _MMBearerMbimPrivate {
     /* The session ID for this bearer */
     guint32 session_id;
 
     MMPort *data;
+
+    /* Counters when the connection was started, as those reported by the
+     * device accumulate across connections */
+    PacketStatistics stats_baseline;
 };
 
 /*****************************************************************************/
@@ -113,6 +124,7 @@ typedef enum {
     CONNECT_STEP_FIRST,
     CONNECT_STEP_PACKET_SERVICE,
     CONNECT_STEP_PROVISIONED_CONTEXTS,
+    CONNECT_STEP_PACKET_STATISTICS,
     CONNECT_STEP_CONNECT,
     CONNECT_STEP_IP_CONFIGURATION,
     CONNECT_STEP_LAST
@@ -556,6 +568,50 @@ provisioned_contexts_query_ready (MbimDevice *device,
     connect_context_step (ctx);
 }
 
+static gboolean
+packet_statistics_parse (MbimMessage *response,
+                         PacketStatistics *stats,
+                         GError **error)
+{
+    return (mbim_message_command_done_get_result (response, error) &&
+            mbim_message_packet_statistics_response_parse (
+                response,
+                NULL, /* in_discards */
+                NULL, /* in_errors */
+                &stats->rx_bytes,
+                &stats->rx_packets,
+                &stats->tx_bytes,
+                &stats->tx_packets,
+                NULL, /* out_errors */
+                NULL, /* out_discards */
+                error));
+}
+
+static void
+packet_statistics_baseline_query_ready (MbimDevice *device,
+                                        GAsyncResult *res,
+                                        ConnectContext *ctx)
+{
+    GError *error = NULL;
+    MbimMessage *response;
+
+    /* Not fatal, counters are then reported as given by the device */
+    response = mbim_device_command_finish (device, res, &error);
+    if (!response ||
+        !packet_statistics_parse (response, &ctx->self->priv->stats_baseline, &error)) {
+        mm_dbg ("Couldn't query packet statistics baseline: %s", error->message);
+        g_error_free (error);
+        memset (&ctx->self->priv->stats_baseline, 0, sizeof (PacketStatistics));
+    }
+
+    if (response)
+        mbim_message_unref (response);
+
+    /* Keep on */
+    ctx->step++;
+    connect_context_step (ctx);
+}
+
 static void
 packet_service_set_ready (MbimDevice *device,
                           GAsyncResult *res,
@@ -684,6 +740,18 @@ connect_context_step (ConnectContext *ctx)
         mbim_message_unref (message);
         return;
 
+    case CONNECT_STEP_PACKET_STATISTICS:
+        mm_dbg ("Querying packet statistics baseline...");
+        message = mbim_message_packet_statistics_query_new (NULL);
+        mbim_device_command (ctx->device,
+                             message,
+                             5,
+                             NULL,
+                             (GAsyncReadyCallback)packet_statistics_baseline_query_ready,
+                             ctx);
+        mbim_message_unref (message);
+        return;
+
     case CONNECT_STEP_CONNECT: {
         const gchar *apn;
         const gchar *user;
@@ -1114,6 +1182,116 @@ disconnect (MMBaseBearer *_self,
     disconnect_context_step (ctx);
 }
 
+/*****************************************************************************/
+/* Reload stats */
+
+static gboolean
+reload_stats_finish (MMBaseBearer *self,
+                     GAsyncResult *res,
+                     guint64 *rx_bytes,
+                     guint64 *tx_bytes,
+                     guint64 *rx_packets,
+                     guint64 *tx_packets,
+                     GError **error)
+{
+    PacketStatistics *stats;
+
+    if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error))
+        return FALSE;
+
+    stats = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res));
+    *rx_bytes = stats->rx_bytes;
+    *tx_bytes = stats->tx_bytes;
+    *rx_packets = stats->rx_packets;
+    *tx_packets = stats->tx_packets;
+    return TRUE;
+}
+
+static guint64
+packet_statistics_diff (guint64 current,
+                        guint64 baseline)
+{
+    /* Counters restart if the device gets reset */
+    return (current >= baseline ? current - baseline : current);
+}
+
+static void
+packet_statistics_query_ready (MbimDevice *device,
+                               GAsyncResult *res,
+                               GSimpleAsyncResult *simple)
+{
+    MMBearerMbim *self;
+    GError *error = NULL;
+    MbimMessage *response;
+    PacketStatistics stats;
+
+    self = MM_BEARER_MBIM (g_async_result_get_source_object (G_ASYNC_RESULT (simple)));
+
+    response = mbim_device_command_finish (device, res, &error);
+    if (response && packet_statistics_parse (response, &stats, &error)) {
+        /* Only the traffic of the current connection */
+        stats.rx_bytes = packet_statistics_diff (stats.rx_bytes, self->priv->stats_baseline.rx_bytes);
+        stats.tx_bytes = packet_statistics_diff (stats.tx_bytes, self->priv->stats_baseline.tx_bytes);
+        stats.rx_packets = packet_statistics_diff (stats.rx_packets, self->priv->stats_baseline.rx_packets);
+        stats.tx_packets = packet_statistics_diff (stats.tx_packets, self->priv->stats_baseline.tx_packets);
+        g_simple_async_result_set_op_res_gpointer (simple,
+                                                   g_memdup (&stats, sizeof (stats)),
+                                                   g_free);
+    } else {
+        g_prefix_error (&error, "Couldn't query packet statistics: ");
+        g_simple_async_result_take_error (simple, error);
+    }
+
+    if (response)
+        mbim_message_unref (response);
+
+    g_simple_async_result_complete (simple);
+    g_object_unref (simple);
+    g_object_unref (self);
+}
+
+static void
+reload_stats (MMBaseBearer *_self,
+              GAsyncReadyCallback callback,
+              gpointer user_data)
+{
+    MMBearerMbim *self = MM_BEARER_MBIM (_self);
+    MbimDevice *device;
+    MbimMessage *message;
+    GSimpleAsyncResult *result;
+
+    if (!self->priv->data) {
+        g_simple_async_report_error_in_idle (
+            G_OBJECT (self),
+            callback,
+            user_data,
+            MM_CORE_ERROR,
+            MM_CORE_ERROR_WRONG_STATE,
+            "Couldn't reload stats: this bearer is not connected");
+        return;
+    }
+
+    if (!peek_ports (self, &device, NULL, callback, user_data))
+        return;
+
+    result = g_simple_async_result_new (G_OBJECT (self),
+                                        callback,
+                                        user_data,
+                                        reload_stats);
+
+    /* Counters are given for the whole function, which is fine as the
+     * bearer owns the single data session; the baseline taken when
+     * connecting is removed when the reply arrives */
+    message = mbim_message_packet_statistics_query_new (NULL);
+    mbim_device_command (device,
+                         message,
+                         5,
+                         NULL,
+                         (GAsyncReadyCallback)packet_statistics_query_ready,
+                         result);
+    mbim_message_unref (message);
+}
+
 /*****************************************************************************/
 
 guint32
@@ -1221,6 +1399,8 @@ mm_bearer_mbim_class_init (MMBearerMbimClass *klass)
     base_bearer_class->connect_finish = connect_finish;
     base_bearer_class->disconnect = disconnect;
     base_bearer_class->disconnect_finish = disconnect_finish;
+    base_bearer_class->reload_stats = reload_stats;
+    base_bearer_class->reload_stats_finish = reload_stats_finish;
 
     properties[PROP_SESSION_ID] =
         g_param_spec_uint (MM_BEARER_MBIM_SESSION_ID,
@@ -61,20 +61,37 @@ struct _MMBearerQmiPrivate {
 typedef enum {
     CONNECT_STEP_FIRST,
     CONNECT_STEP_OPEN_QMI_PORT,
-    CONNECT_STEP_IPV4,
-    CONNECT_STEP_WDS_CLIENT_IPV4,
-    CONNECT_STEP_IP_FAMILY_IPV4,
-    CONNECT_STEP_START_NETWORK_IPV4,
-    CONNECT_STEP_GET_CURRENT_SETTINGS_IPV4,
-    CONNECT_STEP_IPV6,
-    CONNECT_STEP_WDS_CLIENT_IPV6,
-    CONNECT_STEP_IP_FAMILY_IPV6,
-    CONNECT_STEP_START_NETWORK_IPV6,
-    CONNECT_STEP_GET_CURRENT_SETTINGS_IPV6,
+    CONNECT_STEP_START_FAMILIES,
     CONNECT_STEP_LAST
 } ConnectStep;
 
+typedef enum {
+    CONNECT_FAMILY_STEP_FIRST,
+    CONNECT_FAMILY_STEP_WDS_CLIENT,
+    CONNECT_FAMILY_STEP_IP_FAMILY,
+    CONNECT_FAMILY_STEP_START_NETWORK,
+    CONNECT_FAMILY_STEP_GET_CURRENT_SETTINGS,
+    CONNECT_FAMILY_STEP_LAST
+} ConnectFamilyStep;
+
+typedef struct _ConnectContext ConnectContext;
+
+/* Connection setup of a single IP family, run on its own WDS client */
 typedef struct {
+    ConnectContext *ctx;
+    const gchar *name;
+    QmiWdsIpFamily ip_family;
+    MMPortQmiFlag flag;
+    ConnectFamilyStep step;
+    QmiClientWds *client;
+    gboolean default_ip_family_set;
+    guint32 packet_data_handle;
+    GError *error;
+    GTimer *timer;
+    gdouble phase_start;
+} ConnectFamilyContext;
+
+struct _ConnectContext {
     MMBearerQmi *self;
     GSimpleAsyncResult *result;
     GCancellable *cancellable;
@@ -86,22 +103,28 @@ typedef struct {
     gchar *apn;
     QmiWdsAuthentication auth;
     gboolean no_ip_family_preference;
-    gboolean default_ip_family_set;
+    GTimer *timer;
 
     gboolean ipv4;
-    gboolean running_ipv4;
-    QmiClientWds *client_ipv4;
-    guint32 packet_data_handle_ipv4;
+    ConnectFamilyContext family_ipv4;
     MMBearerIpConfig *ipv4_config;
-    GError *error_ipv4;
 
     gboolean ipv6;
-    gboolean running_ipv6;
-    QmiClientWds *client_ipv6;
-    guint32 packet_data_handle_ipv6;
+    ConnectFamilyContext family_ipv6;
     MMBearerIpConfig *ipv6_config;
-    GError *error_ipv6;
-} ConnectContext;
+
+    /* Number of families still being set up */
+    guint n_running;
+};
+
+static void
+connect_family_context_clear (ConnectFamilyContext *family)
+{
+    g_clear_error (&family->error);
+    g_clear_object (&family->client);
+    if (family->timer)
+        g_timer_destroy (family->timer);
+}
 
 static void
 connect_context_complete_and_free (ConnectContext *ctx)
@@ -111,12 +134,11 @@ connect_context_complete_and_free (ConnectContext *ctx)
     g_free (ctx->apn);
     g_free (ctx->user);
     g_free (ctx->password);
-    g_clear_error (&ctx->error_ipv4);
-    g_clear_error (&ctx->error_ipv6);
-    g_clear_object (&ctx->client_ipv4);
-    g_clear_object (&ctx->client_ipv6);
+    connect_family_context_clear (&ctx->family_ipv4);
+    connect_family_context_clear (&ctx->family_ipv6);
     g_clear_object (&ctx->ipv4_config);
     g_clear_object (&ctx->ipv6_config);
+    g_timer_destroy (ctx->timer);
     g_object_unref (ctx->data);
     g_object_unref (ctx->qmi);
     g_object_unref (ctx->cancellable);
@@ -136,17 +158,29 @@ connect_finish (MMBaseBearer *self,
 }
 
 static void connect_context_step (ConnectContext *ctx);
+static void connect_family_step (ConnectFamilyContext *family);
+
+static void
+connect_family_phase_done (ConnectFamilyContext *family,
+                           const gchar *phase)
+{
+    gdouble now;
+
+    now = g_timer_elapsed (family->timer, NULL);
+    mm_dbg ("%s connection setup: %s finished in %.3lfs",
+            family->name, phase, now - family->phase_start);
+    family->phase_start = now;
+}
 
 static void
 start_network_ready (QmiClientWds *client,
                      GAsyncResult *res,
-                     ConnectContext *ctx)
+                     ConnectFamilyContext *family)
 {
     GError *error = NULL;
     QmiMessageWdsStartNetworkOutput *output;
 
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
-    g_assert (!(ctx->running_ipv4 && ctx->running_ipv6));
+    connect_family_phase_done (family, "start network");
 
     output = qmi_client_wds_start_network_finish (client, res, &error);
     if (output &&
@@ -161,14 +195,11 @@ start_network_ready (QmiClientWds *client,
                              QMI_PROTOCOL_ERROR_NO_EFFECT)) {
             g_error_free (error);
             error = NULL;
-            if (ctx->running_ipv4)
-                ctx->packet_data_handle_ipv4 = GLOBAL_PACKET_DATA_HANDLE;
-            else
-                ctx->packet_data_handle_ipv6 = GLOBAL_PACKET_DATA_HANDLE;
+            family->packet_data_handle = GLOBAL_PACKET_DATA_HANDLE;
 
             /* Fall down to a successful connection */
         } else {
-            mm_info ("error: couldn't start network: %s", error->message);
+            mm_info ("error: couldn't start %s network: %s", family->name, error->message);
             if (g_error_matches (error,
                                  QMI_PROTOCOL_ERROR,
                                  QMI_PROTOCOL_ERROR_CALL_FAILED)) {
@@ -198,34 +229,25 @@ start_network_ready (QmiClientWds *client,
         }
     }
 
-    if (error) {
-        if (ctx->running_ipv4)
-            ctx->error_ipv4 = error;
-        else
-            ctx->error_ipv6 = error;
-    } else {
-        if (ctx->running_ipv4)
-            qmi_message_wds_start_network_output_get_packet_data_handle (output, &ctx->packet_data_handle_ipv4, NULL);
-        else
-            qmi_message_wds_start_network_output_get_packet_data_handle (output, &ctx->packet_data_handle_ipv6, NULL);
-    }
+    if (error)
+        family->error = error;
+    else if (!family->packet_data_handle)
+        qmi_message_wds_start_network_output_get_packet_data_handle (output, &family->packet_data_handle, NULL);
 
     if (output)
         qmi_message_wds_start_network_output_unref (output);
 
     /* Keep on */
-    ctx->step++;
-    connect_context_step (ctx);
+    family->step++;
+    connect_family_step (family);
 }
 
 static QmiMessageWdsStartNetworkInput *
-build_start_network_input (ConnectContext *ctx)
+build_start_network_input (ConnectFamilyContext *family)
 {
+    ConnectContext *ctx = family->ctx;
     QmiMessageWdsStartNetworkInput *input;
 
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
-    g_assert (!(ctx->running_ipv4 && ctx->running_ipv6));
-
     input = qmi_message_wds_start_network_input_new ();
 
     if (ctx->apn && ctx->apn[0])
@@ -246,10 +268,10 @@ build_start_network_input (ConnectContext *ctx)
      * TLV if we already set a default IP family preference with "WDS Set IP
      * Family" */
     if (!ctx->no_ip_family_preference &&
-        !ctx->default_ip_family_set) {
+        !family->default_ip_family_set) {
         qmi_message_wds_start_network_input_set_ip_family_preference (
             input,
-            (ctx->running_ipv6 ? QMI_WDS_IP_FAMILY_IPV6 : QMI_WDS_IP_FAMILY_IPV4),
+            family->ip_family,
             NULL);
     }
 
@@ -459,19 +481,20 @@ get_ipv6_config (MMBearerQmi *self,
 static void
 get_current_settings_ready (QmiClientWds *client,
                             GAsyncResult *res,
-                            ConnectContext *ctx)
+                            ConnectFamilyContext *family)
 {
+    ConnectContext *ctx = family->ctx;
     GError *error = NULL;
     QmiMessageWdsGetCurrentSettingsOutput *output;
 
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
+    connect_family_phase_done (family, "get current settings");
 
     output = qmi_client_wds_get_current_settings_finish (client, res, &error);
     if (!output ||
         !qmi_message_wds_get_current_settings_output_get_result (output, &error)) {
         /* Never treat this as a hard connection error; not all devices support
          * "WDS Get Current Settings" */
-        mm_info ("error: couldn't get current settings: %s", error->message);
+        mm_info ("error: couldn't get current %s settings: %s", family->name, error->message);
         g_error_free (error);
     } else {
         QmiWdsIpFamily ip_family = QMI_WDS_IP_FAMILY_UNSPECIFIED;
@@ -492,9 +515,11 @@ get_current_settings_ready (QmiClientWds *client,
             g_clear_error (&error);
         }
 
-        if (ip_family == QMI_WDS_IP_FAMILY_IPV4)
+        /* Both families are set up at the same time, so don't let a
+         * misreported family override the other one's settings */
+        if (ip_family == QMI_WDS_IP_FAMILY_IPV4 && !ctx->ipv4_config)
             ctx->ipv4_config = get_ipv4_config (ctx->self, output, mtu);
-        else if (ip_family == QMI_WDS_IP_FAMILY_IPV6)
+        else if (ip_family == QMI_WDS_IP_FAMILY_IPV6 && !ctx->ipv6_config)
             ctx->ipv6_config = get_ipv6_config (ctx->self, output, mtu);
 
         /* Domain names */
@@ -519,18 +544,16 @@ get_current_settings_ready (QmiClientWds *client,
         qmi_message_wds_get_current_settings_output_unref (output);
 
     /* Keep on */
-    ctx->step++;
-    connect_context_step (ctx);
+    family->step++;
+    connect_family_step (family);
 }
 
 static void
-get_current_settings (ConnectContext *ctx, QmiClientWds *client)
+get_current_settings (ConnectFamilyContext *family)
 {
     QmiMessageWdsGetCurrentSettingsInput *input;
     QmiWdsGetCurrentSettingsRequestedSettings requested;
 
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
-
     requested = QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_DNS_ADDRESS |
                 QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_GRANTED_QOS |
                 QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_IP_ADDRESS |
@@ -541,25 +564,24 @@ get_current_settings (ConnectContext *ctx, QmiClientWds *client)
 
     input = qmi_message_wds_get_current_settings_input_new ();
     qmi_message_wds_get_current_settings_input_set_requested_settings (input, requested, NULL);
-    qmi_client_wds_get_current_settings (client,
+    qmi_client_wds_get_current_settings (family->client,
                                          input,
                                          10,
-                                         ctx->cancellable,
+                                         family->ctx->cancellable,
                                          (GAsyncReadyCallback)get_current_settings_ready,
-                                         ctx);
+                                         family);
     qmi_message_wds_get_current_settings_input_unref (input);
 }
 
 static void
 set_ip_family_ready (QmiClientWds *client,
                      GAsyncResult *res,
-                     ConnectContext *ctx)
+                     ConnectFamilyContext *family)
 {
     GError *error = NULL;
     QmiMessageWdsSetIpFamilyOutput *output;
 
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
-    g_assert (!(ctx->running_ipv4 && ctx->running_ipv6));
+    connect_family_phase_done (family, "set IP family");
 
     output = qmi_client_wds_set_ip_family_finish (client, res, &error);
     if (output) {
@@ -569,280 +591,248 @@ set_ip_family_ready (QmiClientWds *client,
 
     if (error) {
         /* Ensure we add the IP family preference TLV */
-        mm_dbg ("Couldn't set IP family preference: '%s'", error->message);
+        mm_dbg ("Couldn't set %s family preference: '%s'", family->name, error->message);
         g_error_free (error);
-        ctx->default_ip_family_set = FALSE;
+        family->default_ip_family_set = FALSE;
     } else {
         /* No need to add IP family preference */
-        ctx->default_ip_family_set = TRUE;
+        family->default_ip_family_set = TRUE;
     }
 
     /* Keep on */
-    ctx->step++;
-    connect_context_step (ctx);
+    family->step++;
+    connect_family_step (family);
 }
 
 static void
 qmi_port_allocate_client_ready (MMPortQmi *qmi,
                                 GAsyncResult *res,
-                                ConnectContext *ctx)
+                                ConnectFamilyContext *family)
 {
     GError *error = NULL;
 
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
-    g_assert (!(ctx->running_ipv4 && ctx->running_ipv6));
+    connect_family_phase_done (family, "WDS client allocation");
 
     if (!mm_port_qmi_allocate_client_finish (qmi, res, &error)) {
-        g_simple_async_result_take_error (ctx->result, error);
-        connect_context_complete_and_free (ctx);
+        /* Only this family fails; the other one may still connect */
+        family->error = error;
+        family->step = CONNECT_FAMILY_STEP_LAST;
+        connect_family_step (family);
         return;
     }
 
-    if (ctx->running_ipv4)
-        ctx->client_ipv4 = QMI_CLIENT_WDS (mm_port_qmi_get_client (qmi,
-                                                                   QMI_SERVICE_WDS,
-                                                                   MM_PORT_QMI_FLAG_WDS_IPV4));
-    else
-        ctx->client_ipv6 = QMI_CLIENT_WDS (mm_port_qmi_get_client (qmi,
-                                                                   QMI_SERVICE_WDS,
-                                                                   MM_PORT_QMI_FLAG_WDS_IPV6));
+    family->client = QMI_CLIENT_WDS (mm_port_qmi_get_client (qmi,
+                                                             QMI_SERVICE_WDS,
+                                                             family->flag));
+    g_object_ref (family->client);
 
     /* Keep on */
-    ctx->step++;
-    connect_context_step (ctx);
+    family->step++;
+    connect_family_step (family);
 }
 
 static void
-qmi_port_open_ready (MMPortQmi *qmi,
-                     GAsyncResult *res,
-                     ConnectContext *ctx)
+connect_family_step (ConnectFamilyContext *family)
 {
-    GError *error = NULL;
+    ConnectContext *ctx = family->ctx;
 
-    if (!mm_port_qmi_open_finish (qmi, res, &error)) {
-        g_simple_async_result_take_error (ctx->result, error);
-        connect_context_complete_and_free (ctx);
-        return;
-    }
+    /* If cancelled, stop this family; the whole operation completes with
+     * the cancellation error once both families are done */
+    if (family->step != CONNECT_FAMILY_STEP_LAST &&
+        g_cancellable_is_cancelled (ctx->cancellable))
+        family->step = CONNECT_FAMILY_STEP_LAST;
 
-    /* Keep on */
-    ctx->step++;
-    connect_context_step (ctx);
-}
-
-static void
-connect_context_step (ConnectContext *ctx)
-{
-    /* If cancelled, complete */
-    if (g_cancellable_is_cancelled (ctx->cancellable)) {
-        g_simple_async_result_set_error (ctx->result,
-                                         MM_CORE_ERROR,
-                                         MM_CORE_ERROR_CANCELLED,
-                                         "Connection setup operation has been cancelled");
-        connect_context_complete_and_free (ctx);
-        return;
-    }
-
-    switch (ctx->step) {
-    case CONNECT_STEP_FIRST:
-
-        g_assert (ctx->ipv4 || ctx->ipv6);
-
-        /* Fall down */
-        ctx->step++;
-
-    case CONNECT_STEP_OPEN_QMI_PORT:
-        if (!mm_port_qmi_is_open (ctx->qmi)) {
-            mm_port_qmi_open (ctx->qmi,
-                              TRUE,
-                              ctx->cancellable,
-                              (GAsyncReadyCallback)qmi_port_open_ready,
-                              ctx);
-            return;
-        }
-
-        /* If already open, just fall down */
-        ctx->step++;
-
-    case CONNECT_STEP_IPV4:
-        /* If no IPv4 setup needed, jump to IPv6 */
-        if (!ctx->ipv4) {
-            ctx->step = CONNECT_STEP_IPV6;
-            connect_context_step (ctx);
-            return;
-        }
-
-        /* Start IPv4 setup */
-        mm_dbg ("Running IPv4 connection setup");
-        ctx->running_ipv4 = TRUE;
-        ctx->running_ipv6 = FALSE;
+    switch (family->step) {
+    case CONNECT_FAMILY_STEP_FIRST:
+        mm_dbg ("Running %s connection setup", family->name);
         /* Just fall down */
-        ctx->step++;
+        family->step++;
 
-    case CONNECT_STEP_WDS_CLIENT_IPV4: {
+    case CONNECT_FAMILY_STEP_WDS_CLIENT: {
         QmiClient *client;
 
         client = mm_port_qmi_get_client (ctx->qmi,
                                          QMI_SERVICE_WDS,
-                                         MM_PORT_QMI_FLAG_WDS_IPV4);
+                                         family->flag);
         if (!client) {
-            mm_dbg ("Allocating IPv4-specific WDS client");
+            mm_dbg ("Allocating %s-specific WDS client", family->name);
             mm_port_qmi_allocate_client (ctx->qmi,
                                          QMI_SERVICE_WDS,
-                                         MM_PORT_QMI_FLAG_WDS_IPV4,
+                                         family->flag,
                                          ctx->cancellable,
                                          (GAsyncReadyCallback)qmi_port_allocate_client_ready,
-                                         ctx);
+                                         family);
             return;
         }
 
-        ctx->client_ipv4 = QMI_CLIENT_WDS (client);
+        family->client = QMI_CLIENT_WDS (g_object_ref (client));
         /* Just fall down */
-        ctx->step++;
+        family->step++;
     }
 
-    case CONNECT_STEP_IP_FAMILY_IPV4:
+    case CONNECT_FAMILY_STEP_IP_FAMILY:
         /* If client is new enough, select IP family */
         if (!ctx->no_ip_family_preference &&
-            qmi_client_check_version (QMI_CLIENT (ctx->client_ipv4), 1, 9)) {
+            qmi_client_check_version (QMI_CLIENT (family->client), 1, 9)) {
             QmiMessageWdsSetIpFamilyInput *input;
 
-            mm_dbg ("Setting default IP family to: IPv4");
+            mm_dbg ("Setting default IP family to: %s", family->name);
             input = qmi_message_wds_set_ip_family_input_new ();
-            qmi_message_wds_set_ip_family_input_set_preference (input, QMI_WDS_IP_FAMILY_IPV4, NULL);
-            qmi_client_wds_set_ip_family (ctx->client_ipv4,
+            qmi_message_wds_set_ip_family_input_set_preference (input, family->ip_family, NULL);
+            qmi_client_wds_set_ip_family (family->client,
                                           input,
                                           10,
                                           ctx->cancellable,
                                           (GAsyncReadyCallback)set_ip_family_ready,
-                                          ctx);
+                                          family);
             qmi_message_wds_set_ip_family_input_unref (input);
             return;
         }
 
-        ctx->default_ip_family_set = FALSE;
+        family->default_ip_family_set = FALSE;
 
         /* Just fall down */
-        ctx->step++;
+        family->step++;
 
-    case CONNECT_STEP_START_NETWORK_IPV4: {
+    case CONNECT_FAMILY_STEP_START_NETWORK: {
         QmiMessageWdsStartNetworkInput *input;
 
-        mm_dbg ("Starting IPv4 connection...");
-        input = build_start_network_input (ctx);
-        qmi_client_wds_start_network (ctx->client_ipv4,
+        mm_dbg ("Starting %s connection...", family->name);
+        input = build_start_network_input (family);
+        qmi_client_wds_start_network (family->client,
                                       input,
                                       45,
                                       ctx->cancellable,
                                       (GAsyncReadyCallback)start_network_ready,
-                                      ctx);
+                                      family);
         qmi_message_wds_start_network_input_unref (input);
         return;
     }
 
-    case CONNECT_STEP_GET_CURRENT_SETTINGS_IPV4: {
+    case CONNECT_FAMILY_STEP_GET_CURRENT_SETTINGS:
         /* Retrieve and print IP configuration */
-        if (ctx->packet_data_handle_ipv4) {
-            mm_dbg ("Getting IPv4 configuration...");
-            get_current_settings (ctx, ctx->client_ipv4);
+        if (family->packet_data_handle) {
+            mm_dbg ("Getting %s configuration...", family->name);
+            get_current_settings (family);
             return;
         }
         /* Fall through */
-        ctx->step++;
-    }
+        family->step++;
 
-    case CONNECT_STEP_IPV6:
-        /* If no IPv6 setup needed, jump to last */
-        if (!ctx->ipv6) {
-            ctx->step = CONNECT_STEP_LAST;
+    case CONNECT_FAMILY_STEP_LAST:
+        if (family->packet_data_handle)
+            mm_dbg ("%s connection setup succeeded in %.3lfs",
+                    family->name, g_timer_elapsed (family->timer, NULL));
+        else
+            mm_dbg ("%s connection setup failed in %.3lfs: %s",
+                    family->name, g_timer_elapsed (family->timer, NULL),
+                    family->error ? family->error->message : "cancelled");
+
+        /* Once both are done, go on with the whole connection */
+        g_assert (ctx->n_running > 0);
+        if (--ctx->n_running == 0) {
+            ctx->step++;
             connect_context_step (ctx);
-            return;
         }
+        return;
+    }
 
-        /* Start IPv6 setup */
-        mm_dbg ("Running IPv6 connection setup");
-        ctx->running_ipv4 = FALSE;
-        ctx->running_ipv6 = TRUE;
-        /* Just fall down */
-        ctx->step++;
+    g_assert_not_reached ();
+}
 
-    case CONNECT_STEP_WDS_CLIENT_IPV6: {
-        QmiClient *client;
+static void
+connect_family_start (ConnectContext *ctx,
+                      ConnectFamilyContext *family,
+                      const gchar *name,
+                      QmiWdsIpFamily ip_family,
+                      MMPortQmiFlag flag)
+{
+    family->ctx = ctx;
+    family->name = name;
+    family->ip_family = ip_family;
+    family->flag = flag;
+    family->step = CONNECT_FAMILY_STEP_FIRST;
+    family->timer = g_timer_new ();
+    connect_family_step (family);
+}
 
-        client = mm_port_qmi_get_client (ctx->qmi,
-                                         QMI_SERVICE_WDS,
-                                         MM_PORT_QMI_FLAG_WDS_IPV6);
-        if (!client) {
-            mm_dbg ("Allocating IPv6-specific WDS client");
-            mm_port_qmi_allocate_client (ctx->qmi,
-                                         QMI_SERVICE_WDS,
-                                         MM_PORT_QMI_FLAG_WDS_IPV6,
-                                         ctx->cancellable,
-                                         (GAsyncReadyCallback)qmi_port_allocate_client_ready,
-                                         ctx);
-            return;
-        }
+static void
+qmi_port_open_ready (MMPortQmi *qmi,
+                     GAsyncResult *res,
+                     ConnectContext *ctx)
+{
+    GError *error = NULL;
 
-        ctx->client_ipv6 = QMI_CLIENT_WDS (client);
-        /* Just fall down */
-        ctx->step++;
+    if (!mm_port_qmi_open_finish (qmi, res, &error)) {
+        g_simple_async_result_take_error (ctx->result, error);
+        connect_context_complete_and_free (ctx);
+        return;
     }
 
-    case CONNECT_STEP_IP_FAMILY_IPV6:
-
-        g_assert (ctx->no_ip_family_preference == FALSE);
+    /* Keep on */
+    ctx->step++;
+    connect_context_step (ctx);
+}
 
-        /* If client is new enough, select IP family */
-        if (qmi_client_check_version (QMI_CLIENT (ctx->client_ipv6), 1, 9)) {
-            QmiMessageWdsSetIpFamilyInput *input;
+static void
+connect_context_step (ConnectContext *ctx)
+{
+    /* If cancelled, complete. Never while families are being set up; they
+     * will bring us here once they are done. */
+    if (g_cancellable_is_cancelled (ctx->cancellable)) {
+        g_simple_async_result_set_error (ctx->result,
+                                         MM_CORE_ERROR,
+                                         MM_CORE_ERROR_CANCELLED,
+                                         "Connection setup operation has been cancelled");
+        connect_context_complete_and_free (ctx);
+        return;
+    }
 
-            mm_dbg ("Setting default IP family to: IPv6");
-            input = qmi_message_wds_set_ip_family_input_new ();
-            qmi_message_wds_set_ip_family_input_set_preference (input, QMI_WDS_IP_FAMILY_IPV6, NULL);
-            qmi_client_wds_set_ip_family (ctx->client_ipv6,
-                                          input,
-                                          10,
-                                          ctx->cancellable,
-                                          (GAsyncReadyCallback)set_ip_family_ready,
-                                          ctx);
-            qmi_message_wds_set_ip_family_input_unref (input);
-            return;
-        }
+    switch (ctx->step) {
+    case CONNECT_STEP_FIRST:
 
-        ctx->default_ip_family_set = FALSE;
+        g_assert (ctx->ipv4 || ctx->ipv6);
 
-        /* Just fall down */
+        /* Fall down */
         ctx->step++;
 
-    case CONNECT_STEP_START_NETWORK_IPV6: {
-        QmiMessageWdsStartNetworkInput *input;
-
-        mm_dbg ("Starting IPv6 connection...");
-        input = build_start_network_input (ctx);
-        qmi_client_wds_start_network (ctx->client_ipv6,
-                                      input,
-                                      45,
-                                      ctx->cancellable,
-                                      (GAsyncReadyCallback)start_network_ready,
-                                      ctx);
-        qmi_message_wds_start_network_input_unref (input);
-        return;
-    }
-
-    case CONNECT_STEP_GET_CURRENT_SETTINGS_IPV6: {
-        /* Retrieve and print IP configuration */
-        if (ctx->packet_data_handle_ipv6) {
-            mm_dbg ("Getting IPv6 configuration...");
-            get_current_settings (ctx, ctx->client_ipv6);
+    case CONNECT_STEP_OPEN_QMI_PORT:
+        if (!mm_port_qmi_is_open (ctx->qmi)) {
+            mm_port_qmi_open (ctx->qmi,
+                              TRUE,
+                              ctx->cancellable,
+                              (GAsyncReadyCallback)qmi_port_open_ready,
+                              ctx);
             return;
         }
-        /* Fall through */
+
+        /* If already open, just fall down */
         ctx->step++;
-    }
+
+    case CONNECT_STEP_START_FAMILIES:
+        /* Each family runs on its own WDS client, so set up both at the same
+         * time. The counter is fully set before starting any of them, as
+         * they may complete right away. */
+        ctx->n_running = (ctx->ipv4 ? 1 : 0) + (ctx->ipv6 ? 1 : 0);
+        if (ctx->ipv4)
+            connect_family_start (ctx, &ctx->family_ipv4, "IPv4", QMI_WDS_IP_FAMILY_IPV4, MM_PORT_QMI_FLAG_WDS_IPV4);
+        if (ctx->ipv6)
+            connect_family_start (ctx, &ctx->family_ipv6, "IPv6", QMI_WDS_IP_FAMILY_IPV6, MM_PORT_QMI_FLAG_WDS_IPV6);
+        return;
 
     case CONNECT_STEP_LAST:
-        /* If one of IPv4 or IPv6 succeeds, we're connected */
-        if (ctx->packet_data_handle_ipv4 || ctx->packet_data_handle_ipv6) {
+        mm_dbg ("Connection setup finished in %.3lfs", g_timer_elapsed (ctx->timer, NULL));
+
+        /* If one of IPv4 or IPv6 succeeds, we're connected; the failure of
+         * the other one is just reported in the logs */
+        if (ctx->family_ipv4.packet_data_handle || ctx->family_ipv6.packet_data_handle) {
+            if (ctx->ipv4 && !ctx->family_ipv4.packet_data_handle)
+                mm_info ("Connected with IPv6 only, IPv4 connection failed: %s",
+                         ctx->family_ipv4.error ? ctx->family_ipv4.error->message : "unknown error");
+            else if (ctx->ipv6 && !ctx->family_ipv6.packet_data_handle)
+                mm_info ("Connected with IPv4 only, IPv6 connection failed: %s",
+                         ctx->family_ipv6.error ? ctx->family_ipv6.error->message : "unknown error");
+
             /* Port is connected; update the state */
             mm_port_set_connected (MM_PORT (ctx->data), TRUE);
 
@@ -852,16 +842,16 @@ connect_context_step (ConnectContext *ctx)
 
             g_assert (ctx->self->priv->packet_data_handle_ipv4 == 0);
             g_assert (ctx->self->priv->client_ipv4 == NULL);
-            if (ctx->packet_data_handle_ipv4) {
-                ctx->self->priv->packet_data_handle_ipv4 = ctx->packet_data_handle_ipv4;
-                ctx->self->priv->client_ipv4 = g_object_ref (ctx->client_ipv4);
+            if (ctx->family_ipv4.packet_data_handle) {
+                ctx->self->priv->packet_data_handle_ipv4 = ctx->family_ipv4.packet_data_handle;
+                ctx->self->priv->client_ipv4 = g_object_ref (ctx->family_ipv4.client);
             }
 
             g_assert (ctx->self->priv->packet_data_handle_ipv6 == 0);
             g_assert (ctx->self->priv->client_ipv6 == NULL);
-            if (ctx->packet_data_handle_ipv6) {
-                ctx->self->priv->packet_data_handle_ipv6 = ctx->packet_data_handle_ipv6;
-                ctx->self->priv->client_ipv6 = g_object_ref (ctx->client_ipv6);
+            if (ctx->family_ipv6.packet_data_handle) {
+                ctx->self->priv->packet_data_handle_ipv6 = ctx->family_ipv6.packet_data_handle;
+                ctx->self->priv->client_ipv6 = g_object_ref (ctx->family_ipv6.client);
             }
 
             /* Set operation result */
@@ -873,13 +863,16 @@ connect_context_step (ConnectContext *ctx)
             GError *error;
 
             /* No connection, set error. If both set, IPv4 error preferred */
-            if (ctx->error_ipv4) {
-                error = ctx->error_ipv4;
-                ctx->error_ipv4 = NULL;
-            } else {
-                error = ctx->error_ipv6;
-                ctx->error_ipv6 = NULL;
-            }
+            if (ctx->family_ipv4.error) {
+                error = ctx->family_ipv4.error;
+                ctx->family_ipv4.error = NULL;
+            } else if (ctx->family_ipv6.error) {
+                error = ctx->family_ipv6.error;
+                ctx->family_ipv6.error = NULL;
+            } else
+                error = g_error_new (MM_CORE_ERROR,
+                                     MM_CORE_ERROR_FAILED,
+                                     "Couldn't connect");
 
             g_simple_async_result_take_error (ctx->result, error);
         }
@@ -887,6 +880,8 @@ connect_context_step (ConnectContext *ctx)
         connect_context_complete_and_free (ctx);
         return;
     }
+
+    g_assert_not_reached ();
 }
 
 static void
@@ -978,6 +973,7 @@ _connect (MMBaseBearer *self,
     ctx->data = data;
     ctx->cancellable = g_object_ref (cancellable);
     ctx->step = CONNECT_STEP_FIRST;
+    ctx->timer = g_timer_new ();
     ctx->result = g_simple_async_result_new (G_OBJECT (self),
                                              callback,
                                              user_data,
@@ -1308,6 +1304,163 @@ report_connection_status (MMBaseBearer *self,
     MM_BASE_BEARER_CLASS (mm_bearer_qmi_parent_class)->report_connection_status (self, status);
 }
 
+/*****************************************************************************/
+/* Reload stats */
+
+typedef struct {
+    guint64 rx_bytes;
+    guint64 tx_bytes;
+    guint64 rx_packets;
+    guint64 tx_packets;
+} ReloadStatsResult;
+
+typedef struct {
+    MMBearerQmi *self;
+    GSimpleAsyncResult *result;
+    /* Clients still to query, one per connected IP family */
+    GList *clients;
+    ReloadStatsResult stats;
+} ReloadStatsContext;
+
+static void
+reload_stats_context_complete_and_free (ReloadStatsContext *ctx)
+{
+    g_simple_async_result_complete_in_idle (ctx->result);
+    g_object_unref (ctx->result);
+    g_list_free_full (ctx->clients, (GDestroyNotify) g_object_unref);
+    g_object_unref (ctx->self);
+    g_slice_free (ReloadStatsContext, ctx);
+}
+
+static gboolean
+reload_stats_finish (MMBaseBearer *self,
+                     GAsyncResult *res,
+                     guint64 *rx_bytes,
+                     guint64 *tx_bytes,
+                     guint64 *rx_packets,
+                     guint64 *tx_packets,
+                     GError **error)
+{
+    ReloadStatsResult *stats;
+
+    if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error))
+        return FALSE;
+
+    stats = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res));
+    *rx_bytes = stats->rx_bytes;
+    *tx_bytes = stats->tx_bytes;
+    *rx_packets = stats->rx_packets;
+    *tx_packets = stats->tx_packets;
+    return TRUE;
+}
+
+static void reload_stats_context_step (ReloadStatsContext *ctx);
+
+static void
+get_packet_statistics_ready (QmiClientWds *client,
+                             GAsyncResult *res,
+                             ReloadStatsContext *ctx)
+{
+    GError *error = NULL;
+    QmiMessageWdsGetPacketStatisticsOutput *output;
+    guint64 bytes;
+    guint32 packets;
+
+    output = qmi_client_wds_get_packet_statistics_finish (client, res, &error);
+    if (!output ||
+        !qmi_message_wds_get_packet_statistics_output_get_result (output, &error)) {
+        g_prefix_error (&error, "Couldn't get packet statistics: ");
+        g_simple_async_result_take_error (ctx->result, error);
+        if (output)
+            qmi_message_wds_get_packet_statistics_output_unref (output);
+        reload_stats_context_complete_and_free (ctx);
+        return;
+    }
+
+    /* Counters missing in the response are just not added */
+    if (qmi_message_wds_get_packet_statistics_output_get_rx_bytes_ok (output, &bytes, NULL))
+        ctx->stats.rx_bytes += bytes;
+    if (qmi_message_wds_get_packet_statistics_output_get_tx_bytes_ok (output, &bytes, NULL))
+        ctx->stats.tx_bytes += bytes;
+    if (qmi_message_wds_get_packet_statistics_output_get_rx_packets_ok (output, &packets, NULL))
+        ctx->stats.rx_packets += packets;
+    if (qmi_message_wds_get_packet_statistics_output_get_tx_packets_ok (output, &packets, NULL))
+        ctx->stats.tx_packets += packets;
+
+    qmi_message_wds_get_packet_statistics_output_unref (output);
+
+    /* Go on with the next client */
+    reload_stats_context_step (ctx);
+}
+
+static void
+reload_stats_context_step (ReloadStatsContext *ctx)
+{
+    QmiMessageWdsGetPacketStatisticsInput *input;
+    QmiClientWds *client;
+
+    if (!ctx->clients) {
+        g_simple_async_result_set_op_res_gpointer (ctx->result,
+                                                   g_memdup (&ctx->stats, sizeof (ctx->stats)),
+                                                   g_free);
+        reload_stats_context_complete_and_free (ctx);
+        return;
+    }
+
+    client = QMI_CLIENT_WDS (ctx->clients->data);
+    ctx->clients = g_list_delete_link (ctx->clients, ctx->clients);
+
+    input = qmi_message_wds_get_packet_statistics_input_new ();
+    qmi_message_wds_get_packet_statistics_input_set_mask (
+        input,
+        (QMI_WDS_PACKET_STATISTICS_MASK_FLAG_TX_PACKETS_OK |
+         QMI_WDS_PACKET_STATISTICS_MASK_FLAG_RX_PACKETS_OK |
+         QMI_WDS_PACKET_STATISTICS_MASK_FLAG_TX_BYTES_OK   |
+         QMI_WDS_PACKET_STATISTICS_MASK_FLAG_RX_BYTES_OK),
+        NULL);
+    qmi_client_wds_get_packet_statistics (client,
+                                          input,
+                                          10,
+                                          NULL,
+                                          (GAsyncReadyCallback)get_packet_statistics_ready,
+                                          ctx);
+    qmi_message_wds_get_packet_statistics_input_unref (input);
+    g_object_unref (client);
+}
+
+static void
+reload_stats (MMBaseBearer *_self,
+              GAsyncReadyCallback callback,
+              gpointer user_data)
+{
+    MMBearerQmi *self = MM_BEARER_QMI (_self);
+    ReloadStatsContext *ctx;
+
+    ctx = g_slice_new0 (ReloadStatsContext);
+    ctx->self = g_object_ref (self);
+    ctx->result = g_simple_async_result_new (G_OBJECT (self),
+                                             callback,
+                                             user_data,
+                                             reload_stats);
+
+    /* Counters of each IP family are kept in their own client */
+    if (self->priv->packet_data_handle_ipv4 && self->priv->client_ipv4)
+        ctx->clients = g_list_append (ctx->clients, g_object_ref (self->priv->client_ipv4));
+    if (self->priv->packet_data_handle_ipv6 && self->priv->client_ipv6)
+        ctx->clients = g_list_append (ctx->clients, g_object_ref (self->priv->client_ipv6));
+
+    if (!ctx->clients) {
+        g_simple_async_result_set_error (ctx->result,
+                                         MM_CORE_ERROR,
+                                         MM_CORE_ERROR_WRONG_STATE,
+                                         "Couldn't reload stats: bearer not connected");
+        reload_stats_context_complete_and_free (ctx);
+        return;
+    }
+
+    reload_stats_context_step (ctx);
+}
+
 /*****************************************************************************/
 
 MMBaseBearer *
@@ -1407,6 +1560,8 @@ mm_bearer_qmi_class_init (MMBearerQmiClass *klass)
     base_bearer_class->disconnect = disconnect;
     base_bearer_class->disconnect_finish = disconnect_finish;
     base_bearer_class->report_connection_status = report_connection_status;
+    base_bearer_class->reload_stats = reload_stats;
+    base_bearer_class->reload_stats_finish = reload_stats_finish;
 
     /* Properties */
     properties[PROP_FORCE_DHCP] =
@@ -42,6 +42,25 @@ G_DEFINE_TYPE_EXTENDED (MMBroadbandBearer, mm_broadband_bearer, MM_TYPE_BASE_BEA
                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE,
                                                async_initable_iface_init));
 
+typedef struct {
+    guint64 rx_bytes;
+    guint64 tx_bytes;
+    guint64 rx_packets;
+    guint64 tx_packets;
+} NetStats;
+
+/* Setup of the last successful 3GPP connection, tried right away in the
+ * next connection attempt of the bearer, after setting up the PDP context
+ * again */
+typedef struct {
+    guint cid;
+    gchar *apn;
+    MMBearerIpFamily ip_family;
+    MMPort *data;
+    /* UNKNOWN if the IP config needs to be reloaded on every connection */
+    MMBearerIpMethod ip_method;
+} LastConnection;
+
 typedef enum {
     CONNECTION_TYPE_NONE,
     CONNECTION_TYPE_3GPP,
@@ -54,10 +73,14 @@ struct _MMBroadbandBearerPrivate {
     MMPort *port;
     /* Current connection type */
     ConnectionType connection_type;
+    /* Kernel traffic counters of the data port when connected */
+    NetStats stats_baseline;
 
     /*-- 3GPP specific --*/
     /* CID of the PDP context */
     guint cid;
+    /* Last successful connection setup, if any */
+    LastConnection *last_connection;
 };
 
 /*****************************************************************************/
@@ -68,6 +91,52 @@ mm_broadband_bearer_get_3gpp_cid (MMBroadbandBearer *self)
     return self->priv->cid;
 }
 
+/*****************************************************************************/
+/* Kernel traffic counters */
+
+static gboolean
+read_net_stats (MMPort *port,
+                NetStats *stats,
+                GError **error)
+{
+    static const gchar *names[] = { "rx_bytes", "tx_bytes", "rx_packets", "tx_packets" };
+    guint64 *values[G_N_ELEMENTS (names)];
+    guint i;
+
+    /* Only network interfaces have kernel counters we know about; pppd
+     * creates its own interface, unknown to us */
+    if (mm_port_get_subsys (port) != MM_PORT_SUBSYS_NET) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_UNSUPPORTED,
+                     "No traffic counters available in %s port '%s'",
+                     mm_port_subsys_get_string (mm_port_get_subsys (port)),
+                     mm_port_get_device (port));
+        return FALSE;
+    }
+
+    values[0] = &stats->rx_bytes;
+    values[1] = &stats->tx_bytes;
+    values[2] = &stats->rx_packets;
+    values[3] = &stats->tx_packets;
+
+    for (i = 0; i < G_N_ELEMENTS (names); i++) {
+        gchar *path;
+        gchar *contents;
+        gboolean read;
+
+        path = g_strdup_printf ("/sys/class/net/%s/statistics/%s",
+                                mm_port_get_device (port), names[i]);
+        read = g_file_get_contents (path, &contents, NULL, error);
+        g_free (path);
+        if (!read)
+            return FALSE;
+
+        *values[i] = g_ascii_strtoull (contents, NULL, 10);
+        g_free (contents);
+    }
+
+    return TRUE;
+}
+
 /*****************************************************************************/
 /* Detailed connect context, used in both CDMA and 3GPP sequences */
 
@@ -87,6 +156,7 @@ typedef struct {
     guint max_cid;
     gboolean use_existing_cid;
     MMBearerIpFamily ip_family;
+    gboolean hot_reconnect;
 } DetailedConnectContext;
 
 static MMBearerConnectResult *
@@ -190,12 +260,23 @@ detailed_connect_context_new (MMBroadbandBearer *self,
 
 static MMPortSerialAt *
 common_get_at_data_port (MMBaseModem *modem,
+                         MMPort *preferred,
                          GError **error)
 {
-    MMPort *data;
+    MMPort *data = NULL;
+
+    /* Reuse the given port if it is still a valid one */
+    if (preferred &&
+        MM_IS_PORT_SERIAL_AT (preferred) &&
+        !mm_port_get_connected (preferred) &&
+        mm_base_modem_owns_port (modem,
+                                 mm_port_subsys_get_string (mm_port_get_subsys (preferred)),
+                                 mm_port_get_device (preferred)))
+        data = preferred;
 
     /* Look for best data port, NULL if none available. */
-    data = mm_base_modem_peek_best_data_port (modem, MM_PORT_TYPE_AT);
+    if (!data)
+        data = mm_base_modem_peek_best_data_port (modem, MM_PORT_TYPE_AT);
     if (!data) {
         /* It may happen that the desired data port grabbed during probing was
          * actually a 'net' port, which the generic logic cannot handle, so if
@@ -410,7 +491,7 @@ connect_cdma (MMBroadbandBearer *self,
 
     /* Grab dial port. This gets a reference to the dial port and OPENs it.
      * If we fail, we'll need to close it ourselves. */
-    ctx->data = (MMPort *)common_get_at_data_port (ctx->modem, &error);
+    ctx->data = (MMPort *)common_get_at_data_port (ctx->modem, NULL, &error);
     if (!ctx->data) {
         g_simple_async_result_take_error (ctx->result, error);
         detailed_connect_context_complete_and_free (ctx);
@@ -598,7 +679,11 @@ dial_3gpp (MMBroadbandBearer *self,
 
     /* Grab dial port. This gets a reference to the dial port and OPENs it.
      * If we fail, we'll need to close it ourselves. */
-    ctx->dial_port = common_get_at_data_port (ctx->modem, &error);
+    ctx->dial_port = common_get_at_data_port (ctx->modem,
+                                              (self->priv->last_connection ?
+                                               self->priv->last_connection->data :
+                                               NULL),
+                                              &error);
     if (!ctx->dial_port) {
         g_simple_async_result_take_error (ctx->result, error);
         dial_3gpp_context_complete_and_free (ctx);
@@ -632,8 +717,78 @@ dial_3gpp (MMBroadbandBearer *self,
  *   2.3) If none found, look for the highest available CID, and use that one.
  * 3) Activate PDP context.
  * 4) Initiate call.
+ *
+ * If a previous connection attempt succeeded, the CID and data port used in
+ * that one are tried right away, skipping the PDP context lookup in step 2;
+ * so is its IP config method if the same data port is used. The whole
+ * procedure is run only if that fails.
  */
 
+static void
+last_connection_free (LastConnection *last)
+{
+    g_free (last->apn);
+    if (last->data)
+        g_object_unref (last->data);
+    g_slice_free (LastConnection, last);
+}
+
+static void
+last_connection_clear (MMBroadbandBearer *self)
+{
+    if (self->priv->last_connection) {
+        last_connection_free (self->priv->last_connection);
+        self->priv->last_connection = NULL;
+    }
+}
+
+static void
+last_connection_store (DetailedConnectContext *ctx,
+                       MMBearerIpMethod ip_method)
+{
+    LastConnection *last;
+
+    last_connection_clear (ctx->self);
+
+    last = g_slice_new0 (LastConnection);
+    last->cid = ctx->cid;
+    last->apn = g_strdup (mm_bearer_properties_get_apn (mm_base_bearer_peek_config (MM_BASE_BEARER (ctx->self))));
+    last->ip_family = ctx->ip_family;
+    last->data = g_object_ref (ctx->data);
+    last->ip_method = ip_method;
+    ctx->self->priv->last_connection = last;
+}
+
+static gboolean
+last_connection_matches (DetailedConnectContext *ctx)
+{
+    LastConnection *last = ctx->self->priv->last_connection;
+
+    return (last &&
+            last->ip_family == ctx->ip_family &&
+            !g_strcmp0 (last->apn,
+                        mm_bearer_properties_get_apn (mm_base_bearer_peek_config (MM_BASE_BEARER (ctx->self)))));
+}
+
+static MMBearerIpMethod
+ip_config_get_reusable_method (MMBearerIpConfig *ipv4_config,
+                               MMBearerIpConfig *ipv6_config)
+{
+    MMBearerIpMethod method = MM_BEARER_IP_METHOD_UNKNOWN;
+
+    /* Static configurations may change on every connection; and don't bother
+     * with different methods per IP family */
+    if (ipv4_config)
+        method = mm_bearer_ip_config_get_method (ipv4_config);
+    if (ipv6_config) {
+        if (ipv4_config && mm_bearer_ip_config_get_method (ipv6_config) != method)
+            return MM_BEARER_IP_METHOD_UNKNOWN;
+        method = mm_bearer_ip_config_get_method (ipv6_config);
+    }
+
+    return (method == MM_BEARER_IP_METHOD_STATIC ? MM_BEARER_IP_METHOD_UNKNOWN : method);
+}
+
 static void
 get_ip_config_3gpp_ready (MMBroadbandModem *modem,
                           GAsyncResult *res,
@@ -657,6 +812,8 @@ get_ip_config_3gpp_ready (MMBroadbandModem *modem,
     if (MM_IS_PORT_SERIAL_AT (ctx->data))
         ctx->close_data_on_exit = FALSE;
 
+    last_connection_store (ctx, ip_config_get_reusable_method (ipv4_config, ipv6_config));
+
     g_simple_async_result_set_op_res_gpointer (
         ctx->result,
         mm_bearer_connect_result_new (ctx->data, ipv4_config, ipv6_config),
@@ -669,6 +826,8 @@ get_ip_config_3gpp_ready (MMBroadbandModem *modem,
         g_object_unref (ipv6_config);
 }
 
+static void find_cid (DetailedConnectContext *ctx);
+
 static void
 dial_3gpp_ready (MMBroadbandModem *modem,
                  GAsyncResult *res,
@@ -683,6 +842,19 @@ dial_3gpp_ready (MMBroadbandModem *modem,
     if (!ctx->data) {
         /* Clear CID when it failed to connect. */
         ctx->self->priv->cid = 0;
+
+        /* If the last connection setup is no longer valid, forget it and
+         * run the whole procedure */
+        if (ctx->hot_reconnect &&
+            !g_cancellable_is_cancelled (ctx->cancellable)) {
+            mm_dbg ("Couldn't reconnect with the last connection setup: '%s'", error->message);
+            g_error_free (error);
+            last_connection_clear (ctx->self);
+            ctx->hot_reconnect = FALSE;
+            find_cid (ctx);
+            return;
+        }
+
         g_simple_async_result_take_error (ctx->result, error);
         detailed_connect_context_complete_and_free (ctx);
         return;
@@ -693,8 +865,15 @@ dial_3gpp_ready (MMBroadbandModem *modem,
     if (MM_IS_PORT_SERIAL_AT (ctx->data))
         ctx->close_data_on_exit = TRUE;
 
-    if (MM_BROADBAND_BEARER_GET_CLASS (ctx->self)->get_ip_config_3gpp &&
-        MM_BROADBAND_BEARER_GET_CLASS (ctx->self)->get_ip_config_3gpp_finish) {
+    /* The IP config only needs to be reloaded if it wasn't a dynamic one, or
+     * if the dial ended up in a different data port */
+    if (ctx->hot_reconnect &&
+        ctx->self->priv->last_connection &&
+        ctx->self->priv->last_connection->data == ctx->data &&
+        ctx->self->priv->last_connection->ip_method != MM_BEARER_IP_METHOD_UNKNOWN)
+        ip_method = ctx->self->priv->last_connection->ip_method;
+    else if (MM_BROADBAND_BEARER_GET_CLASS (ctx->self)->get_ip_config_3gpp &&
+             MM_BROADBAND_BEARER_GET_CLASS (ctx->self)->get_ip_config_3gpp_finish) {
         /* Launch specific IP config retrieval */
         MM_BROADBAND_BEARER_GET_CLASS (ctx->self)->get_ip_config_3gpp (
             ctx->self,
@@ -717,9 +896,10 @@ dial_3gpp_ready (MMBroadbandModem *modem,
 
     /* If no specific IP retrieval requested, set the default implementation
      * (PPP if data port is AT, DHCP otherwise) */
-    ip_method = MM_IS_PORT_SERIAL_AT (ctx->data) ?
-                    MM_BEARER_IP_METHOD_PPP :
-                    MM_BEARER_IP_METHOD_DHCP;
+    if (ip_method == MM_BEARER_IP_METHOD_UNKNOWN)
+        ip_method = MM_IS_PORT_SERIAL_AT (ctx->data) ?
+                        MM_BEARER_IP_METHOD_PPP :
+                        MM_BEARER_IP_METHOD_DHCP;
 
     if (ctx->ip_family & MM_BEARER_IP_FAMILY_IPV4 ||
             ctx->ip_family & MM_BEARER_IP_FAMILY_IPV4V6) {
@@ -733,6 +913,8 @@ dial_3gpp_ready (MMBroadbandModem *modem,
     }
     g_assert (ipv4_config || ipv6_config);
 
+    last_connection_store (ctx, ip_method);
+
     g_simple_async_result_set_op_res_gpointer (
         ctx->result,
         mm_bearer_connect_result_new (ctx->data, ipv4_config, ipv6_config),
@@ -771,6 +953,17 @@ initialize_pdp_context_ready (MMBaseModem *modem,
 
     mm_base_modem_at_command_full_finish (modem, res, &error);
     if (error) {
+        /* The CID of the last connection may no longer be usable */
+        if (ctx->hot_reconnect) {
+            mm_dbg ("Couldn't reinitialize PDP context of the last connection setup: '%s'",
+                    error->message);
+            g_error_free (error);
+            last_connection_clear (ctx->self);
+            ctx->hot_reconnect = FALSE;
+            find_cid (ctx);
+            return;
+        }
+
         mm_warn ("Couldn't initialize PDP context with our APN: '%s'",
                  error->message);
         g_simple_async_result_take_error (ctx->result, error);
@@ -781,13 +974,37 @@ initialize_pdp_context_ready (MMBaseModem *modem,
     start_3gpp_dial (ctx);
 }
 
+static void
+initialize_pdp_context (DetailedConnectContext *ctx,
+                        const gchar *pdp_type)
+{
+    gchar *apn;
+    gchar *command;
+
+    apn = mm_port_serial_at_quote_string (mm_bearer_properties_get_apn (mm_base_bearer_peek_config (MM_BASE_BEARER (ctx->self))));
+    command = g_strdup_printf ("+CGDCONT=%u,\"%s\",%s",
+                               ctx->cid,
+                               pdp_type,
+                               apn);
+    g_free (apn);
+    mm_base_modem_at_command_full (ctx->modem,
+                                   ctx->primary,
+                                   command,
+                                   3,
+                                   FALSE,
+                                   FALSE, /* raw */
+                                   NULL, /* cancellable */
+                                   (GAsyncReadyCallback)initialize_pdp_context_ready,
+                                   ctx);
+    g_free (command);
+}
+
 static void
 find_cid_ready (MMBaseModem *modem,
                 GAsyncResult *res,
                 DetailedConnectContext *ctx)
 {
     GVariant *result;
-    gchar *apn, *command;
     GError *error = NULL;
     const gchar *pdp_type;
 
@@ -828,22 +1045,7 @@ find_cid_ready (MMBaseModem *modem,
     }
 
     /* Otherwise, initialize a new PDP context with our APN */
-    apn = mm_port_serial_at_quote_string (mm_bearer_properties_get_apn (mm_base_bearer_peek_config (MM_BASE_BEARER (ctx->self))));
-    command = g_strdup_printf ("+CGDCONT=%u,\"%s\",%s",
-                               ctx->cid,
-                               pdp_type,
-                               apn);
-    g_free (apn);
-    mm_base_modem_at_command_full (ctx->modem,
-                                   ctx->primary,
-                                   command,
-                                   3,
-                                   FALSE,
-                                   FALSE, /* raw */
-                                   NULL, /* cancellable */
-                                   (GAsyncReadyCallback)initialize_pdp_context_ready,
-                                   ctx);
-    g_free (command);
+    initialize_pdp_context (ctx, pdp_type);
 }
 
 static gboolean
@@ -1020,6 +1222,23 @@ static const MMBaseModemAtCommand find_cid_sequence[] = {
     { NULL }
 };
 
+static void
+find_cid (DetailedConnectContext *ctx)
+{
+    ctx->max_cid = 0;
+    ctx->use_existing_cid = FALSE;
+
+    mm_dbg ("Looking for best CID...");
+    mm_base_modem_at_sequence_full (ctx->modem,
+                                    ctx->primary,
+                                    find_cid_sequence,
+                                    ctx, /* also passed as response processor context */
+                                    NULL, /* response_processor_context_free */
+                                    NULL, /* cancellable */
+                                    (GAsyncReadyCallback)find_cid_ready,
+                                    ctx);
+}
+
 static void
 connect_3gpp (MMBroadbandBearer *self,
               MMBroadbandModem *modem,
@@ -1041,15 +1260,20 @@ connect_3gpp (MMBroadbandBearer *self,
                                         callback,
                                         user_data);
 
-    mm_dbg ("Looking for best CID...");
-    mm_base_modem_at_sequence_full (ctx->modem,
-                                    ctx->primary,
-                                    find_cid_sequence,
-                                    ctx, /* also passed as response processor context */
-                                    NULL, /* response_processor_context_free */
-                                    NULL, /* cancellable */
-                                    (GAsyncReadyCallback)find_cid_ready,
-                                    ctx);
+    /* Try with the setup of the last successful connection first. The PDP
+     * context is set up again, as it may have been changed meanwhile (e.g.
+     * by another bearer or by an external tool) */
+    if (last_connection_matches (ctx)) {
+        mm_dbg ("Reconnecting with the last connection setup (CID %u)...",
+                self->priv->last_connection->cid);
+        ctx->cid = self->priv->last_connection->cid;
+        ctx->hot_reconnect = TRUE;
+        initialize_pdp_context (ctx, mm_3gpp_get_pdp_type_from_ip_family (ctx->ip_family));
+        return;
+    }
+
+    last_connection_clear (self);
+    find_cid (ctx);
 }
 
 /*****************************************************************************/
@@ -1092,6 +1316,10 @@ connect_succeeded (ConnectContext *ctx,
     /* Port is connected; update the state */
     mm_port_set_connected (ctx->self->priv->port, TRUE);
 
+    /* Traffic counters are reported from this point */
+    if (!read_net_stats (ctx->self->priv->port, &ctx->self->priv->stats_baseline, NULL))
+        memset (&ctx->self->priv->stats_baseline, 0, sizeof (NetStats));
+
     /* Set operation result */
     g_simple_async_result_set_op_res_gpointer (ctx->result,
                                                result,
@@ -1820,6 +2048,76 @@ disconnect (MMBaseBearer *self,
     g_object_unref (modem);
 }
 
+/*****************************************************************************/
+/* Reload stats */
+
+static guint64
+net_stats_diff (guint64 current,
+                guint64 baseline)
+{
+    /* Counters restart if the interface gets re-created */
+    return (current >= baseline ? current - baseline : current);
+}
+
+static gboolean
+reload_stats_finish (MMBaseBearer *self,
+                     GAsyncResult *res,
+                     guint64 *rx_bytes,
+                     guint64 *tx_bytes,
+                     guint64 *rx_packets,
+                     guint64 *tx_packets,
+                     GError **error)
+{
+    NetStats *stats;
+
+    if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error))
+        return FALSE;
+
+    stats = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res));
+    *rx_bytes = stats->rx_bytes;
+    *tx_bytes = stats->tx_bytes;
+    *rx_packets = stats->rx_packets;
+    *tx_packets = stats->tx_packets;
+    return TRUE;
+}
+
+static void
+reload_stats (MMBaseBearer *_self,
+              GAsyncReadyCallback callback,
+              gpointer user_data)
+{
+    MMBroadbandBearer *self = MM_BROADBAND_BEARER (_self);
+    GSimpleAsyncResult *result;
+    GError *error = NULL;
+    NetStats current;
+    NetStats *stats;
+
+    result = g_simple_async_result_new (G_OBJECT (self),
+                                        callback,
+                                        user_data,
+                                        reload_stats);
+
+    if (!self->priv->port)
+        g_simple_async_result_set_error (result,
+                                         MM_CORE_ERROR,
+                                         MM_CORE_ERROR_WRONG_STATE,
+                                         "Couldn't reload stats: this bearer is not connected");
+    else if (!read_net_stats (self->priv->port, &current, &error))
+        g_simple_async_result_take_error (result, error);
+    else {
+        /* Report the traffic of this connection only */
+        stats = g_new (NetStats, 1);
+        stats->rx_bytes = net_stats_diff (current.rx_bytes, self->priv->stats_baseline.rx_bytes);
+        stats->tx_bytes = net_stats_diff (current.tx_bytes, self->priv->stats_baseline.tx_bytes);
+        stats->rx_packets = net_stats_diff (current.rx_packets, self->priv->stats_baseline.rx_packets);
+        stats->tx_packets = net_stats_diff (current.tx_packets, self->priv->stats_baseline.tx_packets);
+        g_simple_async_result_set_op_res_gpointer (result, stats, g_free);
+    }
+
+    g_simple_async_result_complete_in_idle (result);
+    g_object_unref (result);
+}
+
 /*****************************************************************************/
 
 static void
@@ -2068,6 +2366,7 @@ dispose (GObject *object)
     MMBroadbandBearer *self = MM_BROADBAND_BEARER (object);
 
     reset_bearer_connection (self);
+    last_connection_clear (self);
 
     G_OBJECT_CLASS (mm_broadband_bearer_parent_class)->dispose (object);
 }
@@ -2095,6 +2394,8 @@ mm_broadband_bearer_class_init (MMBroadbandBearerClass *klass)
     base_bearer_class->disconnect = disconnect;
     base_bearer_class->disconnect_finish = disconnect_finish;
     base_bearer_class->report_connection_status = report_connection_status;
+    base_bearer_class->reload_stats = reload_stats;
+    base_bearer_class->reload_stats_finish = reload_stats_finish;
 
     klass->connect_3gpp = connect_3gpp;
     klass->connect_3gpp_finish = detailed_connect_finish;
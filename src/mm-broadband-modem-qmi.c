@@ -27,6 +27,7 @@
 
 #include "ModemManager.h"
 #include "mm-log.h"
+#include "mm-context.h"
 #include "mm-errors-types.h"
 #include "mm-modem-helpers.h"
 #include "mm-modem-helpers-qmi.h"
@@ -69,6 +70,21 @@ G_DEFINE_TYPE_EXTENDED (MMBroadbandModemQmi, mm_broadband_modem_qmi, MM_TYPE_BRO
                         G_IMPLEMENT_INTERFACE (MM_TYPE_IFACE_MODEM_OMA, iface_modem_oma_init)
                         G_IMPLEMENT_INTERFACE (MM_TYPE_IFACE_MODEM_FIRMWARE, iface_modem_firmware_init))
 
+typedef enum {
+    DMS_PREFETCH_MANUFACTURER,
+    DMS_PREFETCH_MODEL,
+    DMS_PREFETCH_REVISION,
+    DMS_PREFETCH_EQUIPMENT_IDENTIFIER,
+    DMS_PREFETCH_LAST
+} DmsPrefetchItem;
+
+typedef struct {
+    gboolean done;
+    gchar *value;
+    GError *error;
+    GSimpleAsyncResult *waiter;
+} DmsPrefetch;
+
 struct _MMBroadbandModemQmiPrivate {
     /* Cached device IDs, retrieved by the modem interface when loading device
      * IDs, and used afterwards in the 3GPP and CDMA interfaces. */
@@ -76,6 +92,9 @@ struct _MMBroadbandModemQmiPrivate {
     gchar *meid;
     gchar *esn;
 
+    /* DMS identity queries launched during initialization */
+    DmsPrefetch *dms_prefetch[DMS_PREFETCH_LAST];
+
     /* Cached supported radio interfaces; in order to load supported modes */
     GArray *supported_radio_interfaces;
 
@@ -927,6 +946,94 @@ set_current_capabilities (MMIfaceModem *self,
     set_current_capabilities_context_step (ctx);
 }
 
+/*****************************************************************************/
+/* DMS identity prefetch
+ *
+ * The manufacturer, model, revision and IDs are all requested at once when
+ * initialization starts, instead of one after the other through the steps of
+ * the modem interface. Each result is given to the first load operation that
+ * asks for it, which waits if the request is still in flight. */
+
+static void
+dms_prefetch_free (DmsPrefetch *prefetch)
+{
+    g_assert (prefetch->waiter == NULL);
+    g_free (prefetch->value);
+    if (prefetch->error)
+        g_error_free (prefetch->error);
+    g_slice_free (DmsPrefetch, prefetch);
+}
+
+static void
+dms_prefetch_complete (DmsPrefetch *prefetch,
+                       GSimpleAsyncResult *result)
+{
+    if (prefetch->error)
+        g_simple_async_result_set_from_error (result, prefetch->error);
+    else
+        g_simple_async_result_set_op_res_gpointer (result,
+                                                   g_strdup (prefetch->value),
+                                                   (GDestroyNotify)g_free);
+    g_simple_async_result_complete_in_idle (result);
+    g_object_unref (result);
+}
+
+static void
+dms_prefetch_ready (MMBroadbandModemQmi *self,
+                    GAsyncResult *res,
+                    gpointer user_data)
+{
+    DmsPrefetchItem item = GPOINTER_TO_UINT (user_data);
+    DmsPrefetch *prefetch;
+
+    prefetch = self->priv->dms_prefetch[item];
+    g_assert (prefetch != NULL);
+
+    if (!g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), &prefetch->error))
+        prefetch->value = g_strdup (g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res)));
+    prefetch->done = TRUE;
+
+    /* Keep it around until someone asks for it */
+    if (!prefetch->waiter)
+        return;
+
+    dms_prefetch_complete (prefetch, prefetch->waiter);
+    prefetch->waiter = NULL;
+    self->priv->dms_prefetch[item] = NULL;
+    dms_prefetch_free (prefetch);
+}
+
+static DmsPrefetch *
+dms_prefetch_new (MMBroadbandModemQmi *self,
+                  DmsPrefetchItem item)
+{
+    g_assert (self->priv->dms_prefetch[item] == NULL);
+    self->priv->dms_prefetch[item] = g_slice_new0 (DmsPrefetch);
+    return self->priv->dms_prefetch[item];
+}
+
+static gboolean
+dms_prefetch_take (MMBroadbandModemQmi *self,
+                   DmsPrefetchItem item,
+                   GSimpleAsyncResult *result)
+{
+    DmsPrefetch *prefetch;
+
+    prefetch = self->priv->dms_prefetch[item];
+    if (!prefetch || prefetch->waiter)
+        return FALSE;
+
+    if (!prefetch->done) {
+        prefetch->waiter = result;
+        return TRUE;
+    }
+
+    dms_prefetch_complete (prefetch, result);
+    self->priv->dms_prefetch[item] = NULL;
+    dms_prefetch_free (prefetch);
+    return TRUE;
+}
+
 /*****************************************************************************/
 /* Manufacturer loading (Modem interface) */
 
@@ -994,6 +1101,9 @@ modem_load_manufacturer (MMIfaceModem *self,
                                         user_data,
                                         modem_load_manufacturer);
 
+    if (dms_prefetch_take (MM_BROADBAND_MODEM_QMI (self), DMS_PREFETCH_MANUFACTURER, result))
+        return;
+
     mm_dbg ("loading manufacturer...");
     qmi_client_dms_get_manufacturer (QMI_CLIENT_DMS (client),
                                      NULL,
@@ -1070,6 +1180,9 @@ modem_load_model (MMIfaceModem *self,
                                         user_data,
                                         modem_load_model);
 
+    if (dms_prefetch_take (MM_BROADBAND_MODEM_QMI (self), DMS_PREFETCH_MODEL, result))
+        return;
+
     mm_dbg ("loading model...");
     qmi_client_dms_get_model (QMI_CLIENT_DMS (client),
                               NULL,
@@ -1146,6 +1259,9 @@ modem_load_revision (MMIfaceModem *self,
                                         user_data,
                                         modem_load_revision);
 
+    if (dms_prefetch_take (MM_BROADBAND_MODEM_QMI (self), DMS_PREFETCH_REVISION, result))
+        return;
+
     mm_dbg ("loading revision...");
     qmi_client_dms_get_revision (QMI_CLIENT_DMS (client),
                                  NULL,
@@ -1273,6 +1389,7 @@ modem_load_equipment_identifier (MMIfaceModem *self,
                                  gpointer user_data)
 {
     LoadEquipmentIdentifierContext *ctx;
+    GSimpleAsyncResult *result;
     QmiClient *client = NULL;
 
     if (!ensure_qmi_client (MM_BROADBAND_MODEM_QMI (self),
@@ -1280,13 +1397,18 @@ modem_load_equipment_identifier (MMIfaceModem *self,
                             callback, user_data))
         return;
 
+    result = g_simple_async_result_new (G_OBJECT (self),
+                                        callback,
+                                        user_data,
+                                        modem_load_equipment_identifier);
+
+    if (dms_prefetch_take (MM_BROADBAND_MODEM_QMI (self), DMS_PREFETCH_EQUIPMENT_IDENTIFIER, result))
+        return;
+
     ctx = g_new (LoadEquipmentIdentifierContext, 1);
     ctx->self = g_object_ref (self);
     ctx->client = g_object_ref (client);
-    ctx->result = g_simple_async_result_new (G_OBJECT (self),
-                                             callback,
-                                             user_data,
-                                             modem_load_equipment_identifier);
+    ctx->result = result;
 
     mm_dbg ("loading equipment identifier...");
     qmi_client_dms_get_ids (QMI_CLIENT_DMS (client),
@@ -1297,6 +1419,74 @@ modem_load_equipment_identifier (MMIfaceModem *self,
                             ctx);
 }
 
+static void
+dms_prefetch_start (MMBroadbandModemQmi *self)
+{
+    LoadEquipmentIdentifierContext *ctx;
+    QmiClient *client;
+    guint i;
+
+    client = peek_qmi_client (self, QMI_SERVICE_DMS, NULL);
+    if (!client)
+        return;
+
+    /* Nothing to do if a previous prefetch wasn't consumed yet */
+    for (i = 0; i < DMS_PREFETCH_LAST; i++) {
+        if (self->priv->dms_prefetch[i])
+            return;
+    }
+
+    mm_dbg ("prefetching DMS identity...");
+
+    dms_prefetch_new (self, DMS_PREFETCH_MANUFACTURER);
+    qmi_client_dms_get_manufacturer (QMI_CLIENT_DMS (client),
+                                     NULL,
+                                     5,
+                                     NULL,
+                                     (GAsyncReadyCallback)dms_get_manufacturer_ready,
+                                     g_simple_async_result_new (G_OBJECT (self),
+                                                                (GAsyncReadyCallback)dms_prefetch_ready,
+                                                                GUINT_TO_POINTER (DMS_PREFETCH_MANUFACTURER),
+                                                                dms_prefetch_start));
+
+    dms_prefetch_new (self, DMS_PREFETCH_MODEL);
+    qmi_client_dms_get_model (QMI_CLIENT_DMS (client),
+                              NULL,
+                              5,
+                              NULL,
+                              (GAsyncReadyCallback)dms_get_model_ready,
+                              g_simple_async_result_new (G_OBJECT (self),
+                                                         (GAsyncReadyCallback)dms_prefetch_ready,
+                                                         GUINT_TO_POINTER (DMS_PREFETCH_MODEL),
+                                                         dms_prefetch_start));
+
+    dms_prefetch_new (self, DMS_PREFETCH_REVISION);
+    qmi_client_dms_get_revision (QMI_CLIENT_DMS (client),
+                                 NULL,
+                                 5,
+                                 NULL,
+                                 (GAsyncReadyCallback)dms_get_revision_ready,
+                                 g_simple_async_result_new (G_OBJECT (self),
+                                                            (GAsyncReadyCallback)dms_prefetch_ready,
+                                                            GUINT_TO_POINTER (DMS_PREFETCH_REVISION),
+                                                            dms_prefetch_start));
+
+    dms_prefetch_new (self, DMS_PREFETCH_EQUIPMENT_IDENTIFIER);
+    ctx = g_new (LoadEquipmentIdentifierContext, 1);
+    ctx->self = g_object_ref (self);
+    ctx->client = g_object_ref (client);
+    ctx->result = g_simple_async_result_new (G_OBJECT (self),
+                                             (GAsyncReadyCallback)dms_prefetch_ready,
+                                             GUINT_TO_POINTER (DMS_PREFETCH_EQUIPMENT_IDENTIFIER),
+                                             dms_prefetch_start);
+    qmi_client_dms_get_ids (QMI_CLIENT_DMS (client),
+                            NULL,
+                            5,
+                            NULL,
+                            (GAsyncReadyCallback)dms_get_ids_ready,
+                            ctx);
+}
+
 /*****************************************************************************/
 /* Device identifier loading (Modem interface) */
 
@@ -6816,20 +7006,35 @@ typedef struct {
     QmiClientWms *client;
     MMSmsStorage storage;
     LoadInitialSmsPartsStep step;
+    GTimer *timer;
+    guint n_read;
 
-    /* For each step */
+    /* For each step; up to 'window' Raw Read requests are kept in flight */
     GArray *message_array;
     guint i;
+    guint n_pending;
+    guint window;
 } LoadInitialSmsPartsContext;
 
+typedef struct {
+    LoadInitialSmsPartsContext *ctx;
+    guint32 memory_index;
+} RawReadContext;
+
 static void
 load_initial_sms_parts_context_complete_and_free (LoadInitialSmsPartsContext *ctx)
 {
+    mm_dbg ("Loaded %u SMS parts from storage '%s' in %.3lf s",
+            ctx->n_read,
+            mm_sms_storage_get_string (ctx->storage),
+            g_timer_elapsed (ctx->timer, NULL));
+
     g_simple_async_result_complete (ctx->result);
     g_object_unref (ctx->result);
 
     if (ctx->message_array)
         g_array_unref (ctx->message_array);
+    g_timer_destroy (ctx->timer);
 
     g_object_unref (ctx->client);
     g_object_unref (ctx->self);
@@ -6903,8 +7108,9 @@ add_new_read_sms_part (MMIfaceModemMessaging *self,
 static void
 wms_raw_read_ready (QmiClientWms *client,
                     GAsyncResult *res,
-                    LoadInitialSmsPartsContext *ctx)
+                    RawReadContext *read_ctx)
 {
+    LoadInitialSmsPartsContext *ctx = read_ctx->ctx;
     QmiMessageWmsRawReadOutput *output = NULL;
     GError *error = NULL;
 
@@ -6921,12 +7127,8 @@ wms_raw_read_ready (QmiClientWms *client,
         QmiWmsMessageTagType tag;
         QmiWmsMessageFormat format;
         GArray *data;
-        QmiMessageWmsListMessagesOutputMessageListElement *message;
-
-        message = &g_array_index (ctx->message_array,
-                                  QmiMessageWmsListMessagesOutputMessageListElement,
-                                  ctx->i);
 
+        /* Replies may come in any order, so decode each one right away */
         qmi_message_wms_raw_read_output_get_raw_message_data (
             output,
             &tag,
@@ -6935,50 +7137,37 @@ wms_raw_read_ready (QmiClientWms *client,
             NULL);
         add_new_read_sms_part (MM_IFACE_MODEM_MESSAGING (ctx->self),
                                mm_sms_storage_to_qmi_storage_type (ctx->storage),
-                               message->memory_index,
+                               read_ctx->memory_index,
                                tag,
                                format,
                                data);
+        ctx->n_read++;
     }
 
     if (output)
         qmi_message_wms_raw_read_output_unref (output);
+    g_slice_free (RawReadContext, read_ctx);
 
     /* Keep on reading parts */
-    ctx->i++;
+    g_assert (ctx->n_pending > 0);
+    ctx->n_pending--;
     read_next_sms_part (ctx);
 }
 
 static void load_initial_sms_parts_step (LoadInitialSmsPartsContext *ctx);
 
 static void
-read_next_sms_part (LoadInitialSmsPartsContext *ctx)
+read_sms_part (LoadInitialSmsPartsContext *ctx,
+               guint32 memory_index)
 {
-    QmiMessageWmsListMessagesOutputMessageListElement *message;
     QmiMessageWmsRawReadInput *input;
-
-    if (ctx->i >= ctx->message_array->len ||
-        !ctx->message_array) {
-        /* If we just listed all SMS, we're done. Otherwise go to next tag. */
-        if (ctx->step == LOAD_INITIAL_SMS_PARTS_STEP_3GPP_LIST_ALL)
-            ctx->step = LOAD_INITIAL_SMS_PARTS_STEP_3GPP_LAST;
-        else if (ctx->step == LOAD_INITIAL_SMS_PARTS_STEP_CDMA_LIST_ALL)
-            ctx->step = LOAD_INITIAL_SMS_PARTS_STEP_CDMA_LAST;
-        else
-            ctx->step++;
-        load_initial_sms_parts_step (ctx);
-        return;
-    }
-
-    message = &g_array_index (ctx->message_array,
-                              QmiMessageWmsListMessagesOutputMessageListElement,
-                              ctx->i);
+    RawReadContext *read_ctx;
 
     input = qmi_message_wms_raw_read_input_new ();
     qmi_message_wms_raw_read_input_set_message_memory_storage_id (
         input,
         mm_sms_storage_to_qmi_storage_type (ctx->storage),
-        message->memory_index,
+        memory_index,
         NULL);
 
     /* set message mode */
@@ -6995,15 +7184,50 @@ read_next_sms_part (LoadInitialSmsPartsContext *ctx)
     else
         g_assert_not_reached ();
 
+    read_ctx = g_slice_new (RawReadContext);
+    read_ctx->ctx = ctx;
+    read_ctx->memory_index = memory_index;
+
+    ctx->n_pending++;
     qmi_client_wms_raw_read (QMI_CLIENT_WMS (ctx->client),
                              input,
                              3,
                              NULL,
                              (GAsyncReadyCallback)wms_raw_read_ready,
-                             ctx);
+                             read_ctx);
     qmi_message_wms_raw_read_input_unref (input);
 }
 
+static void
+read_next_sms_part (LoadInitialSmsPartsContext *ctx)
+{
+    /* Fill the window of requests in flight */
+    while (ctx->message_array &&
+           ctx->i < ctx->message_array->len &&
+           ctx->n_pending < ctx->window) {
+        QmiMessageWmsListMessagesOutputMessageListElement *message;
+
+        message = &g_array_index (ctx->message_array,
+                                  QmiMessageWmsListMessagesOutputMessageListElement,
+                                  ctx->i);
+        ctx->i++;
+        read_sms_part (ctx, message->memory_index);
+    }
+
+    /* Wait for all replies before going on */
+    if (ctx->n_pending > 0)
+        return;
+
+    /* If we just listed all SMS, we're done. Otherwise go to next tag. */
+    if (ctx->step == LOAD_INITIAL_SMS_PARTS_STEP_3GPP_LIST_ALL)
+        ctx->step = LOAD_INITIAL_SMS_PARTS_STEP_3GPP_LAST;
+    else if (ctx->step == LOAD_INITIAL_SMS_PARTS_STEP_CDMA_LIST_ALL)
+        ctx->step = LOAD_INITIAL_SMS_PARTS_STEP_CDMA_LAST;
+    else
+        ctx->step++;
+    load_initial_sms_parts_step (ctx);
+}
+
 static void
 wms_list_messages_ready (QmiClientWms *client,
                          GAsyncResult *res,
@@ -7036,6 +7260,8 @@ wms_list_messages_ready (QmiClientWms *client,
         NULL);
 
     /* Keep a reference to the array ourselves */
+    if (ctx->message_array)
+        g_array_unref (ctx->message_array);
     ctx->message_array = g_array_ref (message_array);
 
     qmi_message_wms_list_messages_output_unref (output);
@@ -7199,6 +7425,8 @@ load_initial_sms_parts (MMIfaceModemMessaging *_self,
                                              user_data,
                                              load_initial_sms_parts);
     ctx->step = LOAD_INITIAL_SMS_PARTS_STEP_FIRST;
+    ctx->window = mm_context_get_qmi_sms_read_window ();
+    ctx->timer = g_timer_new ();
 
     load_initial_sms_parts_step (ctx);
 }
@@ -10439,8 +10667,8 @@ typedef struct {
     MMBroadbandModem *self;
     GSimpleAsyncResult *result;
     MMPortQmi *qmi;
-    QmiService services[32];
-    guint service_index;
+    guint n_pending;
+    GTimer *timer;
 } InitializationStartedContext;
 
 static void
@@ -10449,6 +10677,7 @@ initialization_started_context_complete_and_free (InitializationStartedContext *
     g_simple_async_result_complete_in_idle (ctx->result);
     if (ctx->qmi)
         g_object_unref (ctx->qmi);
+    g_timer_destroy (ctx->timer);
     g_object_unref (ctx->result);
     g_object_unref (ctx->self);
     g_free (ctx);
@@ -10498,7 +10727,14 @@ parent_initialization_started (InitializationStartedContext *ctx)
         ctx);
 }
 
-static void allocate_next_client (InitializationStartedContext *ctx);
+/* Clients allocated right after opening the port */
+static const QmiService initial_services[] = {
+    QMI_SERVICE_DMS,
+    QMI_SERVICE_NAS,
+    QMI_SERVICE_WMS,
+    QMI_SERVICE_PDS,
+    QMI_SERVICE_OMA,
+};
 
 static void
 qmi_port_allocate_client_ready (MMPortQmi *qmi,
@@ -10508,35 +10744,42 @@ qmi_port_allocate_client_ready (MMPortQmi *qmi,
     GError *error = NULL;
 
     if (!mm_port_qmi_allocate_client_finish (qmi, res, &error)) {
-        mm_dbg ("Couldn't allocate client for service '%s': %s",
-                qmi_service_get_string (ctx->services[ctx->service_index]),
-                error->message);
+        mm_dbg ("%s", error->message);
         g_error_free (error);
     }
 
-    ctx->service_index++;
-    allocate_next_client (ctx);
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending > 0)
+        return;
+
+    /* All allocations done; start loading the DMS identity right away, so
+     * that it's already available when the modem interface asks for it */
+    mm_dbg ("QMI clients allocated in %.3lfs",
+            g_timer_elapsed (ctx->timer, NULL));
+    dms_prefetch_start (MM_BROADBAND_MODEM_QMI (ctx->self));
+
+    /* Launch parent's callback */
+    parent_initialization_started (ctx);
 }
 
 static void
-allocate_next_client (InitializationStartedContext *ctx)
+allocate_clients (InitializationStartedContext *ctx)
 {
-    if (ctx->services[ctx->service_index] == QMI_SERVICE_UNKNOWN) {
-        /* Done we are, launch parent's callback */
-        parent_initialization_started (ctx);
-        return;
-    }
+    guint i;
 
-    /* Otherwise, allocate next client */
-    mm_port_qmi_allocate_client (ctx->qmi,
-                                 ctx->services[ctx->service_index],
-                                 MM_PORT_QMI_FLAG_DEFAULT,
-                                 NULL,
-                                 (GAsyncReadyCallback)qmi_port_allocate_client_ready,
-                                 ctx);
+    /* Each allocation is a full CTL transaction, and they don't depend on
+     * each other, so request all of them at once */
+    g_timer_start (ctx->timer);
+    ctx->n_pending = G_N_ELEMENTS (initial_services);
+    for (i = 0; i < G_N_ELEMENTS (initial_services); i++)
+        mm_port_qmi_allocate_client (ctx->qmi,
+                                     initial_services[i],
+                                     MM_PORT_QMI_FLAG_DEFAULT,
+                                     NULL,
+                                     (GAsyncReadyCallback)qmi_port_allocate_client_ready,
+                                     ctx);
 }
 
-
 static void
 qmi_port_open_ready_no_data_format (MMPortQmi *qmi,
                                     GAsyncResult *res,
@@ -10550,7 +10793,7 @@ qmi_port_open_ready_no_data_format (MMPortQmi *qmi,
         return;
     }
 
-    allocate_next_client (ctx);
+    allocate_clients (ctx);
 }
 
 static void
@@ -10574,7 +10817,7 @@ qmi_port_open_ready (MMPortQmi *qmi,
         return;
     }
 
-    allocate_next_client (ctx);
+    allocate_clients (ctx);
 }
 
 static void
@@ -10591,6 +10834,7 @@ initialization_started (MMBroadbandModem *self,
                                              user_data,
                                              initialization_started);
     ctx->qmi = mm_base_modem_get_port_qmi (MM_BASE_MODEM (self));
+    ctx->timer = g_timer_new ();
 
     /* This may happen if we unplug the modem unexpectedly */
     if (!ctx->qmi) {
@@ -10608,14 +10852,6 @@ initialization_started (MMBroadbandModem *self,
         return;
     }
 
-    /* Setup services to open */
-    ctx->services[0] = QMI_SERVICE_DMS;
-    ctx->services[1] = QMI_SERVICE_NAS;
-    ctx->services[2] = QMI_SERVICE_WMS;
-    ctx->services[3] = QMI_SERVICE_PDS;
-    ctx->services[4] = QMI_SERVICE_OMA;
-    ctx->services[5] = QMI_SERVICE_UNKNOWN;
-
     /* Now open our QMI port */
     mm_port_qmi_open (ctx->qmi,
                       TRUE,
@@ -10656,6 +10892,7 @@ finalize (GObject *object)
 {
     MMPortQmi *qmi;
     MMBroadbandModemQmi *self = MM_BROADBAND_MODEM_QMI (object);
+    guint i;
 
     qmi = mm_base_modem_peek_port_qmi (MM_BASE_MODEM (self));
     /* If we did open the QMI port during initialization, close it now */
@@ -10667,6 +10904,10 @@ finalize (GObject *object)
     g_free (self->priv->imei);
     g_free (self->priv->meid);
     g_free (self->priv->esn);
+    for (i = 0; i < DMS_PREFETCH_LAST; i++) {
+        if (self->priv->dms_prefetch[i])
+            dms_prefetch_free (self->priv->dms_prefetch[i]);
+    }
     g_free (self->priv->current_operator_id);
     g_free (self->priv->current_operator_description);
     if (self->priv->supported_bands)
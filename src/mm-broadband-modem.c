@@ -48,6 +48,7 @@
 #include "mm-modem-helpers.h"
 #include "mm-error-helpers.h"
 #include "mm-port-serial-qcdm.h"
+#include "mm-reply-cache.h"
 #include "libqcdm/src/errors.h"
 #include "libqcdm/src/commands.h"
 
@@ -3746,9 +3747,9 @@ typedef struct {
     gboolean cs_supported;
     gboolean ps_supported;
     gboolean eps_supported;
-    gboolean run_cs;
-    gboolean run_ps;
-    gboolean run_eps;
+    /* CS, PS and EPS checks + last NUL */
+    MMBaseModemAtCommand checks[4];
+    guint n_checks;
     gboolean running_cs;
     gboolean running_ps;
     gboolean running_eps;
@@ -3780,14 +3781,17 @@ modem_3gpp_run_registration_checks_finish (MMIfaceModem3gpp *self,
     return !g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error);
 }
 
-static void run_registration_checks_context_step (RunRegistrationChecksContext *ctx);
-
-static void
-registration_status_check_ready (MMBroadbandModem *self,
-                                 GAsyncResult *res,
-                                 RunRegistrationChecksContext *ctx)
+static gboolean
+registration_status_check_processor (MMBaseModem *_self,
+                                     RunRegistrationChecksContext *ctx,
+                                     const gchar *command,
+                                     const gchar *response,
+                                     gboolean last_command,
+                                     const GError *response_error,
+                                     GVariant **result,
+                                     GError **result_error)
 {
-    const gchar *response;
+    MMBroadbandModem *self = MM_BROADBAND_MODEM (_self);
     GError *error = NULL;
     GMatchInfo *match_info;
     guint i;
@@ -3799,14 +3803,18 @@ registration_status_check_ready (MMBroadbandModem *self,
     gulong lac;
     gulong cid;
 
+    ctx->running_cs = g_str_equal (command, "+CREG?");
+    ctx->running_ps = g_str_equal (command, "+CGREG?");
+    ctx->running_eps = g_str_equal (command, "+CEREG?");
+
     /* Only one must be running */
     g_assert ((ctx->running_cs ? 1 : 0) +
               (ctx->running_ps ? 1 : 0) +
               (ctx->running_eps ? 1 : 0) == 1);
 
-    response = mm_base_modem_at_command_finish (MM_BASE_MODEM (self), res, &error);
-    if (!response) {
-        g_assert (error != NULL);
+    /* Errors are not fatal, just go on with the next check */
+    if (response_error) {
+        error = g_error_copy (response_error);
         if (ctx->running_cs)
             ctx->cs_error = error;
         else if (ctx->running_ps)
@@ -3814,8 +3822,7 @@ registration_status_check_ready (MMBroadbandModem *self,
         else
             ctx->eps_error = error;
 
-        run_registration_checks_context_step (ctx);
-        return;
+        return FALSE;
     }
 
     /* Unsolicited registration status handlers will usually process the
@@ -3823,8 +3830,7 @@ registration_status_check_ready (MMBroadbandModem *self,
      */
     if (!response[0]) {
         /* Done */
-        run_registration_checks_context_step (ctx);
-        return;
+        return FALSE;
     }
 
     /* Try to match the response */
@@ -3853,8 +3859,7 @@ registration_status_check_ready (MMBroadbandModem *self,
         else
             ctx->eps_error = error;
 
-        run_registration_checks_context_step (ctx);
-        return;
+        return FALSE;
     }
 
     cgreg = FALSE;
@@ -3885,8 +3890,7 @@ registration_status_check_ready (MMBroadbandModem *self,
             ctx->ps_error = error;
         else
             ctx->eps_error = error;
-        run_registration_checks_context_step (ctx);
-        return;
+        return FALSE;
     }
 
     /* Report new registration state */
@@ -3913,52 +3917,20 @@ registration_status_check_ready (MMBroadbandModem *self,
     mm_iface_modem_3gpp_update_access_technologies (MM_IFACE_MODEM_3GPP (self), act);
     mm_iface_modem_3gpp_update_location (MM_IFACE_MODEM_3GPP (self), lac, cid);
 
-    run_registration_checks_context_step (ctx);
+    return FALSE;
 }
 
 static void
-run_registration_checks_context_step (RunRegistrationChecksContext *ctx)
+registration_status_check_ready (MMBaseModem *self,
+                                 GAsyncResult *res,
+                                 RunRegistrationChecksContext *ctx)
 {
-    ctx->running_cs = FALSE;
-    ctx->running_ps = FALSE;
-    ctx->running_eps = FALSE;
-
-    if (ctx->run_cs) {
-        ctx->running_cs = TRUE;
-        ctx->run_cs = FALSE;
-        /* Check current CS-registration state. */
-        mm_base_modem_at_command (MM_BASE_MODEM (ctx->self),
-                                  "+CREG?",
-                                  10,
-                                  FALSE,
-                                  (GAsyncReadyCallback)registration_status_check_ready,
-                                  ctx);
-        return;
-    }
-
-    if (ctx->run_ps) {
-        ctx->running_ps = TRUE;
-        ctx->run_ps = FALSE;
-        /* Check current PS-registration state. */
-        mm_base_modem_at_command (MM_BASE_MODEM (ctx->self),
-                                  "+CGREG?",
-                                  10,
-                                  FALSE,
-                                  (GAsyncReadyCallback)registration_status_check_ready,
-                                  ctx);
-        return;
-    }
+    GError *error = NULL;
 
-    if (ctx->run_eps) {
-        ctx->running_eps = TRUE;
-        ctx->run_eps = FALSE;
-        /* Check current EPS-registration state. */
-        mm_base_modem_at_command (MM_BASE_MODEM (ctx->self),
-                                  "+CEREG?",
-                                  10,
-                                  FALSE,
-                                  (GAsyncReadyCallback)registration_status_check_ready,
-                                  ctx);
+    mm_base_modem_at_sequence_finish (self, res, NULL, &error);
+    if (error) {
+        g_simple_async_result_take_error (ctx->result, error);
+        run_registration_checks_context_complete_and_free (ctx);
         return;
     }
 
@@ -3985,6 +3957,22 @@ run_registration_checks_context_step (RunRegistrationChecksContext *ctx)
     run_registration_checks_context_complete_and_free (ctx);
 }
 
+static void
+add_registration_check (RunRegistrationChecksContext *ctx,
+                        const gchar *command)
+{
+    MMBaseModemAtCommand *check;
+
+    g_assert (ctx->n_checks < G_N_ELEMENTS (ctx->checks) - 1);
+    check = &ctx->checks[ctx->n_checks++];
+    check->command = (gchar *)command;
+    check->timeout = 10;
+    check->allow_cached = FALSE;
+    check->response_processor = (MMBaseModemAtResponseProcessor)registration_status_check_processor;
+    /* Read queries with prefixed replies, so they can go in one command line */
+    check->allow_chaining = TRUE;
+}
+
 static void
 modem_3gpp_run_registration_checks (MMIfaceModem3gpp *self,
                                     gboolean cs_supported,
@@ -4004,11 +3992,27 @@ modem_3gpp_run_registration_checks (MMIfaceModem3gpp *self,
     ctx->cs_supported = cs_supported;
     ctx->ps_supported = ps_supported;
     ctx->eps_supported = eps_supported;
-    ctx->run_cs = cs_supported;
-    ctx->run_ps = ps_supported;
-    ctx->run_eps = eps_supported;
 
-    run_registration_checks_context_step (ctx);
+    /* Check current CS, PS and EPS registration states */
+    if (cs_supported)
+        add_registration_check (ctx, "+CREG?");
+    if (ps_supported)
+        add_registration_check (ctx, "+CGREG?");
+    if (eps_supported)
+        add_registration_check (ctx, "+CEREG?");
+
+    if (!ctx->n_checks) {
+        g_simple_async_result_set_op_res_gboolean (ctx->result, TRUE);
+        run_registration_checks_context_complete_and_free (ctx);
+        return;
+    }
+
+    mm_base_modem_at_sequence (MM_BASE_MODEM (self),
+                               ctx->checks,
+                               ctx,
+                               NULL,
+                               (GAsyncReadyCallback)registration_status_check_ready,
+                               ctx);
 }
 
 /*****************************************************************************/
@@ -5904,6 +5908,8 @@ typedef struct {
     MMBroadbandModem *self;
     GSimpleAsyncResult *result;
     MMSmsStorage list_storage;
+    /* Parts already processed while the PDU listing was being received */
+    guint n_streamed;
 } ListPartsContext;
 
 static void
@@ -6081,6 +6087,55 @@ sms_state_from_index (guint index)
     }
 }
 
+static void
+sms_pdu_part_take (MMBroadbandModem *self,
+                   ListPartsContext *ctx,
+                   gint index,
+                   gint status,
+                   MMSmsPart *part,
+                   GError *error)
+{
+    if (part) {
+        mm_dbg ("Correctly parsed PDU (%d)", index);
+        mm_iface_modem_messaging_take_part (MM_IFACE_MODEM_MESSAGING (self),
+                                            part,
+                                            sms_state_from_index (status),
+                                            ctx->list_storage);
+    } else {
+        /* Don't treat the error as critical */
+        mm_dbg ("Error parsing PDU (%d): %s", index, error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+sms_pdu_part_list_entry (MMPortSerialAt *port,
+                         GMatchInfo *match_info,
+                         ListPartsContext *ctx)
+{
+    GError *error = NULL;
+    MMSmsPart *part;
+    gint index;
+    gint status;
+    gint start;
+    gint end;
+
+    if (!mm_get_int_from_match_info (match_info, 1, &index) ||
+        !mm_get_int_from_match_info (match_info, 2, &status) ||
+        !g_match_info_fetch_pos (match_info, 4, &start, &end)) {
+        mm_dbg ("Couldn't parse +CMGL entry");
+        return;
+    }
+
+    /* Decode the PDU right from the port buffer */
+    part = mm_sms_part_3gpp_new_from_hex_pdu (index,
+                                              g_match_info_get_string (match_info) + start,
+                                              end - start,
+                                              &error);
+    sms_pdu_part_take (ctx->self, ctx, index, status, part, error);
+    ctx->n_streamed++;
+}
+
 static void
 sms_pdu_part_list_ready (MMBroadbandModem *self,
                          GAsyncResult *res,
@@ -6101,6 +6156,9 @@ sms_pdu_part_list_ready (MMBroadbandModem *self,
         return;
     }
 
+    mm_dbg ("%u SMS parts processed while listing", ctx->n_streamed);
+
+    /* Entries not already streamed, if any */
     info_list = mm_3gpp_parse_pdu_cmgl_response (response, &error);
     if (error) {
         g_simple_async_result_take_error (ctx->result, error);
@@ -6113,17 +6171,8 @@ sms_pdu_part_list_ready (MMBroadbandModem *self,
         MMSmsPart *part;
 
         part = mm_sms_part_3gpp_new_from_pdu (info->index, info->pdu, &error);
-        if (part) {
-            mm_dbg ("Correctly parsed PDU (%d)", info->index);
-            mm_iface_modem_messaging_take_part (MM_IFACE_MODEM_MESSAGING (self),
-                                                part,
-                                                sms_state_from_index (info->status),
-                                                ctx->list_storage);
-        } else {
-            /* Don't treat the error as critical */
-            mm_dbg ("Error parsing PDU (%d): %s", info->index, error->message);
-            g_clear_error (&error);
-        }
+        sms_pdu_part_take (self, ctx, info->index, info->status, part, error);
+        error = NULL;
     }
 
     mm_3gpp_pdu_info_list_free (info_list);
@@ -6152,15 +6201,29 @@ list_parts_lock_storages_ready (MMBroadbandModem *self,
 
     /* Get SMS parts from ALL types.
      * Different command to be used if we are on Text or PDU mode */
+    if (MM_BROADBAND_MODEM (self)->priv->modem_messaging_sms_pdu_mode) {
+        GRegex *r;
+
+        /* PDUs are processed as they arrive, so that large stores don't need
+         * to be fully buffered */
+        r = mm_3gpp_cmgl_pdu_entry_regex_get ();
+        mm_base_modem_at_command_streaming (MM_BASE_MODEM (self),
+                                            "+CMGL=4",
+                                            20,
+                                            r,
+                                            (MMPortSerialAtStreamEntryFn)sms_pdu_part_list_entry,
+                                            ctx,
+                                            (GAsyncReadyCallback)sms_pdu_part_list_ready,
+                                            ctx);
+        g_regex_unref (r);
+        return;
+    }
+
     mm_base_modem_at_command (MM_BASE_MODEM (self),
-                              (MM_BROADBAND_MODEM (self)->priv->modem_messaging_sms_pdu_mode ?
-                               "+CMGL=4" :
-                               "+CMGL=\"ALL\""),
+                              "+CMGL=\"ALL\"",
                               20,
                               FALSE,
-                              (GAsyncReadyCallback) (MM_BROADBAND_MODEM (self)->priv->modem_messaging_sms_pdu_mode ?
-                                                     sms_pdu_part_list_ready :
-                                                     sms_text_part_list_ready),
+                              (GAsyncReadyCallback)sms_text_part_list_ready,
                               ctx);
 }
 
@@ -8794,6 +8857,7 @@ typedef enum {
     INITIALIZE_STEP_FIRST,
     INITIALIZE_STEP_SETUP_PORTS,
     INITIALIZE_STEP_STARTED,
+    INITIALIZE_STEP_REPLY_CACHE,
     INITIALIZE_STEP_SETUP_SIMPLE_STATUS,
     INITIALIZE_STEP_IFACE_MODEM,
     INITIALIZE_STEP_IFACE_3GPP,
@@ -8816,6 +8880,9 @@ typedef struct {
     GSimpleAsyncResult *result;
     InitializeStep step;
     gpointer ports_ctx;
+    MMReplyCache *reply_cache;
+    gchar *reply_cache_equipment_identifier;
+    gchar *reply_cache_revision;
 } InitializeContext;
 
 static void initialize_step (InitializeContext *ctx);
@@ -8834,6 +8901,10 @@ initialize_context_complete_and_free (InitializeContext *ctx)
         g_error_free (error);
     }
 
+    if (ctx->reply_cache)
+        mm_reply_cache_free (ctx->reply_cache);
+    g_free (ctx->reply_cache_equipment_identifier);
+    g_free (ctx->reply_cache_revision);
     g_object_unref (ctx->result);
     g_object_unref (ctx->cancellable);
     g_object_unref (ctx->self);
@@ -8896,6 +8967,140 @@ initialization_started_ready (MMBroadbandModem *self,
     initialize_step (ctx);
 }
 
+/* The replies in the persistent cache are only reused if the modem in the
+ * same physical port still reports the same equipment identifier and
+ * firmware revision. The Modem interface isn't initialized yet, so they are
+ * queried here with the generic commands, which don't depend on the modem
+ * capabilities nor on plugin-specific loaders. The replies stay in the port
+ * cache, so the Modem interface initialization reuses them. */
+
+static void
+reply_cache_step_done (InitializeContext *ctx)
+{
+    if (ctx->reply_cache) {
+        mm_reply_cache_free (ctx->reply_cache);
+        ctx->reply_cache = NULL;
+    }
+
+    /* Go on to next step */
+    ctx->step++;
+    initialize_step (ctx);
+}
+
+static void
+reply_cache_validate (InitializeContext *ctx)
+{
+    GError *error = NULL;
+
+    ctx->reply_cache = mm_reply_cache_load (mm_base_modem_get_vendor_id (MM_BASE_MODEM (ctx->self)),
+                                            mm_base_modem_get_product_id (MM_BASE_MODEM (ctx->self)),
+                                            mm_base_modem_get_device (MM_BASE_MODEM (ctx->self)),
+                                            &error);
+    if (!ctx->reply_cache) {
+        mm_dbg ("Couldn't load cached replies: %s", error->message);
+        g_error_free (error);
+    } else if (g_strcmp0 (ctx->reply_cache_equipment_identifier,
+                          mm_reply_cache_get_equipment_identifier (ctx->reply_cache)) != 0)
+        mm_dbg ("Equipment identifier changed, not reusing cached replies");
+    else if (g_strcmp0 (ctx->reply_cache_revision,
+                        mm_reply_cache_get_revision (ctx->reply_cache)) != 0)
+        mm_dbg ("Firmware revision changed, not reusing cached replies");
+    else
+        mm_dbg ("Reusing %u cached replies",
+                mm_reply_cache_apply (ctx->reply_cache,
+                                      MM_PORT_SERIAL (mm_base_modem_peek_port_primary (MM_BASE_MODEM (ctx->self)))));
+
+    reply_cache_step_done (ctx);
+}
+
+static void
+reply_cache_load_revision_ready (MMBaseModem *self,
+                                 GAsyncResult *res,
+                                 InitializeContext *ctx)
+{
+    GVariant *result;
+
+    result = mm_base_modem_at_sequence_full_finish (self, res, NULL, NULL);
+    if (!result) {
+        mm_dbg ("Couldn't load revision, not using the reply cache");
+        g_free (ctx->reply_cache_equipment_identifier);
+        ctx->reply_cache_equipment_identifier = NULL;
+        reply_cache_step_done (ctx);
+        return;
+    }
+
+    ctx->reply_cache_revision = sanitize_info_reply (result, "GMR:");
+    reply_cache_validate (ctx);
+}
+
+static void
+reply_cache_load_equipment_identifier_ready (MMBaseModem *self,
+                                             GAsyncResult *res,
+                                             InitializeContext *ctx)
+{
+    GVariant *result;
+
+    result = mm_base_modem_at_sequence_full_finish (self, res, NULL, NULL);
+    if (!result) {
+        mm_dbg ("Couldn't load equipment identifier, not using the reply cache");
+        reply_cache_step_done (ctx);
+        return;
+    }
+
+    ctx->reply_cache_equipment_identifier = sanitize_info_reply (result, "GSN:");
+    mm_base_modem_at_sequence_full (self,
+                                    mm_base_modem_peek_port_primary (self),
+                                    revisions,
+                                    NULL, /* response_processor_context */
+                                    NULL, /* response_processor_context_free */
+                                    ctx->cancellable,
+                                    (GAsyncReadyCallback)reply_cache_load_revision_ready,
+                                    ctx);
+}
+
+static gboolean
+reply_cache_load (InitializeContext *ctx)
+{
+    MMPortSerialAt *primary;
+
+    primary = mm_base_modem_peek_port_primary (MM_BASE_MODEM (ctx->self));
+    if (!mm_reply_cache_enabled () || !primary)
+        return FALSE;
+
+    mm_base_modem_at_sequence_full (MM_BASE_MODEM (ctx->self),
+                                    primary,
+                                    equipment_identifiers,
+                                    NULL, /* response_processor_context */
+                                    NULL, /* response_processor_context_free */
+                                    ctx->cancellable,
+                                    (GAsyncReadyCallback)reply_cache_load_equipment_identifier_ready,
+                                    ctx);
+    return TRUE;
+}
+
+static void
+reply_cache_save (InitializeContext *ctx)
+{
+    MMPortSerialAt *primary;
+    GError *error = NULL;
+
+    /* Only if the cache keys were loaded in the same initialization */
+    primary = mm_base_modem_peek_port_primary (MM_BASE_MODEM (ctx->self));
+    if (!primary || !ctx->reply_cache_equipment_identifier || !ctx->reply_cache_revision)
+        return;
+
+    if (!mm_reply_cache_save (mm_base_modem_get_vendor_id (MM_BASE_MODEM (ctx->self)),
+                              mm_base_modem_get_product_id (MM_BASE_MODEM (ctx->self)),
+                              mm_base_modem_get_device (MM_BASE_MODEM (ctx->self)),
+                              ctx->reply_cache_equipment_identifier,
+                              ctx->reply_cache_revision,
+                              MM_PORT_SERIAL (primary),
+                              &error)) {
+        mm_warn ("Couldn't save cached replies: %s", error->message);
+        g_error_free (error);
+    }
+}
+
 static void
 iface_modem_initialize_ready (MMBroadbandModem *self,
                               GAsyncResult *result,
@@ -9033,6 +9238,12 @@ initialize_step (InitializeContext *ctx)
         /* Fall down to next step */
         ctx->step++;
 
+    case INITIALIZE_STEP_REPLY_CACHE:
+        if (reply_cache_load (ctx))
+            return;
+        /* Fall down to next step */
+        ctx->step++;
+
     case INITIALIZE_STEP_SETUP_SIMPLE_STATUS:
         /* Simple status must be created before any interface initialization,
          * so that interfaces add and bind the properties they want to export.
@@ -9188,7 +9399,10 @@ initialize_step (InitializeContext *ctx)
         }
 
         /* All initialized without errors!
-         * Set as disabled (a.k.a. initialized) */
+         * Keep the static replies for the next time */
+        reply_cache_save (ctx);
+
+        /* Set as disabled (a.k.a. initialized) */
         mm_iface_modem_update_state (MM_IFACE_MODEM (ctx->self),
                                      MM_MODEM_STATE_DISABLED,
                                      MM_MODEM_STATE_CHANGE_REASON_UNKNOWN);
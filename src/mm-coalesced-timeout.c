@@ -0,0 +1,177 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <config.h>
+
+#include "mm-coalesced-timeout.h"
+
+typedef struct {
+    guint id;
+    guint interval;
+    guint slack;
+    gint64 due;
+    GSourceFunc function;
+    gpointer data;
+} Timeout;
+
+static GHashTable *timeouts;
+static guint last_id;
+static guint wakeup_id;
+static gint64 wakeup_deadline;
+static gboolean dispatching;
+
+/*****************************************************************************/
+
+static void
+timeout_free (Timeout *timeout)
+{
+    g_slice_free (Timeout, timeout);
+}
+
+static gboolean wakeup_cb (gpointer unused);
+
+static void
+schedule_wakeup (void)
+{
+    GHashTableIter iter;
+    Timeout *timeout;
+    gint64 deadline = G_MAXINT64;
+    gint64 now;
+
+    /* Will be done once all the callbacks have run */
+    if (dispatching)
+        return;
+
+    /* Wake up when the first timeout is due; slack only lets others run
+     * early along with it, never delays any of them */
+    g_hash_table_iter_init (&iter, timeouts);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&timeout))
+        deadline = MIN (deadline, timeout->due);
+
+    if (deadline == G_MAXINT64)
+        return;
+
+    /* An earlier wakeup is already good enough */
+    if (wakeup_id && wakeup_deadline <= deadline)
+        return;
+
+    if (wakeup_id)
+        g_source_remove (wakeup_id);
+
+    /* Rounded up, so that the first timeout is really due when we wake up */
+    now = g_get_monotonic_time ();
+    wakeup_deadline = deadline;
+    wakeup_id = g_timeout_add (deadline > now ? (guint)((deadline - now + 999) / 1000) : 0,
+                               wakeup_cb,
+                               NULL);
+}
+
+static gboolean
+wakeup_cb (gpointer unused)
+{
+    GHashTableIter iter;
+    Timeout *timeout;
+    GArray *ready;
+    gint64 now;
+    guint i;
+
+    wakeup_id = 0;
+    now = g_get_monotonic_time ();
+
+    /* Collect the ones due, or due within their slack, first, as callbacks
+     * may add or remove timeouts */
+    ready = g_array_new (FALSE, FALSE, sizeof (guint));
+    g_hash_table_iter_init (&iter, timeouts);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&timeout)) {
+        if (timeout->due <= now + (gint64)timeout->slack * G_USEC_PER_SEC)
+            g_array_append_val (ready, timeout->id);
+    }
+
+    dispatching = TRUE;
+    for (i = 0; i < ready->len; i++) {
+        guint id;
+
+        id = g_array_index (ready, guint, i);
+        timeout = g_hash_table_lookup (timeouts, GUINT_TO_POINTER (id));
+        /* Removed by one of the previous callbacks? */
+        if (!timeout)
+            continue;
+
+        /* Next run counted from the due time, so that running early (or a
+         * bit late) never changes the period. If we fell way behind (e.g.
+         * after a suspend), don't try to catch up with the missed runs. */
+        timeout->due += (gint64)timeout->interval * G_USEC_PER_SEC;
+        if (timeout->due <= now)
+            timeout->due = now + (gint64)timeout->interval * G_USEC_PER_SEC;
+
+        if (!timeout->function (timeout->data))
+            g_hash_table_remove (timeouts, GUINT_TO_POINTER (id));
+    }
+    dispatching = FALSE;
+
+    g_array_unref (ready);
+
+    schedule_wakeup ();
+    return FALSE;
+}
+
+/*****************************************************************************/
+
+guint
+mm_coalesced_timeout_add_seconds (guint interval,
+                                  guint slack,
+                                  GSourceFunc function,
+                                  gpointer data)
+{
+    Timeout *timeout;
+
+    g_return_val_if_fail (function != NULL, 0);
+
+    if (G_UNLIKELY (!timeouts))
+        timeouts = g_hash_table_new_full (g_direct_hash,
+                                          g_direct_equal,
+                                          NULL,
+                                          (GDestroyNotify)timeout_free);
+
+    timeout = g_slice_new (Timeout);
+    /* 0 is never a valid id */
+    if (G_UNLIKELY (++last_id == 0))
+        last_id++;
+    timeout->id = last_id;
+    timeout->interval = interval;
+    timeout->slack = slack;
+    timeout->due = g_get_monotonic_time () + (gint64)interval * G_USEC_PER_SEC;
+    timeout->function = function;
+    timeout->data = data;
+    g_hash_table_insert (timeouts, GUINT_TO_POINTER (timeout->id), timeout);
+
+    schedule_wakeup ();
+    return timeout->id;
+}
+
+void
+mm_coalesced_timeout_remove (guint id)
+{
+    g_return_if_fail (id != 0);
+
+    if (!timeouts || !g_hash_table_remove (timeouts, GUINT_TO_POINTER (id))) {
+        g_warning ("Coalesced timeout %u not found", id);
+        return;
+    }
+
+    /* Just let the wakeup go off if there are other timeouts pending */
+    if (!dispatching && wakeup_id && !g_hash_table_size (timeouts)) {
+        g_source_remove (wakeup_id);
+        wakeup_id = 0;
+    }
+}
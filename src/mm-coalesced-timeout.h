@@ -0,0 +1,36 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_COALESCED_TIMEOUT_H
+#define MM_COALESCED_TIMEOUT_H
+
+#include <glib.h>
+
+/* Periodic timeouts sharing a single main loop source. The source wakes up
+ * when the first timeout is due, and also runs every other timeout due
+ * within its own 'slack' seconds, so that the ones falling in the same
+ * window run in a single wakeup. Each timeout is always rescheduled from its
+ * due time, so running early never changes its period, and timeouts with
+ * the same interval which ran together keep on running together.
+ *
+ * Same semantics as g_timeout_add_seconds(): the callback returns TRUE to be
+ * called again after another interval, or FALSE to be removed. */
+
+guint mm_coalesced_timeout_add_seconds (guint interval,
+                                        guint slack,
+                                        GSourceFunc function,
+                                        gpointer data);
+
+void  mm_coalesced_timeout_remove (guint id);
+
+#endif /* MM_COALESCED_TIMEOUT_H */
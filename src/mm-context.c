@@ -20,10 +20,24 @@
 /*****************************************************************************/
 /* Application context */
 
+#define DEFAULT_QMI_SMS_READ_WINDOW 4
+#define DEFAULT_PROPERTY_BATCH_WINDOW_MS 100
+#define DEFAULT_BEARER_STATS_REFRESH_RATE 30
+
 static gboolean version_flag;
 static gboolean debug;
 static const gchar *log_level;
 static const gchar *log_file;
+static const gchar *log_flush;
+static const gchar *trace_file;
+static const gchar *reply_cache_dir;
+static const gchar *probe_cache_file;
+static gint max_parallel_probes;
+static gint qmi_sms_read_window;
+static gint property_batch_window = DEFAULT_PROPERTY_BATCH_WINDOW_MS;
+static gint bearer_stats_refresh_rate = DEFAULT_BEARER_STATS_REFRESH_RATE;
+static const gchar *data_port_selection_str;
+static MMDataPortSelection data_port_selection = MM_DATA_PORT_SELECTION_FIRST;
 static gboolean show_ts;
 static gboolean rel_ts;
 
@@ -32,6 +46,15 @@ static const GOptionEntry entries[] = {
     { "debug", 0, 0, G_OPTION_ARG_NONE, &debug, "Run with extended debugging capabilities", NULL },
     { "log-level", 0, 0, G_OPTION_ARG_STRING, &log_level, "Log level: one of [ERR, WARN, INFO, DEBUG]", "INFO" },
     { "log-file", 0, 0, G_OPTION_ARG_STRING, &log_file, "Path to log file", NULL },
+    { "log-flush", 0, 0, G_OPTION_ARG_STRING, &log_flush, "Log file flush policy: one of [ALWAYS, WARN, SHUTDOWN]", "WARN" },
+    { "trace-file", 0, 0, G_OPTION_ARG_STRING, &trace_file, "Path to binary trace file recording raw port traffic", NULL },
+    { "reply-cache-dir", 0, 0, G_OPTION_ARG_STRING, &reply_cache_dir, "Path to directory where static modem replies are kept across restarts", "[PATH]" },
+    { "probe-cache-file", 0, 0, G_OPTION_ARG_STRING, &probe_cache_file, "Path to file where port probing results are kept across restarts", "[PATH]" },
+    { "max-parallel-probes", 0, 0, G_OPTION_ARG_INT, &max_parallel_probes, "Maximum number of port support checks run at the same time, 0 for no limit", "[N]" },
+    { "qmi-sms-read-window", 0, 0, G_OPTION_ARG_INT, &qmi_sms_read_window, "Maximum number of stored SMS read at the same time from QMI modems (default 4)", "[N]" },
+    { "property-batch-window", 0, 0, G_OPTION_ARG_INT, &property_batch_window, "Time in milliseconds during which frequently updated DBus properties are merged into a single change signal, 0 to disable (default 100)", "[MS]" },
+    { "bearer-stats-refresh-rate", 0, 0, G_OPTION_ARG_INT, &bearer_stats_refresh_rate, "Time in seconds between reloads of the traffic statistics of connected bearers, 0 to disable (default 30)", "[SECS]" },
+    { "data-port-selection", 0, 0, G_OPTION_ARG_STRING, &data_port_selection_str, "Data port selection policy when a modem has several: one of [FIRST, ROUND-ROBIN]", "FIRST" },
     { "timestamps", 0, 0, G_OPTION_ARG_NONE, &show_ts, "Show timestamps in log output", NULL },
     { "relative-timestamps", 0, 0, G_OPTION_ARG_NONE, &rel_ts, "Use relative timestamps (from MM start)", NULL },
     { NULL }
@@ -55,6 +78,60 @@ mm_context_get_log_file (void)
     return log_file;
 }
 
+const gchar *
+mm_context_get_log_flush (void)
+{
+    return log_flush;
+}
+
+const gchar *
+mm_context_get_trace_file (void)
+{
+    return trace_file;
+}
+
+const gchar *
+mm_context_get_reply_cache_dir (void)
+{
+    return reply_cache_dir;
+}
+
+const gchar *
+mm_context_get_probe_cache_file (void)
+{
+    return probe_cache_file;
+}
+
+guint
+mm_context_get_max_parallel_probes (void)
+{
+    return (max_parallel_probes > 0 ? (guint) max_parallel_probes : 0);
+}
+
+guint
+mm_context_get_qmi_sms_read_window (void)
+{
+    return (qmi_sms_read_window > 0 ? (guint) qmi_sms_read_window : DEFAULT_QMI_SMS_READ_WINDOW);
+}
+
+guint
+mm_context_get_property_batch_window (void)
+{
+    return (property_batch_window > 0 ? (guint) property_batch_window : 0);
+}
+
+guint
+mm_context_get_bearer_stats_refresh_rate (void)
+{
+    return (bearer_stats_refresh_rate > 0 ? (guint) bearer_stats_refresh_rate : 0);
+}
+
+MMDataPortSelection
+mm_context_get_data_port_selection (void)
+{
+    return data_port_selection;
+}
+
 gboolean
 mm_context_get_timestamps (void)
 {
@@ -74,12 +151,14 @@ static gboolean test_session;
 static gboolean test_no_auto_scan;
 static gboolean test_enable;
 static gchar *test_plugin_dir;
+static gboolean test_regex_parser;
 
 static const GOptionEntry test_entries[] = {
     { "test-session", 0, 0, G_OPTION_ARG_NONE, &test_session, "Run in session DBus", NULL },
     { "test-no-auto-scan", 0, 0, G_OPTION_ARG_NONE, &test_no_auto_scan, "Don't auto-scan looking for devices", NULL },
     { "test-enable", 0, 0, G_OPTION_ARG_NONE, &test_enable, "Enable the Test interface in the daemon", NULL },
     { "test-plugin-dir", 0, 0, G_OPTION_ARG_STRING, &test_plugin_dir, "Path to look for plugins", "[PATH]" },
+    { "test-regex-parser", 0, 0, G_OPTION_ARG_NONE, &test_regex_parser, "Parse AT replies with the regex cascade instead of the single-pass classifier", NULL },
     { NULL }
 };
 
@@ -121,6 +200,12 @@ mm_context_get_test_plugin_dir (void)
     return test_plugin_dir ? test_plugin_dir : PLUGINDIR;
 }
 
+gboolean
+mm_context_get_test_regex_parser (void)
+{
+    return test_regex_parser;
+}
+
 /*****************************************************************************/
 
 static void
@@ -156,6 +241,17 @@ mm_context_init (gint argc,
 
     g_option_context_free (ctx);
 
+    if (data_port_selection_str) {
+        if (!g_ascii_strcasecmp (data_port_selection_str, "first"))
+            data_port_selection = MM_DATA_PORT_SELECTION_FIRST;
+        else if (!g_ascii_strcasecmp (data_port_selection_str, "round-robin"))
+            data_port_selection = MM_DATA_PORT_SELECTION_ROUND_ROBIN;
+        else {
+            g_warning ("Unknown data port selection policy '%s'\n", data_port_selection_str);
+            exit (1);
+        }
+    }
+
     /* Additional setup to be done on debug mode */
     if (debug) {
         log_level = "DEBUG";
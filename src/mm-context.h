@@ -26,9 +26,23 @@
 void mm_context_init (gint argc,
                       gchar **argv);
 
+typedef enum {
+    MM_DATA_PORT_SELECTION_FIRST,
+    MM_DATA_PORT_SELECTION_ROUND_ROBIN,
+} MMDataPortSelection;
+
 gboolean     mm_context_get_debug               (void);
 const gchar *mm_context_get_log_level           (void);
 const gchar *mm_context_get_log_file            (void);
+const gchar *mm_context_get_log_flush           (void);
+const gchar *mm_context_get_trace_file          (void);
+const gchar *mm_context_get_reply_cache_dir     (void);
+const gchar *mm_context_get_probe_cache_file    (void);
+guint        mm_context_get_max_parallel_probes (void);
+guint        mm_context_get_qmi_sms_read_window (void);
+guint        mm_context_get_property_batch_window (void);
+guint        mm_context_get_bearer_stats_refresh_rate (void);
+MMDataPortSelection mm_context_get_data_port_selection (void);
 gboolean     mm_context_get_timestamps          (void);
 gboolean     mm_context_get_relative_timestamps (void);
 
@@ -37,5 +51,6 @@ gboolean     mm_context_get_test_session        (void);
 gboolean     mm_context_get_test_no_auto_scan   (void);
 gboolean     mm_context_get_test_enable         (void);
 const gchar *mm_context_get_test_plugin_dir     (void);
+gboolean     mm_context_get_test_regex_parser   (void);
 
 #endif /* MM_CONTEXT_H */
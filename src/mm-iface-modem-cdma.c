@@ -24,8 +24,10 @@
 #include "mm-base-modem.h"
 #include "mm-modem-helpers.h"
 #include "mm-log.h"
+#include "mm-coalesced-timeout.h"
 
 #define REGISTRATION_CHECK_TIMEOUT_SEC 30
+#define REGISTRATION_CHECK_SLACK_SEC   10
 
 #define SUBSYSTEM_CDMA1X "cdma1x"
 #define SUBSYSTEM_EVDO "evdo"
@@ -1123,7 +1125,7 @@ static void
 registration_check_context_free (RegistrationCheckContext *ctx)
 {
     if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+        mm_coalesced_timeout_remove (ctx->timeout_source);
     g_free (ctx);
 }
 
@@ -1196,9 +1198,10 @@ periodic_registration_check_enable (MMIfaceModemCdma *self)
     /* Create context and keep it as object data */
     mm_dbg ("Periodic CDMA registration checks enabled");
     ctx = g_new0 (RegistrationCheckContext, 1);
-    ctx->timeout_source = g_timeout_add_seconds (REGISTRATION_CHECK_TIMEOUT_SEC,
-                                                 (GSourceFunc)periodic_registration_check,
-                                                 self);
+    ctx->timeout_source = mm_coalesced_timeout_add_seconds (REGISTRATION_CHECK_TIMEOUT_SEC,
+                                                            REGISTRATION_CHECK_SLACK_SEC,
+                                                            (GSourceFunc)periodic_registration_check,
+                                                            self);
     g_object_set_qdata_full (G_OBJECT (self),
                              registration_check_context_quark,
                              ctx,
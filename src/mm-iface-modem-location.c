@@ -20,8 +20,11 @@
 
 #include "mm-iface-modem.h"
 #include "mm-iface-modem-location.h"
+#include "mm-modem-helpers.h"
 #include "mm-log.h"
+#include "mm-property-batch.h"
 
+/* Default minimum time between GPS location updates */
 #define MM_LOCATION_GPS_REFRESH_TIME_SECS 30
 
 #define LOCATION_CONTEXT_TAG "location-context-tag"
@@ -46,6 +49,12 @@ typedef struct {
     MMLocationGpsNmea *location_gps_nmea;
     time_t location_gps_raw_last_time;
     MMLocationGpsRaw *location_gps_raw;
+    /* Position tracking for the distance threshold, independent of which
+     * GPS sources are enabled */
+    MMLocationGpsRaw *location_gps_position;
+    gboolean location_gps_last_position_set;
+    gdouble location_gps_last_latitude;
+    gdouble location_gps_last_longitude;
     /* CDMA BS location */
     MMLocationCdmaBs *location_cdma_bs;
 } LocationContext;
@@ -59,6 +68,8 @@ location_context_free (LocationContext *ctx)
         g_object_unref (ctx->location_gps_nmea);
     if (ctx->location_gps_raw)
         g_object_unref (ctx->location_gps_raw);
+    if (ctx->location_gps_position)
+        g_object_unref (ctx->location_gps_position);
     if (ctx->location_cdma_bs)
         g_object_unref (ctx->location_cdma_bs);
     g_free (ctx);
@@ -207,6 +218,24 @@ build_location_dictionary (GVariant *previous,
     return g_variant_builder_end (&builder);
 }
 
+static void
+set_location_property (MmGdbusModemLocation *skeleton,
+                       GVariant *location)
+{
+    GVariant *previous;
+
+    g_variant_ref_sink (location);
+
+    /* Only actual changes are batched, the skeleton doesn't notify the
+     * others anyway */
+    previous = mm_gdbus_modem_location_get_location (skeleton);
+    if (!previous || !g_variant_equal (previous, location))
+        mm_property_batch_update (skeleton);
+    mm_gdbus_modem_location_set_location (skeleton, location);
+
+    g_variant_unref (location);
+}
+
 /*****************************************************************************/
 
 static void
@@ -223,14 +252,46 @@ notify_gps_location_update (MMIfaceModemLocation *self,
 
     /* We only update the property if we are supposed to signal
      * location */
-    if (mm_gdbus_modem_location_get_signals_location (skeleton))
-        mm_gdbus_modem_location_set_location (
+    if (mm_gdbus_modem_location_get_signals_location (skeleton)) {
+        set_location_property (
             skeleton,
             build_location_dictionary (mm_gdbus_modem_location_get_location (skeleton),
                                        NULL,
                                        location_gps_nmea,
                                        location_gps_raw,
                                        NULL));
+    }
+}
+
+/* Whether the position moved beyond the distance threshold since the last
+ * time the location was reported */
+static gboolean
+gps_position_changed (LocationContext *ctx,
+                      const gchar *nmea_trace,
+                      guint threshold)
+{
+    if (!threshold)
+        return FALSE;
+
+    if (!ctx->location_gps_position)
+        ctx->location_gps_position = mm_location_gps_raw_new ();
+    if (!mm_location_gps_raw_add_trace (ctx->location_gps_position, nmea_trace))
+        return FALSE;
+
+    return mm_gps_distance_threshold_reached (threshold,
+                                              ctx->location_gps_last_position_set,
+                                              ctx->location_gps_last_latitude,
+                                              ctx->location_gps_last_longitude,
+                                              mm_location_gps_raw_get_latitude (ctx->location_gps_position),
+                                              mm_location_gps_raw_get_longitude (ctx->location_gps_position));
+}
+
+static gboolean
+gps_refresh_due (time_t last_time,
+                 time_t now,
+                 guint rate)
+{
+    return (last_time == 0 || now - last_time >= rate);
 }
 
 void
@@ -241,6 +302,9 @@ mm_iface_modem_location_gps_update (MMIfaceModemLocation *self,
     LocationContext *ctx;
     gboolean update_nmea = FALSE;
     gboolean update_raw = FALSE;
+    gboolean position_changed;
+    guint rate;
+    time_t now;
 
     ctx = get_location_context (self);
     g_object_get (self,
@@ -249,12 +313,20 @@ mm_iface_modem_location_gps_update (MMIfaceModemLocation *self,
     if (!skeleton)
         return;
 
+    now = time (NULL);
+    rate = mm_gdbus_modem_location_get_gps_refresh_rate (skeleton);
+
+    /* A significant change in the position skips the rate limit */
+    position_changed = gps_position_changed (ctx,
+                                             nmea_trace,
+                                             mm_gdbus_modem_location_get_gps_distance_threshold (skeleton));
+
     if (mm_gdbus_modem_location_get_enabled (skeleton) & MM_MODEM_LOCATION_SOURCE_GPS_NMEA) {
         g_assert (ctx->location_gps_nmea != NULL);
         if (mm_location_gps_nmea_add_trace (ctx->location_gps_nmea, nmea_trace) &&
-            (ctx->location_gps_nmea_last_time == 0 ||
-             time (NULL) - ctx->location_gps_nmea_last_time >= MM_LOCATION_GPS_REFRESH_TIME_SECS)) {
-            ctx->location_gps_nmea_last_time = time (NULL);
+            (position_changed ||
+             gps_refresh_due (ctx->location_gps_nmea_last_time, now, rate))) {
+            ctx->location_gps_nmea_last_time = now;
             update_nmea = TRUE;
         }
     }
@@ -262,18 +334,28 @@ mm_iface_modem_location_gps_update (MMIfaceModemLocation *self,
     if (mm_gdbus_modem_location_get_enabled (skeleton) & MM_MODEM_LOCATION_SOURCE_GPS_RAW) {
         g_assert (ctx->location_gps_raw != NULL);
         if (mm_location_gps_raw_add_trace (ctx->location_gps_raw, nmea_trace) &&
-            (ctx->location_gps_raw_last_time == 0 ||
-             time (NULL) - ctx->location_gps_raw_last_time >= MM_LOCATION_GPS_REFRESH_TIME_SECS)) {
-            ctx->location_gps_raw_last_time = time (NULL);
+            (position_changed ||
+             gps_refresh_due (ctx->location_gps_raw_last_time, now, rate))) {
+            ctx->location_gps_raw_last_time = now;
             update_raw = TRUE;
         }
     }
 
-    if (update_nmea || update_raw)
+    if (update_nmea || update_raw) {
+        /* Remember the reported position for the distance threshold */
+        if (ctx->location_gps_position &&
+            mm_location_gps_raw_get_latitude (ctx->location_gps_position) != MM_LOCATION_LATITUDE_UNKNOWN &&
+            mm_location_gps_raw_get_longitude (ctx->location_gps_position) != MM_LOCATION_LONGITUDE_UNKNOWN) {
+            ctx->location_gps_last_position_set = TRUE;
+            ctx->location_gps_last_latitude = mm_location_gps_raw_get_latitude (ctx->location_gps_position);
+            ctx->location_gps_last_longitude = mm_location_gps_raw_get_longitude (ctx->location_gps_position);
+        }
+
         notify_gps_location_update (self,
                                     skeleton,
                                     update_nmea ? ctx->location_gps_nmea : NULL,
                                     update_raw ? ctx->location_gps_raw : NULL);
+    }
 
     g_object_unref (skeleton);
 }
@@ -298,13 +380,14 @@ notify_3gpp_location_update (MMIfaceModemLocation *self,
 
     /* We only update the property if we are supposed to signal
      * location */
-    if (mm_gdbus_modem_location_get_signals_location (skeleton))
-        mm_gdbus_modem_location_set_location (
+    if (mm_gdbus_modem_location_get_signals_location (skeleton)) {
+        set_location_property (
             skeleton,
             build_location_dictionary (mm_gdbus_modem_location_get_location (skeleton),
                                        location_3gpp,
                                        NULL, NULL,
                                        NULL));
+    }
 }
 
 void
@@ -413,13 +496,14 @@ notify_cdma_bs_location_update (MMIfaceModemLocation *self,
 
     /* We only update the property if we are supposed to signal
      * location */
-    if (mm_gdbus_modem_location_get_signals_location (skeleton))
-        mm_gdbus_modem_location_set_location (
+    if (mm_gdbus_modem_location_get_signals_location (skeleton)) {
+        set_location_property (
             skeleton,
             build_location_dictionary (mm_gdbus_modem_location_get_location (skeleton),
                                        NULL,
                                        NULL, NULL,
                                        location_cdma_bs));
+    }
 }
 
 void
@@ -1025,6 +1109,159 @@ handle_set_supl_server (MmGdbusModemLocation *skeleton,
 
 /*****************************************************************************/
 
+typedef struct {
+    MmGdbusModemLocation *skeleton;
+    GDBusMethodInvocation *invocation;
+    MMIfaceModemLocation *self;
+    guint rate;
+} HandleSetGpsRefreshRateContext;
+
+static void
+handle_set_gps_refresh_rate_context_free (HandleSetGpsRefreshRateContext *ctx)
+{
+    g_object_unref (ctx->skeleton);
+    g_object_unref (ctx->invocation);
+    g_object_unref (ctx->self);
+    g_slice_free (HandleSetGpsRefreshRateContext, ctx);
+}
+
+static void
+handle_set_gps_refresh_rate_auth_ready (MMBaseModem *self,
+                                        GAsyncResult *res,
+                                        HandleSetGpsRefreshRateContext *ctx)
+{
+    GError *error = NULL;
+
+    if (!mm_base_modem_authorize_finish (self, res, &error)) {
+        g_dbus_method_invocation_take_error (ctx->invocation, error);
+        handle_set_gps_refresh_rate_context_free (ctx);
+        return;
+    }
+
+    /* If GPS is NOT supported, set error */
+    if (!(mm_gdbus_modem_location_get_capabilities (ctx->skeleton) & (MM_MODEM_LOCATION_SOURCE_GPS_RAW |
+                                                                      MM_MODEM_LOCATION_SOURCE_GPS_NMEA))) {
+        g_dbus_method_invocation_return_error (ctx->invocation,
+                                               MM_CORE_ERROR,
+                                               MM_CORE_ERROR_UNSUPPORTED,
+                                               "Cannot set GPS refresh rate: GPS not supported");
+        handle_set_gps_refresh_rate_context_free (ctx);
+        return;
+    }
+
+    /* Applies to the next trace received */
+    mm_dbg ("GPS refresh rate set to %u seconds", ctx->rate);
+    mm_gdbus_modem_location_set_gps_refresh_rate (ctx->skeleton, ctx->rate);
+    mm_gdbus_modem_location_complete_set_gps_refresh_rate (ctx->skeleton, ctx->invocation);
+    handle_set_gps_refresh_rate_context_free (ctx);
+}
+
+static gboolean
+handle_set_gps_refresh_rate (MmGdbusModemLocation *skeleton,
+                             GDBusMethodInvocation *invocation,
+                             guint rate,
+                             MMIfaceModemLocation *self)
+{
+    HandleSetGpsRefreshRateContext *ctx;
+
+    ctx = g_slice_new (HandleSetGpsRefreshRateContext);
+    ctx->skeleton = g_object_ref (skeleton);
+    ctx->invocation = g_object_ref (invocation);
+    ctx->self = g_object_ref (self);
+    ctx->rate = rate;
+
+    mm_base_modem_authorize (MM_BASE_MODEM (self),
+                             invocation,
+                             MM_AUTHORIZATION_DEVICE_CONTROL,
+                             (GAsyncReadyCallback)handle_set_gps_refresh_rate_auth_ready,
+                             ctx);
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+typedef struct {
+    MmGdbusModemLocation *skeleton;
+    GDBusMethodInvocation *invocation;
+    MMIfaceModemLocation *self;
+    guint threshold;
+} HandleSetGpsDistanceThresholdContext;
+
+static void
+handle_set_gps_distance_threshold_context_free (HandleSetGpsDistanceThresholdContext *ctx)
+{
+    g_object_unref (ctx->skeleton);
+    g_object_unref (ctx->invocation);
+    g_object_unref (ctx->self);
+    g_slice_free (HandleSetGpsDistanceThresholdContext, ctx);
+}
+
+static void
+handle_set_gps_distance_threshold_auth_ready (MMBaseModem *self,
+                                              GAsyncResult *res,
+                                              HandleSetGpsDistanceThresholdContext *ctx)
+{
+    GError *error = NULL;
+
+    if (!mm_base_modem_authorize_finish (self, res, &error)) {
+        g_dbus_method_invocation_take_error (ctx->invocation, error);
+        handle_set_gps_distance_threshold_context_free (ctx);
+        return;
+    }
+
+    /* If GPS is NOT supported, set error */
+    if (!(mm_gdbus_modem_location_get_capabilities (ctx->skeleton) & (MM_MODEM_LOCATION_SOURCE_GPS_RAW |
+                                                                      MM_MODEM_LOCATION_SOURCE_GPS_NMEA))) {
+        g_dbus_method_invocation_return_error (ctx->invocation,
+                                               MM_CORE_ERROR,
+                                               MM_CORE_ERROR_UNSUPPORTED,
+                                               "Cannot set GPS distance threshold: GPS not supported");
+        handle_set_gps_distance_threshold_context_free (ctx);
+        return;
+    }
+
+    /* Start tracking from the next reported position */
+    if (!ctx->threshold) {
+        LocationContext *location_ctx;
+
+        location_ctx = get_location_context (ctx->self);
+        if (location_ctx->location_gps_position) {
+            g_object_unref (location_ctx->location_gps_position);
+            location_ctx->location_gps_position = NULL;
+        }
+        location_ctx->location_gps_last_position_set = FALSE;
+    }
+
+    mm_dbg ("GPS distance threshold set to %u meters", ctx->threshold);
+    mm_gdbus_modem_location_set_gps_distance_threshold (ctx->skeleton, ctx->threshold);
+    mm_gdbus_modem_location_complete_set_gps_distance_threshold (ctx->skeleton, ctx->invocation);
+    handle_set_gps_distance_threshold_context_free (ctx);
+}
+
+static gboolean
+handle_set_gps_distance_threshold (MmGdbusModemLocation *skeleton,
+                                   GDBusMethodInvocation *invocation,
+                                   guint threshold,
+                                   MMIfaceModemLocation *self)
+{
+    HandleSetGpsDistanceThresholdContext *ctx;
+
+    ctx = g_slice_new (HandleSetGpsDistanceThresholdContext);
+    ctx->skeleton = g_object_ref (skeleton);
+    ctx->invocation = g_object_ref (invocation);
+    ctx->self = g_object_ref (self);
+    ctx->threshold = threshold;
+
+    mm_base_modem_authorize (MM_BASE_MODEM (self),
+                             invocation,
+                             MM_AUTHORIZATION_DEVICE_CONTROL,
+                             (GAsyncReadyCallback)handle_set_gps_distance_threshold_auth_ready,
+                             ctx);
+    return TRUE;
+}
+
+/*****************************************************************************/
+
 typedef struct {
     MmGdbusModemLocation *skeleton;
     GDBusMethodInvocation *invocation;
@@ -1509,6 +1746,14 @@ interface_initialization_step (InitializationContext *ctx)
                           "handle-set-supl-server",
                           G_CALLBACK (handle_set_supl_server),
                           ctx->self);
+        g_signal_connect (ctx->skeleton,
+                          "handle-set-gps-refresh-rate",
+                          G_CALLBACK (handle_set_gps_refresh_rate),
+                          ctx->self);
+        g_signal_connect (ctx->skeleton,
+                          "handle-set-gps-distance-threshold",
+                          G_CALLBACK (handle_set_gps_distance_threshold),
+                          ctx->self);
         g_signal_connect (ctx->skeleton,
                           "handle-get-location",
                           G_CALLBACK (handle_get_location),
@@ -1554,6 +1799,8 @@ mm_iface_modem_location_initialize (MMIfaceModemLocation *self,
         mm_gdbus_modem_location_set_capabilities (skeleton, MM_MODEM_LOCATION_SOURCE_NONE);
         mm_gdbus_modem_location_set_enabled (skeleton, MM_MODEM_LOCATION_SOURCE_NONE);
         mm_gdbus_modem_location_set_signals_location (skeleton, FALSE);
+        mm_gdbus_modem_location_set_gps_refresh_rate (skeleton, MM_LOCATION_GPS_REFRESH_TIME_SECS);
+        mm_gdbus_modem_location_set_gps_distance_threshold (skeleton, 0);
         mm_gdbus_modem_location_set_location (skeleton,
                                               build_location_dictionary (NULL, NULL, NULL, NULL, NULL));
 
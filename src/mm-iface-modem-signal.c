@@ -20,11 +20,15 @@
 #include "mm-iface-modem.h"
 #include "mm-iface-modem-signal.h"
 #include "mm-log.h"
+#include "mm-coalesced-timeout.h"
 
 #define SUPPORT_CHECKED_TAG "signal-support-checked-tag"
 #define SUPPORTED_TAG       "signal-supported-tag"
 #define REFRESH_CONTEXT_TAG "signal-refresh-context-tag"
 
+/* Refreshes may run up to a quarter of the requested rate early */
+#define REFRESH_SLACK(rate) ((rate) / 4)
+
 static GQuark support_checked_quark;
 static GQuark supported_quark;
 static GQuark refresh_context_quark;
@@ -48,7 +52,7 @@ static void
 refresh_context_free (RefreshContext *ctx)
 {
     if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+        mm_coalesced_timeout_remove (ctx->timeout_source);
     g_slice_free (RefreshContext, ctx);
 }
 
@@ -234,8 +238,11 @@ setup_refresh_context (MMIfaceModemSignal *self,
     mm_dbg ("Extended signal information reporting enabled (rate: %u seconds)", new_rate);
     ctx->rate = new_rate;
     if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
-    ctx->timeout_source = g_timeout_add_seconds (ctx->rate, (GSourceFunc) refresh_context_cb, self);
+        mm_coalesced_timeout_remove (ctx->timeout_source);
+    ctx->timeout_source = mm_coalesced_timeout_add_seconds (ctx->rate,
+                                                            REFRESH_SLACK (ctx->rate),
+                                                            (GSourceFunc) refresh_context_cb,
+                                                            self);
 
     /* Also launch right away */
     refresh_context_cb (self);
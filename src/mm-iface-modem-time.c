@@ -20,6 +20,7 @@
 #include "mm-iface-modem.h"
 #include "mm-iface-modem-time.h"
 #include "mm-log.h"
+#include "mm-coalesced-timeout.h"
 
 #define SUPPORT_CHECKED_TAG              "time-support-checked-tag"
 #define SUPPORTED_TAG                    "time-supported-tag"
@@ -30,6 +31,7 @@ static GQuark supported_quark;
 static GQuark network_timezone_cancellable_quark;
 
 #define TIMEZONE_POLL_INTERVAL_SEC 5
+#define TIMEZONE_POLL_SLACK_SEC    2
 #define TIMEZONE_POLL_RETRIES 6
 
 /*****************************************************************************/
@@ -165,7 +167,7 @@ cancelled (GCancellable *cancellable,
 
     /* If waiting in the timeout loop, remove the timeout */
     else if (ctx->network_timezone_poll_id)
-        g_source_remove (ctx->network_timezone_poll_id);
+        mm_coalesced_timeout_remove (ctx->network_timezone_poll_id);
 
     g_simple_async_result_set_error (ctx->result,
                                      MM_CORE_ERROR,
@@ -237,9 +239,10 @@ load_network_timezone_ready (MMIfaceModemTime *self,
                                                    G_CALLBACK (cancelled),
                                                    ctx,
                                                    NULL);
-        ctx->network_timezone_poll_id = g_timeout_add_seconds (TIMEZONE_POLL_INTERVAL_SEC,
-                                                               (GSourceFunc)timezone_poll_cb,
-                                                               ctx);
+        ctx->network_timezone_poll_id = mm_coalesced_timeout_add_seconds (TIMEZONE_POLL_INTERVAL_SEC,
+                                                                          TIMEZONE_POLL_SLACK_SEC,
+                                                                          (GSourceFunc)timezone_poll_cb,
+                                                                          ctx);
 
         g_error_free (error);
         return;
@@ -279,9 +282,10 @@ start_timezone_poll (UpdateNetworkTimezoneContext *ctx)
     /* Setup loop to query current timezone, don't do it right away.
      * Note that we're passing the context reference to the loop. */
     ctx->network_timezone_poll_retries = TIMEZONE_POLL_RETRIES;
-    ctx->network_timezone_poll_id = g_timeout_add_seconds (TIMEZONE_POLL_INTERVAL_SEC,
-                                                           (GSourceFunc)timezone_poll_cb,
-                                                           ctx);
+    ctx->network_timezone_poll_id = mm_coalesced_timeout_add_seconds (TIMEZONE_POLL_INTERVAL_SEC,
+                                                                      TIMEZONE_POLL_SLACK_SEC,
+                                                                      (GSourceFunc)timezone_poll_cb,
+                                                                      ctx);
 }
 
 static void
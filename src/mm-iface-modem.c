@@ -26,11 +26,15 @@
 #include "mm-bearer-list.h"
 #include "mm-log.h"
 #include "mm-context.h"
+#include "mm-coalesced-timeout.h"
+#include "mm-property-batch.h"
 
-#define SIGNAL_QUALITY_RECENT_TIMEOUT_SEC        60
 #define SIGNAL_QUALITY_INITIAL_CHECK_TIMEOUT_SEC 3
 #define SIGNAL_QUALITY_CHECK_TIMEOUT_SEC         30
+#define SIGNAL_QUALITY_STABLE_DELTA              5
+#define SIGNAL_QUALITY_CHECK_SLACK(interval)     ((interval) / 4)
 #define ACCESS_TECHNOLOGIES_CHECK_TIMEOUT_SEC    30
+#define ACCESS_TECHNOLOGIES_CHECK_SLACK_SEC      10
 
 #define STATE_UPDATE_CONTEXT_TAG              "state-update-context-tag"
 #define SIGNAL_QUALITY_UPDATE_CONTEXT_TAG     "signal-quality-update-context-tag"
@@ -370,6 +374,7 @@ bearer_list_updated (MMBearerList *bearer_list,
     mm_gdbus_modem_set_bearers (skeleton, (const gchar *const *)paths);
     g_strfreev (paths);
 
+    mm_property_batch_flush (skeleton);
     g_dbus_interface_skeleton_flush (G_DBUS_INTERFACE_SKELETON (skeleton));
 }
 
@@ -883,6 +888,7 @@ mm_iface_modem_update_access_technologies (MMIfaceModem *self,
         gchar *old_access_tech_string;
         gchar *new_access_tech_string;
 
+        mm_property_batch_update (skeleton);
         mm_gdbus_modem_set_access_technologies (skeleton, built_access_tech);
 
         /* Log */
@@ -910,7 +916,7 @@ static void
 access_technologies_check_context_free (AccessTechnologiesCheckContext *ctx)
 {
     if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+        mm_coalesced_timeout_remove (ctx->timeout_source);
     g_free (ctx);
 }
 
@@ -979,10 +985,11 @@ mm_iface_modem_refresh_access_technologies (MMIfaceModem *self)
 
     /* Re-set timeout */
     if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
-    ctx->timeout_source = g_timeout_add_seconds (ACCESS_TECHNOLOGIES_CHECK_TIMEOUT_SEC,
-                                                 (GSourceFunc)periodic_access_technologies_check,
-                                                 self);
+        mm_coalesced_timeout_remove (ctx->timeout_source);
+    ctx->timeout_source = mm_coalesced_timeout_add_seconds (ACCESS_TECHNOLOGIES_CHECK_TIMEOUT_SEC,
+                                                            ACCESS_TECHNOLOGIES_CHECK_SLACK_SEC,
+                                                            (GSourceFunc)periodic_access_technologies_check,
+                                                            self);
 
     /* Get first access technology value */
     periodic_access_technologies_check (self);
@@ -1098,7 +1105,7 @@ expire_signal_quality (MMIfaceModem *self)
         if (recent) {
             mm_dbg ("Signal quality value not updated in %us, "
                     "marking as not being recent",
-                    SIGNAL_QUALITY_RECENT_TIMEOUT_SEC);
+                    MM_SIGNAL_QUALITY_RECENT_TIMEOUT_SEC);
             mm_gdbus_modem_set_signal_quality (skeleton,
                                                g_variant_new ("(ub)",
                                                               signal_quality,
@@ -1121,6 +1128,8 @@ update_signal_quality (MMIfaceModem *self,
 {
     SignalQualityUpdateContext *ctx;
     MmGdbusModem *skeleton = NULL;
+    GVariant *old_signal_quality;
+    GVariant *new_signal_quality;
     const gchar *dbus_path;
 
     g_object_get (self,
@@ -1154,10 +1163,14 @@ update_signal_quality (MMIfaceModem *self,
      * The only exception being if 'expire' is FALSE; in that case we assume
      * the value won't expire and therefore can be considered obsolete
      * already. */
-    mm_gdbus_modem_set_signal_quality (skeleton,
-                                       g_variant_new ("(ub)",
-                                                      signal_quality,
-                                                      expire));
+    new_signal_quality = g_variant_ref_sink (g_variant_new ("(ub)", signal_quality, expire));
+    old_signal_quality = mm_gdbus_modem_get_signal_quality (skeleton);
+    /* Only actual changes are batched, the skeleton doesn't notify the
+     * others anyway */
+    if (!old_signal_quality || !g_variant_equal (old_signal_quality, new_signal_quality))
+        mm_property_batch_update (skeleton);
+    mm_gdbus_modem_set_signal_quality (skeleton, new_signal_quality);
+    g_variant_unref (new_signal_quality);
 
     dbus_path = g_dbus_object_get_object_path (G_DBUS_OBJECT (self));
     mm_dbg ("Modem %s: signal quality updated (%u)",
@@ -1173,38 +1186,86 @@ update_signal_quality (MMIfaceModem *self,
     /* If we got a new expirable value, setup new timeout */
     if (expire)
         ctx->recent_timeout_source = (g_timeout_add_seconds (
-                                          SIGNAL_QUALITY_RECENT_TIMEOUT_SEC,
+                                          MM_SIGNAL_QUALITY_RECENT_TIMEOUT_SEC,
                                           (GSourceFunc)expire_signal_quality,
                                           self));
 
     g_object_unref (skeleton);
 }
 
-void
-mm_iface_modem_update_signal_quality (MMIfaceModem *self,
-                                      guint signal_quality)
-{
-    update_signal_quality (self, signal_quality, TRUE);
-}
-
 /*****************************************************************************/
 
+/* Signal quality is polled with an interval that adapts to how it behaves
+ * (see mm_signal_quality_check_next_interval()):
+ *  - polls are skipped, and the interval doubled, while unsolicited updates
+ *    keep arriving;
+ *  - the interval is doubled while the polled value stays stable;
+ *  - the interval is halved when the polled value changes.
+ * The interval never goes above MM_SIGNAL_QUALITY_RECENT_TIMEOUT_SEC, as
+ * indications like +CIEV are only sent on changes and the value would
+ * otherwise expire while the signal is stable.
+ */
+
 typedef struct {
     guint interval;
     guint initial_retries;
     guint timeout_source;
     gboolean running;
+    /* Adaptive scheduling */
+    time_t last_indication;
+    time_t last_check;
+    gboolean last_polled_set;
+    guint last_polled;
+    guint n_polls;
+    guint n_skipped;
 } SignalQualityCheckContext;
 
 static void
 signal_quality_check_context_free (SignalQualityCheckContext *ctx)
 {
     if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+        mm_coalesced_timeout_remove (ctx->timeout_source);
     g_free (ctx);
 }
 
-static gboolean periodic_signal_quality_check (MMIfaceModem *self);
+static gboolean signal_quality_check_timeout (MMIfaceModem *self);
+
+static void
+signal_quality_check_reschedule (MMIfaceModem *self,
+                                 SignalQualityCheckContext *ctx,
+                                 guint interval)
+{
+    if (interval == ctx->interval)
+        return;
+
+    ctx->interval = interval;
+    mm_dbg ("Periodic signal quality checks rescheduled (interval = %ds)",
+            ctx->interval);
+
+    if (ctx->timeout_source) {
+        mm_coalesced_timeout_remove (ctx->timeout_source);
+        ctx->timeout_source = mm_coalesced_timeout_add_seconds (ctx->interval,
+                                                                SIGNAL_QUALITY_CHECK_SLACK (ctx->interval),
+                                                                (GSourceFunc)signal_quality_check_timeout,
+                                                                self);
+    }
+}
+
+void
+mm_iface_modem_update_signal_quality (MMIfaceModem *self,
+                                      guint signal_quality)
+{
+    SignalQualityCheckContext *ctx;
+
+    update_signal_quality (self, signal_quality, TRUE);
+
+    /* Unsolicited updates make periodic polling unnecessary */
+    if (G_LIKELY (signal_quality_check_context_quark)) {
+        ctx = g_object_get_qdata (G_OBJECT (self), signal_quality_check_context_quark);
+        if (ctx)
+            ctx->last_indication = time (NULL);
+    }
+}
 
 static void
 signal_quality_check_ready (MMIfaceModem *self,
@@ -1227,40 +1288,78 @@ signal_quality_check_ready (MMIfaceModem *self,
      * mm_iface_modem_shutdown when this function is invoked as a callback of
      * load_signal_quality. */
     ctx = g_object_get_qdata (G_OBJECT (self), signal_quality_check_context_quark);
-    if (ctx) {
-        if (ctx->interval == SIGNAL_QUALITY_INITIAL_CHECK_TIMEOUT_SEC &&
-            (signal_quality != 0 || --ctx->initial_retries == 0)) {
-            ctx->interval = SIGNAL_QUALITY_CHECK_TIMEOUT_SEC;
-            if (ctx->timeout_source) {
-                mm_dbg ("Periodic signal quality checks rescheduled (interval = %ds)", ctx->interval);
-                g_source_remove(ctx->timeout_source);
-                ctx->timeout_source = g_timeout_add_seconds (ctx->interval,
-                                                             (GSourceFunc)periodic_signal_quality_check,
-                                                             self);
-            }
-        }
-        ctx->running = FALSE;
+    if (!ctx)
+        return;
+
+    ctx->running = FALSE;
+
+    if (ctx->interval == SIGNAL_QUALITY_INITIAL_CHECK_TIMEOUT_SEC) {
+        if (signal_quality != 0 || --ctx->initial_retries == 0)
+            signal_quality_check_reschedule (self, ctx, SIGNAL_QUALITY_CHECK_TIMEOUT_SEC);
+    } else if (!error) {
+        MMSignalQualityCheckResult result;
+
+        if (ctx->last_polled_set &&
+            ABS ((gint)signal_quality - (gint)ctx->last_polled) <= SIGNAL_QUALITY_STABLE_DELTA)
+            result = MM_SIGNAL_QUALITY_CHECK_STABLE;
+        else
+            result = MM_SIGNAL_QUALITY_CHECK_CHANGED;
+        signal_quality_check_reschedule (self, ctx,
+                                         mm_signal_quality_check_next_interval (ctx->interval, result));
+    }
+
+    if (!error) {
+        ctx->last_polled = signal_quality;
+        ctx->last_polled_set = TRUE;
     }
 }
 
-static gboolean
+static void
 periodic_signal_quality_check (MMIfaceModem *self)
 {
     SignalQualityCheckContext *ctx;
+    time_t now;
 
     ctx = g_object_get_qdata (G_OBJECT (self), signal_quality_check_context_quark);
+    now = time (NULL);
+
+    /* If the modem reported signal quality by itself since the last check,
+     * skip polling and check less often */
+    if (ctx->interval != SIGNAL_QUALITY_INITIAL_CHECK_TIMEOUT_SEC &&
+        ctx->last_indication &&
+        ctx->last_indication >= ctx->last_check) {
+        ctx->last_check = now;
+        ctx->n_skipped++;
+        mm_dbg ("Signal quality poll skipped, unsolicited update received "
+                "(%u polls, %u skipped)",
+                ctx->n_polls, ctx->n_skipped);
+        signal_quality_check_reschedule (self, ctx,
+                                         mm_signal_quality_check_next_interval (ctx->interval,
+                                                                                MM_SIGNAL_QUALITY_CHECK_INDICATION));
+        return;
+    }
+    ctx->last_check = now;
 
     /* Only launch a new one if not one running already OR if the last one run
-     * was more than 15s ago. */
+     * was more than half an interval ago. */
     if (!ctx->running ||
-        (time (NULL) - get_last_signal_quality_update_time (self) > (ctx->interval / 2))) {
+        (now - get_last_signal_quality_update_time (self) > (ctx->interval / 2))) {
         ctx->running = TRUE;
+        ctx->n_polls++;
+        mm_dbg ("Polling signal quality (interval = %ds, %u polls, %u skipped)",
+                ctx->interval, ctx->n_polls, ctx->n_skipped);
         MM_IFACE_MODEM_GET_INTERFACE (self)->load_signal_quality (
             self,
             (GAsyncReadyCallback)signal_quality_check_ready,
             NULL);
     }
+}
 
+static gboolean
+signal_quality_check_timeout (MMIfaceModem *self)
+{
+    /* May get rescheduled with a different interval in the check */
+    periodic_signal_quality_check (self);
     return TRUE;
 }
 
@@ -1314,9 +1413,10 @@ periodic_signal_quality_check_enable (MMIfaceModem *self)
     ctx->interval = SIGNAL_QUALITY_INITIAL_CHECK_TIMEOUT_SEC;
     ctx->initial_retries = 5;
     mm_dbg ("Periodic signal quality checks enabled (interval = %ds)", ctx->interval);
-    ctx->timeout_source = g_timeout_add_seconds (ctx->interval,
-                                                 (GSourceFunc)periodic_signal_quality_check,
-                                                 self);
+    ctx->timeout_source = mm_coalesced_timeout_add_seconds (ctx->interval,
+                                                            SIGNAL_QUALITY_CHECK_SLACK (ctx->interval),
+                                                            (GSourceFunc)signal_quality_check_timeout,
+                                                            self);
     g_object_set_qdata_full (G_OBJECT (self),
                              signal_quality_check_context_quark,
                              ctx,
@@ -1405,7 +1505,9 @@ __iface_modem_update_state_internal (MMIfaceModem *self,
 
             /* Flush current change before signaling the state change,
              * so that clients get the proper state already in the
-             * state-changed callback */
+             * state-changed callback; this includes any change held
+             * back in a property batch */
+            mm_property_batch_flush (skeleton);
             g_dbus_interface_skeleton_flush (G_DBUS_INTERFACE_SKELETON (skeleton));
             mm_gdbus_modem_emit_state_changed (skeleton,
                                                old_state,
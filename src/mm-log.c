@@ -49,6 +49,27 @@ static GTimeVal rel_start = { 0, 0 };
 static int logfd = -1;
 static gboolean func_loc = FALSE;
 
+/* Log file flush policies */
+enum {
+    FLUSH_MODE_ALWAYS = 0,  /* Synchronous write and fsync() on every line */
+    FLUSH_MODE_WARN,        /* Buffered, fsync() as soon as a WARN/ERR line is logged */
+    FLUSH_MODE_SHUTDOWN     /* Buffered, fsync() only on shutdown */
+};
+
+typedef struct {
+    guint mode;
+    const char *name;
+} FlushDesc;
+
+static const FlushDesc flush_descs[] = {
+    { FLUSH_MODE_ALWAYS,   "ALWAYS" },
+    { FLUSH_MODE_WARN,     "WARN" },
+    { FLUSH_MODE_SHUTDOWN, "SHUTDOWN" },
+    { 0, NULL }
+};
+
+static guint flush_mode = FLUSH_MODE_WARN;
+
 typedef struct {
     guint32 num;
     const char *name;
@@ -65,6 +86,167 @@ static const LogDesc level_descs[] = {
 static GString *msgbuf = NULL;
 static volatile gsize msgbuf_once = 0;
 
+/*****************************************************************************/
+/* Buffered log file writer
+ *
+ * Unless the ALWAYS flush mode is requested, lines logged to a file are
+ * queued in memory and written by a separate thread, either once enough data
+ * is pending or periodically, so that logging never blocks on disk I/O. The
+ * queue is bounded: if the writer can't keep up, loggers wait for it instead
+ * of dropping lines.
+ */
+
+/* Pending data which wakes up the writer right away */
+#define WRITER_FLUSH_SIZE      (16 * 1024)
+/* Pending data after which loggers wait for the writer */
+#define WRITER_QUEUE_MAX_SIZE  (1024 * 1024)
+/* Maximum time data stays in the queue */
+#define WRITER_FLUSH_TIMEOUT_MS 500
+
+static GMutex   writer_mutex;
+static GCond    writer_cond;
+static GThread *writer_thread;
+static GString *writer_queue;
+static GString *writer_spare;
+static gboolean writer_writing;
+static gboolean writer_sync;
+static gboolean writer_quit;
+
+static void
+write_all (const char *data,
+           gsize len)
+{
+    while (len > 0) {
+        ssize_t written;
+
+        written = write (logfd, data, len);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            /* whatever; nothing else we can do */
+            return;
+        }
+        data += written;
+        len -= written;
+    }
+}
+
+static gpointer
+writer_thread_func (gpointer user_data)
+{
+    g_mutex_lock (&writer_mutex);
+    while (TRUE) {
+        GString *pending;
+        gboolean sync;
+
+        if (!writer_queue->len && writer_quit)
+            break;
+
+        if (writer_queue->len < WRITER_FLUSH_SIZE && !writer_sync && !writer_quit) {
+            gint64 end_time;
+
+            end_time = g_get_monotonic_time () + WRITER_FLUSH_TIMEOUT_MS * G_TIME_SPAN_MILLISECOND;
+            while (writer_queue->len < WRITER_FLUSH_SIZE && !writer_sync && !writer_quit) {
+                if (!g_cond_wait_until (&writer_cond, &writer_mutex, end_time))
+                    break;
+            }
+        }
+
+        if (!writer_queue->len && !writer_sync)
+            continue;
+
+        /* Swap buffers so that loggers can keep on queueing while we write */
+        pending = writer_queue;
+        writer_queue = writer_spare;
+        writer_spare = pending;
+        sync = writer_sync;
+        writer_sync = FALSE;
+        writer_writing = TRUE;
+        g_cond_broadcast (&writer_cond);
+        g_mutex_unlock (&writer_mutex);
+
+        write_all (pending->str, pending->len);
+        if (sync)
+            fsync (logfd);
+        g_string_truncate (pending, 0);
+
+        g_mutex_lock (&writer_mutex);
+        writer_writing = FALSE;
+        g_cond_broadcast (&writer_cond);
+    }
+    g_mutex_unlock (&writer_mutex);
+
+    fsync (logfd);
+    return NULL;
+}
+
+static void
+log_file_write (const char *data,
+                gsize len,
+                gboolean sync)
+{
+    if (!writer_thread) {
+        write_all (data, len);
+        if (sync)
+            fsync (logfd);
+        return;
+    }
+
+    g_mutex_lock (&writer_mutex);
+    while (writer_queue->len + len > WRITER_QUEUE_MAX_SIZE && writer_queue->len > 0)
+        g_cond_wait (&writer_cond, &writer_mutex);
+    g_string_append_len (writer_queue, data, len);
+    if (sync)
+        writer_sync = TRUE;
+    if (sync || writer_queue->len >= WRITER_FLUSH_SIZE)
+        g_cond_broadcast (&writer_cond);
+    g_mutex_unlock (&writer_mutex);
+}
+
+/* Block until everything queued so far is on disk */
+static void
+log_file_flush (void)
+{
+    if (!writer_thread) {
+        fsync (logfd);
+        return;
+    }
+
+    g_mutex_lock (&writer_mutex);
+    writer_sync = TRUE;
+    g_cond_broadcast (&writer_cond);
+    while (writer_sync || writer_writing || writer_queue->len > 0)
+        g_cond_wait (&writer_cond, &writer_mutex);
+    g_mutex_unlock (&writer_mutex);
+}
+
+static void
+writer_start (void)
+{
+    writer_queue = g_string_sized_new (WRITER_FLUSH_SIZE * 2);
+    writer_spare = g_string_sized_new (WRITER_FLUSH_SIZE * 2);
+    writer_thread = g_thread_new ("mm-log-writer", writer_thread_func, NULL);
+}
+
+static void
+writer_stop (void)
+{
+    g_mutex_lock (&writer_mutex);
+    writer_quit = TRUE;
+    g_cond_broadcast (&writer_cond);
+    g_mutex_unlock (&writer_mutex);
+
+    g_thread_join (writer_thread);
+    writer_thread = NULL;
+
+    g_string_free (writer_queue, TRUE);
+    writer_queue = NULL;
+    g_string_free (writer_spare, TRUE);
+    writer_spare = NULL;
+}
+
+/*****************************************************************************/
+
 void
 _mm_log (const char *loc,
          const char *func,
@@ -75,7 +257,6 @@ _mm_log (const char *loc,
     va_list args;
     GTimeVal tv;
     int syslog_priority = LOG_INFO;
-    ssize_t ign;
 
     if (!(log_level & level))
         return;
@@ -128,12 +309,11 @@ _mm_log (const char *loc,
 
     if (logfd < 0)
         syslog (syslog_priority, "%s", msgbuf->str);
-    else {
-        ign = write (logfd, msgbuf->str, msgbuf->len);
-        if (ign) {} /* whatever; really shut up about unused result */
-
-        fsync (logfd);  /* Make sure output is dumped to disk immediately */
-    }
+    else
+        log_file_write (msgbuf->str,
+                        msgbuf->len,
+                        (flush_mode == FLUSH_MODE_ALWAYS ||
+                         (flush_mode == FLUSH_MODE_WARN && (level & (LOGL_WARN | LOGL_ERR)))));
 }
 
 static void
@@ -143,9 +323,8 @@ log_handler (const gchar *log_domain,
              gpointer ignored)
 {
     int syslog_priority;
-    ssize_t ign;
 
-    switch (level) {
+    switch (level & G_LOG_LEVEL_MASK) {
     case G_LOG_LEVEL_ERROR:
         syslog_priority = LOG_CRIT;
         break;
@@ -170,8 +349,13 @@ log_handler (const gchar *log_domain,
     if (logfd < 0)
         syslog (syslog_priority, "%s", message);
     else {
-        ign = write (logfd, message, strlen (message));
-        if (ign) {} /* whatever; really shut up about unused result */
+        log_file_write (message,
+                        strlen (message),
+                        (flush_mode != FLUSH_MODE_SHUTDOWN &&
+                         syslog_priority <= LOG_WARNING));
+        /* We're about to abort, make sure the message reaches the disk */
+        if (level & G_LOG_FLAG_FATAL)
+            log_file_flush ();
     }
 }
 
@@ -204,9 +388,27 @@ mm_log_set_level (const char *level, GError **error)
     return found;
 }
 
+static gboolean
+log_set_flush_mode (const char *mode, GError **error)
+{
+    const FlushDesc *diter;
+
+    for (diter = &flush_descs[0]; diter->name; diter++) {
+        if (!strcasecmp (diter->name, mode)) {
+            flush_mode = diter->mode;
+            return TRUE;
+        }
+    }
+
+    g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_INVALID_ARGS,
+                 "Unknown log flush mode '%s'", mode);
+    return FALSE;
+}
+
 gboolean
 mm_log_setup (const char *level,
               const char *log_file,
+              const char *log_flush,
               gboolean show_timestamps,
               gboolean rel_timestamps,
               gboolean debug_func_loc,
@@ -216,6 +418,10 @@ mm_log_setup (const char *level,
     if (level && strlen (level) && !mm_log_set_level (level, error))
         return FALSE;
 
+    /* flush mode */
+    if (log_flush && strlen (log_flush) && !log_set_flush_mode (log_flush, error))
+        return FALSE;
+
     func_loc = debug_func_loc;
 
     if (show_timestamps)
@@ -238,6 +444,9 @@ mm_log_setup (const char *level,
                          errno, strerror (errno));
             return FALSE;
         }
+
+        if (flush_mode != FLUSH_MODE_ALWAYS)
+            writer_start ();
     }
 
     g_log_set_handler (G_LOG_DOMAIN,
@@ -267,6 +476,11 @@ mm_log_shutdown (void)
 {
     if (logfd < 0)
         closelog ();
-    else
+    else {
+        if (writer_thread)
+            writer_stop ();
+        else
+            fsync (logfd);
         close (logfd);
+    }
 }
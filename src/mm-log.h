@@ -51,6 +51,7 @@ gboolean mm_log_set_level (const char *level, GError **error);
 
 gboolean mm_log_setup (const char *level,
                        const char *log_file,
+                       const char *log_flush,
                        gboolean show_ts,
                        gboolean rel_ts,
                        gboolean debug_func_loc,
@@ -22,6 +22,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <math.h>
 #include <arpa/inet.h>
 
 #include <ModemManager.h>
@@ -80,6 +81,83 @@ mm_count_bits_set (gulong number)
 
 /*****************************************************************************/
 
+GRegex *
+mm_regex_get (MMRegex *self)
+{
+    if (g_once_init_enter (&self->regex)) {
+        GError *error = NULL;
+        GRegex *regex;
+
+        regex = g_regex_new (self->pattern, self->compile_options, self->match_options, &error);
+        /* Patterns are built in, so this is a programming error */
+        if (!regex)
+            g_error ("Invalid regular expression '%s': %s", self->pattern, error->message);
+        g_once_init_leave (&self->regex, (gsize) regex);
+    }
+
+    return g_regex_ref ((GRegex *) self->regex);
+}
+
+/*****************************************************************************/
+
+gchar **
+mm_split_chained_response (const gchar *response,
+                           const gchar * const *commands,
+                           guint n_commands)
+{
+    GString **responses;
+    gchar **lines;
+    gchar **split;
+    gint current = -1;
+    guint i;
+    guint j;
+
+    responses = g_new (GString *, n_commands);
+    for (i = 0; i < n_commands; i++)
+        responses[i] = g_string_new ("");
+
+    lines = g_strsplit (response, "\n", -1);
+    for (i = 0; lines[i]; i++) {
+        const gchar *line;
+
+        line = g_strstrip (lines[i]);
+        if (!line[0])
+            continue;
+
+        /* e.g. "+CREG?" replies with "+CREG: ..." */
+        for (j = 0; j < n_commands; j++) {
+            const gchar *command = commands[j];
+            gsize len;
+
+            if (!g_ascii_strncasecmp (command, "AT", 2))
+                command += 2;
+            len = strcspn (command, "?=");
+            if (!g_ascii_strncasecmp (line, command, len) && line[len] == ':') {
+                current = j;
+                break;
+            }
+        }
+
+        /* Lines without prefix continue the previous response */
+        if (current < 0)
+            continue;
+
+        if (responses[current]->len)
+            g_string_append (responses[current], "\r\n");
+        g_string_append (responses[current], line);
+    }
+    g_strfreev (lines);
+
+    split = g_new0 (gchar *, n_commands + 1);
+    for (i = 0; i < n_commands; i++)
+        split[i] = g_string_free (responses[i], FALSE);
+    g_free (responses);
+
+    return split;
+}
+
+/*****************************************************************************/
+
 gchar *
 mm_create_device_identifier (guint vid,
                              guint pid,
@@ -323,6 +401,199 @@ mm_filter_supported_capabilities (MMModemCapability all,
 
 /*****************************************************************************/
 
+G_STATIC_ASSERT (MM_SIGNAL_QUALITY_CHECK_MAX_INTERVAL_SEC < MM_SIGNAL_QUALITY_RECENT_TIMEOUT_SEC);
+
+guint
+mm_signal_quality_check_next_interval (guint interval,
+                                       MMSignalQualityCheckResult result)
+{
+    switch (result) {
+    case MM_SIGNAL_QUALITY_CHECK_INDICATION:
+    case MM_SIGNAL_QUALITY_CHECK_STABLE:
+        /* Check less often, but often enough so that the value doesn't expire
+         * if the modem stops reporting it because it doesn't change */
+        return MIN (interval * 2, MM_SIGNAL_QUALITY_CHECK_MAX_INTERVAL_SEC);
+    case MM_SIGNAL_QUALITY_CHECK_CHANGED:
+        return MAX (MIN (interval, MM_SIGNAL_QUALITY_CHECK_MAX_INTERVAL_SEC) / 2,
+                    MM_SIGNAL_QUALITY_CHECK_MIN_INTERVAL_SEC);
+    }
+
+    g_assert_not_reached ();
+    return interval;
+}
+
+/*****************************************************************************/
+
+#define EARTH_RADIUS_METERS 6371008.8
+
+gdouble
+mm_gps_distance (gdouble latitude1,
+                 gdouble longitude1,
+                 gdouble latitude2,
+                 gdouble longitude2)
+{
+    gdouble dlat;
+    gdouble dlon;
+    gdouble a;
+
+    /* Haversine formula */
+    latitude1 *= G_PI / 180.0;
+    latitude2 *= G_PI / 180.0;
+    dlat = latitude2 - latitude1;
+    dlon = (longitude2 - longitude1) * G_PI / 180.0;
+
+    a = sin (dlat / 2) * sin (dlat / 2) +
+        cos (latitude1) * cos (latitude2) * sin (dlon / 2) * sin (dlon / 2);
+    return 2 * EARTH_RADIUS_METERS * asin (MIN (1.0, sqrt (a)));
+}
+
+gboolean
+mm_gps_distance_threshold_reached (guint threshold,
+                                   gboolean last_set,
+                                   gdouble last_latitude,
+                                   gdouble last_longitude,
+                                   gdouble latitude,
+                                   gdouble longitude)
+{
+    if (!threshold)
+        return FALSE;
+
+    if (latitude == MM_LOCATION_LATITUDE_UNKNOWN ||
+        longitude == MM_LOCATION_LONGITUDE_UNKNOWN)
+        return FALSE;
+
+    /* First known position */
+    if (!last_set)
+        return TRUE;
+
+    return (mm_gps_distance (last_latitude, last_longitude, latitude, longitude) >= threshold);
+}
+
+/*****************************************************************************/
+
+#define SYSFS_NET_CLASS_PATH "/sys/class/net"
+
+/* Network drivers preferred for data connections: those which can aggregate
+ * frames or skip the ethernet emulation come before the plain ethernet ones.
+ * Unknown drivers go last. */
+static const gchar *net_driver_preference[] = {
+    "qmi_wwan",
+    "cdc_mbim",
+    "huawei_cdc_ncm",
+    "cdc_ncm",
+    "cdc_ether",
+    "sierra_net",
+    "rndis_host",
+};
+
+gchar *
+mm_net_port_get_driver (const gchar *sysfs_class_path,
+                        const gchar *iface)
+{
+    gchar *path;
+    gchar *link;
+    gchar *driver;
+
+    path = g_build_filename (sysfs_class_path ? sysfs_class_path : SYSFS_NET_CLASS_PATH,
+                             iface,
+                             "device",
+                             "driver",
+                             NULL);
+    link = g_file_read_link (path, NULL);
+    g_free (path);
+    if (!link)
+        return NULL;
+
+    driver = g_path_get_basename (link);
+    g_free (link);
+    return driver;
+}
+
+guint
+mm_net_driver_get_rank (const gchar *driver)
+{
+    guint i;
+
+    if (driver) {
+        for (i = 0; i < G_N_ELEMENTS (net_driver_preference); i++) {
+            if (g_str_equal (driver, net_driver_preference[i]))
+                return i;
+        }
+    }
+
+    return G_N_ELEMENTS (net_driver_preference);
+}
+
+gint
+mm_data_port_cmp (gboolean net_a,
+                  guint rank_a,
+                  const gchar *name_a,
+                  gboolean net_b,
+                  guint rank_b,
+                  const gchar *name_b)
+{
+    if (net_a != net_b)
+        return (net_a ? -1 : 1);
+    if (!net_a)
+        return 0;
+
+    /* By name as last resort, so that the order is always the same for
+     * the same modem */
+    if (rank_a != rank_b)
+        return (rank_a < rank_b ? -1 : 1);
+    return g_strcmp0 (name_a, name_b);
+}
+
+gboolean
+mm_data_port_usage_set_connected (MMDataPortUsage *usage,
+                                  gboolean connected,
+                                  gint64 now,
+                                  guint *connection_counter)
+{
+    if (connected) {
+        if (usage->connected_since)
+            return FALSE;
+        usage->n_connections++;
+        usage->last_connection = ++(*connection_counter);
+        usage->connected_since = now;
+    } else {
+        if (!usage->connected_since)
+            return FALSE;
+        usage->connected_time += now - usage->connected_since;
+        usage->connected_since = 0;
+    }
+
+    return TRUE;
+}
+
+gint64
+mm_data_port_usage_get_connected_time (const MMDataPortUsage *usage,
+                                       gint64 now)
+{
+    if (usage->connected_since)
+        return usage->connected_time + (now - usage->connected_since);
+    return usage->connected_time;
+}
+
+gint
+mm_data_port_usage_select (const MMDataPortUsage **usages,
+                           guint n_usages)
+{
+    gint best = -1;
+    guint i;
+
+    /* Only the last connection is looked at, so that peeking the best port
+     * without using it doesn't alter the rotation */
+    for (i = 0; i < n_usages; i++) {
+        if (best < 0 || usages[i]->last_connection < usages[best]->last_connection)
+            best = i;
+    }
+
+    return best;
+}
+
+/*****************************************************************************/
+
 /* +CREG: <stat>                      (GSM 07.07 CREG=1 unsolicited) */
 #define CREG1 "\\+(CREG|CGREG|CEREG):\\s*0*([0-9])"
 
@@ -356,108 +627,48 @@ mm_filter_supported_capabilities (MMModemCapability all,
 /* +CEREG: <n>,<stat>,<lac>,<rac>,<ci>,<AcT> (ETSI 27.007 v8.6 CREG=2 solicited with RAC) */
 #define CEREG2 "\\+(CEREG):\\s*0*([0-9]),\\s*0*([0-9])\\s*,\\s*([^,\\s]*)\\s*,\\s*([^,\\s]*)\\s*,\\s*([^,\\s]*)\\s*,\\s*0*([0-9])"
 
+static MMRegex creg_solicited_regex[] = {
+    MM_REGEX_INIT (CREG1 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT (CREG2 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT (CREG3 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT (CREG4 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT (CREG5 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT (CREG6 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT (CREG7 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT (CREG8 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT (CREG9 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT (CREG10 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT (CEREG1 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT (CEREG2 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+};
+
+static MMRegex creg_unsolicited_regex[] = {
+    MM_REGEX_INIT ("\\r\\n" CREG1 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT ("\\r\\n" CREG2 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT ("\\r\\n" CREG3 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT ("\\r\\n" CREG4 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT ("\\r\\n" CREG5 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT ("\\r\\n" CREG6 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT ("\\r\\n" CREG7 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT ("\\r\\n" CREG8 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT ("\\r\\n" CREG9 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT ("\\r\\n" CREG10 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT ("\\r\\n" CEREG1 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+    MM_REGEX_INIT ("\\r\\n" CEREG2 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0),
+};
+
 GPtrArray *
 mm_3gpp_creg_regex_get (gboolean solicited)
 {
-    GPtrArray *array = g_ptr_array_sized_new (12);
-    GRegex *regex;
-
-    /* #1 */
-    if (solicited)
-        regex = g_regex_new (CREG1 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CREG1 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
-
-    /* #2 */
-    if (solicited)
-        regex = g_regex_new (CREG2 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CREG2 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
-
-    /* #3 */
-    if (solicited)
-        regex = g_regex_new (CREG3 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CREG3 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
-
-    /* #4 */
-    if (solicited)
-        regex = g_regex_new (CREG4 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CREG4 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
-
-    /* #5 */
-    if (solicited)
-        regex = g_regex_new (CREG5 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CREG5 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
-
-    /* #6 */
-    if (solicited)
-        regex = g_regex_new (CREG6 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CREG6 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
-
-    /* #7 */
-    if (solicited)
-        regex = g_regex_new (CREG7 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CREG7 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
-
-    /* #8 */
-    if (solicited)
-        regex = g_regex_new (CREG8 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CREG8 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
-
-    /* #9 */
-    if (solicited)
-        regex = g_regex_new (CREG9 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CREG9 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
-
-    /* #10 */
-    if (solicited)
-        regex = g_regex_new (CREG10 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CREG10 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
-
-    /* CEREG #1 */
-    if (solicited)
-        regex = g_regex_new (CEREG1 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CEREG1 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
+    MMRegex *regex = (solicited ? creg_solicited_regex : creg_unsolicited_regex);
+    GPtrArray *array;
+    guint i;
 
-    /* CEREG #2 */
-    if (solicited)
-        regex = g_regex_new (CEREG2 "$", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    else
-        regex = g_regex_new ("\\r\\n" CEREG2 "\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (regex);
-    g_ptr_array_add (array, regex);
+    G_STATIC_ASSERT (G_N_ELEMENTS (creg_solicited_regex) == G_N_ELEMENTS (creg_unsolicited_regex));
 
+    array = g_ptr_array_sized_new (G_N_ELEMENTS (creg_solicited_regex));
+    for (i = 0; i < G_N_ELEMENTS (creg_solicited_regex); i++)
+        g_ptr_array_add (array, mm_regex_get (&regex[i]));
     return array;
 }
 
@@ -470,47 +681,51 @@ mm_3gpp_creg_regex_destroy (GPtrArray *array)
 
 /*************************************************************************/
 
+static MMRegex ciev_regex = MM_REGEX_INIT ("\\r\\n\\+CIEV: (.*),(\\d)\\r\\n",
+                                           G_REGEX_RAW | G_REGEX_OPTIMIZE,
+                                           0);
+
 GRegex *
 mm_3gpp_ciev_regex_get (void)
 {
-    return g_regex_new ("\\r\\n\\+CIEV: (.*),(\\d)\\r\\n",
-                        G_REGEX_RAW | G_REGEX_OPTIMIZE,
-                        0,
-                        NULL);
+    return mm_regex_get (&ciev_regex);
 }
 
 /*************************************************************************/
 
+static MMRegex cusd_regex = MM_REGEX_INIT ("\\r\\n\\+CUSD:\\s*(.*)\\r\\n",
+                                           G_REGEX_RAW | G_REGEX_OPTIMIZE,
+                                           0);
+
 GRegex *
 mm_3gpp_cusd_regex_get (void)
 {
-    return g_regex_new ("\\r\\n\\+CUSD:\\s*(.*)\\r\\n",
-                        G_REGEX_RAW | G_REGEX_OPTIMIZE,
-                        0,
-                        NULL);
+    return mm_regex_get (&cusd_regex);
 }
 
 /*************************************************************************/
 
+static MMRegex cmti_regex = MM_REGEX_INIT ("\\r\\n\\+CMTI:\\s*\"(\\S+)\",\\s*(\\d+)\\r\\n",
+                                           G_REGEX_RAW | G_REGEX_OPTIMIZE,
+                                           0);
+
 GRegex *
 mm_3gpp_cmti_regex_get (void)
 {
-    return g_regex_new ("\\r\\n\\+CMTI:\\s*\"(\\S+)\",\\s*(\\d+)\\r\\n",
-                        G_REGEX_RAW | G_REGEX_OPTIMIZE,
-                        0,
-                        NULL);
+    return mm_regex_get (&cmti_regex);
 }
 
+/* Example:
+ * <CR><LF>+CDS: 24<CR><LF>07914356060013F10659098136395339F6219011707193802190117071938030<CR><LF>
+ */
+static MMRegex cds_regex = MM_REGEX_INIT ("\\r\\n\\+CDS:\\s*(\\d+)\\r\\n(.*)\\r\\n",
+                                          G_REGEX_RAW | G_REGEX_OPTIMIZE,
+                                          0);
+
 GRegex *
 mm_3gpp_cds_regex_get (void)
 {
-    /* Example:
-     * <CR><LF>+CDS: 24<CR><LF>07914356060013F10659098136395339F6219011707193802190117071938030<CR><LF>
-     */
-    return g_regex_new ("\\r\\n\\+CDS:\\s*(\\d+)\\r\\n(.*)\\r\\n",
-                        G_REGEX_RAW | G_REGEX_OPTIMIZE,
-                        0,
-                        NULL);
+    return mm_regex_get (&cds_regex);
 }
 
 /*************************************************************************/
@@ -586,6 +801,13 @@ parse_access_tech (const gchar *str)
     return get_mm_access_tech_from_etsi_access_tech (str[0] - '0');
 }
 
+static MMRegex cops_test_umts_regex = MM_REGEX_INIT ("\\((\\d),\"([^\"\\)]*)\",([^,\\)]*),([^,\\)]*)[\\)]?,(\\d)\\)",
+                                                     G_REGEX_UNGREEDY,
+                                                     0);
+static MMRegex cops_test_pre_umts_regex = MM_REGEX_INIT ("\\((\\d),([^,\\)]*),([^,\\)]*),([^\\)]*)\\)",
+                                                         G_REGEX_UNGREEDY,
+                                                         0);
+
 GList *
 mm_3gpp_parse_cops_test_response (const gchar *reply,
                                   GError **error)
@@ -594,7 +816,6 @@ mm_3gpp_parse_cops_test_response (const gchar *reply,
     GList *info_list = NULL;
     GMatchInfo *match_info;
     gboolean umts_format = TRUE;
-    GError *inner_error = NULL;
 
     g_return_val_if_fail (reply != NULL, NULL);
     if (error)
@@ -623,15 +844,7 @@ mm_3gpp_parse_cops_test_response (const gchar *reply,
      *       +COPS: (2,"","T-Mobile","31026",0),(1,"AT&T","AT&T","310410"),0)
      */
 
-    r = g_regex_new ("\\((\\d),\"([^\"\\)]*)\",([^,\\)]*),([^,\\)]*)[\\)]?,(\\d)\\)", G_REGEX_UNGREEDY, 0, &inner_error);
-    if (inner_error) {
-        mm_err ("Invalid regular expression: %s", inner_error->message);
-        g_error_free (inner_error);
-        g_set_error_literal (error,
-                             MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
-                             "Could not parse scan results");
-        return NULL;
-    }
+    r = mm_regex_get (&cops_test_umts_regex);
 
     /* If we didn't get any hits, try the pre-UMTS format match */
     if (!g_regex_match (r, reply, 0, &match_info)) {
@@ -652,15 +865,7 @@ mm_3gpp_parse_cops_test_response (const gchar *reply,
          *       +COPS: (2,"T - Mobile",,"31026"),(1,"Einstein PCS",,"31064"),(1,"Cingular",,"31041"),,(0,1,3),(0,2)
          */
 
-        r = g_regex_new ("\\((\\d),([^,\\)]*),([^,\\)]*),([^\\)]*)\\)", G_REGEX_UNGREEDY, 0, &inner_error);
-        if (inner_error) {
-            mm_err ("Invalid regular expression: %s", inner_error->message);
-            g_error_free (inner_error);
-            g_set_error_literal (error,
-                                 MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
-                                 "Could not parse scan results");
-            return NULL;
-        }
+        r = mm_regex_get (&cops_test_pre_umts_regex);
 
         g_regex_match (r, reply, 0, &match_info);
         umts_format = FALSE;
@@ -750,6 +955,10 @@ mm_3gpp_pdp_context_format_list_free (GList *pdp_format_list)
     g_list_free_full (pdp_format_list, (GDestroyNotify) mm_3gpp_pdp_context_format_free);
 }
 
+static MMRegex cgdcont_test_regex = MM_REGEX_INIT ("\\+CGDCONT:\\s*\\((\\d+)-?(\\d+)?\\),\\(?\"(\\S+)\"",
+                                                   G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
+                                                   0);
+
 GList *
 mm_3gpp_parse_cgdcont_test_response (const gchar *response,
                                      GError **error)
@@ -764,10 +973,7 @@ mm_3gpp_parse_cgdcont_test_response (const gchar *response,
         return NULL;
     }
 
-    r = g_regex_new ("\\+CGDCONT:\\s*\\((\\d+)-?(\\d+)?\\),\\(?\"(\\S+)\"",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                     0, &inner_error);
-    g_assert (r != NULL);
+    r = mm_regex_get (&cgdcont_test_regex);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
     while (!inner_error && g_match_info_matches (match_info)) {
@@ -838,6 +1044,10 @@ mm_3gpp_pdp_context_cmp (MM3gppPdpContext *a,
     return (a->cid - b->cid);
 }
 
+static MMRegex cgdcont_read_regex = MM_REGEX_INIT ("\\+CGDCONT:\\s*(\\d+)\\s*,([^,\\)]*),([^,\\)]*),([^,\\)]*)",
+                                                   G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
+                                                   0);
+
 GList *
 mm_3gpp_parse_cgdcont_read_response (const gchar *reply,
                                      GError **error)
@@ -852,46 +1062,42 @@ mm_3gpp_parse_cgdcont_read_response (const gchar *reply,
         return NULL;
 
     list = NULL;
-    r = g_regex_new ("\\+CGDCONT:\\s*(\\d+)\\s*,([^,\\)]*),([^,\\)]*),([^,\\)]*)",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                     0, &inner_error);
-    if (r) {
-        g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, &inner_error);
-
-        while (!inner_error &&
-               g_match_info_matches (match_info)) {
-            gchar *str;
-            MMBearerIpFamily ip_family;
+    r = mm_regex_get (&cgdcont_read_regex);
+    g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, &inner_error);
 
-            str = mm_get_string_unquoted_from_match_info (match_info, 2);
-            ip_family = mm_3gpp_get_ip_family_from_pdp_type (str);
-            if (ip_family == MM_BEARER_IP_FAMILY_NONE)
-                mm_dbg ("Ignoring PDP context type: '%s'", str);
-            else {
-                MM3gppPdpContext *pdp;
-
-                pdp = g_slice_new0 (MM3gppPdpContext);
-                if (!mm_get_uint_from_match_info (match_info, 1, &pdp->cid)) {
-                    inner_error = g_error_new (MM_CORE_ERROR,
-                                               MM_CORE_ERROR_FAILED,
-                                               "Couldn't parse CID from reply: '%s'",
-                                               reply);
-                    break;
-                }
-                pdp->pdp_type = ip_family;
-                pdp->apn = mm_get_string_unquoted_from_match_info (match_info, 3);
+    while (!inner_error &&
+           g_match_info_matches (match_info)) {
+        gchar *str;
+        MMBearerIpFamily ip_family;
 
-                list = g_list_prepend (list, pdp);
+        str = mm_get_string_unquoted_from_match_info (match_info, 2);
+        ip_family = mm_3gpp_get_ip_family_from_pdp_type (str);
+        if (ip_family == MM_BEARER_IP_FAMILY_NONE)
+            mm_dbg ("Ignoring PDP context type: '%s'", str);
+        else {
+            MM3gppPdpContext *pdp;
+
+            pdp = g_slice_new0 (MM3gppPdpContext);
+            if (!mm_get_uint_from_match_info (match_info, 1, &pdp->cid)) {
+                inner_error = g_error_new (MM_CORE_ERROR,
+                                           MM_CORE_ERROR_FAILED,
+                                           "Couldn't parse CID from reply: '%s'",
+                                           reply);
+                break;
             }
+            pdp->pdp_type = ip_family;
+            pdp->apn = mm_get_string_unquoted_from_match_info (match_info, 3);
 
-            g_free (str);
-            g_match_info_next (match_info, &inner_error);
+            list = g_list_prepend (list, pdp);
         }
 
-        g_match_info_free (match_info);
-        g_regex_unref (r);
+        g_free (str);
+        g_match_info_next (match_info, &inner_error);
     }
 
+    g_match_info_free (match_info);
+    g_regex_unref (r);
+
     if (inner_error) {
         mm_3gpp_pdp_context_list_free (list);
         g_propagate_error (error, inner_error);
@@ -1106,6 +1312,8 @@ mm_3gpp_parse_creg_response (GMatchInfo *info,
 
 #define CMGF_TAG "+CMGF:"
 
+static MMRegex cmgf_test_regex = MM_REGEX_INIT ("\\(?\\s*(\\d+)\\s*[-,]?\\s*(\\d+)?\\s*\\)?", 0, 0);
+
 gboolean
 mm_3gpp_parse_cmgf_test_response (const gchar *reply,
                                   gboolean *sms_pdu_supported,
@@ -1123,9 +1331,7 @@ mm_3gpp_parse_cmgf_test_response (const gchar *reply,
     while (isspace (*reply))
         reply++;
 
-    r = g_regex_new ("\\(?\\s*(\\d+)\\s*[-,]?\\s*(\\d+)?\\s*\\)?", 0, 0, error);
-    if (!r)
-        return FALSE;
+    r = mm_regex_get (&cmgf_test_regex);
 
     if (!g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, NULL)) {
         g_set_error (error,
@@ -1179,6 +1385,8 @@ storage_from_str (const gchar *str)
     return MM_SMS_STORAGE_UNKNOWN;
 }
 
+static MMRegex cpms_test_regex = MM_REGEX_INIT ("\\s*\"([^,\\)]+)\"\\s*", 0, 0);
+
 gboolean
 mm_3gpp_parse_cpms_test_response (const gchar *reply,
                                   GArray **mem1,
@@ -1203,8 +1411,7 @@ mm_3gpp_parse_cpms_test_response (const gchar *reply,
     if (!split)
         return FALSE;
 
-    r = g_regex_new ("\\s*\"([^,\\)]+)\"\\s*", 0, 0, NULL);
-    g_assert (r);
+    r = mm_regex_get (&cpms_test_regex);
 
     for (i = 0; split[i]; i++) {
         GMatchInfo *match_info;
@@ -1271,6 +1478,8 @@ mm_3gpp_parse_cpms_test_response (const gchar *reply,
 
 /*************************************************************************/
 
+static MMRegex cscs_test_regex = MM_REGEX_INIT ("\\s*([^,\\)]+)\\s*", 0, 0);
+
 gboolean
 mm_3gpp_parse_cscs_test_response (const gchar *reply,
                                   MMModemCharset *out_charsets)
@@ -1300,9 +1509,7 @@ mm_3gpp_parse_cscs_test_response (const gchar *reply,
     }
 
     /* Now parse each charset */
-    r = g_regex_new ("\\s*([^,\\)]+)\\s*", 0, 0, NULL);
-    if (!r)
-        return FALSE;
+    r = mm_regex_get (&cscs_test_regex);
 
     if (g_regex_match_full (r, p, strlen (p), 0, 0, &match_info, NULL)) {
         while (g_match_info_matches (match_info)) {
@@ -1325,6 +1532,8 @@ mm_3gpp_parse_cscs_test_response (const gchar *reply,
 
 /*************************************************************************/
 
+static MMRegex clck_test_regex = MM_REGEX_INIT ("\\s*\"([^,\\)]+)\"\\s*", 0, 0);
+
 gboolean
 mm_3gpp_parse_clck_test_response (const gchar *reply,
                                   MMModem3gppFacility *out_facilities)
@@ -1342,8 +1551,7 @@ mm_3gpp_parse_clck_test_response (const gchar *reply,
     reply = mm_strip_tag (reply, "+CLCK:");
 
     /* Now parse each facility */
-    r = g_regex_new ("\\s*\"([^,\\)]+)\"\\s*", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_regex_get (&clck_test_regex);
 
     *out_facilities = MM_MODEM_3GPP_FACILITY_NONE;
     if (g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, NULL)) {
@@ -1367,6 +1575,8 @@ mm_3gpp_parse_clck_test_response (const gchar *reply,
 
 /*************************************************************************/
 
+static MMRegex clck_write_regex = MM_REGEX_INIT ("\\s*([01])\\s*", 0, 0);
+
 gboolean
 mm_3gpp_parse_clck_write_response (const gchar *reply,
                                    gboolean *enabled)
@@ -1380,8 +1590,7 @@ mm_3gpp_parse_clck_write_response (const gchar *reply,
 
     reply = mm_strip_tag (reply, "+CLCK:");
 
-    r = g_regex_new ("\\s*([01])\\s*", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_regex_get (&clck_write_regex);
 
     if (g_regex_match (r, reply, 0, &match_info)) {
         gchar *str;
@@ -1409,6 +1618,9 @@ mm_3gpp_parse_clck_write_response (const gchar *reply,
 
 /*************************************************************************/
 
+static MMRegex cnum_exec_regex = MM_REGEX_INIT ("\\+CNUM:\\s*((\"([^\"]|(\\\"))*\")|([^,]*)),\"(?<num>\\S+)\",\\d",
+                                                G_REGEX_UNGREEDY, 0);
+
 GStrv
 mm_3gpp_parse_cnum_exec_response (const gchar *reply,
                                   GError **error)
@@ -1421,9 +1633,7 @@ mm_3gpp_parse_cnum_exec_response (const gchar *reply,
     if (!reply || !reply[0])
         return NULL;
 
-    r = g_regex_new ("\\+CNUM:\\s*((\"([^\"]|(\\\"))*\")|([^,]*)),\"(?<num>\\S+)\",\\d",
-                     G_REGEX_UNGREEDY, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_regex_get (&cnum_exec_regex);
 
     g_regex_match (r, reply, 0, &match_info);
     while (g_match_info_matches (match_info)) {
@@ -1525,6 +1735,9 @@ mm_3gpp_cind_response_get_max (MM3gppCindResponse *r)
 
 #define CIND_TAG "+CIND:"
 
+static MMRegex cind_test_regex = MM_REGEX_INIT ("\\(([^,]*),\\((\\d+)[-,](\\d+).*\\)", G_REGEX_UNGREEDY, 0);
+static MMRegex cind_read_regex = MM_REGEX_INIT ("(\\d+)[^0-9]+", G_REGEX_UNGREEDY, 0);
+
 GHashTable *
 mm_3gpp_parse_cind_test_response (const gchar *reply,
                                   GError **error)
@@ -1542,13 +1755,7 @@ mm_3gpp_parse_cind_test_response (const gchar *reply,
     while (isspace (*reply))
         reply++;
 
-    r = g_regex_new ("\\(([^,]*),\\((\\d+)[-,](\\d+).*\\)", G_REGEX_UNGREEDY, 0, NULL);
-    if (!r) {
-        g_set_error_literal (error,
-                             MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
-                             "Could not parse scan results.");
-        return NULL;
-    }
+    r = mm_regex_get (&cind_test_regex);
 
     hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) cind_response_free);
 
@@ -1606,8 +1813,7 @@ mm_3gpp_parse_cind_read_response (const gchar *reply,
 
     reply = mm_strip_tag (reply, CIND_TAG);
 
-    r = g_regex_new ("(\\d+)[^0-9]+", G_REGEX_UNGREEDY, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_regex_get (&cind_read_regex);
 
     if (!g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, NULL)) {
         g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
@@ -1671,6 +1877,20 @@ mm_3gpp_pdu_info_list_free (GList *info_list)
     g_list_free_full (info_list, (GDestroyNotify)mm_3gpp_pdu_info_free);
 }
 
+static MMRegex cmgl_pdu_regex = MM_REGEX_INIT ("\\+CMGL:\\s*(\\d+)\\s*,\\s*(\\d+)\\s*,(.*)\\r\\n([^\\r\\n]*)(\\r\\n)?",
+                                               G_REGEX_RAW | G_REGEX_OPTIMIZE, 0);
+
+/* Unlike the one used for the whole response, the line break after the PDU is
+ * required, so that partially received entries never match */
+static MMRegex cmgl_pdu_entry_regex = MM_REGEX_INIT ("\\+CMGL:\\s*(\\d+)\\s*,\\s*(\\d+)\\s*,(.*)\\r\\n([^\\r\\n]*)\\r\\n",
+                                                     G_REGEX_RAW | G_REGEX_OPTIMIZE, 0);
+
+GRegex *
+mm_3gpp_cmgl_pdu_entry_regex_get (void)
+{
+    return mm_regex_get (&cmgl_pdu_entry_regex);
+}
+
 GList *
 mm_3gpp_parse_pdu_cmgl_response (const gchar *str,
                                  GError **error)
@@ -1687,9 +1907,7 @@ mm_3gpp_parse_pdu_cmgl_response (const gchar *str,
      *
      * We just read <index>, <stat> and the PDU itself.
      */
-    r = g_regex_new ("\\+CMGL:\\s*(\\d+)\\s*,\\s*(\\d+)\\s*,(.*)\\r\\n([^\\r\\n]*)(\\r\\n)?",
-                     G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_regex_get (&cmgl_pdu_regex);
 
     g_regex_match_full (r, str, strlen (str), 0, 0, &match_info, &inner_error);
     while (!inner_error && g_match_info_matches (match_info)) {
@@ -1824,6 +2042,8 @@ mm_string_to_access_tech (const gchar *string)
 
 /*************************************************************************/
 
+static MMRegex cops_read_regex = MM_REGEX_INIT ("(\\d),(\\d),\"(.+)\"", G_REGEX_UNGREEDY, 0);
+
 gchar *
 mm_3gpp_parse_operator (const gchar *reply,
                         MMModemCharset cur_charset)
@@ -1836,9 +2056,7 @@ mm_3gpp_parse_operator (const gchar *reply,
         GMatchInfo *match_info;
 
         reply += 7;
-        r = g_regex_new ("(\\d),(\\d),\"(.+)\"", G_REGEX_UNGREEDY, 0, NULL);
-        if (!r)
-            return NULL;
+        r = mm_regex_get (&cops_read_regex);
 
         g_regex_match (r, reply, 0, &match_info);
         if (g_match_info_matches (match_info))
@@ -2336,6 +2554,9 @@ mm_cdma_parse_eri (const gchar *reply,
 
 /*************************************************************************/
 
+static MMRegex crm_test_regex = MM_REGEX_INIT ("\\+CRM:\\s*\\((\\d+)-(\\d+)\\)",
+                                               G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW, 0);
+
 gboolean
 mm_cdma_parse_crm_test_response (const gchar *reply,
                                  MMModemCdmaRmProtocol *min,
@@ -2352,10 +2573,7 @@ mm_cdma_parse_crm_test_response (const gchar *reply,
      *   <--- +CRM: (0-2)
      */
 
-    r = g_regex_new ("\\+CRM:\\s*\\((\\d+)-(\\d+)\\)",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                     0, error);
-    g_assert (r != NULL);
+    r = mm_regex_get (&crm_test_regex);
 
     if (g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, &match_error)) {
         gchar *aux;
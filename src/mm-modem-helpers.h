@@ -50,6 +50,29 @@ const gchar *mm_strip_tag    (const gchar *str,
 
 guint mm_count_bits_set (gulong number);
 
+/* Regular expression compiled on first use and kept for the whole lifetime
+ * of the process, so that parsers don't rebuild it on every call. */
+typedef struct {
+    const gchar *pattern;
+    GRegexCompileFlags compile_options;
+    GRegexMatchFlags match_options;
+    volatile gsize regex;
+} MMRegex;
+
+#define MM_REGEX_INIT(pattern, compile_options, match_options) \
+    { pattern, compile_options, match_options, 0 }
+
+/* Returns a new reference */
+GRegex *mm_regex_get (MMRegex *self);
+
+/* Splits the response to several extended commands sent in a single command
+ * line (e.g. "+CREG?;+CGREG?") into the response of each of them, using the
+ * command names as line prefixes. Lines without a known prefix belong to the
+ * previous response; commands without lines get an empty response. */
+gchar **mm_split_chained_response (const gchar *response,
+                                   const gchar * const *commands,
+                                   guint n_commands);
+
 gchar *mm_create_device_identifier (guint vid,
                                     guint pid,
                                     const gchar *ati,
@@ -79,6 +102,85 @@ GArray *mm_filter_supported_modes (const GArray *all,
 GArray *mm_filter_supported_capabilities (MMModemCapability all,
                                           const GArray *supported_combinations);
 
+/* Adaptive signal quality polling. The interval never goes above the time
+ * after which the last reported value is no longer considered recent, as
+ * modems only send unsolicited updates when the value changes. */
+#define MM_SIGNAL_QUALITY_RECENT_TIMEOUT_SEC     60
+#define MM_SIGNAL_QUALITY_CHECK_MIN_INTERVAL_SEC 10
+#define MM_SIGNAL_QUALITY_CHECK_MAX_INTERVAL_SEC 50
+
+typedef enum {
+    MM_SIGNAL_QUALITY_CHECK_INDICATION, /* Unsolicited update since last check */
+    MM_SIGNAL_QUALITY_CHECK_STABLE,     /* Polled value close to the previous one */
+    MM_SIGNAL_QUALITY_CHECK_CHANGED,    /* Polled value different or first one */
+} MMSignalQualityCheckResult;
+
+guint mm_signal_quality_check_next_interval (guint interval,
+                                             MMSignalQualityCheckResult result);
+
+/* Great-circle distance between two points given in degrees, in meters */
+gdouble mm_gps_distance (gdouble latitude1,
+                         gdouble longitude1,
+                         gdouble latitude2,
+                         gdouble longitude2);
+
+/* Whether the position moved at least the given threshold in meters since
+ * the last reported one, so that it needs to be reported right away. A
+ * threshold of 0 disables it, and unknown positions never reach it. */
+gboolean mm_gps_distance_threshold_reached (guint threshold,
+                                            gboolean last_set,
+                                            gdouble last_latitude,
+                                            gdouble last_longitude,
+                                            gdouble latitude,
+                                            gdouble longitude);
+
+/* Kernel driver of a network interface, read from sysfs. The directory of
+ * the net class in sysfs may be given, e.g. for testing, or NULL to use
+ * the system one. */
+gchar *mm_net_port_get_driver (const gchar *sysfs_class_path,
+                               const gchar *iface);
+
+/* Preference of a network driver for data connections, lower is better;
+ * unknown or NULL drivers go last */
+guint mm_net_driver_get_rank (const gchar *driver);
+
+/* Compares data ports by preference for data connections: net ports come
+ * before AT ports, and net ports are sorted by driver rank and then by
+ * name. AT ports compare as equal, so that a stable sort keeps their
+ * order. */
+gint mm_data_port_cmp (gboolean net_a,
+                       guint rank_a,
+                       const gchar *name_a,
+                       gboolean net_b,
+                       guint rank_b,
+                       const gchar *name_b);
+
+/* Utilization of a data port. Connections are numbered across all the data
+ * ports of a modem, so that the port connected longest ago can be found. */
+typedef struct {
+    guint n_connections;
+    /* Number of the last connection, 0 if never connected */
+    guint last_connection;
+    /* Monotonic times, connected_since is 0 if not connected */
+    gint64 connected_since;
+    gint64 connected_time;
+} MMDataPortUsage;
+
+/* Accounts a connection state change at @now; @connection_counter is the
+ * counter shared by all the data ports of the modem. Returns FALSE if the
+ * port was already in that state. */
+gboolean mm_data_port_usage_set_connected      (MMDataPortUsage *usage,
+                                                gboolean connected,
+                                                gint64 now,
+                                                guint *connection_counter);
+gint64   mm_data_port_usage_get_connected_time (const MMDataPortUsage *usage,
+                                                gint64 now);
+
+/* Round-robin selection among free data ports: returns the index of the one
+ * connected longest ago, the first one on ties, or -1 if there are none. */
+gint mm_data_port_usage_select (const MMDataPortUsage **usages,
+                                guint n_usages);
+
 /*****************************************************************************/
 /* 3GPP specific helpers and utilities */
 /*****************************************************************************/
@@ -184,6 +286,9 @@ typedef struct {
 void   mm_3gpp_pdu_info_list_free      (GList *info_list);
 GList *mm_3gpp_parse_pdu_cmgl_response (const gchar *str,
                                         GError **error);
+/* Matches single complete +CMGL=4 entries, for streamed listings: index in
+ * group 1, status in group 2 and the hex PDU in group 4 */
+GRegex *mm_3gpp_cmgl_pdu_entry_regex_get (void);
 
 
 /* Additional 3GPP-specific helpers */
@@ -27,6 +27,7 @@
 
 #include "mm-plugin-manager.h"
 #include "mm-plugin.h"
+#include "mm-context.h"
 #include "mm-log.h"
 
 /* Default time to defer probing checks */
@@ -57,6 +58,13 @@ struct _MMPluginManagerPrivate {
     GList *plugins;
     /* Last, the generic plugin. */
     MMPlugin *generic;
+
+    /* Global budget of support checks running at the same time, shared by
+     * all ports of all devices; 0 if unlimited */
+    guint max_running_checks;
+    guint n_running_checks;
+    GQueue pending_checks;
+    guint pending_checks_id;
 };
 
 /*****************************************************************************/
@@ -94,6 +102,9 @@ typedef struct {
     gulong released_id;
 
     GList *running_probes;
+
+    /* Per-port probing events, reported once the device is done */
+    GPtrArray *timeline;
 } FindDeviceSupportContext;
 
 typedef struct {
@@ -106,6 +117,10 @@ typedef struct {
     MMPlugin *suggested_plugin;
     guint defer_id;
     gboolean defer_until_suggested;
+
+    /* Waiting for a free slot in the global budget */
+    gboolean queued;
+    gdouble queued_at;
 } PortProbeContext;
 
 static void port_probe_context_step (PortProbeContext *port_probe_ctx);
@@ -113,10 +128,38 @@ static void suggest_port_probe_result (FindDeviceSupportContext *ctx,
                                        PortProbeContext *origin,
                                        MMPlugin *suggested_plugin);
 
+static void
+timeline_add (FindDeviceSupportContext *ctx,
+              GUdevDevice *port,
+              const gchar *fmt,
+              ...) G_GNUC_PRINTF (3, 4);
+
+static void
+timeline_add (FindDeviceSupportContext *ctx,
+              GUdevDevice *port,
+              const gchar *fmt,
+              ...)
+{
+    va_list args;
+    gchar *event;
+
+    va_start (args, fmt);
+    event = g_strdup_vprintf (fmt, args);
+    va_end (args);
+
+    g_ptr_array_add (ctx->timeline,
+                     g_strdup_printf ("+%.3lfs [%s] %s",
+                                      g_timer_elapsed (ctx->timer, NULL),
+                                      port ? g_udev_device_get_name (port) : "device",
+                                      event));
+    g_free (event);
+}
+
 static void
 port_probe_context_free (PortProbeContext *ctx)
 {
     g_assert (ctx->defer_id == 0);
+    g_assert (!ctx->queued);
 
     if (ctx->best_plugin)
         g_object_unref (ctx->best_plugin);
@@ -131,11 +174,20 @@ port_probe_context_free (PortProbeContext *ctx)
 static void
 find_device_support_context_complete_and_free (FindDeviceSupportContext *ctx)
 {
+    guint i;
+
     g_assert (ctx->timeout_id == 0);
 
     mm_dbg ("(Plugin Manager) [%s] device support check finished in '%lf' seconds",
             mm_device_get_path (ctx->device),
             g_timer_elapsed (ctx->timer, NULL));
+    mm_dbg ("(Plugin Manager) [%s] probing timeline:",
+            mm_device_get_path (ctx->device));
+    for (i = 0; i < ctx->timeline->len; i++)
+        mm_dbg ("(Plugin Manager) [%s]   %s",
+                mm_device_get_path (ctx->device),
+                (const gchar *) g_ptr_array_index (ctx->timeline, i));
+    g_ptr_array_unref (ctx->timeline);
     g_timer_destroy (ctx->timer);
 
     /* Set async operation result */
@@ -187,12 +239,16 @@ port_probe_context_finished (PortProbeContext *port_probe_ctx)
             mm_dbg ("(Plugin Manager) [%s] assuming port can be handled by the '%s' plugin",
                     g_udev_device_get_name (port_probe_ctx->port),
                     mm_plugin_get_name (device_plugin));
+            timeline_add (ctx, port_probe_ctx->port,
+                          "finished, assumed '%s'",
+                          mm_plugin_get_name (device_plugin));
         } else {
             gboolean cancel_remaining;
             GList *l;
 
             mm_dbg ("(Plugin Manager) [%s] not supported by any plugin",
                     g_udev_device_get_name (port_probe_ctx->port));
+            timeline_add (ctx, port_probe_ctx->port, "finished, unsupported");
 
             /* Tell the device to ignore this port */
             mm_device_ignore_port (ctx->device, port_probe_ctx->port);
@@ -216,6 +272,10 @@ port_probe_context_finished (PortProbeContext *port_probe_ctx)
                 suggest_port_probe_result (ctx, port_probe_ctx, NULL);
         }
     } else {
+        timeline_add (ctx, port_probe_ctx->port,
+                      "finished, best plugin '%s'",
+                      mm_plugin_get_name (port_probe_ctx->best_plugin));
+
         /* Notify the plugin to the device, if this is the first port probing
          * result we got.
          * Also, if the previously suggested plugin was the GENERIC one and now
@@ -423,6 +483,57 @@ suggest_port_probe_result (FindDeviceSupportContext *ctx,
     }
 }
 
+static gboolean
+pending_checks_idle (MMPluginManager *self)
+{
+    self->priv->pending_checks_id = 0;
+
+    while (!g_queue_is_empty (&self->priv->pending_checks) &&
+           self->priv->n_running_checks < self->priv->max_running_checks) {
+        PortProbeContext *port_probe_ctx;
+
+        port_probe_ctx = g_queue_pop_head (&self->priv->pending_checks);
+        port_probe_ctx->queued = FALSE;
+        timeline_add (port_probe_ctx->parent_ctx, port_probe_ctx->port,
+                      "got probing slot after %.3lfs",
+                      g_timer_elapsed (port_probe_ctx->parent_ctx->timer, NULL) - port_probe_ctx->queued_at);
+        port_probe_context_step (port_probe_ctx);
+    }
+
+    return FALSE;
+}
+
+static void
+release_check_slot (MMPluginManager *self)
+{
+    g_assert (self->priv->n_running_checks > 0);
+    self->priv->n_running_checks--;
+
+    /* Pending checks are started from an idle, so the port releasing the slot
+     * processes its result first and may go on with its next plugin right
+     * away; finishing ports already in progress is preferred over starting
+     * new ones. */
+    if (!g_queue_is_empty (&self->priv->pending_checks) && !self->priv->pending_checks_id)
+        self->priv->pending_checks_id = g_idle_add ((GSourceFunc)pending_checks_idle, self);
+}
+
+static const gchar *
+supports_result_to_string (MMPluginSupportsResult support_result)
+{
+    switch (support_result) {
+    case MM_PLUGIN_SUPPORTS_PORT_UNSUPPORTED:
+        return "unsupported";
+    case MM_PLUGIN_SUPPORTS_PORT_DEFER:
+        return "deferred";
+    case MM_PLUGIN_SUPPORTS_PORT_DEFER_UNTIL_SUGGESTED:
+        return "deferred until suggested";
+    case MM_PLUGIN_SUPPORTS_PORT_SUPPORTED:
+        return "supported";
+    default:
+        return "unknown";
+    }
+}
+
 static void
 plugin_supports_port_ready (MMPlugin *plugin,
                             GAsyncResult *result,
@@ -431,8 +542,14 @@ plugin_supports_port_ready (MMPlugin *plugin,
     MMPluginSupportsResult support_result;
     GError *error = NULL;
 
+    release_check_slot (port_probe_ctx->parent_ctx->self);
+
     /* Get supports check results */
     support_result = mm_plugin_supports_port_finish (plugin, result, &error);
+    timeline_add (port_probe_ctx->parent_ctx, port_probe_ctx->port,
+                  "'%s' check: %s",
+                  mm_plugin_get_name (plugin),
+                  supports_result_to_string (support_result));
 
     if (error) {
         mm_warn ("(Plugin Manager) (%s) [%s] error when checking support: '%s'",
@@ -576,6 +693,7 @@ static void
 port_probe_context_step (PortProbeContext *port_probe_ctx)
 {
     FindDeviceSupportContext *ctx = port_probe_ctx->parent_ctx;
+    MMPluginManagerPrivate *priv = ctx->self->priv;
 
     /* Already checked all plugins? */
     if (!port_probe_ctx->current) {
@@ -583,6 +701,23 @@ port_probe_context_step (PortProbeContext *port_probe_ctx)
         return;
     }
 
+    /* Wait for a free slot if the global budget is already consumed */
+    if (priv->max_running_checks > 0 &&
+        priv->n_running_checks >= priv->max_running_checks) {
+        mm_dbg ("(Plugin Manager) [%s] waiting for a free probing slot (%u checks running)",
+                g_udev_device_get_name (port_probe_ctx->port),
+                priv->n_running_checks);
+        port_probe_ctx->queued = TRUE;
+        port_probe_ctx->queued_at = g_timer_elapsed (ctx->timer, NULL);
+        g_queue_push_tail (&priv->pending_checks, port_probe_ctx);
+        return;
+    }
+
+    priv->n_running_checks++;
+    timeline_add (ctx, port_probe_ctx->port,
+                  "checking support with '%s'",
+                  mm_plugin_get_name (MM_PLUGIN (port_probe_ctx->current->data)));
+
     /* Ask the current plugin to check support of this port */
     mm_plugin_supports_port (MM_PLUGIN (port_probe_ctx->current->data),
                              ctx->device,
@@ -594,12 +729,15 @@ port_probe_context_step (PortProbeContext *port_probe_ctx)
 static GList *
 build_plugins_list (MMPluginManager *self,
                     MMDevice *device,
-                    GUdevDevice *port)
+                    GUdevDevice *port,
+                    MMPlugin **definitive)
 {
     GList *list = NULL;
     GList *l;
     gboolean supported_found = FALSE;
 
+    *definitive = NULL;
+
     for (l = self->priv->plugins; l && !supported_found; l = g_list_next (l)) {
         MMPluginSupportsHint hint;
 
@@ -623,6 +761,7 @@ build_plugins_list (MMPluginManager *self,
                 list = NULL;
             }
             list = g_list_prepend (list, g_object_ref (l->data));
+            *definitive = MM_PLUGIN (l->data);
             /* This will end the loop as well */
             supported_found = TRUE;
             break;
@@ -653,6 +792,7 @@ device_port_grabbed_cb (MMDevice *device,
                         FindDeviceSupportContext *ctx)
 {
     PortProbeContext *port_probe_ctx;
+    MMPlugin *definitive;
 
     /* Launch probing task on this port with the first plugin of the list */
     port_probe_ctx = g_slice_new0 (PortProbeContext);
@@ -660,8 +800,9 @@ device_port_grabbed_cb (MMDevice *device,
     port_probe_ctx->port = g_object_ref (port);
 
     /* Setup plugins to probe and first one to check */
-    port_probe_ctx->plugins = build_plugins_list (ctx->self, device, port);
+    port_probe_ctx->plugins = build_plugins_list (ctx->self, device, port, &definitive);
     port_probe_ctx->current = port_probe_ctx->plugins;
+    timeline_add (ctx, port, "port added, %u plugins to try", g_list_length (port_probe_ctx->plugins));
 
     /* If we got one suggested, it will be the first one, unless it is the generic plugin */
     port_probe_ctx->suggested_plugin = (!!mm_device_peek_plugin (device) ?
@@ -677,6 +818,18 @@ device_port_grabbed_cb (MMDevice *device,
                                                    port_probe_ctx->suggested_plugin);
     }
 
+    /* If the vendor/product filters already tell which plugin handles the
+     * device, don't wait for this port probing to finish before letting the
+     * other ports know: they can go straight to that plugin, and the ports
+     * deferred until suggested get completed right away. */
+    if (definitive && !mm_device_peek_plugin (device)) {
+        mm_dbg ("(Plugin Manager) (%s) [%s] plugin selected by filters, suggesting it to other ports",
+                mm_plugin_get_name (definitive),
+                g_udev_device_get_name (port));
+        timeline_add (ctx, port, "'%s' selected by filters", mm_plugin_get_name (definitive));
+        suggest_port_probe_result (ctx, port_probe_ctx, definitive);
+    }
+
     /* Set as running */
     ctx->running_probes = g_list_prepend (ctx->running_probes, port_probe_ctx);
 
@@ -708,6 +861,7 @@ min_probing_timeout_cb (FindDeviceSupportContext *ctx)
 
         mm_dbg ("(Plugin Manager) [%s] Minimum probing time consumed",
                 mm_device_get_path (ctx->device));
+        timeline_add (ctx, NULL, "minimum probing time consumed");
 
         /* If all we got were probes with 'deferred_until_suggested', just cancel
          * the probing. May happen e.g. with just 'net' ports */
@@ -745,6 +899,8 @@ mm_plugin_manager_find_device_support (MMPluginManager *self,
                                              callback,
                                              user_data,
                                              mm_plugin_manager_find_device_support);
+    ctx->timeline = g_ptr_array_new_with_free_func (g_free);
+    ctx->timer = g_timer_new ();
 
     /* Connect to device port grabbed/released notifications */
     ctx->grabbed_id = g_signal_connect (device,
@@ -761,7 +917,6 @@ mm_plugin_manager_find_device_support (MMPluginManager *self,
      * bring up ports. Given that we launch this only when the first port of the
      * device has been exposed in udev, this timeout effectively means that we
      * leave up to 2s to the remaining ports to appear. */
-    ctx->timer = g_timer_new ();
     ctx->timeout_id = g_timeout_add_seconds (MIN_PROBING_TIME_SECS,
                                              (GSourceFunc)min_probing_timeout_cb,
                                              ctx);
@@ -928,6 +1083,9 @@ mm_plugin_manager_init (MMPluginManager *manager)
     manager->priv = G_TYPE_INSTANCE_GET_PRIVATE (manager,
                                                  MM_TYPE_PLUGIN_MANAGER,
                                                  MMPluginManagerPrivate);
+
+    g_queue_init (&manager->priv->pending_checks);
+    manager->priv->max_running_checks = mm_context_get_max_parallel_probes ();
 }
 
 static void
@@ -981,6 +1139,13 @@ dispose (GObject *object)
 {
     MMPluginManager *self = MM_PLUGIN_MANAGER (object);
 
+    /* Pending checks keep a reference to the manager, so there can be none */
+    g_warn_if_fail (g_queue_is_empty (&self->priv->pending_checks));
+    if (self->priv->pending_checks_id) {
+        g_source_remove (self->priv->pending_checks_id);
+        self->priv->pending_checks_id = 0;
+    }
+
     /* Cleanup list of plugins */
     if (self->priv->plugins) {
         g_list_free_full (self->priv->plugins, (GDestroyNotify)g_object_unref);
@@ -34,6 +34,7 @@
 #include "libqcdm/src/utils.h"
 #include "libqcdm/src/errors.h"
 #include "mm-port-serial-qcdm.h"
+#include "mm-probe-cache.h"
 #include "mm-daemon-enums-types.h"
 
 #if defined WITH_QMI
@@ -138,6 +139,12 @@ struct _MMPortProbePrivate {
     /* From udev tags */
     gboolean is_ignored;
 
+    /* Key in the persistent probe cache, if any */
+    gchar *cache_key;
+    gboolean cache_checked;
+    gboolean from_cache;
+    gboolean cache_needs_open;
+
     /* Current probing task. Only one can be available at a time */
     PortProbeRunTask *task;
 };
@@ -321,6 +328,106 @@ mm_port_probe_set_result_mbim (MMPortProbe *self,
                 g_udev_device_get_name (self->priv->port));
 }
 
+/***************************************************************/
+/* Persistent probe cache */
+
+static void
+port_probe_cache_load (MMPortProbe *self)
+{
+    MMProbeCacheEntry entry;
+    guint32 mask;
+    gchar *probe_list_str;
+
+    if (!mm_probe_cache_lookup (self->priv->cache_key, &entry))
+        return;
+
+    /* Results already set (e.g. by plugins) take precedence */
+    mask = entry.flags & ~self->priv->flags;
+    if (!mask) {
+        mm_probe_cache_entry_clear (&entry);
+        return;
+    }
+
+    if (mask & MM_PORT_PROBE_AT)
+        self->priv->is_at = entry.is_at;
+    if (mask & MM_PORT_PROBE_AT_VENDOR) {
+        g_free (self->priv->vendor);
+        self->priv->vendor = g_strdup (entry.vendor);
+    }
+    if (mask & MM_PORT_PROBE_AT_PRODUCT) {
+        g_free (self->priv->product);
+        self->priv->product = g_strdup (entry.product);
+    }
+    if (mask & MM_PORT_PROBE_AT_ICERA)
+        self->priv->is_icera = entry.is_icera;
+    if (mask & MM_PORT_PROBE_QCDM)
+        self->priv->is_qcdm = entry.is_qcdm;
+    if (mask & MM_PORT_PROBE_QMI)
+        self->priv->is_qmi = entry.is_qmi;
+    if (mask & MM_PORT_PROBE_MBIM)
+        self->priv->is_mbim = entry.is_mbim;
+    self->priv->flags |= mask;
+    self->priv->from_cache = TRUE;
+    /* Serial ports are opened before the results are trusted, as the first
+     * step of the probing run; if that fails, the entry is dropped */
+    self->priv->cache_needs_open = mm_probe_cache_entry_needs_open (&entry);
+
+    probe_list_str = mm_port_probe_flag_build_string_from_mask (mask);
+    mm_dbg ("(%s/%s) using cached probing results: '%s'",
+            g_udev_device_get_subsystem (self->priv->port),
+            g_udev_device_get_name (self->priv->port),
+            probe_list_str);
+    g_free (probe_list_str);
+
+    mm_probe_cache_entry_clear (&entry);
+}
+
+static void
+port_probe_cache_store (MMPortProbe *self)
+{
+    MMProbeCacheEntry entry;
+
+    entry.flags = self->priv->flags;
+    entry.is_at = self->priv->is_at;
+    entry.is_qcdm = self->priv->is_qcdm;
+    entry.is_qmi = self->priv->is_qmi;
+    entry.is_mbim = self->priv->is_mbim;
+    entry.is_icera = self->priv->is_icera;
+    entry.vendor = self->priv->vendor;
+    entry.product = self->priv->product;
+
+    mm_probe_cache_store (self->priv->cache_key, &entry);
+}
+
+static void
+port_probe_cache_check (MMPortProbe *self,
+                        gboolean has_custom_init)
+{
+    if (self->priv->cache_checked)
+        return;
+    self->priv->cache_checked = TRUE;
+
+    if (!mm_probe_cache_enabled ())
+        return;
+
+    self->priv->cache_key = (mm_probe_cache_build_key (
+                                 mm_device_get_vendor (self->priv->device),
+                                 mm_device_get_product (self->priv->device),
+                                 g_udev_device_get_property (self->priv->port, "ID_USB_INTERFACE_NUM"),
+                                 mm_device_utils_get_port_driver (self->priv->port),
+                                 g_udev_device_get_subsystem (self->priv->port)));
+    if (!self->priv->cache_key)
+        return;
+
+    /* Custom initialization may have side effects the plugin relies on (e.g.
+     * port type hints), so always run the real probing in that case. The
+     * results still get cached. */
+    if (!has_custom_init)
+        port_probe_cache_load (self);
+}
+
+/***************************************************************/
+
 static gboolean serial_probe_at (MMPortProbe *self);
 static gboolean serial_probe_qcdm (MMPortProbe *self);
 static void serial_probe_schedule (MMPortProbe *self);
@@ -1221,6 +1328,18 @@ serial_open_at (MMPortProbe *self)
         return FALSE;
     }
 
+    /* If only the cached results needed the port to be opened, we're done */
+    if (self->priv->cache_needs_open) {
+        self->priv->cache_needs_open = FALSE;
+        if (!(task->flags & (MM_PORT_PROBE_AT |
+                             MM_PORT_PROBE_AT_VENDOR |
+                             MM_PORT_PROBE_AT_PRODUCT |
+                             MM_PORT_PROBE_AT_ICERA))) {
+            serial_probe_schedule (self);
+            return FALSE;
+        }
+    }
+
     /* success, start probing */
     task->buffer_full_id = g_signal_connect (task->serial,
                                              "buffer-full",
@@ -1272,17 +1391,38 @@ mm_port_probe_run_finish (MMPortProbe *self,
                           GAsyncResult *result,
                           GError **error)
 {
+    GError *inner_error = NULL;
     gboolean res;
 
     g_return_val_if_fail (MM_IS_PORT_PROBE (self), FALSE);
     g_return_val_if_fail (G_IS_ASYNC_RESULT (result), FALSE);
 
     /* Propagate error, if any */
-    if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result), error))
+    if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result), &inner_error))
         res = FALSE;
     else
         res = g_simple_async_result_get_op_res_gboolean (G_SIMPLE_ASYNC_RESULT (result));
 
+    if (self->priv->cache_key) {
+        /* Keep the new results, if we really probed something */
+        if (res && self->priv->task && self->priv->task->flags)
+            port_probe_cache_store (self);
+        /* If probing fails on a port known from the cache, don't trust the
+         * cached results any more */
+        else if (inner_error &&
+                 self->priv->from_cache &&
+                 !g_error_matches (inner_error, MM_CORE_ERROR, MM_CORE_ERROR_CANCELLED)) {
+            mm_dbg ("(%s/%s) removing cached probing results",
+                    g_udev_device_get_subsystem (self->priv->port),
+                    g_udev_device_get_name (self->priv->port));
+            mm_probe_cache_remove (self->priv->cache_key);
+            self->priv->from_cache = FALSE;
+        }
+    }
+
+    if (inner_error)
+        g_propagate_error (error, inner_error);
+
     /* Cleanup probing task */
     if (self->priv->task) {
         port_probe_run_task_free (self->priv->task);
@@ -1313,6 +1453,9 @@ mm_port_probe_run (MMPortProbe *self,
     /* Shouldn't schedule more than one probing at a time */
     g_assert (self->priv->task == NULL);
 
+    /* Known hardware may skip probing */
+    port_probe_cache_check (self, !!at_custom_init);
+
     task = g_new0 (PortProbeRunTask, 1);
     task->at_send_delay = at_send_delay;
     task->at_remove_echo = at_remove_echo;
@@ -1341,7 +1484,7 @@ mm_port_probe_run (MMPortProbe *self,
     self->priv->task = task;
 
     /* All requested probings already available? If so, we're done */
-    if (!task->flags) {
+    if (!task->flags && !self->priv->cache_needs_open) {
         port_probe_run_task_complete (task, TRUE, NULL);
         return;
     }
@@ -1349,15 +1492,22 @@ mm_port_probe_run (MMPortProbe *self,
     /* Setup internal cancellable */
     task->cancellable = g_cancellable_new ();
 
-    probe_list_str = mm_port_probe_flag_build_string_from_mask (task->flags);
-    mm_dbg ("(%s/%s) launching port probing: '%s'",
-            g_udev_device_get_subsystem (self->priv->port),
-            g_udev_device_get_name (self->priv->port),
-            probe_list_str);
-    g_free (probe_list_str);
+    if (task->flags) {
+        probe_list_str = mm_port_probe_flag_build_string_from_mask (task->flags);
+        mm_dbg ("(%s/%s) launching port probing: '%s'",
+                g_udev_device_get_subsystem (self->priv->port),
+                g_udev_device_get_name (self->priv->port),
+                probe_list_str);
+        g_free (probe_list_str);
+    } else
+        mm_dbg ("(%s/%s) opening port to validate cached probing results",
+                g_udev_device_get_subsystem (self->priv->port),
+                g_udev_device_get_name (self->priv->port));
 
-    /* If any AT probing is needed, start by opening as AT port */
-    if (task->flags & MM_PORT_PROBE_AT ||
+    /* If any AT probing is needed, or the cached results need the port to be
+     * opened, start by opening as AT port */
+    if (self->priv->cache_needs_open ||
+        task->flags & MM_PORT_PROBE_AT ||
         task->flags & MM_PORT_PROBE_AT_VENDOR ||
         task->flags & MM_PORT_PROBE_AT_PRODUCT ||
         task->flags & MM_PORT_PROBE_AT_ICERA) {
@@ -1750,6 +1900,7 @@ finalize (GObject *object)
 
     g_free (self->priv->vendor);
     g_free (self->priv->product);
+    g_free (self->priv->cache_key);
 
     G_OBJECT_CLASS (mm_port_probe_parent_class)->finalize (object);
 }
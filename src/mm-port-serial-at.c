@@ -40,8 +40,15 @@ struct _MMPortSerialAtPrivate {
     MMPortSerialAtResponseParserFn response_parser_fn;
     gpointer response_parser_user_data;
     GDestroyNotify response_parser_notify;
+    /* Reused across reads to avoid reallocating on every chunk */
+    GString *response_string;
 
     GSList *unsolicited_msg_handlers;
+    /* Unsolicited message dispatcher: trie of the literal prefixes of the
+     * handlers, with the nodes for each first byte */
+    struct _UnsolicitedMsgTrieNode **unsolicited_msg_trie;
+    guint unsolicited_msg_scan_id;
+    GArray *unsolicited_msg_spans;
 
     MMPortSerialAtFlag flags;
 
@@ -132,19 +139,25 @@ parse_response (MMPortSerial *port,
         mm_port_serial_at_remove_echo (response);
 
     /* Construct the string that AT-parsing functions expect */
-    string = g_string_sized_new (response->len + 1);
+    if (!self->priv->response_string)
+        self->priv->response_string = g_string_sized_new (response->len + 1);
+    string = self->priv->response_string;
+    g_string_truncate (string, 0);
     g_string_append_len (string, (const char *) response->data, response->len);
 
     /* Parse it */
     found = self->priv->response_parser_fn (self->priv->response_parser_user_data, string, error);
 
-    /* And copy it back into the response array after the parser has removed
-     * matches and cleaned it up.
+    /* And copy it back into the response array only if the parser has removed
+     * matches and cleaned it up; partial responses are usually left untouched.
      */
-    if (response->len)
-        g_byte_array_remove_range (response, 0, response->len);
-    g_byte_array_append (response, (const guint8 *) string->str, string->len);
-    g_string_free (string, TRUE);
+    if (found ||
+        string->len != response->len ||
+        memcmp (string->str, response->data, string->len) != 0) {
+        g_byte_array_set_size (response, 0);
+        g_byte_array_append (response, (const guint8 *) string->str, string->len);
+    }
+    g_string_truncate (string, 0);
     return found;
 }
 
@@ -156,8 +169,163 @@ typedef struct {
     gboolean enable;
     gpointer user_data;
     GDestroyNotify notify;
+    /* Literal text every match starts with, if known */
+    gchar *prefix;
+    /* Last scan in which the prefix was found */
+    guint scan_id;
 } MMAtUnsolicitedMsgHandler;
 
+typedef struct {
+    gint start;
+    gint end;
+} MatchSpan;
+
+/* Node of the prefix trie; siblings are kept in a list, as most nodes only
+ * have one or two children */
+typedef struct _UnsolicitedMsgTrieNode UnsolicitedMsgTrieNode;
+struct _UnsolicitedMsgTrieNode {
+    guint8 byte;
+    UnsolicitedMsgTrieNode *next;
+    UnsolicitedMsgTrieNode *children;
+    /* Handlers whose prefix ends in this node */
+    GSList *handlers;
+};
+
+static void
+unsolicited_msg_trie_node_free (UnsolicitedMsgTrieNode *node)
+{
+    while (node) {
+        UnsolicitedMsgTrieNode *next;
+
+        next = node->next;
+        unsolicited_msg_trie_node_free (node->children);
+        g_slist_free (node->handlers);
+        g_slice_free (UnsolicitedMsgTrieNode, node);
+        node = next;
+    }
+}
+
+static UnsolicitedMsgTrieNode *
+unsolicited_msg_trie_node_find_child (UnsolicitedMsgTrieNode *node,
+                                      guint8 byte)
+{
+    UnsolicitedMsgTrieNode *child;
+
+    for (child = node->children; child; child = child->next) {
+        if (child->byte == byte)
+            return child;
+    }
+    return NULL;
+}
+
+/* Tokens which may lead a URC pattern before its literal prefix */
+static gboolean
+skip_line_break_token (const gchar **p)
+{
+    const gchar *s = *p;
+
+    if (*s == '\r' || *s == '\n')
+        s++;
+    else if (s[0] == '\\' && (s[1] == 'r' || s[1] == 'n' || s[1] == 'R'))
+        s += 2;
+    else
+        return FALSE;
+
+    /* Any quantifier applied to the line break */
+    while (*s == '+' || *s == '*' || *s == '?')
+        s++;
+
+    *p = s;
+    return TRUE;
+}
+
+/* Alternations at the top level mean there's no single prefix */
+static gboolean
+has_top_level_alternation (const gchar *pattern)
+{
+    const gchar *s;
+    gint depth = 0;
+    gboolean in_class = FALSE;
+
+    for (s = pattern; *s; s++) {
+        if (*s == '\\') {
+            if (!*(++s))
+                break;
+            continue;
+        }
+        if (in_class) {
+            if (*s == ']')
+                in_class = FALSE;
+            continue;
+        }
+        if (*s == '[')
+            in_class = TRUE;
+        else if (*s == '(')
+            depth++;
+        else if (*s == ')')
+            depth--;
+        else if (*s == '|' && depth == 0)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+gchar *
+mm_port_serial_at_get_unsolicited_msg_prefix (GRegex *regex)
+{
+    const gchar *pattern;
+    const gchar *s;
+    GString *prefix;
+
+    if (g_regex_get_compile_flags (regex) & (G_REGEX_CASELESS | G_REGEX_EXTENDED))
+        return NULL;
+
+    pattern = g_regex_get_pattern (regex);
+    if (has_top_level_alternation (pattern))
+        return NULL;
+
+    /* Skip leading anchor and line breaks */
+    s = pattern;
+    if (*s == '^')
+        s++;
+    while (skip_line_break_token (&s));
+
+    /* Collect literal characters until the first regex construct */
+    prefix = g_string_new ("");
+    while (*s) {
+        gchar c;
+
+        if (s[0] == '\\') {
+            /* Only escaped punctuation is taken as literal */
+            if (!s[1] || g_ascii_isalnum (s[1]))
+                break;
+            c = s[1];
+            s += 2;
+        } else if (strchr (".[]()*+?{}|^$\r\n", *s))
+            break;
+        else
+            c = *s++;
+
+        if (*s == '?' || *s == '*' || *s == '{')
+            /* Optional character, not part of the prefix */
+            break;
+
+        g_string_append_c (prefix, c);
+
+        if (*s == '+')
+            break;
+    }
+
+    /* A single byte is too common to filter anything */
+    if (prefix->len < 2) {
+        g_string_free (prefix, TRUE);
+        return NULL;
+    }
+
+    return g_string_free (prefix, FALSE);
+}
+
 static gint
 unsolicited_msg_handler_cmp (MMAtUnsolicitedMsgHandler *handler,
                              GRegex *regex)
@@ -166,6 +334,45 @@ unsolicited_msg_handler_cmp (MMAtUnsolicitedMsgHandler *handler,
                       g_regex_get_pattern (regex));
 }
 
+static void
+unsolicited_msg_handler_index (MMPortSerialAt *self,
+                               MMAtUnsolicitedMsgHandler *handler)
+{
+    UnsolicitedMsgTrieNode *node;
+    guint8 first;
+    gsize i;
+
+    handler->prefix = mm_port_serial_at_get_unsolicited_msg_prefix (handler->regex);
+    if (!handler->prefix)
+        return;
+
+    if (!self->priv->unsolicited_msg_trie)
+        self->priv->unsolicited_msg_trie = g_new0 (UnsolicitedMsgTrieNode *, 256);
+
+    first = (guint8) handler->prefix[0];
+    node = self->priv->unsolicited_msg_trie[first];
+    if (!node) {
+        node = g_slice_new0 (UnsolicitedMsgTrieNode);
+        node->byte = first;
+        self->priv->unsolicited_msg_trie[first] = node;
+    }
+
+    for (i = 1; handler->prefix[i]; i++) {
+        UnsolicitedMsgTrieNode *child;
+
+        child = unsolicited_msg_trie_node_find_child (node, (guint8) handler->prefix[i]);
+        if (!child) {
+            child = g_slice_new0 (UnsolicitedMsgTrieNode);
+            child->byte = (guint8) handler->prefix[i];
+            child->next = node->children;
+            node->children = child;
+        }
+        node = child;
+    }
+
+    node->handlers = g_slist_prepend (node->handlers, handler);
+}
+
 void
 mm_port_serial_at_add_unsolicited_msg_handler (MMPortSerialAt *self,
                                                GRegex *regex,
@@ -188,9 +395,10 @@ mm_port_serial_at_add_unsolicited_msg_handler (MMPortSerialAt *self,
         if (handler->notify)
             handler->notify (handler->user_data);
     } else {
-        handler = g_slice_new (MMAtUnsolicitedMsgHandler);
+        handler = g_slice_new0 (MMAtUnsolicitedMsgHandler);
         self->priv->unsolicited_msg_handlers = g_slist_append (self->priv->unsolicited_msg_handlers, handler);
         handler->regex = g_regex_ref (regex);
+        unsolicited_msg_handler_index (self, handler);
     }
 
     handler->callback = callback;
@@ -219,19 +427,64 @@ mm_port_serial_at_enable_unsolicited_msg_handler (MMPortSerialAt *self,
     }
 }
 
-static gboolean
-remove_eval_cb (const GMatchInfo *match_info,
-                GString *result,
-                gpointer user_data)
+/* Single pass over the response walking the prefix trie from every byte and
+ * flagging the handlers whose full prefix is found, so that the cost per byte
+ * depends on the length of the matched prefixes, not on the number of
+ * handlers sharing their first bytes (e.g. all the "+C..." ones) */
+static void
+unsolicited_msg_scan (MMPortSerialAt *self,
+                      const GByteArray *response)
 {
-    int *result_len = (int *) user_data;
-    int start;
-    int end;
+    guint i;
 
-    if (g_match_info_fetch_pos  (match_info, 0, &start, &end))
-        *result_len -= (end - start);
+    self->priv->unsolicited_msg_scan_id++;
 
-    return FALSE;
+    if (!self->priv->unsolicited_msg_trie)
+        return;
+
+    for (i = 0; i < response->len; i++) {
+        UnsolicitedMsgTrieNode *node;
+        guint j;
+
+        node = self->priv->unsolicited_msg_trie[response->data[i]];
+        for (j = i + 1; node; j++) {
+            GSList *l;
+
+            for (l = node->handlers; l; l = g_slist_next (l))
+                ((MMAtUnsolicitedMsgHandler *) l->data)->scan_id = self->priv->unsolicited_msg_scan_id;
+
+            if (j == response->len)
+                break;
+            node = unsolicited_msg_trie_node_find_child (node, response->data[j]);
+        }
+    }
+}
+
+/* Remove all matched spans in place, moving each kept chunk just once */
+static void
+remove_spans (GByteArray *response,
+              GArray *spans)
+{
+    guint i;
+    guint dst;
+
+    if (!spans->len)
+        return;
+
+    dst = g_array_index (spans, MatchSpan, 0).start;
+    for (i = 0; i < spans->len; i++) {
+        guint src;
+        guint next;
+
+        src = g_array_index (spans, MatchSpan, i).end;
+        next = (i + 1 < spans->len ? g_array_index (spans, MatchSpan, i + 1).start : response->len);
+        if (next > src) {
+            memmove (&response->data[dst], &response->data[src], next - src);
+            dst += next - src;
+        }
+    }
+
+    g_byte_array_set_size (response, dst);
 }
 
 static void
@@ -244,42 +497,41 @@ parse_unsolicited (MMPortSerial *port, GByteArray *response)
     if (self->priv->remove_echo)
         mm_port_serial_at_remove_echo (response);
 
+    unsolicited_msg_scan (self, response);
+
+    if (!self->priv->unsolicited_msg_spans)
+        self->priv->unsolicited_msg_spans = g_array_new (FALSE, FALSE, sizeof (MatchSpan));
+
     for (iter = self->priv->unsolicited_msg_handlers; iter; iter = iter->next) {
         MMAtUnsolicitedMsgHandler *handler = (MMAtUnsolicitedMsgHandler *) iter->data;
         GMatchInfo *match_info;
-        gboolean matches;
 
         if (!handler->enable)
             continue;
 
-        matches = g_regex_match_full (handler->regex,
-                                      (const char *) response->data,
-                                      response->len,
-                                      0, 0, &match_info, NULL);
-        if (handler->callback) {
-            while (g_match_info_matches (match_info)) {
-                handler->callback (self, match_info, handler->user_data);
-                g_match_info_next (match_info, NULL);
-            }
-        }
-
-        g_match_info_free (match_info);
+        /* Skip the regex altogether if the prefix isn't in the response */
+        if (handler->prefix && handler->scan_id != self->priv->unsolicited_msg_scan_id)
+            continue;
 
-        if (matches) {
-            /* Remove matches */
-            char *str;
-            int result_len = response->len;
+        g_array_set_size (self->priv->unsolicited_msg_spans, 0);
 
-            str = g_regex_replace_eval (handler->regex,
-                                        (const char *) response->data,
-                                        response->len,
-                                        0, 0,
-                                        remove_eval_cb, &result_len, NULL);
+        g_regex_match_full (handler->regex,
+                            (const char *) response->data,
+                            response->len,
+                            0, 0, &match_info, NULL);
+        while (g_match_info_matches (match_info)) {
+            MatchSpan span;
 
-            g_byte_array_remove_range (response, 0, response->len);
-            g_byte_array_append (response, (const guint8 *) str, result_len);
-            g_free (str);
+            if (handler->callback)
+                handler->callback (self, match_info, handler->user_data);
+            if (g_match_info_fetch_pos (match_info, 0, &span.start, &span.end))
+                g_array_append_val (self->priv->unsolicited_msg_spans, span);
+            g_match_info_next (match_info, NULL);
         }
+        g_match_info_free (match_info);
+
+        /* Remove matches */
+        remove_spans (response, self->priv->unsolicited_msg_spans);
     }
 }
 
@@ -341,9 +593,9 @@ string_free (GString *str)
 }
 
 static void
-serial_command_ready (MMPortSerial *port,
-                      GAsyncResult *res,
-                      GSimpleAsyncResult *simple)
+serial_command_complete (MMPortSerial *port,
+                         GAsyncResult *res,
+                         GSimpleAsyncResult *simple)
 {
     GByteArray *response_buffer;
     GError *error = NULL;
@@ -353,24 +605,68 @@ serial_command_ready (MMPortSerial *port,
     if (!response_buffer) {
         g_simple_async_result_take_error (simple, error);
         g_simple_async_result_complete (simple);
-        g_object_unref (simple);
         return;
     }
 
     /* Build a GString just with the response we need, and clear the
      * processed range from the response buffer */
     response = g_string_new_len ((const gchar *)response_buffer->data, response_buffer->len);
-    if (response_buffer->len > 0)
-        g_byte_array_remove_range (response_buffer, 0, response_buffer->len);
+    g_byte_array_set_size (response_buffer, 0);
     g_byte_array_unref (response_buffer);
 
     g_simple_async_result_set_op_res_gpointer (simple,
                                                response,
                                                (GDestroyNotify)string_free);
     g_simple_async_result_complete (simple);
+}
+
+static void
+serial_command_ready (MMPortSerial *port,
+                      GAsyncResult *res,
+                      GSimpleAsyncResult *simple)
+{
+    serial_command_complete (port, res, simple);
     g_object_unref (simple);
 }
 
+/* Commands known to be either periodic polls or long-running bulk reads,
+ * so that polls don't wait behind queued listings, and listings don't delay
+ * everything else. Matched against the command without the AT prefix. */
+static const struct {
+    const gchar *prefix;
+    MMPortSerialCommandPriority priority;
+} command_priorities[] = {
+    { "+CSQ",      MM_PORT_SERIAL_COMMAND_PRIORITY_POLL },
+    { "+CIND?",    MM_PORT_SERIAL_COMMAND_PRIORITY_POLL },
+    { "+CREG?",    MM_PORT_SERIAL_COMMAND_PRIORITY_POLL },
+    { "+CGREG?",   MM_PORT_SERIAL_COMMAND_PRIORITY_POLL },
+    { "+CEREG?",   MM_PORT_SERIAL_COMMAND_PRIORITY_POLL },
+    { "+COPS?",    MM_PORT_SERIAL_COMMAND_PRIORITY_POLL },
+    { "+CAD?",     MM_PORT_SERIAL_COMMAND_PRIORITY_POLL },
+    { "+CSS?",     MM_PORT_SERIAL_COMMAND_PRIORITY_POLL },
+    { "+COPS=?",   MM_PORT_SERIAL_COMMAND_PRIORITY_BULK },
+    { "+CMGL",     MM_PORT_SERIAL_COMMAND_PRIORITY_BULK },
+    { "+CPBR",     MM_PORT_SERIAL_COMMAND_PRIORITY_BULK },
+};
+
+MMPortSerialCommandPriority
+mm_port_serial_at_get_command_priority (const gchar *command)
+{
+    guint i;
+
+    if (!g_ascii_strncasecmp (command, "AT", 2))
+        command += 2;
+
+    for (i = 0; i < G_N_ELEMENTS (command_priorities); i++) {
+        if (!g_ascii_strncasecmp (command,
+                                  command_priorities[i].prefix,
+                                  strlen (command_priorities[i].prefix)))
+            return command_priorities[i].priority;
+    }
+
+    return MM_PORT_SERIAL_COMMAND_PRIORITY_INTERACTIVE;
+}
+
 void
 mm_port_serial_at_command (MMPortSerialAt *self,
                            const char *command,
@@ -404,12 +700,119 @@ mm_port_serial_at_command (MMPortSerialAt *self,
                             buf,
                             timeout_seconds,
                             allow_cached,
+                            mm_port_serial_at_get_command_priority (command),
                             cancellable,
                             (GAsyncReadyCallback)serial_command_ready,
                             simple);
     g_byte_array_unref (buf);
 }
 
+/*****************************************************************************/
+
+typedef struct {
+    GSimpleAsyncResult *result;
+    GRegex *regex;
+    MMPortSerialAtStreamEntryFn callback;
+    gpointer user_data;
+    GArray *spans;
+} StreamingContext;
+
+static void
+streaming_context_free (StreamingContext *ctx)
+{
+    g_object_unref (ctx->result);
+    g_regex_unref (ctx->regex);
+    g_array_unref (ctx->spans);
+    g_slice_free (StreamingContext, ctx);
+}
+
+static void
+streaming_partial_response (MMPortSerial *port,
+                            GByteArray *response,
+                            StreamingContext *ctx)
+{
+    GMatchInfo *match_info;
+
+    g_array_set_size (ctx->spans, 0);
+
+    /* Entries are passed straight from the response buffer, and removed
+     * afterwards so that the buffer doesn't grow with the whole listing */
+    g_regex_match_full (ctx->regex,
+                        (const char *) response->data,
+                        response->len,
+                        0, 0, &match_info, NULL);
+    while (g_match_info_matches (match_info)) {
+        MatchSpan span;
+
+        ctx->callback (MM_PORT_SERIAL_AT (port), match_info, ctx->user_data);
+        if (g_match_info_fetch_pos (match_info, 0, &span.start, &span.end))
+            g_array_append_val (ctx->spans, span);
+        g_match_info_next (match_info, NULL);
+    }
+    g_match_info_free (match_info);
+
+    remove_spans (response, ctx->spans);
+}
+
+static void
+serial_command_streaming_ready (MMPortSerial *port,
+                                GAsyncResult *res,
+                                StreamingContext *ctx)
+{
+    serial_command_complete (port, res, ctx->result);
+    streaming_context_free (ctx);
+}
+
+void
+mm_port_serial_at_command_streaming (MMPortSerialAt *self,
+                                     const char *command,
+                                     guint32 timeout_seconds,
+                                     GRegex *entry_regex,
+                                     MMPortSerialAtStreamEntryFn entry_callback,
+                                     gpointer entry_user_data,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data)
+{
+    StreamingContext *ctx;
+    GByteArray *buf;
+
+    g_return_if_fail (MM_IS_PORT_SERIAL_AT (self));
+    g_return_if_fail (command != NULL);
+    g_return_if_fail (entry_regex != NULL);
+    g_return_if_fail (entry_callback != NULL);
+
+    buf = at_command_to_byte_array (command,
+                                    FALSE,
+                                    (mm_port_get_subsys (MM_PORT (self)) == MM_PORT_SUBSYS_TTY ?
+                                     self->priv->send_lf :
+                                     TRUE));
+    g_return_if_fail (buf != NULL);
+
+    ctx = g_slice_new0 (StreamingContext);
+    ctx->result = g_simple_async_result_new (G_OBJECT (self),
+                                             callback,
+                                             user_data,
+                                             mm_port_serial_at_command);
+    ctx->regex = g_regex_ref (entry_regex);
+    ctx->callback = entry_callback;
+    ctx->user_data = entry_user_data;
+    ctx->spans = g_array_new (FALSE, FALSE, sizeof (MatchSpan));
+
+    mm_port_serial_command_streaming (MM_PORT_SERIAL (self),
+                                      buf,
+                                      timeout_seconds,
+                                      mm_port_serial_at_get_command_priority (command),
+                                      (MMPortSerialPartialResponseFn)streaming_partial_response,
+                                      ctx,
+                                      cancellable,
+                                      (GAsyncReadyCallback)serial_command_streaming_ready,
+                                      ctx);
+    g_byte_array_unref (buf);
+}
+
+/*****************************************************************************/
+
 static void
 debug_log (MMPortSerial *port, const char *prefix, const char *buf, gsize len)
 {
@@ -595,13 +998,26 @@ finalize (GObject *object)
             handler->notify (handler->user_data);
 
         g_regex_unref (handler->regex);
+        g_free (handler->prefix);
         g_slice_free (MMAtUnsolicitedMsgHandler, handler);
         self->priv->unsolicited_msg_handlers = g_slist_delete_link (self->priv->unsolicited_msg_handlers,
                                                                     self->priv->unsolicited_msg_handlers);
     }
 
+    if (self->priv->unsolicited_msg_trie) {
+        guint i;
+
+        for (i = 0; i < 256; i++)
+            unsolicited_msg_trie_node_free (self->priv->unsolicited_msg_trie[i]);
+        g_free (self->priv->unsolicited_msg_trie);
+    }
+    if (self->priv->unsolicited_msg_spans)
+        g_array_unref (self->priv->unsolicited_msg_spans);
+
     if (self->priv->response_parser_notify)
         self->priv->response_parser_notify (self->priv->response_parser_user_data);
+    if (self->priv->response_string)
+        g_string_free (self->priv->response_string, TRUE);
 
     g_strfreev (self->priv->init_sequence);
 
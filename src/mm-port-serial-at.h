@@ -61,6 +61,10 @@ typedef void (*MMPortSerialAtUnsolicitedMsgFn) (MMPortSerialAt *port,
                                                 GMatchInfo *match_info,
                                                 gpointer user_data);
 
+typedef void (*MMPortSerialAtStreamEntryFn) (MMPortSerialAt *port,
+                                             GMatchInfo *match_info,
+                                             gpointer user_data);
+
 #define MM_PORT_SERIAL_AT_REMOVE_ECHO           "remove-echo"
 #define MM_PORT_SERIAL_AT_INIT_SEQUENCE_ENABLED "init-sequence-enabled"
 #define MM_PORT_SERIAL_AT_INIT_SEQUENCE         "init-sequence"
@@ -107,6 +111,20 @@ const gchar *mm_port_serial_at_command_finish (MMPortSerialAt *self,
                                                GAsyncResult *res,
                                                GError **error);
 
+/* Like mm_port_serial_at_command(), but each match of @entry_regex is reported
+ * and removed from the response as soon as it has been received. The regex
+ * must only match complete entries. The result is what's left of the
+ * response, and is retrieved with mm_port_serial_at_command_finish(). */
+void         mm_port_serial_at_command_streaming (MMPortSerialAt *self,
+                                                  const char *command,
+                                                  guint32 timeout_seconds,
+                                                  GRegex *entry_regex,
+                                                  MMPortSerialAtStreamEntryFn entry_callback,
+                                                  gpointer entry_user_data,
+                                                  GCancellable *cancellable,
+                                                  GAsyncReadyCallback callback,
+                                                  gpointer user_data);
+
 /*
  * Convert a string into a quoted and escaped string. Returns a new
  * allocated string. Follows ITU V.250 5.4.2.2 "String constants".
@@ -115,6 +133,8 @@ gchar   *mm_port_serial_at_quote_string (const char *string);
 
 /* Just for unit tests */
 void     mm_port_serial_at_remove_echo (GByteArray *response);
+gchar   *mm_port_serial_at_get_unsolicited_msg_prefix (GRegex *regex);
+MMPortSerialCommandPriority mm_port_serial_at_get_command_priority (const gchar *command);
 
 void     mm_port_serial_at_set_flags (MMPortSerialAt *self,
                                       MMPortSerialAtFlag flags);
@@ -28,9 +28,6 @@ struct _MMPortSerialGpsPrivate {
     MMPortSerialGpsTraceFn callback;
     gpointer user_data;
     GDestroyNotify notify;
-
-    /* Regex for all known traces */
-    GRegex *known_traces_regex;
 };
 
 /*****************************************************************************/
@@ -53,19 +50,29 @@ mm_port_serial_gps_add_trace_handler (MMPortSerialGps *self,
 
 /*****************************************************************************/
 
+/* Validates the optional "*HH" checksum: the XOR of all characters between
+ * the '$' and the '*' */
 static gboolean
-remove_eval_cb (const GMatchInfo *match_info,
-                GString *result,
-                gpointer user_data)
+nmea_checksum_valid (const gchar *sentence,
+                     const gchar *end)
 {
-    int *result_len = (int *) user_data;
-    int start;
-    int end;
+    const gchar *p;
+    guint8 checksum = 0;
+    gint high;
+    gint low;
+
+    for (p = sentence + 1; p < end && *p != '*'; p++)
+        checksum ^= (guint8) *p;
 
-    if (g_match_info_fetch_pos  (match_info, 0, &start, &end))
-        *result_len -= (end - start);
+    /* No checksum given */
+    if (p == end)
+        return TRUE;
 
-    return FALSE;
+    if (end - p < 3)
+        return FALSE;
+    high = g_ascii_xdigit_value (p[1]);
+    low = g_ascii_xdigit_value (p[2]);
+    return (high >= 0 && low >= 0 && checksum == (guint8) ((high << 4) | low));
 }
 
 static gboolean
@@ -74,11 +81,12 @@ parse_response (MMPortSerial *port,
                 GError **error)
 {
     MMPortSerialGps *self = MM_PORT_SERIAL_GPS (port);
-    gboolean matches;
-    GMatchInfo *match_info;
-    gchar *str;
-    gint result_len;
+    gchar *data;
+    gboolean matches = FALSE;
+    guint len;
     guint i;
+    guint src = 0;
+    guint dst = 0;
 
     for (i = 0; i < response->len; i++) {
         /* If there is any content before the first $,
@@ -91,40 +99,64 @@ parse_response (MMPortSerial *port,
         }
     }
 
-    matches = g_regex_match_full (self->priv->known_traces_regex,
-                                  (const gchar *) response->data,
-                                  response->len,
-                                  0, 0, &match_info, NULL);
-
-    if (self->priv->callback) {
-        while (g_match_info_matches (match_info)) {
-            gchar *trace;
-
-            trace = g_match_info_fetch (match_info, 0);
-            if (trace) {
-                self->priv->callback (self, trace, self->priv->user_data);
-                g_free (trace);
-            }
-            g_match_info_next (match_info, NULL);
+    /* NUL-terminate the buffer, so that each trace can be reported in place
+     * just by terminating it temporarily */
+    len = response->len;
+    g_byte_array_append (response, (const guint8 *) "", 1);
+    data = (gchar *) response->data;
+
+    /* Every trace starts with the dollar sign and ends with \r\n. Report each
+     * one and remove it from the response in the same pass; only the bytes
+     * before the current trace are moved, which we have already gone past. */
+    i = 0;
+    while (i < len) {
+        gchar *start;
+        gchar *lf;
+        guint end;
+        gchar saved;
+
+        start = memchr (&data[i], '$', len - i);
+        if (!start)
+            break;
+        lf = memchr (start, '\n', len - (start - data));
+        if (!lf)
+            break;
+
+        /* A bare \n doesn't end a trace; look for the next one */
+        if (lf == start || lf[-1] != '\r') {
+            i = start - data + 1;
+            continue;
         }
-    }
 
-    g_match_info_free (match_info);
+        end = lf - data + 1;
+        matches = TRUE;
+
+        if (!nmea_checksum_valid (start, lf - 1))
+            mm_dbg ("(%s): ignoring NMEA trace with wrong checksum",
+                    mm_port_get_device (MM_PORT (port)));
+        else if (self->priv->callback) {
+            saved = data[end];
+            data[end] = '\0';
+            self->priv->callback (self, start, self->priv->user_data);
+            data[end] = saved;
+        }
 
-    if (!matches)
-        return FALSE;
+        if (dst != src)
+            memmove (&data[dst], &data[src], (start - data) - src);
+        dst += (start - data) - src;
+        src = end;
+        i = end;
+    }
 
-    /* Remove matches */
-    result_len = response->len;
-    str = g_regex_replace_eval (self->priv->known_traces_regex,
-                                (const char *) response->data,
-                                response->len,
-                                0, 0,
-                                remove_eval_cb, &result_len, NULL);
+    if (!matches) {
+        g_byte_array_set_size (response, len);
+        return FALSE;
+    }
 
-    g_byte_array_remove_range (response, 0, response->len);
-    g_byte_array_append (response, (const guint8 *) str, result_len);
-    g_free (str);
+    /* Keep whatever comes after the last trace */
+    if (dst != src)
+        memmove (&data[dst], &data[src], len - src);
+    g_byte_array_set_size (response, dst + (len - src));
 
     return TRUE;
 }
@@ -180,13 +212,6 @@ mm_port_serial_gps_init (MMPortSerialGps *self)
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
                                               MM_TYPE_PORT_SERIAL_GPS,
                                               MMPortSerialGpsPrivate);
-
-    /* We'll assume that all traces start with the dollar sign and end with \r\n */
-    self->priv->known_traces_regex =
-        g_regex_new ("\\$.*\\r\\n",
-                     G_REGEX_RAW | G_REGEX_OPTIMIZE,
-                     0,
-                     NULL);
 }
 
 static void
@@ -197,8 +222,6 @@ finalize (GObject *object)
     if (self->priv->notify)
         self->priv->notify (self->priv->user_data);
 
-    g_regex_unref (self->priv->known_traces_regex);
-
     G_OBJECT_CLASS (mm_port_serial_gps_parent_class)->finalize (object);
 }
 
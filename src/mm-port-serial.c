@@ -34,6 +34,7 @@
 #include <mm-errors-types.h>
 
 #include "mm-port-serial.h"
+#include "mm-trace.h"
 #include "mm-log.h"
 
 static gboolean port_serial_queue_process          (gpointer data);
@@ -74,6 +75,11 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 #define SERIAL_BUF_SIZE 2048
 
+/* The response buffer is allocated once with enough room for a full read on
+ * top of a buffer which is about to be trimmed by spew control, so that in the
+ * common case reads go straight into it without reallocations. */
+#define SERIAL_RESPONSE_BUF_SIZE (2 * SERIAL_BUF_SIZE)
+
 struct _MMPortSerialPrivate {
     guint32 open_count;
     gboolean forced_close;
@@ -111,6 +117,12 @@ struct _MMPortSerialPrivate {
 
     guint connected_id;
 
+    /* Binary trace port id, 0 if not registered yet */
+    guint32 trace_id;
+
+    /* Command queue statistics, per priority */
+    MMPortSerialCommandStats command_stats[MM_PORT_SERIAL_COMMAND_PRIORITY_LAST + 1];
+
     gpointer flash_ctx;
     gpointer reopen_ctx;
 };
@@ -126,6 +138,10 @@ typedef struct {
     guint32 timeout;
     gboolean allow_cached;
     guint32 eagain_count;
+    MMPortSerialCommandPriority priority;
+    gint64 queued_time;
+    MMPortSerialPartialResponseFn partial_response_fn;
+    gpointer partial_response_user_data;
 
     guint32 idx;
     gboolean started;
@@ -159,18 +175,110 @@ mm_port_serial_command_finish (MMPortSerial *self,
 }
 
 void
-mm_port_serial_command (MMPortSerial *self,
-                        GByteArray *command,
-                        guint32 timeout_seconds,
-                        gboolean allow_cached,
-                        GCancellable *cancellable,
-                        GAsyncReadyCallback callback,
-                        gpointer user_data)
+mm_port_serial_get_command_stats (MMPortSerial *self,
+                                  MMPortSerialCommandPriority priority,
+                                  MMPortSerialCommandStats *stats)
+{
+    g_return_if_fail (MM_IS_PORT_SERIAL (self));
+    g_return_if_fail (priority <= MM_PORT_SERIAL_COMMAND_PRIORITY_LAST);
+
+    *stats = self->priv->command_stats[priority];
+}
+
+static void
+port_serial_queue_push (MMPortSerial *self,
+                        CommandContext *ctx)
+{
+    MMPortSerialCommandStats *stats;
+    GList *l;
+
+    stats = &self->priv->command_stats[ctx->priority];
+    stats->queued++;
+    stats->max_queued = MAX (stats->max_queued, stats->queued);
+    ctx->queued_time = g_get_monotonic_time ();
+
+    /* Queue after the last command with the same or higher priority. The head
+     * of the queue may already be in progress, so never go before it. */
+    for (l = self->priv->queue->tail; l && l != self->priv->queue->head; l = g_list_previous (l)) {
+        if (((CommandContext *) l->data)->priority <= ctx->priority)
+            break;
+    }
+
+    if (l)
+        g_queue_insert_after (self->priv->queue, l, ctx);
+    else
+        g_queue_push_tail (self->priv->queue, ctx);
+}
+
+static CommandContext *
+port_serial_queue_pop (MMPortSerial *self)
 {
     CommandContext *ctx;
 
-    g_return_if_fail (MM_IS_PORT_SERIAL (self));
-    g_return_if_fail (command != NULL);
+    ctx = (CommandContext *) g_queue_pop_head (self->priv->queue);
+    if (ctx)
+        self->priv->command_stats[ctx->priority].queued--;
+    return ctx;
+}
+
+/* Account how long the command waited in the queue, once it gets processed */
+static void
+port_serial_account_wait (MMPortSerial *self,
+                          CommandContext *ctx)
+{
+    MMPortSerialCommandStats *stats;
+    gint64 wait;
+
+    if (!ctx->queued_time)
+        return;
+
+    wait = g_get_monotonic_time () - ctx->queued_time;
+    ctx->queued_time = 0;
+
+    stats = &self->priv->command_stats[ctx->priority];
+    stats->processed++;
+    stats->total_wait += wait;
+    stats->max_wait = MAX (stats->max_wait, wait);
+}
+
+static void
+port_serial_log_command_stats (MMPortSerial *self)
+{
+    static const gchar *priority_names[] = { "interactive", "poll", "bulk" };
+    guint i;
+
+    G_STATIC_ASSERT (G_N_ELEMENTS (priority_names) == MM_PORT_SERIAL_COMMAND_PRIORITY_LAST + 1);
+
+    for (i = 0; i <= MM_PORT_SERIAL_COMMAND_PRIORITY_LAST; i++) {
+        MMPortSerialCommandStats *stats = &self->priv->command_stats[i];
+
+        if (!stats->processed)
+            continue;
+
+        mm_dbg ("(%s) %s commands: %u processed, max queue depth %u, "
+                "wait time avg %" G_GINT64_FORMAT "ms max %" G_GINT64_FORMAT "ms",
+                mm_port_get_device (MM_PORT (self)),
+                priority_names[i],
+                stats->processed,
+                stats->max_queued,
+                stats->total_wait / stats->processed / 1000,
+                stats->max_wait / 1000);
+    }
+}
+
+static void
+port_serial_command (MMPortSerial *self,
+                     GByteArray *command,
+                     guint32 timeout_seconds,
+                     gboolean allow_cached,
+                     MMPortSerialCommandPriority priority,
+                     MMPortSerialPartialResponseFn partial_response_fn,
+                     gpointer partial_response_user_data,
+                     GCancellable *cancellable,
+                     GAsyncReadyCallback callback,
+                     gpointer user_data)
+{
+    CommandContext *ctx;
 
     /* Setup command context */
     ctx = g_slice_new0 (CommandContext);
@@ -181,8 +289,11 @@ mm_port_serial_command (MMPortSerial *self,
                                              mm_port_serial_command);
     ctx->command = g_byte_array_ref (command);
     ctx->allow_cached = allow_cached;
+    ctx->priority = priority;
     ctx->timeout = timeout_seconds;
     ctx->cancellable = (cancellable ? g_object_ref (cancellable) : NULL);
+    ctx->partial_response_fn = partial_response_fn;
+    ctx->partial_response_user_data = partial_response_user_data;
 
     /* Only accept about 3 seconds of EAGAIN for this command */
     if (self->priv->send_delay && mm_port_get_subsys (MM_PORT (self)) == MM_PORT_SUBSYS_TTY)
@@ -203,12 +314,67 @@ mm_port_serial_command (MMPortSerial *self,
     if (!allow_cached)
         port_serial_set_cached_reply (self, ctx->command, NULL);
 
-    g_queue_push_tail (self->priv->queue, ctx);
+    port_serial_queue_push (self, ctx);
 
     if (g_queue_get_length (self->priv->queue) == 1)
         port_serial_schedule_queue_process (self, 0);
 }
 
+void
+mm_port_serial_command (MMPortSerial *self,
+                        GByteArray *command,
+                        guint32 timeout_seconds,
+                        gboolean allow_cached,
+                        MMPortSerialCommandPriority priority,
+                        GCancellable *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data)
+{
+    g_return_if_fail (MM_IS_PORT_SERIAL (self));
+    g_return_if_fail (command != NULL);
+    g_return_if_fail (priority <= MM_PORT_SERIAL_COMMAND_PRIORITY_LAST);
+
+    port_serial_command (self,
+                         command,
+                         timeout_seconds,
+                         allow_cached,
+                         priority,
+                         NULL,
+                         NULL,
+                         cancellable,
+                         callback,
+                         user_data);
+}
+
+void
+mm_port_serial_command_streaming (MMPortSerial *self,
+                                  GByteArray *command,
+                                  guint32 timeout_seconds,
+                                  MMPortSerialCommandPriority priority,
+                                  MMPortSerialPartialResponseFn partial_response_fn,
+                                  gpointer partial_response_user_data,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+    g_return_if_fail (MM_IS_PORT_SERIAL (self));
+    g_return_if_fail (command != NULL);
+    g_return_if_fail (priority <= MM_PORT_SERIAL_COMMAND_PRIORITY_LAST);
+    g_return_if_fail (partial_response_fn != NULL);
+
+    /* Only the tail of the response is ever available, so never cached */
+    port_serial_command (self,
+                         command,
+                         timeout_seconds,
+                         FALSE,
+                         priority,
+                         partial_response_fn,
+                         partial_response_user_data,
+                         cancellable,
+                         callback,
+                         user_data);
+}
+
 /*****************************************************************************/
 
 #if 0
@@ -518,6 +684,18 @@ real_config_fd (MMPortSerial *self, int fd, GError **error)
     return TRUE;
 }
 
+static void
+serial_trace (MMPortSerial *self, MMTraceDirection direction, const char *buf, gsize len)
+{
+    if (!mm_trace_enabled ())
+        return;
+
+    if (!self->priv->trace_id)
+        self->priv->trace_id = mm_trace_register_port (mm_port_get_device (MM_PORT (self)),
+                                                       mm_port_get_port_type (MM_PORT (self)));
+    mm_trace_frame (self->priv->trace_id, direction, (const guint8 *) buf, len);
+}
+
 static void
 serial_debug (MMPortSerial *self, const char *prefix, const char *buf, gsize len)
 {
@@ -551,6 +729,7 @@ port_serial_process_command (MMPortSerial *self,
     /* Only print command the first time */
     if (ctx->started == FALSE) {
         ctx->started = TRUE;
+        serial_trace (self, MM_TRACE_DIRECTION_TX, (const char *) ctx->command->data, ctx->command->len);
         serial_debug (self, "-->", (const char *) ctx->command->data, ctx->command->len);
     }
 
@@ -675,6 +854,34 @@ port_serial_get_cached_reply (MMPortSerial *self,
     return (const GByteArray *)g_hash_table_lookup (self->priv->reply_cache, command);
 }
 
+void
+mm_port_serial_foreach_cached_reply (MMPortSerial *self,
+                                     MMPortSerialCachedReplyFn callback,
+                                     gpointer user_data)
+{
+    GHashTableIter iter;
+    gpointer command;
+    gpointer response;
+
+    g_return_if_fail (MM_IS_PORT_SERIAL (self));
+
+    g_hash_table_iter_init (&iter, self->priv->reply_cache);
+    while (g_hash_table_iter_next (&iter, &command, &response))
+        callback ((const GByteArray *) command, (const GByteArray *) response, user_data);
+}
+
+void
+mm_port_serial_add_cached_reply (MMPortSerial *self,
+                                 const GByteArray *command,
+                                 const GByteArray *response)
+{
+    g_return_if_fail (MM_IS_PORT_SERIAL (self));
+    g_return_if_fail (response != NULL);
+
+    if (!g_hash_table_lookup (self->priv->reply_cache, command))
+        port_serial_set_cached_reply (self, command, response);
+}
+
 static void
 port_serial_schedule_queue_process (MMPortSerial *self, guint timeout_ms)
 {
@@ -714,7 +921,7 @@ port_serial_got_response (MMPortSerial *self,
 
     g_clear_object (&self->priv->cancellable);
 
-    ctx = (CommandContext *) g_queue_pop_head (self->priv->queue);
+    ctx = port_serial_queue_pop (self);
     if (ctx) {
         if (error)
             g_simple_async_result_set_from_error (ctx->result, error);
@@ -797,6 +1004,8 @@ port_serial_queue_process (gpointer data)
     if (!ctx)
         return FALSE;
 
+    port_serial_account_wait (self, ctx);
+
     if (ctx->allow_cached) {
         const GByteArray *cached;
 
@@ -866,9 +1075,17 @@ parse_response (MMPortSerial *self,
                 GByteArray *response,
                 GError **error)
 {
+    CommandContext *ctx;
+
     if (MM_PORT_SERIAL_GET_CLASS (self)->parse_unsolicited)
         MM_PORT_SERIAL_GET_CLASS (self)->parse_unsolicited (self, response);
 
+    /* Let streaming commands consume what they can before the final response
+     * is looked for */
+    ctx = (CommandContext *) g_queue_peek_head (self->priv->queue);
+    if (ctx && ctx->done && ctx->partial_response_fn)
+        ctx->partial_response_fn (self, response, ctx->partial_response_user_data);
+
     g_return_val_if_fail (MM_PORT_SERIAL_GET_CLASS (self)->parse_response, FALSE);
     return MM_PORT_SERIAL_GET_CLASS (self)->parse_response (self, response, error);
 }
@@ -877,7 +1094,8 @@ static gboolean
 common_input_available (MMPortSerial *self,
                         GIOCondition condition)
 {
-    char buf[SERIAL_BUF_SIZE + 1];
+    gchar *buf;
+    guint previous_len;
     gsize bytes_read;
     GIOStatus status = G_IO_STATUS_NORMAL;
     CommandContext *ctx;
@@ -888,15 +1106,13 @@ common_input_available (MMPortSerial *self,
         device = mm_port_get_device (MM_PORT (self));
         mm_dbg ("(%s) unexpected port hangup!", device);
 
-        if (self->priv->response->len)
-            g_byte_array_remove_range (self->priv->response, 0, self->priv->response->len);
+        g_byte_array_set_size (self->priv->response, 0);
         port_serial_close_force (self);
         return FALSE;
     }
 
     if (condition & G_IO_ERR) {
-        if (self->priv->response->len)
-            g_byte_array_remove_range (self->priv->response, 0, self->priv->response->len);
+        g_byte_array_set_size (self->priv->response, 0);
         return TRUE;
     }
 
@@ -908,6 +1124,11 @@ common_input_available (MMPortSerial *self,
     do {
         bytes_read = 0;
 
+        /* Read right into the free space at the end of the response buffer */
+        previous_len = self->priv->response->len;
+        g_byte_array_set_size (self->priv->response, previous_len + SERIAL_BUF_SIZE);
+        buf = (gchar *) &self->priv->response->data[previous_len];
+
         if (self->priv->iochannel) {
             status = g_io_channel_read_chars (self->priv->iochannel,
                                               buf,
@@ -942,15 +1163,15 @@ common_input_available (MMPortSerial *self,
                 status = G_IO_STATUS_NORMAL;
         }
 
-
+        g_byte_array_set_size (self->priv->response, previous_len + bytes_read);
 
         /* If no bytes read, just wait for more data */
         if (bytes_read == 0)
             break;
 
         g_assert (bytes_read > 0);
+        serial_trace (self, MM_TRACE_DIRECTION_RX, buf, bytes_read);
         serial_debug (self, "<--", buf, bytes_read);
-        g_byte_array_append (self->priv->response, (const guint8 *) buf, bytes_read);
 
         /* Make sure the response doesn't grow too long */
         if ((self->priv->response->len > SERIAL_BUF_SIZE) && self->priv->spew_control) {
@@ -1381,6 +1602,10 @@ mm_port_serial_close (MMPortSerial *self)
         command_context_complete_and_free (ctx, TRUE);
     }
     g_queue_clear (self->priv->queue);
+    for (i = 0; i <= MM_PORT_SERIAL_COMMAND_PRIORITY_LAST; i++)
+        self->priv->command_stats[i].queued = 0;
+
+    port_serial_log_command_stats (self);
 
     if (self->priv->timeout_id) {
         g_source_remove (self->priv->timeout_id);
@@ -1865,7 +2090,7 @@ mm_port_serial_init (MMPortSerial *self)
     self->priv->send_delay = 1000;
 
     self->priv->queue = g_queue_new ();
-    self->priv->response = g_byte_array_sized_new (500);
+    self->priv->response = g_byte_array_sized_new (SERIAL_RESPONSE_BUF_SIZE);
 }
 
 static void
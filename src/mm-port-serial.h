@@ -40,6 +40,24 @@
 #define MM_PORT_SERIAL_SPEW_CONTROL "spew-control" /* Construct-only */
 #define MM_PORT_SERIAL_FLASH_OK     "flash-ok" /* Construct-only */
 
+/* Commands are sent in priority order; commands of the same priority are
+ * sent in the order they were queued. */
+typedef enum {
+    MM_PORT_SERIAL_COMMAND_PRIORITY_INTERACTIVE = 0, /* Default */
+    MM_PORT_SERIAL_COMMAND_PRIORITY_POLL,            /* Periodic status polls */
+    MM_PORT_SERIAL_COMMAND_PRIORITY_BULK,            /* Long listings and scans */
+    MM_PORT_SERIAL_COMMAND_PRIORITY_LAST = MM_PORT_SERIAL_COMMAND_PRIORITY_BULK
+} MMPortSerialCommandPriority;
+
+/* Per-priority command queue statistics, wait times in microseconds */
+typedef struct {
+    guint  queued;
+    guint  max_queued;
+    guint  processed;
+    gint64 total_wait;
+    gint64 max_wait;
+} MMPortSerialCommandStats;
+
 typedef struct _MMPortSerial MMPortSerial;
 typedef struct _MMPortSerialClass MMPortSerialClass;
 typedef struct _MMPortSerialPrivate MMPortSerialPrivate;
@@ -127,6 +145,7 @@ void        mm_port_serial_command        (MMPortSerial *self,
                                            GByteArray *command,
                                            guint32 timeout_seconds,
                                            gboolean allow_cached,
+                                           MMPortSerialCommandPriority priority,
                                            GCancellable *cancellable,
                                            GAsyncReadyCallback callback,
                                            gpointer user_data);
@@ -134,4 +153,37 @@ GByteArray *mm_port_serial_command_finish (MMPortSerial *self,
                                            GAsyncResult *res,
                                            GError **error);
 
+/* Streaming commands get the data received so far passed to the partial
+ * response handler before the response parser runs, so that complete entries
+ * of long responses can be processed and removed from the buffer as they
+ * arrive. The finish() result only has what was left in the buffer. */
+typedef void (* MMPortSerialPartialResponseFn) (MMPortSerial *self,
+                                                GByteArray *response,
+                                                gpointer user_data);
+void        mm_port_serial_command_streaming (MMPortSerial *self,
+                                              GByteArray *command,
+                                              guint32 timeout_seconds,
+                                              MMPortSerialCommandPriority priority,
+                                              MMPortSerialPartialResponseFn partial_response_fn,
+                                              gpointer partial_response_user_data,
+                                              GCancellable *cancellable,
+                                              GAsyncReadyCallback callback,
+                                              gpointer user_data);
+
+void        mm_port_serial_get_command_stats (MMPortSerial *self,
+                                              MMPortSerialCommandPriority priority,
+                                              MMPortSerialCommandStats *stats);
+
+/* Access to the cache of replies of commands sent with 'allow_cached' */
+typedef void (* MMPortSerialCachedReplyFn) (const GByteArray *command,
+                                            const GByteArray *response,
+                                            gpointer user_data);
+void        mm_port_serial_foreach_cached_reply (MMPortSerial *self,
+                                                 MMPortSerialCachedReplyFn callback,
+                                                 gpointer user_data);
+/* Entries already in the cache are not replaced */
+void        mm_port_serial_add_cached_reply     (MMPortSerial *self,
+                                                 const GByteArray *command,
+                                                 const GByteArray *response);
+
 #endif /* MM_PORT_SERIAL_H */
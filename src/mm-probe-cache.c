@@ -0,0 +1,227 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include <ModemManager.h>
+#include <mm-errors-types.h>
+
+#include "mm-probe-cache.h"
+#include "mm-log.h"
+
+/* One group per port, e.g.:
+ *
+ *   [1199:68a2:03:qcserial:tty]
+ *   flags=127
+ *   at=true
+ *   ...
+ */
+
+#define KEY_FLAGS   "flags"
+#define KEY_AT      "at"
+#define KEY_QCDM    "qcdm"
+#define KEY_QMI     "qmi"
+#define KEY_MBIM    "mbim"
+#define KEY_ICERA   "icera"
+#define KEY_VENDOR  "vendor"
+#define KEY_PRODUCT "product"
+
+/* Stores are written out in batches, as the ports of a modem are usually
+ * probed within a few seconds of each other */
+#define SAVE_DELAY_SECONDS 5
+
+static GKeyFile *cache;
+static gchar *cache_path;
+static guint save_id;
+
+/*****************************************************************************/
+
+gboolean
+mm_probe_cache_setup (const gchar *cache_file,
+                      GError **error)
+{
+    GError *inner_error = NULL;
+    gchar *dir;
+
+    mm_probe_cache_shutdown ();
+
+    dir = g_path_get_dirname (cache_file);
+    if (g_mkdir_with_parents (dir, 0700) < 0) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
+                     "Couldn't create probe cache directory: (%d) %s",
+                     errno, strerror (errno));
+        g_free (dir);
+        return FALSE;
+    }
+    g_free (dir);
+
+    cache_path = g_strdup (cache_file);
+    cache = g_key_file_new ();
+
+    /* A missing or broken cache is just an empty one */
+    if (!g_key_file_load_from_file (cache, cache_path, G_KEY_FILE_NONE, &inner_error)) {
+        if (!g_error_matches (inner_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            mm_warn ("Ignoring probe cache contents: %s", inner_error->message);
+        g_error_free (inner_error);
+    }
+
+    return TRUE;
+}
+
+gboolean
+mm_probe_cache_enabled (void)
+{
+    return !!cache;
+}
+
+gchar *
+mm_probe_cache_build_key (guint16 vendor_id,
+                          guint16 product_id,
+                          const gchar *interface_number,
+                          const gchar *driver,
+                          const gchar *subsystem)
+{
+    if (!vendor_id || !interface_number || !driver || !subsystem)
+        return NULL;
+
+    return g_strdup_printf ("%04x:%04x:%s:%s:%s",
+                            vendor_id, product_id,
+                            interface_number, driver, subsystem);
+}
+
+static void
+cache_save (void)
+{
+    GError *error = NULL;
+    gchar *data;
+    gsize len;
+
+    data = g_key_file_to_data (cache, &len, NULL);
+    if (!g_file_set_contents (cache_path, data, len, &error)) {
+        mm_warn ("Couldn't write probe cache: %s", error->message);
+        g_error_free (error);
+    }
+    g_free (data);
+}
+
+static gboolean
+cache_save_cb (gpointer user_data)
+{
+    save_id = 0;
+    cache_save ();
+    return FALSE;
+}
+
+static void
+cache_schedule_save (void)
+{
+    if (!save_id)
+        save_id = g_timeout_add_seconds (SAVE_DELAY_SECONDS, cache_save_cb, NULL);
+}
+
+void
+mm_probe_cache_flush (void)
+{
+    if (!save_id)
+        return;
+
+    g_source_remove (save_id);
+    save_id = 0;
+    cache_save ();
+}
+
+void
+mm_probe_cache_shutdown (void)
+{
+    if (!cache)
+        return;
+
+    mm_probe_cache_flush ();
+    g_key_file_free (cache);
+    cache = NULL;
+    g_free (cache_path);
+    cache_path = NULL;
+}
+
+/*****************************************************************************/
+
+void
+mm_probe_cache_entry_clear (MMProbeCacheEntry *entry)
+{
+    g_free (entry->vendor);
+    g_free (entry->product);
+    memset (entry, 0, sizeof (MMProbeCacheEntry));
+}
+
+gboolean
+mm_probe_cache_lookup (const gchar *key,
+                       MMProbeCacheEntry *entry)
+{
+    g_return_val_if_fail (cache != NULL, FALSE);
+
+    memset (entry, 0, sizeof (MMProbeCacheEntry));
+    if (!g_key_file_has_group (cache, key))
+        return FALSE;
+
+    /* Missing or unparseable values are read as 0/FALSE/NULL */
+    entry->flags = (guint32) g_key_file_get_integer (cache, key, KEY_FLAGS, NULL);
+    entry->is_at = g_key_file_get_boolean (cache, key, KEY_AT, NULL);
+    entry->is_qcdm = g_key_file_get_boolean (cache, key, KEY_QCDM, NULL);
+    entry->is_qmi = g_key_file_get_boolean (cache, key, KEY_QMI, NULL);
+    entry->is_mbim = g_key_file_get_boolean (cache, key, KEY_MBIM, NULL);
+    entry->is_icera = g_key_file_get_boolean (cache, key, KEY_ICERA, NULL);
+    entry->vendor = g_key_file_get_string (cache, key, KEY_VENDOR, NULL);
+    entry->product = g_key_file_get_string (cache, key, KEY_PRODUCT, NULL);
+
+    return (entry->flags != 0);
+}
+
+gboolean
+mm_probe_cache_entry_needs_open (const MMProbeCacheEntry *entry)
+{
+    /* QMI and MBIM ports are validated when opened by the modem */
+    return (entry->is_at || entry->is_qcdm);
+}
+
+void
+mm_probe_cache_store (const gchar *key,
+                      const MMProbeCacheEntry *entry)
+{
+    g_return_if_fail (cache != NULL);
+
+    g_key_file_remove_group (cache, key, NULL);
+    g_key_file_set_integer (cache, key, KEY_FLAGS, (gint) entry->flags);
+    g_key_file_set_boolean (cache, key, KEY_AT, entry->is_at);
+    g_key_file_set_boolean (cache, key, KEY_QCDM, entry->is_qcdm);
+    g_key_file_set_boolean (cache, key, KEY_QMI, entry->is_qmi);
+    g_key_file_set_boolean (cache, key, KEY_MBIM, entry->is_mbim);
+    g_key_file_set_boolean (cache, key, KEY_ICERA, entry->is_icera);
+    if (entry->vendor)
+        g_key_file_set_string (cache, key, KEY_VENDOR, entry->vendor);
+    if (entry->product)
+        g_key_file_set_string (cache, key, KEY_PRODUCT, entry->product);
+
+    cache_schedule_save ();
+}
+
+void
+mm_probe_cache_remove (const gchar *key)
+{
+    g_return_if_fail (cache != NULL);
+
+    if (g_key_file_remove_group (cache, key, NULL))
+        cache_schedule_save ();
+}
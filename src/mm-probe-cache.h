@@ -0,0 +1,61 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_PROBE_CACHE_H
+#define MM_PROBE_CACHE_H
+
+#include <glib.h>
+
+/* Persistent cache of port probing results, keyed by the USB vendor and
+ * product IDs, interface number, driver and subsystem of the port, so that
+ * known hardware doesn't need to go through AT/QCDM probing again when it is
+ * re-plugged. Disabled unless a cache file is given. */
+
+typedef struct {
+    /* Mask of MMPortProbeFlag results available in the entry */
+    guint32 flags;
+    gboolean is_at;
+    gboolean is_qcdm;
+    gboolean is_qmi;
+    gboolean is_mbim;
+    gboolean is_icera;
+    gchar *vendor;
+    gchar *product;
+} MMProbeCacheEntry;
+
+gboolean mm_probe_cache_setup   (const gchar *cache_file,
+                                 GError **error);
+gboolean mm_probe_cache_enabled (void);
+/* Changes are written out with a small delay; flush() writes them right
+ * away, and shutdown() flushes and disables the cache */
+void     mm_probe_cache_flush    (void);
+void     mm_probe_cache_shutdown (void);
+
+/* Returns NULL if the port cannot be reliably identified */
+gchar   *mm_probe_cache_build_key (guint16 vendor_id,
+                                   guint16 product_id,
+                                   const gchar *interface_number,
+                                   const gchar *driver,
+                                   const gchar *subsystem);
+
+gboolean mm_probe_cache_lookup (const gchar *key,
+                                MMProbeCacheEntry *entry);
+void     mm_probe_cache_store  (const gchar *key,
+                                const MMProbeCacheEntry *entry);
+void     mm_probe_cache_remove (const gchar *key);
+
+void     mm_probe_cache_entry_clear (MMProbeCacheEntry *entry);
+/* Whether the port must be opened before trusting the cached results */
+gboolean mm_probe_cache_entry_needs_open (const MMProbeCacheEntry *entry);
+
+#endif /* MM_PROBE_CACHE_H */
@@ -0,0 +1,113 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <config.h>
+
+#include "mm-property-batch.h"
+#include "mm-context.h"
+#include "mm-log.h"
+
+/* The generated skeletons schedule the PropertiesChanged emission from their
+ * "notify" handler, so keeping notifications frozen during the window is
+ * enough to merge all the changes done meanwhile into a single signal. */
+
+#define PROPERTY_BATCH_TAG "property-batch-tag"
+
+static GQuark property_batch_quark;
+
+typedef struct {
+    GObject *object;
+    guint n_updates;
+    guint timeout_id;
+} PropertyBatch;
+
+/* Totals since startup; updates only count actual value changes, each of
+ * which would have been emitted on its own without the batch */
+static guint64 total_updates;
+static guint64 total_emissions;
+
+/*****************************************************************************/
+
+static gboolean
+property_batch_timeout (PropertyBatch *batch)
+{
+    GObject *object;
+
+    total_updates += batch->n_updates;
+    total_emissions++;
+    if (batch->n_updates > 1)
+        mm_dbg ("Merged %u property updates in a single emission "
+                "(%" G_GUINT64_FORMAT " updates, %" G_GUINT64_FORMAT " emissions saved so far)",
+                batch->n_updates,
+                total_updates,
+                total_updates - total_emissions);
+
+    /* Thawing may end up running arbitrary handlers, so remove the batch
+     * before, just in case a new one gets started */
+    object = batch->object;
+    g_object_set_qdata (object, property_batch_quark, NULL);
+    g_slice_free (PropertyBatch, batch);
+
+    g_object_thaw_notify (object);
+    g_object_unref (object);
+    return FALSE;
+}
+
+void
+mm_property_batch_update (gpointer skeleton)
+{
+    PropertyBatch *batch;
+    guint window;
+
+    g_return_if_fail (G_IS_OBJECT (skeleton));
+
+    window = mm_context_get_property_batch_window ();
+    if (!window)
+        return;
+
+    if (G_UNLIKELY (!property_batch_quark))
+        property_batch_quark = g_quark_from_static_string (PROPERTY_BATCH_TAG);
+
+    batch = g_object_get_qdata (G_OBJECT (skeleton), property_batch_quark);
+    if (batch) {
+        batch->n_updates++;
+        return;
+    }
+
+    /* The batch keeps a reference until flushed, so that the held back
+     * notifications are always delivered */
+    batch = g_slice_new (PropertyBatch);
+    batch->object = g_object_ref (skeleton);
+    batch->n_updates = 1;
+    g_object_freeze_notify (batch->object);
+    batch->timeout_id = g_timeout_add (window, (GSourceFunc)property_batch_timeout, batch);
+    g_object_set_qdata (batch->object, property_batch_quark, batch);
+}
+
+void
+mm_property_batch_flush (gpointer skeleton)
+{
+    PropertyBatch *batch;
+
+    g_return_if_fail (G_IS_OBJECT (skeleton));
+
+    if (!property_batch_quark)
+        return;
+
+    batch = g_object_get_qdata (G_OBJECT (skeleton), property_batch_quark);
+    if (!batch)
+        return;
+
+    g_source_remove (batch->timeout_id);
+    property_batch_timeout (batch);
+}
@@ -0,0 +1,38 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_PROPERTY_BATCH_H
+#define MM_PROPERTY_BATCH_H
+
+#include <glib-object.h>
+
+/* Merges updates of frequently changing properties of a DBus interface
+ * skeleton into a single PropertiesChanged signal.
+ *
+ * Call it right before setting the property, and only if the new value is
+ * different, as the skeleton emits nothing otherwise. Property values are
+ * updated right away, only the change notifications are held back until the
+ * batch window (see --property-batch-window) elapses, so that all the
+ * properties updated in the meantime get emitted together.
+ *
+ * Notifications are frozen on the whole skeleton, so during the window the
+ * changes of every property of the interface are held back, not just those
+ * of the properties updated through the batch. */
+void mm_property_batch_update (gpointer skeleton);
+
+/* Delivers the notifications held back right away. Call it before emitting
+ * a signal or flushing the skeleton when clients expect the property values
+ * to be already up to date (e.g. StateChanged). */
+void mm_property_batch_flush (gpointer skeleton);
+
+#endif /* MM_PROPERTY_BATCH_H */
@@ -0,0 +1,281 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include <ModemManager.h>
+#include <mm-errors-types.h>
+
+#include "mm-reply-cache.h"
+
+/* Serialized as (equipment identifier, revision, [(command, response)]) */
+#define REPLY_CACHE_FORMAT "(ssa(ayay))"
+
+struct _MMReplyCache {
+    gchar *equipment_identifier;
+    gchar *revision;
+    GPtrArray *commands;
+    GPtrArray *responses;
+};
+
+static gchar *cache_dir;
+
+/*****************************************************************************/
+
+gboolean
+mm_reply_cache_setup (const gchar *dir,
+                      GError **error)
+{
+    if (g_mkdir_with_parents (dir, 0700) < 0) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
+                     "Couldn't create reply cache directory: (%d) %s",
+                     errno, strerror (errno));
+        return FALSE;
+    }
+
+    g_free (cache_dir);
+    cache_dir = g_strdup (dir);
+    return TRUE;
+}
+
+gboolean
+mm_reply_cache_enabled (void)
+{
+    return !!cache_dir;
+}
+
+static gchar *
+build_path (guint16 vendor_id,
+            guint16 product_id,
+            const gchar *physdev)
+{
+    gchar *key;
+    gchar *name;
+    gchar *path;
+
+    /* The same modem model may be plugged in different physical ports at
+     * the same time, so the physical device is part of the key */
+    key = g_strdup_printf ("%04x:%04x:%s", vendor_id, product_id, physdev);
+    name = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+    path = g_build_filename (cache_dir, name, NULL);
+    g_free (name);
+    g_free (key);
+    return path;
+}
+
+/*****************************************************************************/
+
+/* Only replies which never change for a given modem and firmware are
+ * persisted: identity queries and the lists of supported values. Test
+ * commands are listed one by one, as some of them (e.g. the +COPS=? network
+ * scan) report state rather than capabilities. */
+static const gchar *static_commands[] = {
+    "+CGMI", "+CGMM", "+CGMR", "+CGSN",
+    "+GMI", "+GMM", "+GMR", "+GSN",
+    "+GCAP", "I", "I1",
+    "+CGDCONT=?", "+CIND=?", "+CLCK=?", "+CMGF=?", "+CNMI=?",
+    "+CPMS=?", "+CRM=?", "+CSCS=?", "+CUSD=?", "+WS46=?",
+};
+
+gboolean
+mm_reply_cache_command_is_static (const GByteArray *command)
+{
+    const gchar *str = (const gchar *) command->data;
+    gsize len = command->len;
+    guint i;
+
+    if (len >= 2 && !g_ascii_strncasecmp (str, "AT", 2)) {
+        str += 2;
+        len -= 2;
+    }
+    while (len > 0 && (str[len - 1] == '\r' || str[len - 1] == '\n'))
+        len--;
+
+    for (i = 0; i < G_N_ELEMENTS (static_commands); i++) {
+        if (strlen (static_commands[i]) == len &&
+            !g_ascii_strncasecmp (str, static_commands[i], len))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*****************************************************************************/
+
+void
+mm_reply_cache_free (MMReplyCache *cache)
+{
+    g_free (cache->equipment_identifier);
+    g_free (cache->revision);
+    g_ptr_array_unref (cache->commands);
+    g_ptr_array_unref (cache->responses);
+    g_slice_free (MMReplyCache, cache);
+}
+
+const gchar *
+mm_reply_cache_get_equipment_identifier (MMReplyCache *cache)
+{
+    return cache->equipment_identifier;
+}
+
+const gchar *
+mm_reply_cache_get_revision (MMReplyCache *cache)
+{
+    return cache->revision;
+}
+
+static GByteArray *
+byte_array_from_variant (GVariant *variant)
+{
+    GByteArray *array;
+    gconstpointer data;
+    gsize len;
+
+    data = g_variant_get_fixed_array (variant, &len, sizeof (guint8));
+    array = g_byte_array_sized_new (len);
+    g_byte_array_append (array, data, len);
+    return array;
+}
+
+MMReplyCache *
+mm_reply_cache_load (guint16 vendor_id,
+                     guint16 product_id,
+                     const gchar *physdev,
+                     GError **error)
+{
+    MMReplyCache *cache;
+    GVariant *variant;
+    GVariant *entries;
+    GVariantIter iter;
+    GVariant *command;
+    GVariant *response;
+    gchar *path;
+    gchar *contents;
+    gsize len;
+
+    g_return_val_if_fail (cache_dir != NULL, NULL);
+
+    path = build_path (vendor_id, product_id, physdev);
+    if (!g_file_get_contents (path, &contents, &len, error)) {
+        g_free (path);
+        return NULL;
+    }
+    g_free (path);
+
+    /* Not trusted, any corruption just gives default values */
+    variant = g_variant_new_from_data (G_VARIANT_TYPE (REPLY_CACHE_FORMAT),
+                                       contents, len,
+                                       FALSE,
+                                       g_free, contents);
+    g_variant_ref_sink (variant);
+
+    cache = g_slice_new0 (MMReplyCache);
+    cache->commands = g_ptr_array_new_with_free_func ((GDestroyNotify) g_byte_array_unref);
+    cache->responses = g_ptr_array_new_with_free_func ((GDestroyNotify) g_byte_array_unref);
+
+    g_variant_get (variant, "(ss@a(ayay))",
+                   &cache->equipment_identifier,
+                   &cache->revision,
+                   &entries);
+
+    g_variant_iter_init (&iter, entries);
+    while (g_variant_iter_next (&iter, "(@ay@ay)", &command, &response)) {
+        g_ptr_array_add (cache->commands, byte_array_from_variant (command));
+        g_ptr_array_add (cache->responses, byte_array_from_variant (response));
+        g_variant_unref (command);
+        g_variant_unref (response);
+    }
+
+    g_variant_unref (entries);
+    g_variant_unref (variant);
+
+    if (!cache->equipment_identifier[0] || !cache->commands->len) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
+                     "Invalid reply cache contents");
+        mm_reply_cache_free (cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+guint
+mm_reply_cache_apply (MMReplyCache *cache,
+                      MMPortSerial *port)
+{
+    guint i;
+
+    for (i = 0; i < cache->commands->len; i++)
+        mm_port_serial_add_cached_reply (port,
+                                         g_ptr_array_index (cache->commands, i),
+                                         g_ptr_array_index (cache->responses, i));
+    return cache->commands->len;
+}
+
+/*****************************************************************************/
+
+static void
+add_static_reply (const GByteArray *command,
+                  const GByteArray *response,
+                  GVariantBuilder *builder)
+{
+    if (!mm_reply_cache_command_is_static (command))
+        return;
+
+    g_variant_builder_add (builder, "(@ay@ay)",
+                           g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                                      command->data, command->len,
+                                                      sizeof (guint8)),
+                           g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                                      response->data, response->len,
+                                                      sizeof (guint8)));
+}
+
+gboolean
+mm_reply_cache_save (guint16 vendor_id,
+                     guint16 product_id,
+                     const gchar *physdev,
+                     const gchar *equipment_identifier,
+                     const gchar *revision,
+                     MMPortSerial *port,
+                     GError **error)
+{
+    GVariantBuilder builder;
+    GVariant *variant;
+    gchar *path;
+    gboolean saved;
+
+    g_return_val_if_fail (cache_dir != NULL, FALSE);
+    g_return_val_if_fail (equipment_identifier != NULL, FALSE);
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ayay)"));
+    mm_port_serial_foreach_cached_reply (port,
+                                         (MMPortSerialCachedReplyFn) add_static_reply,
+                                         &builder);
+    variant = g_variant_ref_sink (g_variant_new ("(ssa(ayay))",
+                                                 equipment_identifier,
+                                                 revision ? revision : "",
+                                                 &builder));
+
+    path = build_path (vendor_id, product_id, physdev);
+    saved = g_file_set_contents (path,
+                                 g_variant_get_data (variant),
+                                 g_variant_get_size (variant),
+                                 error);
+    g_free (path);
+    g_variant_unref (variant);
+    return saved;
+}
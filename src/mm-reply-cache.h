@@ -0,0 +1,56 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_REPLY_CACHE_H
+#define MM_REPLY_CACHE_H
+
+#include <glib.h>
+
+#include "mm-port-serial.h"
+
+/* Persistent cache of the replies to static queries (identity, capabilities
+ * and supported value lists), so that they can be reused by the primary port
+ * of a known modem after a restart or re-plug. Disabled unless a cache
+ * directory is given. */
+
+typedef struct _MMReplyCache MMReplyCache;
+
+gboolean      mm_reply_cache_setup   (const gchar *cache_dir,
+                                      GError **error);
+gboolean      mm_reply_cache_enabled (void);
+
+MMReplyCache *mm_reply_cache_load (guint16 vendor_id,
+                                   guint16 product_id,
+                                   const gchar *physdev,
+                                   GError **error);
+void          mm_reply_cache_free (MMReplyCache *cache);
+
+const gchar  *mm_reply_cache_get_equipment_identifier (MMReplyCache *cache);
+const gchar  *mm_reply_cache_get_revision             (MMReplyCache *cache);
+
+/* Returns the number of replies added to the port cache */
+guint         mm_reply_cache_apply (MMReplyCache *cache,
+                                    MMPortSerial *port);
+
+gboolean      mm_reply_cache_save (guint16 vendor_id,
+                                   guint16 product_id,
+                                   const gchar *physdev,
+                                   const gchar *equipment_identifier,
+                                   const gchar *revision,
+                                   MMPortSerial *port,
+                                   GError **error);
+
+/* Just for unit tests */
+gboolean      mm_reply_cache_command_is_static (const GByteArray *command);
+
+#endif /* MM_REPLY_CACHE_H */
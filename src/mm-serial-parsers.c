@@ -80,6 +80,9 @@ remove_matches (GRegex *r, GString *string)
 }
 
 typedef struct {
+    /* Whether the built-in replies are matched with the regex cascade below
+     * instead of the single-pass classifier */
+    gboolean use_regex;
     /* Regular expressions for successful replies */
     GRegex *regex_ok;
     GRegex *regex_connect;
@@ -100,13 +103,13 @@ typedef struct {
     gpointer                      filter_user_data;
 } MMSerialParserV1;
 
-gpointer
-mm_serial_parser_v1_new (void)
+static void
+regex_cascade_init (MMSerialParserV1 *parser)
 {
-    MMSerialParserV1 *parser;
     GRegexCompileFlags flags = G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW | G_REGEX_OPTIMIZE;
 
-    parser = g_slice_new (MMSerialParserV1);
+    if (parser->regex_ok)
+        return;
 
     parser->regex_ok = g_regex_new ("\\r\\nOK(\\r\\n)+$", flags, 0, NULL);
     parser->regex_connect = g_regex_new ("\\r\\nCONNECT.*\\r\\n", flags, 0, NULL);
@@ -120,15 +123,63 @@ mm_serial_parser_v1_new (void)
     parser->regex_connect_failed = g_regex_new ("\\r\\n(NO CARRIER)|(BUSY)|(NO ANSWER)|(NO DIALTONE)\\r\\n$", flags, 0, NULL);
     /* Samsung Z810 may reply "NA" to report a not-available error */
     parser->regex_na = g_regex_new ("\\r\\nNA\\r\\n", flags, 0, NULL);
+}
+
+static void
+regex_cascade_clear (MMSerialParserV1 *parser)
+{
+    if (!parser->regex_ok)
+        return;
+
+    g_regex_unref (parser->regex_ok);
+    g_regex_unref (parser->regex_connect);
+    g_regex_unref (parser->regex_sms);
+    g_regex_unref (parser->regex_cme_error);
+    g_regex_unref (parser->regex_cms_error);
+    g_regex_unref (parser->regex_cme_error_str);
+    g_regex_unref (parser->regex_cms_error_str);
+    g_regex_unref (parser->regex_ezx_error);
+    g_regex_unref (parser->regex_unknown_error);
+    g_regex_unref (parser->regex_connect_failed);
+    g_regex_unref (parser->regex_na);
+    parser->regex_ok = NULL;
+}
+
+/* Process-wide default for newly created parsers */
+static gboolean default_use_regex;
 
-    parser->regex_custom_successful = NULL;
-    parser->regex_custom_error = NULL;
-    parser->filter_callback = NULL;
-    parser->filter_user_data = NULL;
+void
+mm_serial_parser_v1_set_default_use_regex (gboolean use_regex)
+{
+    default_use_regex = use_regex;
+}
+
+gpointer
+mm_serial_parser_v1_new (void)
+{
+    MMSerialParserV1 *parser;
+
+    parser = g_slice_new0 (MMSerialParserV1);
+
+    /* The regex cascade is only compiled if explicitly requested */
+    mm_serial_parser_v1_set_use_regex (parser, default_use_regex);
 
     return parser;
 }
 
+void
+mm_serial_parser_v1_set_use_regex (gpointer data,
+                                   gboolean use_regex)
+{
+    MMSerialParserV1 *parser = (MMSerialParserV1 *) data;
+
+    g_return_if_fail (parser != NULL);
+
+    parser->use_regex = use_regex;
+    if (use_regex)
+        regex_cascade_init (parser);
+}
+
 void
 mm_serial_parser_v1_set_custom_regex (gpointer data,
                                       GRegex *successful,
@@ -160,89 +211,37 @@ mm_serial_parser_v1_add_filter (gpointer data,
     parser->filter_user_data = user_data;
 }
 
-gboolean
-mm_serial_parser_v1_parse (gpointer data,
-                           GString *response,
-                           GError **error)
-{
-    MMSerialParserV1 *parser = (MMSerialParserV1 *) data;
-    GMatchInfo *match_info;
-    GError *local_error = NULL;
-    gboolean found = FALSE;
-    char *str = NULL;
-
-    g_return_val_if_fail (parser != NULL, FALSE);
-    g_return_val_if_fail (response != NULL, FALSE);
-
-    /* Skip NUL bytes if they are found leading the response */
-    while (response->len > 0 && response->str[0] == '\0')
-        g_string_erase (response, 0, 1);
-
-    if (G_UNLIKELY (!response->len))
-        return FALSE;
+/*****************************************************************************/
+/* Regex cascade */
 
-    /* First, apply custom filter if any */
-    if (parser->filter_callback &&
-        !parser->filter_callback (parser,
-                                  parser->filter_user_data,
-                                  response,
-                                  &local_error)) {
-        g_assert (local_error != NULL);
-        mm_dbg ("Got response filtered in serial port: %s", local_error->message);
-        g_propagate_error (error, local_error);
-        response_clean (response);
-        return TRUE;
-    }
-
-    /* Then, check for successful responses */
-
-    /* Custom successful replies first, if any */
-    if (parser->regex_custom_successful) {
-        found = g_regex_match_full (parser->regex_custom_successful,
-                                    response->str, response->len,
-                                    0, 0, NULL, NULL);
-    }
-
-    if (!found) {
-        found = g_regex_match_full (parser->regex_ok,
-                                    response->str, response->len,
-                                    0, 0, NULL, NULL);
-        if (found)
-            remove_matches (parser->regex_ok, response);
-    }
-
-    if (!found) {
-        found = g_regex_match_full (parser->regex_connect,
-                                    response->str, response->len,
-                                    0, 0, NULL, NULL);
-    }
-
-    if (!found) {
-        found = g_regex_match_full (parser->regex_sms,
-                                    response->str, response->len,
-                                    0, 0, NULL, NULL);
-    }
-
-    if (found) {
-        response_clean (response);
+static gboolean
+regex_match_successful (MMSerialParserV1 *parser,
+                        GString *response)
+{
+    if (g_regex_match_full (parser->regex_ok,
+                            response->str, response->len,
+                            0, 0, NULL, NULL)) {
+        remove_matches (parser->regex_ok, response);
         return TRUE;
     }
 
-    /* Now failures */
+    return (g_regex_match_full (parser->regex_connect,
+                                response->str, response->len,
+                                0, 0, NULL, NULL) ||
+            g_regex_match_full (parser->regex_sms,
+                                response->str, response->len,
+                                0, 0, NULL, NULL));
+}
 
-    /* Custom error matches first, if any */
-    if (parser->regex_custom_error) {
-        found = g_regex_match_full (parser->regex_custom_error,
-                                    response->str, response->len,
-                                    0, 0, &match_info, NULL);
-        if (found) {
-            str = g_match_info_fetch (match_info, 1);
-            g_assert (str);
-            local_error = mm_mobile_equipment_error_for_code (atoi (str));
-            goto done;
-        }
-        g_match_info_free (match_info);
-    }
+static gboolean
+regex_match_error (MMSerialParserV1 *parser,
+                   GString *response,
+                   GError **error)
+{
+    GMatchInfo *match_info;
+    GError *local_error = NULL;
+    gboolean found;
+    char *str = NULL;
 
     /* Numeric CME errors */
     found = g_regex_match_full (parser->regex_cme_error,
@@ -357,6 +356,374 @@ mm_serial_parser_v1_parse (gpointer data,
 done:
     g_free (str);
     g_match_info_free (match_info);
+
+    if (local_error)
+        g_propagate_error (error, local_error);
+
+    return found;
+}
+
+/*****************************************************************************/
+/* Single-pass classifier
+ *
+ * Recognizes exactly the same replies as the regex cascade above, but
+ * without running a dozen regular expressions over the whole response
+ * buffer on every read. Most of the final result codes are anchored at the
+ * end of the response, so they are recognized scanning backwards from the
+ * tail; the few unanchored ones are looked for in a single forward pass.
+ *
+ * Note that the regex cascade is compiled with G_REGEX_NEWLINE_ANY semantics
+ * (GLib's default), so '.' doesn't match any of <CR>, <LF>, <VT>, <FF> or
+ * NEL (0x85).
+ */
+
+#define IS_REGEX_NEWLINE(c) \
+    ((c) == '\r' || (c) == '\n' || (c) == '\v' || (c) == '\f' || (guint8)(c) == 0x85)
+
+#define IS_CRLF(str, i) \
+    ((str)[i] == '\r' && (str)[(i) + 1] == '\n')
+
+#define HAS_PREFIX_AT(str, len, i, prefix)                  \
+    (((i) + sizeof (prefix) - 1 <= (len)) &&                \
+     !memcmp ((str) + (i), prefix, sizeof (prefix) - 1))
+
+#define HAS_SUFFIX_AT(str, end, suffix)                     \
+    (((end) >= sizeof (suffix) - 1) &&                      \
+     !memcmp ((str) + (end) - (sizeof (suffix) - 1), suffix, sizeof (suffix) - 1))
+
+typedef enum {
+    SCAN_CONNECT        = 1 << 0,
+    SCAN_ERROR          = 1 << 1,
+    SCAN_CONNECT_FAILED = 1 << 2,
+    SCAN_NA             = 1 << 3,
+} ScanFlag;
+
+/* Forward pass looking for the replies which may appear anywhere in the
+ * response, not just at the end of it */
+static guint
+scan_unanchored (const gchar *str,
+                 gsize len)
+{
+    guint flags = 0;
+    gsize i;
+
+    for (i = 0; i < len; i++) {
+        switch (str[i]) {
+        case '\r':
+            if (i + 1 >= len || str[i + 1] != '\n')
+                break;
+            if (HAS_PREFIX_AT (str, len, i + 2, "CONNECT")) {
+                gsize j;
+
+                /* '.*' up to the first line break, which must be <CR><LF> */
+                for (j = i + 9; j < len && !IS_REGEX_NEWLINE (str[j]); j++);
+                if (j + 1 < len && IS_CRLF (str, j))
+                    flags |= SCAN_CONNECT;
+            } else if (HAS_PREFIX_AT (str, len, i + 2, "ERROR"))
+                flags |= SCAN_ERROR;
+            else if (HAS_PREFIX_AT (str, len, i + 2, "NO CARRIER"))
+                flags |= SCAN_CONNECT_FAILED;
+            else if (HAS_PREFIX_AT (str, len, i + 2, "NA\r\n"))
+                flags |= SCAN_NA;
+            break;
+        case 'B':
+            if (HAS_PREFIX_AT (str, len, i, "BUSY"))
+                flags |= SCAN_CONNECT_FAILED;
+            break;
+        case 'N':
+            if (HAS_PREFIX_AT (str, len, i, "NO ANSWER"))
+                flags |= SCAN_CONNECT_FAILED;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return flags;
+}
+
+/* <CR><LF>OK(<CR><LF>)+$ */
+static gboolean
+match_ok (const gchar *str,
+          gsize len,
+          gsize *match_start)
+{
+    gsize end = len;
+
+    while (end >= 2 && IS_CRLF (str, end - 2))
+        end -= 2;
+
+    if (end == len || !HAS_SUFFIX_AT (str, end, "\r\nOK"))
+        return FALSE;
+
+    *match_start = end - 4;
+    return TRUE;
+}
+
+/* <CR><LF>>\s*$ */
+static gboolean
+match_sms_prompt (const gchar *str,
+                  gsize len)
+{
+    gsize end = len;
+
+    while (end > 0 && g_ascii_isspace (str[end - 1]))
+        end--;
+
+    return HAS_SUFFIX_AT (str, end, "\r\n>");
+}
+
+/* <prefix>\s*(\d+)<CR><LF>$ */
+static gboolean
+match_numeric_error (const gchar *str,
+                     gsize len,
+                     const gchar *prefix,
+                     gsize prefix_len,
+                     gsize *code_start)
+{
+    gsize end;
+    gsize start;
+
+    if (len < 2 || !IS_CRLF (str, len - 2))
+        return FALSE;
+    end = len - 2;
+
+    start = end;
+    while (start > 0 && g_ascii_isdigit (str[start - 1]))
+        start--;
+    if (start == end)
+        return FALSE;
+    *code_start = start;
+
+    while (start > 0 && g_ascii_isspace (str[start - 1]))
+        start--;
+
+    return (start >= prefix_len &&
+            !memcmp (str + start - prefix_len, prefix, prefix_len));
+}
+
+/* <prefix>\s*([^\n\r]+)<CR><LF>$
+ *
+ * The error text cannot span lines, so the prefix must either be followed by
+ * a whitespace run covering the last line break before the trailing <CR><LF>,
+ * or start right at that last line break. When both apply, the regex would
+ * have matched the leftmost one. */
+static gboolean
+match_string_error (const gchar *str,
+                    gsize len,
+                    const gchar *prefix,
+                    gsize prefix_len,
+                    gsize *text_start)
+{
+    gsize end;
+    gsize last_eol;
+    gsize start;
+
+    if (len < 2 || !IS_CRLF (str, len - 2))
+        return FALSE;
+    end = len - 2;
+
+    for (last_eol = end; last_eol > 0; last_eol--) {
+        if (str[last_eol - 1] == '\r' || str[last_eol - 1] == '\n')
+            break;
+    }
+    /* The prefix itself has a line break, so there must be one */
+    if (last_eol == 0)
+        return FALSE;
+    last_eol--;
+
+    /* Error text must not be empty */
+    if (last_eol + 1 >= end)
+        return FALSE;
+
+    start = last_eol;
+    while (start > 0 && g_ascii_isspace (str[start - 1]))
+        start--;
+
+    if (start >= prefix_len && !memcmp (str + start - prefix_len, prefix, prefix_len)) {
+        /* Prefix found before the last line break */
+    } else if (last_eol >= 1 &&
+               last_eol - 1 + prefix_len < end &&
+               !memcmp (str + last_eol - 1, prefix, prefix_len)) {
+        /* Prefix found at the last line break */
+        start = last_eol - 1 + prefix_len;
+    } else
+        return FALSE;
+
+    /* Leading whitespace is skipped, as long as some text is left */
+    while (start < end - 1 && g_ascii_isspace (str[start]))
+        start++;
+
+    *text_start = start;
+    return TRUE;
+}
+
+#define CME_ERROR_PREFIX "\r\n+CME ERROR:"
+#define CMS_ERROR_PREFIX "\r\n+CMS ERROR:"
+#define EZX_ERROR_PREFIX "\r\nMODEM ERROR:"
+
+static gboolean
+classifier_match_successful (GString *response,
+                             guint *scan_flags)
+{
+    gsize start;
+
+    if (match_ok (response->str, response->len, &start)) {
+        g_string_truncate (response, start);
+        return TRUE;
+    }
+
+    *scan_flags = scan_unanchored (response->str, response->len);
+
+    return ((*scan_flags & SCAN_CONNECT) ||
+            match_sms_prompt (response->str, response->len));
+}
+
+static gboolean
+classifier_match_error (GString *response,
+                        guint scan_flags,
+                        GError **error)
+{
+    const gchar *str = response->str;
+    gsize len = response->len;
+    gsize start;
+
+    if (match_numeric_error (str, len, CME_ERROR_PREFIX, strlen (CME_ERROR_PREFIX), &start)) {
+        g_propagate_error (error, mm_mobile_equipment_error_for_code (atoi (str + start)));
+        return TRUE;
+    }
+
+    if (match_numeric_error (str, len, CMS_ERROR_PREFIX, strlen (CMS_ERROR_PREFIX), &start)) {
+        g_propagate_error (error, mm_message_error_for_code (atoi (str + start)));
+        return TRUE;
+    }
+
+    if (match_string_error (str, len, CME_ERROR_PREFIX, strlen (CME_ERROR_PREFIX), &start)) {
+        gchar *text;
+
+        text = g_strndup (str + start, len - 2 - start);
+        g_propagate_error (error, mm_mobile_equipment_error_for_string (text));
+        g_free (text);
+        return TRUE;
+    }
+
+    if (match_string_error (str, len, CMS_ERROR_PREFIX, strlen (CMS_ERROR_PREFIX), &start)) {
+        gchar *text;
+
+        text = g_strndup (str + start, len - 2 - start);
+        g_propagate_error (error, mm_message_error_for_string (text));
+        g_free (text);
+        return TRUE;
+    }
+
+    /* Motorola EZX errors */
+    if (match_numeric_error (str, len, EZX_ERROR_PREFIX, strlen (EZX_ERROR_PREFIX), &start)) {
+        g_propagate_error (error, mm_mobile_equipment_error_for_code (MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN));
+        return TRUE;
+    }
+
+    /* Last resort; unknown error */
+    if ((scan_flags & SCAN_ERROR) || HAS_SUFFIX_AT (str, len, "COMMAND NOT SUPPORT\r\n")) {
+        g_propagate_error (error, mm_mobile_equipment_error_for_code (MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN));
+        return TRUE;
+    }
+
+    /* Connection failures. The regex cascade only captures the first
+     * alternative, so every one of these ends up reported as NO CARRIER. */
+    if ((scan_flags & SCAN_CONNECT_FAILED) || HAS_SUFFIX_AT (str, len, "NO DIALTONE\r\n")) {
+        g_propagate_error (error, mm_connection_error_for_code (MM_CONNECTION_ERROR_NO_CARRIER));
+        return TRUE;
+    }
+
+    /* NA error */
+    if (scan_flags & SCAN_NA) {
+        /* Assume NA means 'Not Allowed' :) */
+        g_set_error (error,
+                     MM_MOBILE_EQUIPMENT_ERROR,
+                     MM_MOBILE_EQUIPMENT_ERROR_NOT_ALLOWED,
+                     "Not Allowed");
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*****************************************************************************/
+
+gboolean
+mm_serial_parser_v1_parse (gpointer data,
+                           GString *response,
+                           GError **error)
+{
+    MMSerialParserV1 *parser = (MMSerialParserV1 *) data;
+    GMatchInfo *match_info;
+    GError *local_error = NULL;
+    gboolean found = FALSE;
+    guint scan_flags = 0;
+    char *str;
+
+    g_return_val_if_fail (parser != NULL, FALSE);
+    g_return_val_if_fail (response != NULL, FALSE);
+
+    /* Skip NUL bytes if they are found leading the response */
+    while (response->len > 0 && response->str[0] == '\0')
+        g_string_erase (response, 0, 1);
+
+    if (G_UNLIKELY (!response->len))
+        return FALSE;
+
+    /* First, apply custom filter if any */
+    if (parser->filter_callback &&
+        !parser->filter_callback (parser,
+                                  parser->filter_user_data,
+                                  response,
+                                  &local_error)) {
+        g_assert (local_error != NULL);
+        mm_dbg ("Got response filtered in serial port: %s", local_error->message);
+        g_propagate_error (error, local_error);
+        response_clean (response);
+        return TRUE;
+    }
+
+    /* Then, check for successful responses */
+
+    /* Custom successful replies first, if any */
+    if (parser->regex_custom_successful)
+        found = g_regex_match_full (parser->regex_custom_successful,
+                                    response->str, response->len,
+                                    0, 0, NULL, NULL);
+
+    if (!found)
+        found = (parser->use_regex ?
+                 regex_match_successful (parser, response) :
+                 classifier_match_successful (response, &scan_flags));
+
+    if (found) {
+        response_clean (response);
+        return TRUE;
+    }
+
+    /* Now failures */
+
+    /* Custom error matches first, if any */
+    if (parser->regex_custom_error) {
+        found = g_regex_match_full (parser->regex_custom_error,
+                                    response->str, response->len,
+                                    0, 0, &match_info, NULL);
+        if (found) {
+            str = g_match_info_fetch (match_info, 1);
+            g_assert (str);
+            local_error = mm_mobile_equipment_error_for_code (atoi (str));
+            g_free (str);
+        }
+        g_match_info_free (match_info);
+    }
+
+    if (!found)
+        found = (parser->use_regex ?
+                 regex_match_error (parser, response, &local_error) :
+                 classifier_match_error (response, scan_flags, &local_error));
+
     if (found)
         response_clean (response);
 
@@ -385,17 +752,7 @@ mm_serial_parser_v1_destroy (gpointer data)
 
     g_return_if_fail (parser != NULL);
 
-    g_regex_unref (parser->regex_ok);
-    g_regex_unref (parser->regex_connect);
-    g_regex_unref (parser->regex_sms);
-    g_regex_unref (parser->regex_cme_error);
-    g_regex_unref (parser->regex_cms_error);
-    g_regex_unref (parser->regex_cme_error_str);
-    g_regex_unref (parser->regex_cms_error_str);
-    g_regex_unref (parser->regex_ezx_error);
-    g_regex_unref (parser->regex_unknown_error);
-    g_regex_unref (parser->regex_connect_failed);
-    g_regex_unref (parser->regex_na);
+    regex_cascade_clear (parser);
 
     if (parser->regex_custom_successful)
         g_regex_unref (parser->regex_custom_successful);
@@ -22,6 +22,12 @@ gpointer mm_serial_parser_v1_new                  (void);
 void     mm_serial_parser_v1_set_custom_regex     (gpointer data,
                                                    GRegex *successful,
                                                    GRegex *error);
+/* Built-in replies are recognized with a single-pass classifier by default;
+ * the old regex cascade may be selected instead, e.g. for debugging, either
+ * for all the parsers created afterwards or for a given one. */
+void     mm_serial_parser_v1_set_default_use_regex (gboolean use_regex);
+void     mm_serial_parser_v1_set_use_regex        (gpointer data,
+                                                   gboolean use_regex);
 gboolean mm_serial_parser_v1_parse                (gpointer parser,
                                                    GString *response,
                                                    GError **error);
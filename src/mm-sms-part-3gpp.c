@@ -340,6 +340,42 @@ mm_sms_part_3gpp_new_from_pdu (guint index,
     return part;
 }
 
+MMSmsPart *
+mm_sms_part_3gpp_new_from_hex_pdu (guint index,
+                                   const gchar *hexpdu,
+                                   gsize hexpdu_len,
+                                   GError **error)
+{
+    guint8 pdu[MM_SMS_PART_3GPP_MAX_PDU_LEN];
+    gsize i;
+
+    if (hexpdu_len % 2 != 0 || hexpdu_len / 2 > sizeof (pdu)) {
+        g_set_error (error,
+                     MM_CORE_ERROR,
+                     MM_CORE_ERROR_FAILED,
+                     "Invalid 3GPP PDU length: %" G_GSIZE_FORMAT " hex digits",
+                     hexpdu_len);
+        return NULL;
+    }
+
+    /* Convert PDU from hex to binary right on the stack */
+    for (i = 0; i < hexpdu_len / 2; i++) {
+        gint byte;
+
+        byte = mm_utils_hex2byte (&hexpdu[i * 2]);
+        if (byte < 0) {
+            g_set_error_literal (error,
+                                 MM_CORE_ERROR,
+                                 MM_CORE_ERROR_FAILED,
+                                 "Couldn't convert 3GPP PDU from hex to binary");
+            return NULL;
+        }
+        pdu[i] = (guint8) byte;
+    }
+
+    return mm_sms_part_3gpp_new_from_binary_pdu (index, pdu, hexpdu_len / 2, error);
+}
+
 MMSmsPart *
 mm_sms_part_3gpp_new_from_binary_pdu (guint index,
                                       const guint8 *pdu,
@@ -28,6 +28,12 @@ MMSmsPart *mm_sms_part_3gpp_new_from_pdu  (guint index,
                                            const gchar *hexpdu,
                                            GError **error);
 
+/* Hex PDU given as a span of a larger buffer, not NUL-terminated */
+MMSmsPart *mm_sms_part_3gpp_new_from_hex_pdu (guint index,
+                                              const gchar *hexpdu,
+                                              gsize hexpdu_len,
+                                              GError **error);
+
 MMSmsPart *mm_sms_part_3gpp_new_from_binary_pdu (guint index,
                                                  const guint8 *pdu,
                                                  gsize pdu_len,
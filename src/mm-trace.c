@@ -0,0 +1,231 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <ModemManager.h>
+#include <mm-errors-types.h>
+
+#include "mm-trace.h"
+
+/*****************************************************************************/
+/* File layout, all integers in host byte order:
+ *
+ *   TraceHeader, including the table of known ports
+ *   Data area: ring of TraceRecords, each followed by the frame data and
+ *   padded to 8 bytes.
+ *
+ * Valid records go from 'tail' to 'head'. Once the writer reaches the end of
+ * the data area it goes back to the beginning, and 'wrap' keeps the end of
+ * the valid data in the previous lap, so that the valid records are then
+ * [tail, wrap) followed by [0, head). Old records are dropped from the tail
+ * as new ones overwrite them.
+ */
+
+#define TRACE_MAGIC      "MMTRACE1"
+#define TRACE_MAX_PORTS  256
+#define TRACE_DATA_SIZE  (8 * 1024 * 1024)
+
+/* Longer frames are truncated */
+#define TRACE_MAX_RECORD_SIZE (TRACE_DATA_SIZE / 4)
+
+typedef struct {
+    guint32 id;
+    guint32 type;
+    gchar   device[32];
+} TracePort;
+
+typedef struct {
+    gchar     magic[8];
+    guint32   header_size;
+    guint32   data_size;
+    guint32   head;
+    guint32   tail;
+    guint32   wrap;
+    guint32   n_ports;
+    TracePort ports[TRACE_MAX_PORTS];
+} TraceHeader;
+
+typedef struct {
+    guint32 len;       /* Full record length, including padding */
+    guint32 port_id;
+    gint64  timestamp; /* Wall clock time, in microseconds */
+    guint32 data_len;
+    guint8  direction;
+    guint8  reserved[3];
+} TraceRecord;
+
+#define RECORD_LEN(data_len) ((sizeof (TraceRecord) + (data_len) + 7) & ~7)
+
+static int          trace_fd = -1;
+static gsize        trace_size;
+static TraceHeader *trace_header;
+static guint8      *trace_data;
+static guint32      trace_last_port_id;
+
+/*****************************************************************************/
+
+gboolean
+mm_trace_enabled (void)
+{
+    return !!trace_header;
+}
+
+guint32
+mm_trace_register_port (const gchar *device,
+                        MMPortType port_type)
+{
+    TracePort *port;
+
+    if (!trace_header)
+        return 0;
+
+    /* Port ids are never 0 */
+    if (++trace_last_port_id == 0)
+        trace_last_port_id = 1;
+
+    /* Slots are reused once we go past the maximum */
+    port = &trace_header->ports[trace_last_port_id % TRACE_MAX_PORTS];
+    port->id = trace_last_port_id;
+    port->type = port_type;
+    memset (port->device, 0, sizeof (port->device));
+    if (device)
+        strncpy (port->device, device, sizeof (port->device) - 1);
+    trace_header->n_ports = MIN (trace_last_port_id, TRACE_MAX_PORTS);
+
+    return trace_last_port_id;
+}
+
+static guint8 *
+trace_reserve (guint32 len)
+{
+    TraceHeader *h = trace_header;
+    guint8 *record;
+
+    while (TRUE) {
+        if (!h->wrap) {
+            /* Still in the first lap, or the previous one got fully overwritten */
+            if (h->head + len <= h->data_size)
+                break;
+            h->wrap = h->head;
+            h->head = 0;
+        }
+
+        /* Drop the oldest records until there's room */
+        while (h->tail < h->head + len && h->tail < h->wrap)
+            h->tail += ((TraceRecord *) &trace_data[h->tail])->len;
+        if (h->tail < h->wrap)
+            break;
+
+        /* Nothing left from the previous lap */
+        h->tail = 0;
+        h->wrap = 0;
+    }
+
+    record = &trace_data[h->head];
+    h->head += len;
+    return record;
+}
+
+void
+mm_trace_frame (guint32 port_id,
+                MMTraceDirection direction,
+                const guint8 *data,
+                gsize len)
+{
+    TraceRecord *record;
+
+    if (!trace_header || !port_id || !len)
+        return;
+
+    if (RECORD_LEN (len) > TRACE_MAX_RECORD_SIZE)
+        len = TRACE_MAX_RECORD_SIZE - sizeof (TraceRecord);
+
+    record = (TraceRecord *) trace_reserve (RECORD_LEN (len));
+    record->len = RECORD_LEN (len);
+    record->port_id = port_id;
+    record->timestamp = g_get_real_time ();
+    record->data_len = len;
+    record->direction = direction;
+    memcpy (&record[1], data, len);
+}
+
+/*****************************************************************************/
+
+gboolean
+mm_trace_setup (const gchar *trace_file,
+                GError **error)
+{
+    gpointer mapping;
+
+    g_return_val_if_fail (trace_fd < 0, FALSE);
+
+    trace_fd = open (trace_file,
+                     O_CREAT | O_TRUNC | O_RDWR,
+                     S_IRUSR | S_IWUSR | S_IRGRP);
+    if (trace_fd < 0) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
+                     "Couldn't open trace file: (%d) %s",
+                     errno, strerror (errno));
+        return FALSE;
+    }
+
+    trace_size = sizeof (TraceHeader) + TRACE_DATA_SIZE;
+    if (ftruncate (trace_fd, trace_size) < 0) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
+                     "Couldn't resize trace file: (%d) %s",
+                     errno, strerror (errno));
+        close (trace_fd);
+        trace_fd = -1;
+        return FALSE;
+    }
+
+    mapping = mmap (NULL, trace_size, PROT_READ | PROT_WRITE, MAP_SHARED, trace_fd, 0);
+    if (mapping == MAP_FAILED) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
+                     "Couldn't map trace file: (%d) %s",
+                     errno, strerror (errno));
+        close (trace_fd);
+        trace_fd = -1;
+        return FALSE;
+    }
+
+    trace_header = (TraceHeader *) mapping;
+    trace_data = (guint8 *) mapping + sizeof (TraceHeader);
+
+    memcpy (trace_header->magic, TRACE_MAGIC, sizeof (trace_header->magic));
+    trace_header->header_size = sizeof (TraceHeader);
+    trace_header->data_size = TRACE_DATA_SIZE;
+    return TRUE;
+}
+
+void
+mm_trace_shutdown (void)
+{
+    if (!trace_header)
+        return;
+
+    msync (trace_header, trace_size, MS_SYNC);
+    munmap (trace_header, trace_size);
+    trace_header = NULL;
+    trace_data = NULL;
+    close (trace_fd);
+    trace_fd = -1;
+}
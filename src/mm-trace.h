@@ -0,0 +1,48 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_TRACE_H
+#define MM_TRACE_H
+
+#include <glib.h>
+
+#include "mm-port.h"
+
+/* Binary trace of the raw traffic exchanged with the ports.
+ *
+ * The trace file is a fixed-size ring, mapped in memory: recording a frame
+ * is just a copy into the mapping, so tracing can be kept enabled without
+ * the cost of rendering every byte through the debug log. Use
+ * decode/trace.py to render it.
+ */
+
+typedef enum {
+    MM_TRACE_DIRECTION_TX = 0,
+    MM_TRACE_DIRECTION_RX = 1,
+} MMTraceDirection;
+
+gboolean mm_trace_setup    (const gchar *trace_file,
+                            GError **error);
+void     mm_trace_shutdown (void);
+gboolean mm_trace_enabled  (void);
+
+/* Returns a new trace port id, or 0 if tracing is disabled */
+guint32  mm_trace_register_port (const gchar *device,
+                                 MMPortType port_type);
+
+void     mm_trace_frame (guint32 port_id,
+                         MMTraceDirection direction,
+                         const guint8 *data,
+                         gsize len);
+
+#endif /* MM_TRACE_H */
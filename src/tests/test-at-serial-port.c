@@ -15,9 +15,18 @@
 
 #include <config.h>
 #include <string.h>
+#include <pty.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include "mm-port-serial-at.h"
+#include "mm-serial-parsers.h"
+#include "mm-modem-helpers.h"
+#include "mm-sms-part-3gpp.h"
+#include "mm-reply-cache.h"
 #include "mm-log.h"
 
 typedef struct {
@@ -64,6 +73,703 @@ at_serial_echo_removal (void)
     }
 }
 
+/*****************************************************************************/
+
+typedef struct {
+    const gchar *pattern;
+    const gchar *prefix;
+} UnsolicitedPrefixTest;
+
+static const UnsolicitedPrefixTest unsolicited_prefix_tests[] = {
+    { "\\r\\n\\+CREG:(.*)\\r\\n",            "+CREG:"      },
+    { "\\r\\n\\^RSSI:\\s*(\\d+)\\r\\n",       "^RSSI:"      },
+    { "\\r\\n\\+CIEV: (.*),(\\d)\\r\\n",       "+CIEV: "     },
+    { "\\R\\*ESTKSMENU:.*\\R",               "*ESTKSMENU:" },
+    { "\\r\\n\\^HCSQ:.+\\r+\\n",              "^HCSQ:"      },
+    { "\\r\\n\\+PACSP(\\d)\\r\\n",           "+PACSP"      },
+    { "\\r\\n_OSIGQ:\\s*(\\d+),(\\d)\\r\\n",  "_OSIGQ:"     },
+    { "\\r\\n\\+CPIN?: .*\\r\\n",             "+CPI"        },
+    { "\\r\\n(NO CARRIER)|(BUSY)\\r\\n$",      NULL          },
+    { "\\r\\n(\\^NDISSTAT:.+)\\r+\\n",        NULL          },
+    { "\\r\\n\\s*\\+CSQ:\\s*(\\d+)\\r\\n",     NULL          },
+    { "\\$.*\\r\\n",                         NULL          },
+};
+
+static void
+at_serial_unsolicited_prefix (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (unsolicited_prefix_tests); i++) {
+        GRegex *regex;
+        gchar *prefix;
+
+        regex = g_regex_new (unsolicited_prefix_tests[i].pattern, G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
+        g_assert (regex != NULL);
+
+        prefix = mm_port_serial_at_get_unsolicited_msg_prefix (regex);
+        g_assert_cmpstr (prefix, ==, unsolicited_prefix_tests[i].prefix);
+
+        g_free (prefix);
+        g_regex_unref (regex);
+    }
+}
+
+/*****************************************************************************/
+
+typedef struct {
+    const gchar *command;
+    MMPortSerialCommandPriority priority;
+} CommandPriorityTest;
+
+static const CommandPriorityTest command_priority_tests[] = {
+    { "+CSQ",          MM_PORT_SERIAL_COMMAND_PRIORITY_POLL        },
+    { "AT+CSQ?",       MM_PORT_SERIAL_COMMAND_PRIORITY_POLL        },
+    { "+creg?",        MM_PORT_SERIAL_COMMAND_PRIORITY_POLL        },
+    { "+COPS?",        MM_PORT_SERIAL_COMMAND_PRIORITY_POLL        },
+    { "+COPS=?",       MM_PORT_SERIAL_COMMAND_PRIORITY_BULK        },
+    { "+CMGL=4",       MM_PORT_SERIAL_COMMAND_PRIORITY_BULK        },
+    { "+CMGL=\"ALL\"", MM_PORT_SERIAL_COMMAND_PRIORITY_BULK        },
+    { "+COPS=0",       MM_PORT_SERIAL_COMMAND_PRIORITY_INTERACTIVE },
+    { "+CMGR=1",       MM_PORT_SERIAL_COMMAND_PRIORITY_INTERACTIVE },
+    { "E0",            MM_PORT_SERIAL_COMMAND_PRIORITY_INTERACTIVE },
+};
+
+static void
+at_serial_command_priority (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (command_priority_tests); i++)
+        g_assert_cmpuint (mm_port_serial_at_get_command_priority (command_priority_tests[i].command),
+                          ==,
+                          command_priority_tests[i].priority);
+}
+
+/*****************************************************************************/
+
+static void
+add_cached_reply (MMPortSerial *port,
+                  const gchar *command,
+                  const gchar *response)
+{
+    GByteArray *command_array;
+    GByteArray *response_array;
+
+    command_array = g_byte_array_new ();
+    g_byte_array_append (command_array, (const guint8 *) command, strlen (command));
+    response_array = g_byte_array_new ();
+    g_byte_array_append (response_array, (const guint8 *) response, strlen (response));
+    mm_port_serial_add_cached_reply (port, command_array, response_array);
+    g_byte_array_unref (command_array);
+    g_byte_array_unref (response_array);
+}
+
+typedef struct {
+    const gchar *command;
+    MMPortSerialCommandPriority priority;
+} QueuedCommand;
+
+typedef struct {
+    GMainLoop *loop;
+    GPtrArray *completed;
+    guint n_pending;
+} CommandQueueContext;
+
+static void
+queued_command_ready (MMPortSerial *port,
+                      GAsyncResult *res,
+                      CommandQueueContext *ctx)
+{
+    GByteArray *response;
+    GError *error = NULL;
+
+    response = mm_port_serial_command_finish (port, res, &error);
+    g_assert_no_error (error);
+    g_assert (response != NULL);
+
+    /* The cached reply is the command itself */
+    g_ptr_array_add (ctx->completed, g_strndup ((const gchar *) response->data, response->len));
+    g_byte_array_set_size (response, 0);
+    g_byte_array_unref (response);
+
+    if (--ctx->n_pending == 0)
+        g_main_loop_quit (ctx->loop);
+}
+
+static MMPortSerial *
+open_test_port (int *master)
+{
+    MMPortSerial *port;
+    GError *error = NULL;
+    struct termios stbuf;
+    int slave;
+
+    g_assert_cmpint (openpty (master, &slave, NULL, NULL, NULL), ==, 0);
+    memset (&stbuf, 0, sizeof (stbuf));
+    tcgetattr (slave, &stbuf);
+    cfmakeraw (&stbuf);
+    tcsetattr (slave, TCSANOW, &stbuf);
+    fcntl (*master, F_SETFL, O_NONBLOCK);
+
+    port = MM_PORT_SERIAL (g_object_new (MM_TYPE_PORT_SERIAL_AT,
+                                         MM_PORT_DEVICE, "test",
+                                         MM_PORT_SUBSYS, MM_PORT_SUBSYS_TTY,
+                                         MM_PORT_TYPE, MM_PORT_TYPE_AT,
+                                         MM_PORT_SERIAL_FD, slave,
+                                         MM_PORT_SERIAL_SEND_DELAY, (guint64) 0,
+                                         NULL));
+    mm_port_serial_at_set_response_parser (MM_PORT_SERIAL_AT (port),
+                                           mm_serial_parser_v1_parse,
+                                           mm_serial_parser_v1_new (),
+                                           mm_serial_parser_v1_destroy);
+    g_assert (mm_port_serial_open (port, &error));
+    g_assert_no_error (error);
+    return port;
+}
+
+static void
+run_queued_commands (MMPortSerial *port,
+                     const QueuedCommand *commands,
+                     guint n_commands,
+                     GPtrArray *completed)
+{
+    CommandQueueContext ctx;
+    guint i;
+
+    ctx.loop = g_main_loop_new (NULL, FALSE);
+    ctx.completed = completed;
+    ctx.n_pending = n_commands;
+
+    /* Replies are all served from the cache, so that the commands are
+     * processed in queue order without a device on the other side */
+    for (i = 0; i < n_commands; i++)
+        add_cached_reply (port, commands[i].command, commands[i].command);
+
+    for (i = 0; i < n_commands; i++) {
+        GByteArray *command;
+
+        command = g_byte_array_new ();
+        g_byte_array_append (command, (const guint8 *) commands[i].command, strlen (commands[i].command));
+        mm_port_serial_command (port, command, 3, TRUE, commands[i].priority, NULL,
+                                (GAsyncReadyCallback) queued_command_ready, &ctx);
+        g_byte_array_unref (command);
+    }
+
+    g_main_loop_run (ctx.loop);
+    g_main_loop_unref (ctx.loop);
+}
+
+static const QueuedCommand queued_commands[] = {
+    { "AT+COPS=?\r", MM_PORT_SERIAL_COMMAND_PRIORITY_BULK        },
+    { "AT+CMGL=4\r", MM_PORT_SERIAL_COMMAND_PRIORITY_BULK        },
+    { "AT+CPBR=1\r", MM_PORT_SERIAL_COMMAND_PRIORITY_BULK        },
+    { "AT+CSQ\r",    MM_PORT_SERIAL_COMMAND_PRIORITY_POLL        },
+    { "AT+CGMI\r",   MM_PORT_SERIAL_COMMAND_PRIORITY_INTERACTIVE },
+    { "AT+CREG?\r",  MM_PORT_SERIAL_COMMAND_PRIORITY_POLL        },
+};
+
+static void
+at_serial_command_queue_order (void)
+{
+    static const gchar *expected[] = {
+        /* Already at the head of the queue, so never preempted */
+        "AT+COPS=?\r",
+        "AT+CGMI\r",
+        "AT+CSQ\r",
+        "AT+CREG?\r",
+        "AT+CMGL=4\r",
+        "AT+CPBR=1\r",
+    };
+    MMPortSerial *port;
+    GPtrArray *completed;
+    int master;
+    guint i;
+
+    port = open_test_port (&master);
+    completed = g_ptr_array_new_with_free_func (g_free);
+
+    run_queued_commands (port, queued_commands, G_N_ELEMENTS (queued_commands), completed);
+
+    g_assert_cmpuint (completed->len, ==, G_N_ELEMENTS (expected));
+    for (i = 0; i < completed->len; i++)
+        g_assert_cmpstr (g_ptr_array_index (completed, i), ==, expected[i]);
+
+    g_ptr_array_unref (completed);
+    mm_port_serial_close (port);
+    g_object_unref (port);
+    close (master);
+}
+
+static void
+at_serial_command_stats (void)
+{
+    MMPortSerialCommandStats stats;
+    MMPortSerial *port;
+    GPtrArray *completed;
+    int master;
+
+    port = open_test_port (&master);
+    completed = g_ptr_array_new_with_free_func (g_free);
+
+    mm_port_serial_get_command_stats (port, MM_PORT_SERIAL_COMMAND_PRIORITY_BULK, &stats);
+    g_assert_cmpuint (stats.processed, ==, 0);
+    g_assert_cmpuint (stats.max_queued, ==, 0);
+
+    run_queued_commands (port, queued_commands, G_N_ELEMENTS (queued_commands), completed);
+
+    mm_port_serial_get_command_stats (port, MM_PORT_SERIAL_COMMAND_PRIORITY_BULK, &stats);
+    g_assert_cmpuint (stats.queued, ==, 0);
+    g_assert_cmpuint (stats.max_queued, ==, 3);
+    g_assert_cmpuint (stats.processed, ==, 3);
+    g_assert_cmpint (stats.total_wait, >=, stats.max_wait);
+    g_assert_cmpint (stats.max_wait, >=, 0);
+
+    mm_port_serial_get_command_stats (port, MM_PORT_SERIAL_COMMAND_PRIORITY_POLL, &stats);
+    g_assert_cmpuint (stats.queued, ==, 0);
+    g_assert_cmpuint (stats.max_queued, ==, 2);
+    g_assert_cmpuint (stats.processed, ==, 2);
+
+    mm_port_serial_get_command_stats (port, MM_PORT_SERIAL_COMMAND_PRIORITY_INTERACTIVE, &stats);
+    g_assert_cmpuint (stats.queued, ==, 0);
+    g_assert_cmpuint (stats.max_queued, ==, 1);
+    g_assert_cmpuint (stats.processed, ==, 1);
+
+    /* Running the same commands again only adds to the processed ones */
+    run_queued_commands (port, queued_commands, G_N_ELEMENTS (queued_commands), completed);
+    mm_port_serial_get_command_stats (port, MM_PORT_SERIAL_COMMAND_PRIORITY_BULK, &stats);
+    g_assert_cmpuint (stats.max_queued, ==, 3);
+    g_assert_cmpuint (stats.processed, ==, 6);
+
+    g_ptr_array_unref (completed);
+    mm_port_serial_close (port);
+    g_object_unref (port);
+    close (master);
+}
+
+/*****************************************************************************/
+
+#define TEST_PDU "07914356060013F1065A098136397339F7219011700463802190117004638030"
+
+typedef struct {
+    GMainLoop *loop;
+    int master;
+    GString *command;
+    const gchar *response;
+    gsize written;
+    guint n_entries;
+    gchar *left;
+} StreamingTest;
+
+/* Plays the modem: waits for the whole command, then replies in small
+ * chunks, so that the listing is received over several reads */
+static gboolean
+streaming_modem_cb (StreamingTest *test)
+{
+    gsize len;
+
+    if (!strchr (test->command->str, '\r')) {
+        gchar buf[32];
+        gssize n;
+
+        n = read (test->master, buf, sizeof (buf));
+        if (n > 0)
+            g_string_append_len (test->command, buf, n);
+        return TRUE;
+    }
+
+    len = MIN (7, strlen (test->response) - test->written);
+    g_assert_cmpint (write (test->master, test->response + test->written, len), ==, len);
+    test->written += len;
+    return (test->written < strlen (test->response));
+}
+
+static void
+streaming_entry_cb (MMPortSerialAt *port,
+                    GMatchInfo *match_info,
+                    StreamingTest *test)
+{
+    MMSmsPart *part;
+    GError *error = NULL;
+    gint index;
+    gint status;
+    gint start;
+    gint end;
+
+    /* Entries come in order, and the ones already reported are gone from
+     * the buffer */
+    g_assert (g_match_info_fetch_pos (match_info, 0, &start, &end));
+    g_assert_cmpint (start, <, 8);
+
+    g_assert (mm_get_int_from_match_info (match_info, 1, &index));
+    g_assert (mm_get_int_from_match_info (match_info, 2, &status));
+    g_assert_cmpint (index, ==, test->n_entries);
+    g_assert_cmpint (status, ==, index % 2);
+
+    /* Decoded right from the port buffer, as the messaging support does */
+    g_assert (g_match_info_fetch_pos (match_info, 4, &start, &end));
+    part = mm_sms_part_3gpp_new_from_hex_pdu (index,
+                                              g_match_info_get_string (match_info) + start,
+                                              end - start,
+                                              &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (mm_sms_part_get_index (part), ==, index);
+    g_assert_cmpstr (mm_sms_part_get_number (part), ==, "639337937");
+    mm_sms_part_free (part);
+
+    test->n_entries++;
+}
+
+static void
+streaming_command_ready (MMPortSerialAt *port,
+                         GAsyncResult *res,
+                         StreamingTest *test)
+{
+    const gchar *response;
+    GError *error = NULL;
+
+    response = mm_port_serial_at_command_finish (port, res, &error);
+    g_assert_no_error (error);
+    test->left = g_strdup (response);
+    g_main_loop_quit (test->loop);
+}
+
+static gboolean
+streaming_timeout_cb (gpointer user_data)
+{
+    g_assert_not_reached ();
+    return FALSE;
+}
+
+static void
+at_serial_command_streaming (void)
+{
+    StreamingTest test;
+    MMPortSerial *port;
+    GRegex *regex;
+    GList *list;
+    GError *error = NULL;
+    guint modem_id;
+    guint timeout_id;
+
+    memset (&test, 0, sizeof (test));
+    test.loop = g_main_loop_new (NULL, FALSE);
+    test.command = g_string_new (NULL);
+    test.response =
+        "\r\n+CMGL: 0,0,,31\r\n" TEST_PDU "\r\n"
+        "+CMGL: 1,1,,31\r\n" TEST_PDU "\r\n"
+        "+CMGL: 2,0,,31\r\n" TEST_PDU "\r\n"
+        "+CMGL: 3,1,,31\r\n" TEST_PDU "\r\n"
+        "\r\nOK\r\n";
+
+    port = open_test_port (&test.master);
+
+    regex = mm_3gpp_cmgl_pdu_entry_regex_get ();
+    mm_port_serial_at_command_streaming (MM_PORT_SERIAL_AT (port),
+                                         "+CMGL=4",
+                                         5,
+                                         regex,
+                                         (MMPortSerialAtStreamEntryFn) streaming_entry_cb,
+                                         &test,
+                                         NULL,
+                                         (GAsyncReadyCallback) streaming_command_ready,
+                                         &test);
+    g_regex_unref (regex);
+
+    modem_id = g_timeout_add (5, (GSourceFunc) streaming_modem_cb, &test);
+    timeout_id = g_timeout_add_seconds (10, streaming_timeout_cb, NULL);
+    g_main_loop_run (test.loop);
+    g_source_remove (timeout_id);
+    if (test.written < strlen (test.response))
+        g_source_remove (modem_id);
+
+    g_assert_cmpstr (test.command->str, ==, "AT+CMGL=4\r");
+    g_assert_cmpuint (test.n_entries, ==, 4);
+
+    /* Nothing left to parse once all entries were streamed */
+    list = mm_3gpp_parse_pdu_cmgl_response (test.left, &error);
+    g_assert_no_error (error);
+    g_assert (list == NULL);
+
+    g_free (test.left);
+    g_string_free (test.command, TRUE);
+    g_main_loop_unref (test.loop);
+    mm_port_serial_close (port);
+    g_object_unref (port);
+    close (test.master);
+}
+
+/*****************************************************************************/
+
+static void
+count_unsolicited_cb (MMPortSerialAt *port,
+                      GMatchInfo *match_info,
+                      guint *n_calls)
+{
+    (*n_calls)++;
+}
+
+static void
+parse_unsolicited (MMPortSerialAt *port,
+                   GByteArray *response)
+{
+    MM_PORT_SERIAL_GET_CLASS (port)->parse_unsolicited (MM_PORT_SERIAL (port), response);
+}
+
+static void
+at_serial_unsolicited_dispatch (void)
+{
+    static const gchar *response =
+        "\r\n+CREG: 1\r\n\r\n^RSSI: 15\r\n\r\n+CGREG: 2\r\n\r\n+CREG: 5\r\n\r\n$GPS\r\n\r\n+CGMI: foo\r\n";
+    MMPortSerialAt *port;
+    GRegex *creg;
+    GRegex *cgreg;
+    GRegex *rssi;
+    GRegex *ciev;
+    GRegex *dollar;
+    GByteArray *ba;
+    guint n_creg = 0;
+    guint n_cgreg = 0;
+    guint n_rssi = 0;
+    guint n_ciev = 0;
+    guint n_dollar = 0;
+
+    port = mm_port_serial_at_new ("test", MM_PORT_SUBSYS_UNIX);
+
+    creg = g_regex_new ("\\r\\n\\+CREG:\\s*(\\d)\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
+    /* Shares the first bytes of its prefix with the one above */
+    cgreg = g_regex_new ("\\r\\n\\+CGREG:\\s*(\\d)\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
+    rssi = g_regex_new ("\\r\\n\\^RSSI:\\s*(\\d+)\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
+    ciev = g_regex_new ("\\r\\n\\+CIEV:(.*)\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
+    /* No literal prefix, always run */
+    dollar = g_regex_new ("\\r\\n\\$.*\\r\\n", G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
+
+    mm_port_serial_at_add_unsolicited_msg_handler (port, creg, (MMPortSerialAtUnsolicitedMsgFn)count_unsolicited_cb, &n_creg, NULL);
+    mm_port_serial_at_add_unsolicited_msg_handler (port, cgreg, (MMPortSerialAtUnsolicitedMsgFn)count_unsolicited_cb, &n_cgreg, NULL);
+    mm_port_serial_at_add_unsolicited_msg_handler (port, rssi, (MMPortSerialAtUnsolicitedMsgFn)count_unsolicited_cb, &n_rssi, NULL);
+    mm_port_serial_at_add_unsolicited_msg_handler (port, ciev, (MMPortSerialAtUnsolicitedMsgFn)count_unsolicited_cb, &n_ciev, NULL);
+    mm_port_serial_at_add_unsolicited_msg_handler (port, dollar, (MMPortSerialAtUnsolicitedMsgFn)count_unsolicited_cb, &n_dollar, NULL);
+
+    ba = g_byte_array_new ();
+    g_byte_array_append (ba, (const guint8 *)response, strlen (response));
+    parse_unsolicited (port, ba);
+    /* NUL-terminate so that we can compare C strings */
+    g_byte_array_append (ba, (const guint8 *)"", 1);
+
+    g_assert_cmpuint (n_creg, ==, 2);
+    g_assert_cmpuint (n_cgreg, ==, 1);
+    g_assert_cmpuint (n_rssi, ==, 1);
+    g_assert_cmpuint (n_ciev, ==, 0);
+    g_assert_cmpuint (n_dollar, ==, 1);
+    g_assert_cmpstr ((const gchar *)ba->data, ==, "\r\n+CGMI: foo\r\n");
+
+    /* Disabled handlers are skipped */
+    mm_port_serial_at_enable_unsolicited_msg_handler (port, creg, FALSE);
+    g_byte_array_set_size (ba, 0);
+    g_byte_array_append (ba, (const guint8 *)"\r\n+CREG: 1\r\n", strlen ("\r\n+CREG: 1\r\n"));
+    parse_unsolicited (port, ba);
+    g_assert_cmpuint (n_creg, ==, 2);
+    g_assert_cmpuint (ba->len, ==, strlen ("\r\n+CREG: 1\r\n"));
+
+    g_byte_array_unref (ba);
+    g_regex_unref (creg);
+    g_regex_unref (cgreg);
+    g_regex_unref (rssi);
+    g_regex_unref (ciev);
+    g_regex_unref (dollar);
+    g_object_unref (port);
+}
+
+/*****************************************************************************/
+/* Benchmark, only run in perf mode (-m perf) */
+
+static void
+noop_unsolicited_cb (MMPortSerialAt *port,
+                     GMatchInfo *match_info,
+                     gpointer user_data)
+{
+}
+
+/* The handler loop as it was before the dispatcher: every regex runs over
+ * the whole response on every read */
+static void
+parse_unsolicited_all_regex (GPtrArray *regexes,
+                             GByteArray *response)
+{
+    guint i;
+
+    for (i = 0; i < regexes->len; i++) {
+        GMatchInfo *match_info;
+
+        g_regex_match_full (g_ptr_array_index (regexes, i),
+                            (const char *) response->data,
+                            response->len,
+                            0, 0, &match_info, NULL);
+        g_match_info_free (match_info);
+    }
+}
+
+/* URC patterns as registered by the generic modem and common plugins; most
+ * of them start with "+C" */
+static const gchar *benchmark_unsolicited_patterns[] = {
+    "\\r\\n\\+CREG:(.*)\\r\\n",
+    "\\r\\n\\+CGREG:(.*)\\r\\n",
+    "\\r\\n\\+CEREG:(.*)\\r\\n",
+    "\\r\\n\\+CMTI:\\s*\"(\\S+)\",\\s*(\\d+)\\r\\n",
+    "\\r\\n\\+CDSI:\\s*\"(\\S+)\",\\s*(\\d+)\\r\\n",
+    "\\r\\n\\+CMT:(.*)\\r\\n",
+    "\\r\\n\\+CDS:(.*)\\r\\n",
+    "\\r\\n\\+CUSD:\\s*(.*)\\r\\n",
+    "\\r\\n\\+CIEV: (.*),(\\d)\\r\\n",
+    "\\r\\n\\+CRING:(.*)\\r\\n",
+    "\\r\\n\\+CLIP:(.*)\\r\\n",
+    "\\r\\n\\+CCWA:(.*)\\r\\n",
+    "\\r\\n\\+CSSI:(.*)\\r\\n",
+    "\\r\\n\\+CSSU:(.*)\\r\\n",
+    "\\r\\n\\+CGEV:(.*)\\r\\n",
+    "\\r\\n\\+CPIN: (.*)\\r\\n",
+    "\\r\\n\\+CTZV:(.*)\\r\\n",
+    "\\r\\n\\+CTZE:(.*)\\r\\n",
+    "\\r\\n\\+CMGS:(.*)\\r\\n",
+    "\\r\\n\\+CBM:(.*)\\r\\n",
+    "\\r\\n\\^RSSI:\\s*(\\d+)\\r\\n",
+    "\\r\\n\\^MODE:(.*)\\r\\n",
+    "\\r\\n\\^BOOT:.+\\r\\n",
+    "\\r\\n\\^HCSQ:.+\\r+\\n",
+};
+
+static void
+at_serial_unsolicited_benchmark (void)
+{
+    /* A registration URC along with the reply to a registration query,
+     * both sharing their first bytes with most handlers */
+    static const gchar *response =
+        "\r\n+CEREG: 1,\"1F00\",\"79D903\",7\r\n"
+        "\r\n+COPS: 0,0,\"Vodafone\",7\r\n\r\n+CGREG: 2,1,\"1F00\",\"79D903\",2\r\n\r\nOK\r\n";
+    guint n_handlers;
+
+    if (!g_test_perf ())
+        return;
+
+    for (n_handlers = 3; ; n_handlers = MIN (n_handlers * 2, G_N_ELEMENTS (benchmark_unsolicited_patterns))) {
+        MMPortSerialAt *port;
+        GPtrArray *regexes;
+        GByteArray *ba;
+        gdouble before;
+        gdouble after;
+        guint i;
+
+        port = mm_port_serial_at_new ("test", MM_PORT_SUBSYS_UNIX);
+        regexes = g_ptr_array_new_with_free_func ((GDestroyNotify) g_regex_unref);
+        for (i = 0; i < n_handlers; i++) {
+            GRegex *regex;
+
+            regex = g_regex_new (benchmark_unsolicited_patterns[i], G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
+            g_assert (regex != NULL);
+            mm_port_serial_at_add_unsolicited_msg_handler (port, regex, noop_unsolicited_cb, NULL, NULL);
+            g_ptr_array_add (regexes, regex);
+        }
+
+        ba = g_byte_array_new ();
+
+        g_test_timer_start ();
+        for (i = 0; i < 10000; i++) {
+            g_byte_array_set_size (ba, 0);
+            g_byte_array_append (ba, (const guint8 *)response, strlen (response));
+            parse_unsolicited_all_regex (regexes, ba);
+        }
+        before = g_test_timer_elapsed ();
+
+        g_test_timer_start ();
+        for (i = 0; i < 10000; i++) {
+            g_byte_array_set_size (ba, 0);
+            g_byte_array_append (ba, (const guint8 *)response, strlen (response));
+            parse_unsolicited (port, ba);
+        }
+        after = g_test_timer_elapsed ();
+
+        g_test_message ("%u handlers: regex loop %.3fs, dispatcher %.3fs (10000 reads)",
+                        n_handlers, before, after);
+        g_test_minimized_result (after, "dispatcher with %u handlers: %.3fs", n_handlers, after);
+
+        g_byte_array_unref (ba);
+        g_ptr_array_unref (regexes);
+        g_object_unref (port);
+
+        if (n_handlers == G_N_ELEMENTS (benchmark_unsolicited_patterns))
+            break;
+    }
+}
+
+/*****************************************************************************/
+
+static void
+count_cached_reply_cb (const GByteArray *command,
+                       const GByteArray *response,
+                       guint *n_replies)
+{
+    (*n_replies)++;
+}
+
+static void
+at_serial_reply_cache (void)
+{
+    MMPortSerialAt *port;
+    MMReplyCache *cache;
+    GError *error = NULL;
+    gchar *dir;
+    gchar *name;
+    gchar *file;
+    guint n_replies = 0;
+
+    dir = g_dir_make_tmp ("mm-reply-cache-XXXXXX", &error);
+    g_assert_no_error (error);
+    g_assert (mm_reply_cache_setup (dir, &error));
+    g_assert_no_error (error);
+
+    port = mm_port_serial_at_new ("test", MM_PORT_SUBSYS_UNIX);
+    add_cached_reply (MM_PORT_SERIAL (port), "AT+CGMI\r", "Manufacturer");
+    add_cached_reply (MM_PORT_SERIAL (port), "AT+CGMR\r\n", "1.2.3");
+    add_cached_reply (MM_PORT_SERIAL (port), "ATI1\r", "Info");
+    add_cached_reply (MM_PORT_SERIAL (port), "AT+CPMS=?\r", "+CPMS: (\"SM\"),(\"SM\"),(\"SM\")");
+    /* Not static, must not be persisted */
+    add_cached_reply (MM_PORT_SERIAL (port), "AT+COPS=?\r", "+COPS: (1,\"Network\",\"Net\",\"12345\")");
+    add_cached_reply (MM_PORT_SERIAL (port), "AT+CPIN?\r", "+CPIN: READY");
+    add_cached_reply (MM_PORT_SERIAL (port), "AT+CGATT=?\r", "+CGATT: (0,1)");
+    g_assert (mm_reply_cache_save (0x1234, 0x5678, "/sys/devices/usb1", "123456789012345", "1.2.3",
+                                   MM_PORT_SERIAL (port), &error));
+    g_assert_no_error (error);
+    g_object_unref (port);
+
+    /* Different physical device, no cache */
+    g_assert (mm_reply_cache_load (0x1234, 0x5678, "/sys/devices/usb2", NULL) == NULL);
+
+    cache = mm_reply_cache_load (0x1234, 0x5678, "/sys/devices/usb1", &error);
+    g_assert_no_error (error);
+    g_assert (cache != NULL);
+    g_assert_cmpstr (mm_reply_cache_get_equipment_identifier (cache), ==, "123456789012345");
+    g_assert_cmpstr (mm_reply_cache_get_revision (cache), ==, "1.2.3");
+
+    port = mm_port_serial_at_new ("test", MM_PORT_SUBSYS_UNIX);
+    g_assert_cmpuint (mm_reply_cache_apply (cache, MM_PORT_SERIAL (port)), ==, 4);
+    mm_port_serial_foreach_cached_reply (MM_PORT_SERIAL (port),
+                                         (MMPortSerialCachedReplyFn) count_cached_reply_cb,
+                                         &n_replies);
+    g_assert_cmpuint (n_replies, ==, 4);
+    g_object_unref (port);
+    mm_reply_cache_free (cache);
+
+    name = g_compute_checksum_for_string (G_CHECKSUM_SHA1, "1234:5678:/sys/devices/usb1", -1);
+    file = g_build_filename (dir, name, NULL);
+    g_assert_cmpint (g_unlink (file), ==, 0);
+    g_rmdir (dir);
+    g_free (file);
+    g_free (name);
+    g_free (dir);
+}
+
+/*****************************************************************************/
+
 void
 _mm_log (const char *loc,
          const char *func,
@@ -90,6 +796,14 @@ int main (int argc, char **argv)
     g_test_init (&argc, &argv, NULL);
 
     g_test_add_func ("/ModemManager/AT-serial/echo-removal", at_serial_echo_removal);
+    g_test_add_func ("/ModemManager/AT-serial/unsolicited-prefix", at_serial_unsolicited_prefix);
+    g_test_add_func ("/ModemManager/AT-serial/unsolicited-dispatch", at_serial_unsolicited_dispatch);
+    g_test_add_func ("/ModemManager/AT-serial/unsolicited-benchmark", at_serial_unsolicited_benchmark);
+    g_test_add_func ("/ModemManager/AT-serial/command-priority", at_serial_command_priority);
+    g_test_add_func ("/ModemManager/AT-serial/command-queue-order", at_serial_command_queue_order);
+    g_test_add_func ("/ModemManager/AT-serial/command-stats", at_serial_command_stats);
+    g_test_add_func ("/ModemManager/AT-serial/command-streaming", at_serial_command_streaming);
+    g_test_add_func ("/ModemManager/AT-serial/reply-cache", at_serial_reply_cache);
 
     return g_test_run ();
 }
@@ -0,0 +1,238 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+
+#include "mm-coalesced-timeout.h"
+#include "mm-log.h"
+
+/* Wakeups may be a bit late, but never early */
+#define ASSERT_ELAPSED_MS(start, time, expected_ms)                      \
+    do {                                                                \
+        gint64 __elapsed = ((time) - (start)) / 1000;                   \
+        g_assert_cmpint (__elapsed, >=, (expected_ms) - 5);             \
+        g_assert_cmpint (__elapsed, <=, (expected_ms) + 150);           \
+    } while (0)
+
+#define MAX_RUNS 3
+
+typedef struct {
+    GMainLoop *loop;
+    guint *n_pending;
+    guint n_runs;
+    guint max_runs;
+    gint64 runs[MAX_RUNS];
+} TimeoutData;
+
+static gboolean
+timeout_cb (TimeoutData *data)
+{
+    g_assert_cmpuint (data->n_runs, <, data->max_runs);
+    data->runs[data->n_runs++] = g_get_monotonic_time ();
+    if (data->n_runs < data->max_runs)
+        return TRUE;
+
+    if (--(*data->n_pending) == 0)
+        g_main_loop_quit (data->loop);
+    return FALSE;
+}
+
+static void
+timeout_data_init (TimeoutData *data,
+                   GMainLoop *loop,
+                   guint *n_pending,
+                   guint max_runs)
+{
+    memset (data, 0, sizeof (TimeoutData));
+    data->loop = loop;
+    data->n_pending = n_pending;
+    data->max_runs = max_runs;
+    (*n_pending)++;
+}
+
+/*****************************************************************************/
+
+static void
+test_period (void)
+{
+    GMainLoop *loop;
+    TimeoutData data;
+    guint n_pending = 0;
+    gint64 start;
+
+    loop = g_main_loop_new (NULL, FALSE);
+    timeout_data_init (&data, loop, &n_pending, 3);
+
+    /* Alone in the scheduler, the slack must not make the period longer */
+    start = g_get_monotonic_time ();
+    mm_coalesced_timeout_add_seconds (1, 1, (GSourceFunc) timeout_cb, &data);
+    g_main_loop_run (loop);
+
+    g_assert_cmpuint (data.n_runs, ==, 3);
+    ASSERT_ELAPSED_MS (start, data.runs[0], 1000);
+    ASSERT_ELAPSED_MS (start, data.runs[1], 2000);
+    ASSERT_ELAPSED_MS (start, data.runs[2], 3000);
+
+    g_main_loop_unref (loop);
+}
+
+/*****************************************************************************/
+
+typedef struct {
+    TimeoutData *late_slack;
+    TimeoutData *late_no_slack;
+} BatchingContext;
+
+static gboolean
+add_late_timeouts_cb (BatchingContext *ctx)
+{
+    mm_coalesced_timeout_add_seconds (2, 1, (GSourceFunc) timeout_cb, ctx->late_slack);
+    mm_coalesced_timeout_add_seconds (2, 0, (GSourceFunc) timeout_cb, ctx->late_no_slack);
+    return FALSE;
+}
+
+static void
+test_batching (void)
+{
+    GMainLoop *loop;
+    BatchingContext ctx;
+    TimeoutData first;
+    TimeoutData late_slack;
+    TimeoutData late_no_slack;
+    guint n_pending = 0;
+    gint64 start;
+    guint i;
+
+    loop = g_main_loop_new (NULL, FALSE);
+    timeout_data_init (&first, loop, &n_pending, 2);
+    timeout_data_init (&late_slack, loop, &n_pending, 2);
+    timeout_data_init (&late_no_slack, loop, &n_pending, 2);
+
+    ctx.late_slack = &late_slack;
+    ctx.late_no_slack = &late_no_slack;
+
+    start = g_get_monotonic_time ();
+    mm_coalesced_timeout_add_seconds (2, 1, (GSourceFunc) timeout_cb, &first);
+    g_timeout_add (500, (GSourceFunc) add_late_timeouts_cb, &ctx);
+    g_main_loop_run (loop);
+
+    for (i = 0; i < 2; i++) {
+        /* The first one runs on time */
+        ASSERT_ELAPSED_MS (start, first.runs[i], 2000 * (i + 1));
+        /* The late one with slack runs early, in the same wakeup */
+        g_assert_cmpint (late_slack.runs[i] - first.runs[i], <, 20000);
+        /* The late one without slack runs when due */
+        ASSERT_ELAPSED_MS (start, late_no_slack.runs[i], 2000 * (i + 1) + 500);
+    }
+
+    g_main_loop_unref (loop);
+}
+
+/*****************************************************************************/
+
+typedef struct {
+    guint ids[2];
+    guint n_runs;
+} RemoveContext;
+
+/* Whichever runs first removes the other one */
+static gboolean
+remove_second_cb (RemoveContext *ctx)
+{
+    ctx->n_runs++;
+    mm_coalesced_timeout_remove (ctx->ids[1]);
+    return FALSE;
+}
+
+static gboolean
+remove_first_cb (RemoveContext *ctx)
+{
+    ctx->n_runs++;
+    mm_coalesced_timeout_remove (ctx->ids[0]);
+    return FALSE;
+}
+
+static gboolean
+not_reached_cb (gpointer unused)
+{
+    g_assert_not_reached ();
+    return FALSE;
+}
+
+static gboolean
+quit_cb (GMainLoop *loop)
+{
+    g_main_loop_quit (loop);
+    return FALSE;
+}
+
+static void
+test_remove (void)
+{
+    GMainLoop *loop;
+    RemoveContext ctx;
+    guint id;
+
+    loop = g_main_loop_new (NULL, FALSE);
+
+    /* Removed before it's due */
+    id = mm_coalesced_timeout_add_seconds (1, 0, not_reached_cb, NULL);
+    mm_coalesced_timeout_remove (id);
+
+    /* Removed by another one running in the same wakeup */
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.ids[0] = mm_coalesced_timeout_add_seconds (1, 1, (GSourceFunc) remove_second_cb, &ctx);
+    ctx.ids[1] = mm_coalesced_timeout_add_seconds (1, 1, (GSourceFunc) remove_first_cb, &ctx);
+
+    g_timeout_add (1500, (GSourceFunc) quit_cb, loop);
+    g_main_loop_run (loop);
+    g_assert_cmpuint (ctx.n_runs, ==, 1);
+
+    g_main_loop_unref (loop);
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    g_type_init ();
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/ModemManager/coalesced-timeout/period", test_period);
+    g_test_add_func ("/ModemManager/coalesced-timeout/batching", test_batching);
+    g_test_add_func ("/ModemManager/coalesced-timeout/remove", test_remove);
+
+    return g_test_run ();
+}
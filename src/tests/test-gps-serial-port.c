@@ -0,0 +1,184 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+
+#include "mm-port-serial-gps.h"
+#include "mm-log.h"
+
+#define GGA "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47"
+#define GGA_NO_CHECKSUM "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,"
+#define RMC_LOWERCASE "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6a"
+
+typedef struct {
+    MMPortSerialGps *port;
+    GByteArray *buffer;
+    GPtrArray *traces;
+} TestData;
+
+static void
+trace_cb (MMPortSerialGps *port,
+          const gchar *trace,
+          GPtrArray *traces)
+{
+    g_ptr_array_add (traces, g_strdup (trace));
+}
+
+static void
+test_setup (TestData *d,
+            gconstpointer user_data)
+{
+    d->port = mm_port_serial_gps_new ("test");
+    d->buffer = g_byte_array_new ();
+    d->traces = g_ptr_array_new_with_free_func (g_free);
+    mm_port_serial_gps_add_trace_handler (d->port,
+                                          (MMPortSerialGpsTraceFn)trace_cb,
+                                          d->traces,
+                                          NULL);
+}
+
+static void
+test_teardown (TestData *d,
+               gconstpointer user_data)
+{
+    g_object_unref (d->port);
+    g_byte_array_unref (d->buffer);
+    g_ptr_array_unref (d->traces);
+}
+
+/* Feeds data to the port as if just read from the device */
+static gboolean
+feed (TestData *d,
+      const gchar *data)
+{
+    g_byte_array_append (d->buffer, (const guint8 *) data, strlen (data));
+    return MM_PORT_SERIAL_GET_CLASS (d->port)->parse_response (MM_PORT_SERIAL (d->port),
+                                                               d->buffer,
+                                                               NULL);
+}
+
+static void
+assert_buffer (TestData *d,
+               const gchar *expected)
+{
+    g_assert_cmpuint (d->buffer->len, ==, strlen (expected));
+    g_assert (memcmp (d->buffer->data, expected, d->buffer->len) == 0);
+}
+
+/*****************************************************************************/
+
+static void
+test_checksum (TestData *d,
+               gconstpointer user_data)
+{
+    /* Good */
+    g_assert (feed (d, GGA "\r\n"));
+    g_assert_cmpuint (d->traces->len, ==, 1);
+    g_assert_cmpstr (g_ptr_array_index (d->traces, 0), ==, GGA "\r\n");
+    assert_buffer (d, "");
+
+    /* Lowercase hex digits */
+    g_assert (feed (d, RMC_LOWERCASE "\r\n"));
+    g_assert_cmpuint (d->traces->len, ==, 2);
+    g_assert_cmpstr (g_ptr_array_index (d->traces, 1), ==, RMC_LOWERCASE "\r\n");
+
+    /* No checksum given */
+    g_assert (feed (d, GGA_NO_CHECKSUM "\r\n"));
+    g_assert_cmpuint (d->traces->len, ==, 3);
+    g_assert_cmpstr (g_ptr_array_index (d->traces, 2), ==, GGA_NO_CHECKSUM "\r\n");
+
+    /* Wrong, truncated or not hex checksums are consumed but not reported */
+    g_assert (feed (d, GGA_NO_CHECKSUM "*48\r\n"));
+    g_assert (feed (d, GGA_NO_CHECKSUM "*4\r\n"));
+    g_assert (feed (d, GGA_NO_CHECKSUM "*\r\n"));
+    g_assert (feed (d, GGA_NO_CHECKSUM "*4G\r\n"));
+    g_assert_cmpuint (d->traces->len, ==, 3);
+    assert_buffer (d, "");
+}
+
+static void
+test_split (TestData *d,
+            gconstpointer user_data)
+{
+    /* Nothing complete yet, left as is */
+    g_assert (!feed (d, "$GPGGA,123519,4807.038,N,"));
+    assert_buffer (d, "$GPGGA,123519,4807.038,N,");
+
+    g_assert (!feed (d, "01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r"));
+    g_assert_cmpuint (d->traces->len, ==, 0);
+
+    g_assert (feed (d, "\n"));
+    g_assert_cmpuint (d->traces->len, ==, 1);
+    g_assert_cmpstr (g_ptr_array_index (d->traces, 0), ==, GGA "\r\n");
+    assert_buffer (d, "");
+
+    /* A bare \n doesn't end a trace, the next one is looked for instead */
+    g_assert (!feed (d, "$GPGGA,123519,4807.038\n"));
+    g_assert (feed (d, GGA "\r\n"));
+    g_assert_cmpuint (d->traces->len, ==, 2);
+    g_assert_cmpstr (g_ptr_array_index (d->traces, 1), ==, GGA "\r\n");
+}
+
+static void
+test_merged (TestData *d,
+             gconstpointer user_data)
+{
+    /* Garbage before the first trace is dropped, and whatever comes after
+     * the last complete one is kept for the next read */
+    g_assert (feed (d,
+                    "garbage"
+                    GGA "\r\n"
+                    RMC_LOWERCASE "\r\n"
+                    GGA_NO_CHECKSUM "*00\r\n"
+                    "$GPGSV,2,1,08"));
+    g_assert_cmpuint (d->traces->len, ==, 2);
+    g_assert_cmpstr (g_ptr_array_index (d->traces, 0), ==, GGA "\r\n");
+    g_assert_cmpstr (g_ptr_array_index (d->traces, 1), ==, RMC_LOWERCASE "\r\n");
+    assert_buffer (d, "$GPGSV,2,1,08");
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    g_type_init ();
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add ("/ModemManager/gps-serial-port/checksum", TestData, NULL, test_setup, test_checksum, test_teardown);
+    g_test_add ("/ModemManager/gps-serial-port/split", TestData, NULL, test_setup, test_split, test_teardown);
+    g_test_add ("/ModemManager/gps-serial-port/merged", TestData, NULL, test_setup, test_merged, test_teardown);
+
+    return g_test_run ();
+}
@@ -17,6 +17,8 @@
 #include <glib-object.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
 
 #include <libmm-glib.h>
 #include "mm-modem-helpers.h"
@@ -2342,6 +2344,317 @@ test_supported_capability_filter (void *f, gpointer d)
 
 /*****************************************************************************/
 
+static MMRegex test_regex = MM_REGEX_INIT ("\\+CSQ:\\s*(\\d+),\\s*(\\d+)", G_REGEX_RAW, 0);
+
+static void
+test_regex_registry (void *f, gpointer d)
+{
+    GRegex *r1;
+    GRegex *r2;
+
+    /* Compiled once, and every user gets a reference to the same one */
+    r1 = mm_regex_get (&test_regex);
+    r2 = mm_regex_get (&test_regex);
+    g_assert (r1 != NULL);
+    g_assert (r1 == r2);
+    g_assert_cmpuint (g_regex_get_compile_flags (r1) & G_REGEX_RAW, ==, G_REGEX_RAW);
+    g_assert (g_regex_match (r1, "+CSQ: 15,99", 0, NULL));
+    g_regex_unref (r1);
+    g_regex_unref (r2);
+
+    /* Still usable after all users are gone */
+    r1 = mm_regex_get (&test_regex);
+    g_assert (g_regex_match (r1, "+CSQ: 31,0", 0, NULL));
+    g_regex_unref (r1);
+}
+
+static void
+test_regex_registry_benchmark (void *f, gpointer d)
+{
+    static const gchar *reply = "+CSQ: 15,99";
+    gdouble before;
+    gdouble after;
+    guint i;
+
+    if (!g_test_perf ())
+        return;
+
+    g_test_timer_start ();
+    for (i = 0; i < 100000; i++) {
+        GRegex *r;
+
+        r = g_regex_new (test_regex.pattern, test_regex.compile_options, test_regex.match_options, NULL);
+        g_regex_match (r, reply, 0, NULL);
+        g_regex_unref (r);
+    }
+    before = g_test_timer_elapsed ();
+
+    g_test_timer_start ();
+    for (i = 0; i < 100000; i++) {
+        GRegex *r;
+
+        r = mm_regex_get (&test_regex);
+        g_regex_match (r, reply, 0, NULL);
+        g_regex_unref (r);
+    }
+    after = g_test_timer_elapsed ();
+
+    g_test_message ("compile per call %.3fs, registry %.3fs (100000 matches)", before, after);
+    g_test_minimized_result (after, "registry: %.3fs", after);
+}
+
+/*****************************************************************************/
+/* Test chained command responses */
+
+static void
+test_chained_response (void *f, gpointer d)
+{
+    static const gchar *commands[] = { "+CREG?", "AT+CGREG?", "+CGDCONT?", "+CEREG?" };
+    static const gchar *reply =
+        "+CGREG: 2,1,\"1F00\",\"79D903\",2\r\n"
+        "\r\n"
+        "+CGDCONT: 1,\"IP\",\"internet\",\"\",0,0\r\n"
+        "+CGDCONT: 2,\"IPV6\",\"ims\",\"\",0,0\r\n"
+        "\r\n"
+        "+CREG: 2,5,\"1F00\",\"79D903\",2";
+    gchar **split;
+
+    split = mm_split_chained_response (reply, commands, G_N_ELEMENTS (commands));
+    g_assert_cmpuint (g_strv_length (split), ==, G_N_ELEMENTS (commands));
+    g_assert_cmpstr (split[0], ==, "+CREG: 2,5,\"1F00\",\"79D903\",2");
+    g_assert_cmpstr (split[1], ==, "+CGREG: 2,1,\"1F00\",\"79D903\",2");
+    g_assert_cmpstr (split[2], ==,
+                     "+CGDCONT: 1,\"IP\",\"internet\",\"\",0,0\r\n"
+                     "+CGDCONT: 2,\"IPV6\",\"ims\",\"\",0,0");
+    /* Consumed elsewhere (e.g. by unsolicited message handlers) */
+    g_assert_cmpstr (split[3], ==, "");
+    g_strfreev (split);
+}
+
+/*****************************************************************************/
+/* Test adaptive signal quality polling */
+
+static void
+test_signal_quality_check_interval (void *f, gpointer d)
+{
+    guint interval;
+    guint i;
+
+    /* Backs off while indications arrive, but never so much that the last
+     * value expires once they stop because the signal is stable */
+    interval = 30;
+    for (i = 0; i < 10; i++) {
+        interval = mm_signal_quality_check_next_interval (interval, MM_SIGNAL_QUALITY_CHECK_INDICATION);
+        g_assert_cmpuint (interval, <, MM_SIGNAL_QUALITY_RECENT_TIMEOUT_SEC);
+    }
+    g_assert_cmpuint (interval, ==, MM_SIGNAL_QUALITY_CHECK_MAX_INTERVAL_SEC);
+
+    /* Same while the polled value is stable */
+    interval = 30;
+    for (i = 0; i < 10; i++) {
+        interval = mm_signal_quality_check_next_interval (interval, MM_SIGNAL_QUALITY_CHECK_STABLE);
+        g_assert_cmpuint (interval, <, MM_SIGNAL_QUALITY_RECENT_TIMEOUT_SEC);
+    }
+    g_assert_cmpuint (interval, ==, MM_SIGNAL_QUALITY_CHECK_MAX_INTERVAL_SEC);
+
+    /* Halved on changes, down to the minimum */
+    interval = mm_signal_quality_check_next_interval (interval, MM_SIGNAL_QUALITY_CHECK_CHANGED);
+    g_assert_cmpuint (interval, ==, MM_SIGNAL_QUALITY_CHECK_MAX_INTERVAL_SEC / 2);
+    for (i = 0; i < 10; i++)
+        interval = mm_signal_quality_check_next_interval (interval, MM_SIGNAL_QUALITY_CHECK_CHANGED);
+    g_assert_cmpuint (interval, ==, MM_SIGNAL_QUALITY_CHECK_MIN_INTERVAL_SEC);
+
+    /* And back up again once stable */
+    interval = mm_signal_quality_check_next_interval (interval, MM_SIGNAL_QUALITY_CHECK_STABLE);
+    g_assert_cmpuint (interval, ==, MM_SIGNAL_QUALITY_CHECK_MIN_INTERVAL_SEC * 2);
+
+    /* Intervals above the maximum are brought back into range */
+    g_assert_cmpuint (mm_signal_quality_check_next_interval (300, MM_SIGNAL_QUALITY_CHECK_INDICATION),
+                      ==, MM_SIGNAL_QUALITY_CHECK_MAX_INTERVAL_SEC);
+    g_assert_cmpuint (mm_signal_quality_check_next_interval (300, MM_SIGNAL_QUALITY_CHECK_CHANGED),
+                      ==, MM_SIGNAL_QUALITY_CHECK_MAX_INTERVAL_SEC / 2);
+}
+
+/*****************************************************************************/
+/* Test GPS distance helpers */
+
+static void
+test_gps_distance (void *f, gpointer d)
+{
+    /* Same point */
+    g_assert_cmpfloat (mm_gps_distance (48.8566, 2.3522, 48.8566, 2.3522), ==, 0.0);
+
+    /* One degree of longitude along the equator, both ways */
+    g_assert_cmpfloat (fabs (mm_gps_distance (0.0, 0.0, 0.0, 1.0) - 111195.08), <, 0.01);
+    g_assert_cmpfloat (fabs (mm_gps_distance (0.0, 1.0, 0.0, 0.0) - 111195.08), <, 0.01);
+
+    /* Paris to London */
+    g_assert_cmpfloat (fabs (mm_gps_distance (48.8566, 2.3522, 51.5074, -0.1278) - 343556.53), <, 0.01);
+
+    /* Antipodes, half the circumference */
+    g_assert_cmpfloat (fabs (mm_gps_distance (0.0, 0.0, 0.0, 180.0) - 20015114.44), <, 0.01);
+}
+
+static void
+test_gps_distance_threshold (void *f, gpointer d)
+{
+    /* ~100m north */
+    static const gdouble latitude = 48.8566;
+    static const gdouble longitude = 2.3522;
+    static const gdouble moved_latitude = 48.8566 + 0.0009;
+
+    /* Disabled */
+    g_assert (!mm_gps_distance_threshold_reached (0, TRUE, latitude, longitude, moved_latitude, longitude));
+    g_assert (!mm_gps_distance_threshold_reached (0, FALSE, 0.0, 0.0, latitude, longitude));
+
+    /* First known position */
+    g_assert (mm_gps_distance_threshold_reached (100, FALSE, 0.0, 0.0, latitude, longitude));
+
+    /* Unknown position */
+    g_assert (!mm_gps_distance_threshold_reached (100, FALSE, 0.0, 0.0,
+                                                  MM_LOCATION_LATITUDE_UNKNOWN, longitude));
+    g_assert (!mm_gps_distance_threshold_reached (100, TRUE, latitude, longitude,
+                                                  moved_latitude, MM_LOCATION_LONGITUDE_UNKNOWN));
+
+    /* Below and above the threshold */
+    g_assert (!mm_gps_distance_threshold_reached (100, TRUE, latitude, longitude, latitude, longitude));
+    g_assert (mm_gps_distance_threshold_reached (100, TRUE, latitude, longitude, moved_latitude, longitude));
+    g_assert (!mm_gps_distance_threshold_reached (101, TRUE, latitude, longitude, moved_latitude, longitude));
+}
+
+/*****************************************************************************/
+/* Test data port preference */
+
+static void
+test_net_port_get_driver (void *f, gpointer d)
+{
+    GError *error = NULL;
+    gchar *sysfs;
+    gchar *device;
+    gchar *link;
+    gchar *driver;
+
+    /* /sys/class/net/<iface>/device/driver links to the driver directory */
+    sysfs = g_dir_make_tmp ("mm-test-sysfs-XXXXXX", &error);
+    g_assert_no_error (error);
+    device = g_build_filename (sysfs, "wwan0", "device", NULL);
+    g_assert_cmpint (g_mkdir_with_parents (device, 0755), ==, 0);
+    link = g_build_filename (device, "driver", NULL);
+    g_assert_cmpint (symlink ("../../../../bus/usb/drivers/qmi_wwan", link), ==, 0);
+
+    driver = mm_net_port_get_driver (sysfs, "wwan0");
+    g_assert_cmpstr (driver, ==, "qmi_wwan");
+    g_free (driver);
+
+    /* Unknown interface */
+    g_assert (mm_net_port_get_driver (sysfs, "wwan1") == NULL);
+
+    unlink (link);
+    rmdir (device);
+    g_free (device);
+    device = g_build_filename (sysfs, "wwan0", NULL);
+    rmdir (device);
+    rmdir (sysfs);
+    g_free (device);
+    g_free (link);
+    g_free (sysfs);
+}
+
+static void
+test_net_driver_rank (void *f, gpointer d)
+{
+    g_assert_cmpuint (mm_net_driver_get_rank ("qmi_wwan"), ==, 0);
+    g_assert_cmpuint (mm_net_driver_get_rank ("cdc_mbim"), <, mm_net_driver_get_rank ("cdc_ether"));
+    g_assert_cmpuint (mm_net_driver_get_rank ("cdc_ether"), <, mm_net_driver_get_rank ("unknown"));
+    g_assert_cmpuint (mm_net_driver_get_rank (NULL), ==, mm_net_driver_get_rank ("unknown"));
+}
+
+static void
+test_data_port_cmp (void *f, gpointer d)
+{
+    guint qmi_wwan;
+    guint cdc_ether;
+
+    qmi_wwan = mm_net_driver_get_rank ("qmi_wwan");
+    cdc_ether = mm_net_driver_get_rank ("cdc_ether");
+
+    /* Net ports before AT ports, whatever the driver */
+    g_assert_cmpint (mm_data_port_cmp (TRUE, cdc_ether, "wwan0", FALSE, 0, "ttyUSB0"), <, 0);
+    g_assert_cmpint (mm_data_port_cmp (FALSE, 0, "ttyUSB0", TRUE, cdc_ether, "wwan0"), >, 0);
+
+    /* AT ports keep their order */
+    g_assert_cmpint (mm_data_port_cmp (FALSE, 0, "ttyUSB2", FALSE, 0, "ttyUSB0"), ==, 0);
+
+    /* Net ports by driver, then by name */
+    g_assert_cmpint (mm_data_port_cmp (TRUE, qmi_wwan, "wwan1", TRUE, cdc_ether, "wwan0"), <, 0);
+    g_assert_cmpint (mm_data_port_cmp (TRUE, cdc_ether, "wwan0", TRUE, qmi_wwan, "wwan1"), >, 0);
+    g_assert_cmpint (mm_data_port_cmp (TRUE, qmi_wwan, "wwan0", TRUE, qmi_wwan, "wwan1"), <, 0);
+    g_assert_cmpint (mm_data_port_cmp (TRUE, qmi_wwan, "wwan0", TRUE, qmi_wwan, "wwan0"), ==, 0);
+}
+
+static void
+test_data_port_usage (void *f, gpointer d)
+{
+    MMDataPortUsage a = { 0 };
+    MMDataPortUsage b = { 0 };
+    guint counter = 0;
+
+    /* Connections are numbered across ports */
+    g_assert (mm_data_port_usage_set_connected (&a, TRUE, 1 * G_USEC_PER_SEC, &counter));
+    g_assert (mm_data_port_usage_set_connected (&b, TRUE, 2 * G_USEC_PER_SEC, &counter));
+    g_assert_cmpuint (a.last_connection, ==, 1);
+    g_assert_cmpuint (b.last_connection, ==, 2);
+
+    /* Repeated notifications of the same state are ignored */
+    g_assert (!mm_data_port_usage_set_connected (&a, TRUE, 3 * G_USEC_PER_SEC, &counter));
+    g_assert_cmpuint (a.n_connections, ==, 1);
+    g_assert_cmpuint (a.last_connection, ==, 1);
+
+    /* Time connected, including the current connection */
+    g_assert (mm_data_port_usage_set_connected (&a, FALSE, 4 * G_USEC_PER_SEC, &counter));
+    g_assert (!mm_data_port_usage_set_connected (&a, FALSE, 5 * G_USEC_PER_SEC, &counter));
+    g_assert_cmpint (mm_data_port_usage_get_connected_time (&a, 10 * G_USEC_PER_SEC), ==, 3 * G_USEC_PER_SEC);
+    g_assert (mm_data_port_usage_set_connected (&a, TRUE, 10 * G_USEC_PER_SEC, &counter));
+    g_assert_cmpint (mm_data_port_usage_get_connected_time (&a, 12 * G_USEC_PER_SEC), ==, 5 * G_USEC_PER_SEC);
+    g_assert_cmpuint (a.n_connections, ==, 2);
+    g_assert_cmpuint (a.last_connection, ==, 3);
+    g_assert_cmpuint (counter, ==, 3);
+}
+
+static void
+test_data_port_usage_select (void *f, gpointer d)
+{
+    MMDataPortUsage usages[3] = { { 0 } };
+    const MMDataPortUsage *candidates[3];
+    guint counter = 0;
+    gint64 now = G_USEC_PER_SEC;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (usages); i++)
+        candidates[i] = &usages[i];
+
+    g_assert_cmpint (mm_data_port_usage_select (candidates, 0), ==, -1);
+
+    /* Never used ports in order, then the one used longest ago */
+    for (i = 0; i < 2 * G_N_ELEMENTS (usages); i++) {
+        gint selected;
+
+        selected = mm_data_port_usage_select (candidates, G_N_ELEMENTS (usages));
+        g_assert_cmpint (selected, ==, i % G_N_ELEMENTS (usages));
+        mm_data_port_usage_set_connected (&usages[selected], TRUE, now++, &counter);
+        mm_data_port_usage_set_connected (&usages[selected], FALSE, now++, &counter);
+    }
+
+    /* Selecting without connecting doesn't alter the rotation */
+    g_assert_cmpint (mm_data_port_usage_select (candidates, G_N_ELEMENTS (usages)), ==, 0);
+    g_assert_cmpint (mm_data_port_usage_select (candidates, G_N_ELEMENTS (usages)), ==, 0);
+
+    /* Only free ports are given as candidates */
+    g_assert_cmpint (mm_data_port_usage_select (&candidates[1], 2), ==, 0);
+}
+
+/*****************************************************************************/
+
 void
 _mm_log (const char *loc,
          const char *func,
@@ -2501,6 +2814,22 @@ int main (int argc, char **argv)
 
     g_test_suite_add (suite, TESTCASE (test_supported_capability_filter, NULL));
 
+    g_test_suite_add (suite, TESTCASE (test_regex_registry, NULL));
+    g_test_suite_add (suite, TESTCASE (test_regex_registry_benchmark, NULL));
+
+    g_test_suite_add (suite, TESTCASE (test_chained_response, NULL));
+
+    g_test_suite_add (suite, TESTCASE (test_signal_quality_check_interval, NULL));
+
+    g_test_suite_add (suite, TESTCASE (test_gps_distance, NULL));
+    g_test_suite_add (suite, TESTCASE (test_gps_distance_threshold, NULL));
+
+    g_test_suite_add (suite, TESTCASE (test_net_port_get_driver, NULL));
+    g_test_suite_add (suite, TESTCASE (test_net_driver_rank, NULL));
+    g_test_suite_add (suite, TESTCASE (test_data_port_cmp, NULL));
+    g_test_suite_add (suite, TESTCASE (test_data_port_usage, NULL));
+    g_test_suite_add (suite, TESTCASE (test_data_port_usage_select, NULL));
+
     result = g_test_run ();
 
     reg_test_data_free (reg_data);
@@ -0,0 +1,215 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "mm-probe-cache.h"
+#include "mm-log.h"
+
+#define TEST_KEY "1199:68a2:03:qcserial:tty"
+
+typedef struct {
+    gchar *dir;
+    gchar *file;
+} TestData;
+
+static void
+test_setup (TestData *d,
+            gconstpointer user_data)
+{
+    GError *error = NULL;
+
+    d->dir = g_dir_make_tmp ("mm-probe-cache-XXXXXX", &error);
+    g_assert_no_error (error);
+    d->file = g_build_filename (d->dir, "probe-cache", NULL);
+}
+
+static void
+test_teardown (TestData *d,
+               gconstpointer user_data)
+{
+    mm_probe_cache_shutdown ();
+    g_unlink (d->file);
+    g_rmdir (d->dir);
+    g_free (d->file);
+    g_free (d->dir);
+}
+
+static void
+cache_setup (TestData *d)
+{
+    GError *error = NULL;
+
+    g_assert (mm_probe_cache_setup (d->file, &error));
+    g_assert_no_error (error);
+    g_assert (mm_probe_cache_enabled ());
+}
+
+static void
+store_at_entry (void)
+{
+    MMProbeCacheEntry entry;
+
+    memset (&entry, 0, sizeof (entry));
+    entry.flags = 0x7F;
+    entry.is_at = TRUE;
+    entry.vendor = "sierra";
+    entry.product = "mc7710";
+    mm_probe_cache_store (TEST_KEY, &entry);
+}
+
+/*****************************************************************************/
+
+static void
+test_build_key (void)
+{
+    gchar *key;
+
+    key = mm_probe_cache_build_key (0x1199, 0x68a2, "03", "qcserial", "tty");
+    g_assert_cmpstr (key, ==, TEST_KEY);
+    g_free (key);
+
+    /* Ports which cannot be reliably identified are never cached */
+    g_assert (mm_probe_cache_build_key (0, 0x68a2, "03", "qcserial", "tty") == NULL);
+    g_assert (mm_probe_cache_build_key (0x1199, 0x68a2, NULL, "qcserial", "tty") == NULL);
+    g_assert (mm_probe_cache_build_key (0x1199, 0x68a2, "03", NULL, "tty") == NULL);
+}
+
+static void
+test_store_and_load (TestData *d,
+                     gconstpointer user_data)
+{
+    MMProbeCacheEntry entry;
+
+    cache_setup (d);
+    g_assert (!mm_probe_cache_lookup (TEST_KEY, &entry));
+
+    store_at_entry ();
+    g_assert (mm_probe_cache_lookup (TEST_KEY, &entry));
+    g_assert_cmpuint (entry.flags, ==, 0x7F);
+    g_assert (entry.is_at);
+    g_assert (!entry.is_qcdm);
+    g_assert_cmpstr (entry.vendor, ==, "sierra");
+    g_assert_cmpstr (entry.product, ==, "mc7710");
+    mm_probe_cache_entry_clear (&entry);
+
+    /* Writes are batched, nothing on disk until flushed */
+    g_assert (!g_file_test (d->file, G_FILE_TEST_EXISTS));
+    mm_probe_cache_flush ();
+    g_assert (g_file_test (d->file, G_FILE_TEST_EXISTS));
+
+    /* Loaded back after a restart */
+    cache_setup (d);
+    g_assert (mm_probe_cache_lookup (TEST_KEY, &entry));
+    g_assert_cmpuint (entry.flags, ==, 0x7F);
+    g_assert (entry.is_at);
+    g_assert_cmpstr (entry.vendor, ==, "sierra");
+    g_assert_cmpstr (entry.product, ==, "mc7710");
+    mm_probe_cache_entry_clear (&entry);
+}
+
+static void
+test_remove (TestData *d,
+             gconstpointer user_data)
+{
+    MMProbeCacheEntry entry;
+
+    cache_setup (d);
+    store_at_entry ();
+    mm_probe_cache_flush ();
+
+    mm_probe_cache_remove (TEST_KEY);
+    g_assert (!mm_probe_cache_lookup (TEST_KEY, &entry));
+
+    /* Pending changes are written out on shutdown */
+    mm_probe_cache_shutdown ();
+    g_assert (!mm_probe_cache_enabled ());
+    cache_setup (d);
+    g_assert (!mm_probe_cache_lookup (TEST_KEY, &entry));
+}
+
+static void
+test_corrupted (TestData *d,
+                gconstpointer user_data)
+{
+    MMProbeCacheEntry entry;
+
+    g_assert (g_file_set_contents (d->file, "[" TEST_KEY "\nflags=", -1, NULL));
+
+    /* A broken cache is just an empty one */
+    cache_setup (d);
+    g_assert (!mm_probe_cache_lookup (TEST_KEY, &entry));
+
+    /* Unparseable values read as not available */
+    g_assert (g_file_set_contents (d->file, "[" TEST_KEY "]\nflags=foo\nat=true\n", -1, NULL));
+    cache_setup (d);
+    g_assert (!mm_probe_cache_lookup (TEST_KEY, &entry));
+    mm_probe_cache_entry_clear (&entry);
+}
+
+static void
+test_needs_open (void)
+{
+    MMProbeCacheEntry entry;
+
+    memset (&entry, 0, sizeof (entry));
+    entry.is_at = TRUE;
+    g_assert (mm_probe_cache_entry_needs_open (&entry));
+
+    entry.is_at = FALSE;
+    entry.is_qcdm = TRUE;
+    g_assert (mm_probe_cache_entry_needs_open (&entry));
+
+    entry.is_qcdm = FALSE;
+    entry.is_qmi = TRUE;
+    g_assert (!mm_probe_cache_entry_needs_open (&entry));
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    g_type_init ();
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/ModemManager/probe-cache/build-key", test_build_key);
+    g_test_add ("/ModemManager/probe-cache/store-and-load", TestData, NULL, test_setup, test_store_and_load, test_teardown);
+    g_test_add ("/ModemManager/probe-cache/remove", TestData, NULL, test_setup, test_remove, test_teardown);
+    g_test_add ("/ModemManager/probe-cache/corrupted", TestData, NULL, test_setup, test_corrupted, test_teardown);
+    g_test_add_func ("/ModemManager/probe-cache/needs-open", test_needs_open);
+
+    return g_test_run ();
+}
@@ -0,0 +1,207 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+
+#define _LIBMM_INSIDE_MM
+#include <libmm-glib.h>
+
+#include "mm-property-batch.h"
+#include "mm-context.h"
+#include "mm-log.h"
+
+#define TEST_WINDOW_MS 50
+
+static guint batch_window;
+
+typedef struct {
+    MmGdbusModem *skeleton;
+    GPtrArray *notified;
+} TestData;
+
+static void
+notify_cb (GObject *object,
+           GParamSpec *pspec,
+           GPtrArray *notified)
+{
+    g_ptr_array_add (notified, g_strdup (pspec->name));
+}
+
+static void
+test_setup (TestData *d,
+            gconstpointer user_data)
+{
+    batch_window = TEST_WINDOW_MS;
+    d->skeleton = mm_gdbus_modem_skeleton_new ();
+    d->notified = g_ptr_array_new_with_free_func (g_free);
+    g_signal_connect (d->skeleton, "notify", G_CALLBACK (notify_cb), d->notified);
+}
+
+static void
+test_teardown (TestData *d,
+               gconstpointer user_data)
+{
+    g_object_unref (d->skeleton);
+    g_ptr_array_unref (d->notified);
+}
+
+static gboolean
+was_notified (TestData *d,
+              const gchar *property)
+{
+    guint i;
+
+    for (i = 0; i < d->notified->len; i++) {
+        if (g_str_equal (g_ptr_array_index (d->notified, i), property))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean
+quit_cb (GMainLoop *loop)
+{
+    g_main_loop_quit (loop);
+    return FALSE;
+}
+
+/* Runs the main loop for longer than the batch window */
+static void
+run_past_window (void)
+{
+    GMainLoop *loop;
+
+    loop = g_main_loop_new (NULL, FALSE);
+    g_timeout_add (TEST_WINDOW_MS * 4, (GSourceFunc) quit_cb, loop);
+    g_main_loop_run (loop);
+    g_main_loop_unref (loop);
+}
+
+static void
+set_signal_quality (TestData *d,
+                    guint quality)
+{
+    mm_property_batch_update (d->skeleton);
+    mm_gdbus_modem_set_signal_quality (d->skeleton, g_variant_new ("(ub)", quality, TRUE));
+}
+
+/*****************************************************************************/
+
+static void
+test_batch (TestData *d,
+            gconstpointer user_data)
+{
+    guint quality;
+    gboolean recent;
+
+    set_signal_quality (d, 10);
+    set_signal_quality (d, 20);
+    mm_property_batch_update (d->skeleton);
+    mm_gdbus_modem_set_access_technologies (d->skeleton, MM_MODEM_ACCESS_TECHNOLOGY_LTE);
+
+    /* Values are updated right away, notifications are held back */
+    g_variant_get (mm_gdbus_modem_get_signal_quality (d->skeleton), "(ub)", &quality, &recent);
+    g_assert_cmpuint (quality, ==, 20);
+    g_assert_cmpuint (d->notified->len, ==, 0);
+
+    /* And delivered once each when the window elapses */
+    run_past_window ();
+    g_assert_cmpuint (d->notified->len, ==, 2);
+    g_assert (was_notified (d, "signal-quality"));
+    g_assert (was_notified (d, "access-technologies"));
+
+    /* A new update starts a new batch */
+    set_signal_quality (d, 30);
+    g_assert_cmpuint (d->notified->len, ==, 2);
+    run_past_window ();
+    g_assert_cmpuint (d->notified->len, ==, 3);
+}
+
+static void
+test_flush (TestData *d,
+            gconstpointer user_data)
+{
+    set_signal_quality (d, 10);
+
+    /* Properties updated outside the batch are held back too */
+    mm_gdbus_modem_set_state (d->skeleton, MM_MODEM_STATE_REGISTERED);
+    g_assert_cmpuint (d->notified->len, ==, 0);
+
+    /* Flushing delivers everything right away, as done before StateChanged */
+    mm_property_batch_flush (d->skeleton);
+    g_assert_cmpuint (d->notified->len, ==, 2);
+    g_assert (was_notified (d, "signal-quality"));
+    g_assert (was_notified (d, "state"));
+
+    /* Nothing else pending once the window elapses */
+    run_past_window ();
+    g_assert_cmpuint (d->notified->len, ==, 2);
+
+    /* Flushing without a batch is a no-op */
+    mm_property_batch_flush (d->skeleton);
+    g_assert_cmpuint (d->notified->len, ==, 2);
+}
+
+static void
+test_disabled (TestData *d,
+               gconstpointer user_data)
+{
+    batch_window = 0;
+
+    set_signal_quality (d, 10);
+    g_assert_cmpuint (d->notified->len, ==, 1);
+    set_signal_quality (d, 20);
+    g_assert_cmpuint (d->notified->len, ==, 2);
+}
+
+/*****************************************************************************/
+
+guint
+mm_context_get_property_batch_window (void)
+{
+    return batch_window;
+}
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    g_type_init ();
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add ("/ModemManager/property-batch/batch", TestData, NULL, test_setup, test_batch, test_teardown);
+    g_test_add ("/ModemManager/property-batch/flush", TestData, NULL, test_setup, test_flush, test_teardown);
+    g_test_add ("/ModemManager/property-batch/disabled", TestData, NULL, test_setup, test_disabled, test_teardown);
+
+    return g_test_run ();
+}
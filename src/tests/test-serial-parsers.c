@@ -0,0 +1,259 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <glib-object.h>
+
+#include <libmm-glib.h>
+#include "mm-serial-parsers.h"
+#include "mm-log.h"
+
+/*****************************************************************************/
+
+static gboolean
+run_parser (gboolean use_regex,
+            const gchar *response,
+            gsize response_len,
+            GString **out_response,
+            GError **error)
+{
+    gpointer parser;
+    GString *str;
+    gboolean found;
+
+    parser = mm_serial_parser_v1_new ();
+    mm_serial_parser_v1_set_use_regex (parser, use_regex);
+
+    str = g_string_new_len (response, response_len);
+    found = mm_serial_parser_v1_parse (parser, str, error);
+    mm_serial_parser_v1_destroy (parser);
+
+    *out_response = str;
+    return found;
+}
+
+/*****************************************************************************/
+/* Known replies */
+
+typedef struct {
+    const gchar *response;
+    gboolean     found;
+    const gchar *cleaned;
+    GQuark     (* error_domain) (void);
+    gint         error_code;
+} ParserTest;
+
+static const ParserTest parser_tests[] = {
+    { "\r\nOK\r\n", TRUE, "", NULL, 0 },
+    { "\r\n+CGMI: foo\r\n\r\nOK\r\n", TRUE, "+CGMI: foo", NULL, 0 },
+    { "\r\nCONNECT 115200\r\n", TRUE, "CONNECT 115200", NULL, 0 },
+    { "\r\n> ", TRUE, "> ", NULL, 0 },
+    { "\r\n+CME ERROR: 10\r\n", TRUE, "+CME ERROR: 10",
+      mm_mobile_equipment_error_quark, MM_MOBILE_EQUIPMENT_ERROR_SIM_NOT_INSERTED },
+    { "\r\n+CMS ERROR: 310\r\n", TRUE, "+CMS ERROR: 310",
+      mm_message_error_quark, MM_MESSAGE_ERROR_SIM_NOT_INSERTED },
+    { "\r\n+CME ERROR: SIM busy\r\n", TRUE, "+CME ERROR: SIM busy",
+      mm_mobile_equipment_error_quark, MM_MOBILE_EQUIPMENT_ERROR_SIM_BUSY },
+    { "\r\n+CMS ERROR: SIM busy\r\n", TRUE, "+CMS ERROR: SIM busy",
+      mm_message_error_quark, MM_MESSAGE_ERROR_SIM_BUSY },
+    { "\r\nMODEM ERROR: 5\r\n", TRUE, "MODEM ERROR: 5",
+      mm_mobile_equipment_error_quark, MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN },
+    { "\r\nERROR\r\n", TRUE, "ERROR",
+      mm_mobile_equipment_error_quark, MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN },
+    { "\r\nCOMMAND NOT SUPPORT\r\n", TRUE, "COMMAND NOT SUPPORT",
+      mm_mobile_equipment_error_quark, MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN },
+    { "\r\nNO CARRIER\r\n", TRUE, "NO CARRIER",
+      mm_connection_error_quark, MM_CONNECTION_ERROR_NO_CARRIER },
+    { "\r\nNA\r\n", TRUE, "NA",
+      mm_mobile_equipment_error_quark, MM_MOBILE_EQUIPMENT_ERROR_NOT_ALLOWED },
+    { "\r\n+CREG: 1\r\n", FALSE, "\r\n+CREG: 1\r\n", NULL, 0 },
+    { "\r\n+CME ERROR: 1", FALSE, "\r\n+CME ERROR: 1", NULL, 0 },
+    { "\r\nOK", FALSE, "\r\nOK", NULL, 0 },
+};
+
+static void
+test_known_replies (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (parser_tests); i++) {
+        guint use_regex;
+
+        for (use_regex = 0; use_regex < 2; use_regex++) {
+            GString *response;
+            GError *error = NULL;
+            gboolean found;
+
+            found = run_parser (use_regex,
+                                parser_tests[i].response,
+                                strlen (parser_tests[i].response),
+                                &response,
+                                &error);
+            g_assert_cmpuint (found, ==, parser_tests[i].found);
+            g_assert_cmpstr (response->str, ==, parser_tests[i].cleaned);
+            if (parser_tests[i].error_domain)
+                g_assert_error (error, parser_tests[i].error_domain (), parser_tests[i].error_code);
+            else
+                g_assert_no_error (error);
+            g_string_free (response, TRUE);
+        }
+    }
+}
+
+/*****************************************************************************/
+/* Differential test: random responses must be handled the same way by the
+ * single-pass classifier and by the regex cascade */
+
+static const gchar *fuzz_tokens[] = {
+    "\r\n", "\r\n", "\r\n", "\r", "\n", "\f", " ", "\t", "\x85",
+    "OK", "ERROR", "+CME ERROR:", "+CMS ERROR:", "MODEM ERROR:",
+    "10", "3", "SIM busy", "CONNECT", " 115200",
+    "NO CARRIER", "BUSY", "NO ANSWER", "NO DIALTONE", "COMMAND NOT SUPPORT",
+    "NA", ">", "x", "+CREG: 1", "\r\nOK", "OK\r\n",
+};
+
+static void
+test_differential (void)
+{
+    guint n_iterations;
+    guint i;
+
+    n_iterations = g_test_thorough () ? 1000000 : 20000;
+
+    for (i = 0; i < n_iterations; i++) {
+        GString *input;
+        GString *classifier_response;
+        GString *regex_response;
+        GError *classifier_error = NULL;
+        GError *regex_error = NULL;
+        gboolean classifier_found;
+        gboolean regex_found;
+        guint n_tokens;
+
+        input = g_string_new ("");
+        n_tokens = g_test_rand_int_range (1, 11);
+        while (n_tokens--)
+            g_string_append (input, fuzz_tokens[g_test_rand_int_range (0, G_N_ELEMENTS (fuzz_tokens))]);
+
+        classifier_found = run_parser (FALSE, input->str, input->len, &classifier_response, &classifier_error);
+        regex_found = run_parser (TRUE, input->str, input->len, &regex_response, &regex_error);
+
+        g_assert_cmpuint (classifier_found, ==, regex_found);
+        g_assert_cmpuint (classifier_response->len, ==, regex_response->len);
+        g_assert (memcmp (classifier_response->str, regex_response->str, regex_response->len) == 0);
+        if (regex_error) {
+            g_assert_error (classifier_error, regex_error->domain, regex_error->code);
+            g_assert_cmpstr (classifier_error->message, ==, regex_error->message);
+            g_error_free (regex_error);
+            g_error_free (classifier_error);
+        } else
+            g_assert_no_error (classifier_error);
+
+        g_string_free (classifier_response, TRUE);
+        g_string_free (regex_response, TRUE);
+        g_string_free (input, TRUE);
+    }
+}
+
+/*****************************************************************************/
+/* Benchmark, only run in perf mode (-m perf) */
+
+static const gchar *benchmark_responses[] = {
+    /* Partial response, the most common case while reading */
+    "\r\n+COPS: (2,\"Vodafone\",\"VF\",\"21401\",2),(1,\"Movistar\",\"MV\",\"21407\",2),"
+    "(1,\"Orange\",\"OR\",\"21403\",2),,(0,1,2,3,4),(0,1,2)\r\n",
+    "\r\n+CGMR: 1.2.3\r\n\r\nOK\r\n",
+    "\r\n+CME ERROR: SIM busy\r\n",
+    "\r\nNO CARRIER\r\n",
+};
+
+static gdouble
+benchmark_parser (gboolean use_regex,
+                  const gchar *response,
+                  guint n_iterations)
+{
+    gpointer parser;
+    GString *str;
+    guint i;
+
+    parser = mm_serial_parser_v1_new ();
+    mm_serial_parser_v1_set_use_regex (parser, use_regex);
+    str = g_string_sized_new (strlen (response) + 1);
+
+    g_test_timer_start ();
+    for (i = 0; i < n_iterations; i++) {
+        g_string_assign (str, response);
+        mm_serial_parser_v1_parse (parser, str, NULL);
+    }
+
+    g_string_free (str, TRUE);
+    mm_serial_parser_v1_destroy (parser);
+    return g_test_timer_elapsed ();
+}
+
+static void
+test_benchmark (void)
+{
+    guint i;
+
+    if (!g_test_perf ())
+        return;
+
+    for (i = 0; i < G_N_ELEMENTS (benchmark_responses); i++) {
+        gdouble regex_time;
+        gdouble classifier_time;
+
+        regex_time = benchmark_parser (TRUE, benchmark_responses[i], 100000);
+        classifier_time = benchmark_parser (FALSE, benchmark_responses[i], 100000);
+
+        g_test_message ("response #%u: regex cascade %.3fs, classifier %.3fs (100000 iterations)",
+                        i, regex_time, classifier_time);
+        g_test_minimized_result (classifier_time, "classifier: %.3fs", classifier_time);
+    }
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    g_type_init ();
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/ModemManager/serial-parsers/known-replies", test_known_replies);
+    g_test_add_func ("/ModemManager/serial-parsers/differential", test_differential);
+    g_test_add_func ("/ModemManager/serial-parsers/benchmark", test_benchmark);
+
+    return g_test_run ();
+}
@@ -454,6 +454,40 @@ test_pdu_not_stored (void)
         NULL, 0);
 }
 
+static void
+test_pdu_hex_span (void)
+{
+    /* PDU in the middle of a +CMGL listing, not NUL-terminated */
+    static const gchar *listing =
+        "+CMGL: 1,1,,31\r\n"
+        "07914356060013F1065A098136397339F7219011700463802190117004638030"
+        "\r\n+CMGL: 2,1,,31\r\n";
+    const gchar *hexpdu;
+    MMSmsPart *part;
+    GError *error = NULL;
+
+    hexpdu = strstr (listing, "\r\n") + 2;
+    part = mm_sms_part_3gpp_new_from_hex_pdu (1, hexpdu, strstr (hexpdu, "\r\n") - hexpdu, &error);
+    g_assert_no_error (error);
+    g_assert (part != NULL);
+    g_assert_cmpuint (mm_sms_part_get_index (part), ==, 1);
+    g_assert_cmpstr (mm_sms_part_get_smsc (part), ==, "+34656000311");
+    g_assert_cmpstr (mm_sms_part_get_number (part), ==, "639337937");
+    mm_sms_part_free (part);
+
+    /* Odd number of digits */
+    part = mm_sms_part_3gpp_new_from_hex_pdu (1, hexpdu, 63, &error);
+    g_assert_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED);
+    g_assert (part == NULL);
+    g_clear_error (&error);
+
+    /* Not hex */
+    part = mm_sms_part_3gpp_new_from_hex_pdu (1, listing, 10, &error);
+    g_assert_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED);
+    g_assert (part == NULL);
+    g_clear_error (&error);
+}
+
 /********************* SMS ADDRESS ENCODER TESTS *********************/
 
 static void
@@ -882,6 +916,7 @@ int main (int argc, char **argv)
     g_test_add_func ("/MM/SMS/3GPP/PDU-Parser/pdu-multipart", test_pdu_multipart);
     g_test_add_func ("/MM/SMS/3GPP/PDU-Parser/pdu-stored-by-us", test_pdu_stored_by_us);
     g_test_add_func ("/MM/SMS/3GPP/PDU-Parser/pdu-not-stored", test_pdu_not_stored);
+    g_test_add_func ("/MM/SMS/3GPP/PDU-Parser/pdu-hex-span", test_pdu_hex_span);
 
     g_test_add_func ("/MM/SMS/3GPP/Address-Encoder/smsc-intl", test_address_encode_smsc_intl);
     g_test_add_func ("/MM/SMS/3GPP/Address-Encoder/smsc-unknown", test_address_encode_smsc_unknown);